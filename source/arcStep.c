@@ -0,0 +1,138 @@
+/****************************************************************************************
+ * arcStep.c                                                                            *
+ * Perform a closed-form ray step where the sound speed is a linear function of depth.  *
+ *                                                                                      *
+ * ------------------------------------------------------------------------------------ *
+ * Website:                                                                             *
+ *          https://github.com/EyNuel/cTraceo/wiki                                      *
+ *                                                                                      *
+ * License: This file is part of the cTraceo Raytracing Model and is released under the *
+ *          Creative Commons Attribution-NonCommercial-ShareAlike 3.0 Unported License  *
+ *          http://creativecommons.org/licenses/by-nc-sa/3.0/                           *
+ *                                                                                      *
+ * NOTE:    cTraceo is research code under active development.                          *
+ *          The code may contain bugs and updates are possible in the future.           *
+ *                                                                                      *
+ * Written for project SENSOCEAN by:                                                    *
+ *          Emanuel Ey                                                                  *
+ *          emanuel.ey@gmail.com                                                        *
+ *          Copyright (C) 2011 - 2013                                                   *
+ *          Signal Processing Laboratory                                                *
+ *          Universidade do Algarve                                                     *
+ *                                                                                      *
+ * ------------------------------------------------------------------------------------ *
+ * Used instead of rkf45() when option '--arcStep' is passed.                           *
+ * Where c = c0 + g*(z-z0), the horizontal slowness cos(theta)/c is constant and the    *
+ * ray's curvature d(theta)/ds = -g*cos(theta)/c is constant as well, i.e., the ray is  *
+ * a circular arc (or a straight line, if g = 0). This applies to isovelocity (ISOV)    *
+ * and linear (LINP) profiles and to the first and last interval of tabulated profiles  *
+ * (TABL), which cValues1D() interpolates linearly.                                     *
+ *                                                                                      *
+ * Inputs:                                                                              *
+ *          cursor: Lookup cursor of the ray being traced.                              *
+ *          ds:     Step size (arc length).                                             *
+ *          yOld:   Vector containing initial value of y (see rkf45.c).                 *
+ *                                                                                      *
+ * Outputs:                                                                             *
+ *          yNew:   Vector containing new values of of y.                               *
+ *          fNew:   Vector containing new values of of F.                               *
+ *                                                                                      *
+ * Return Value:                                                                        *
+ *          true:   if the step was taken.                                              *
+ *          false:  if the sound speed isn't linear along the whole step; yNew and fNew *
+ *                  are not modified and the step has to be integrated numerically.     *
+ *                                                                                      *
+ ****************************************************************************************/
+
+#pragma     once
+#include    <stdbool.h>
+#include    "globals.h"
+#include    "csValues.c"
+#include    "math.h"
+
+bool    arcStep(settings_t*, lookupCursor_t*, double, double*, double*, double*);
+
+bool    arcStep(settings_t* settings, lookupCursor_t* cursor, double ds, double* yOld, double* yNew, double* fNew){
+    DEBUG(6,"in\n");
+    soundSpeed_t*   ssp     = &settings->soundSpeed;
+    uintptr_t       n       = ssp->nz;
+    double          zMin    = -INFINITY;    //depths between which the sound speed is linear
+    double          zMax    =  INFINITY;
+    double          ci, cc, sigmaI, cri, czi, crri, czzi, crzi;
+    double          cosOld, sinOld, cosHalf, sinHalf, cosMid, sinMid, cosNew, sinNew;
+    double          kappa, halfAngle, sinc, zNew, zTurn;
+    vector_t        slowness;
+
+    if(ssp->cDist != C_DIST__PROFILE){
+        return false;
+    }
+    switch(ssp->cClass){
+        case C_CLASS__ISOVELOCITY:
+        case C_CLASS__LINEAR:
+            break;
+
+        case C_CLASS__TABULATED:
+            //only the first and last interval are linear (unless there are no others):
+            if(yOld[1] < ssp->z[1]){
+                if(n > 2){
+                    zMax = ssp->z[1];
+                }
+            }else if(yOld[1] >= ssp->z[n-2]){
+                if(n > 2){
+                    zMin = ssp->z[n-2];
+                }
+            }else{
+                return false;
+            }
+            break;
+
+        default:
+            return false;
+    }
+
+    //sound speed and its gradient at the start of the step:
+    ssp->cValues(ssp, cursor, yOld[0], yOld[1], &ci, &cri, &czi, &crri, &czzi, &crzi);
+
+    sigmaI      = sqrt( yOld[2]*yOld[2] + yOld[3]*yOld[3] );
+    cosOld      = yOld[2] / sigmaI;
+    sinOld      = yOld[3] / sigmaI;
+    kappa       = -czi * cosOld / ci;
+
+    //the ray turns by kappa*ds; use the chord through the arc's midpoint (exact for kappa = 0):
+    halfAngle   = 0.5 * kappa * ds;
+    if(fabs(2*halfAngle) > 0.5*M_PI){
+        return false;
+    }
+    cosHalf     = cos(halfAngle);
+    sinHalf     = sin(halfAngle);
+    sinc        = (halfAngle == 0) ? 1.0 : sinHalf / halfAngle;
+    cosMid      = cosOld * cosHalf - sinOld * sinHalf;
+    sinMid      = sinOld * cosHalf + cosOld * sinHalf;
+    cosNew      = cosMid * cosHalf - sinMid * sinHalf;
+    sinNew      = sinMid * cosHalf + cosMid * sinHalf;
+    zNew        = yOld[1] + ds * sinMid * sinc;
+
+    //verify that the arc doesn't leave the linear interval, including at its turning point:
+    if(zNew < zMin || zNew >= zMax){
+        return false;
+    }
+    if(sinOld * sinNew < 0){
+        zTurn = yOld[1] - ( copysign(1.0, cosOld) - cosOld ) / kappa;
+        if(zTurn < zMin || zTurn >= zMax){
+            return false;
+        }
+    }
+
+    yNew[0] = yOld[0] + ds * cosMid * sinc;
+    yNew[1] = zNew;
+
+    csValues(settings, cursor, yNew[0], yNew[1], &ci, &cc, &sigmaI, &cri, &czi, &slowness, &crri, &czzi, &crzi);
+    yNew[2] = sigmaI * cosNew;
+    yNew[3] = sigmaI * sinNew;
+    fNew[0] = cosNew;
+    fNew[1] = sinNew;
+    fNew[2] = slowness.r;
+    fNew[3] = slowness.z;
+    DEBUG(6,"out\n");
+    return true;
+}
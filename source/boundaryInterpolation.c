@@ -35,6 +35,8 @@
  *  Inputs:                                                                             *
  *          interface:  A pointer of type interface_t, containing the parameters        *
  *                      of the interface.                                               *
+ *          cursor:     interval of interface->r found by the previous lookup (or       *
+ *                      NULL); updated with the new interval (see bracketHunt()).       *
  *          ri:         range of interpolation point.                                   *
  *                                                                                      *
  *  Outputs:                                                                            *
@@ -51,12 +53,18 @@
 #include    "globals.h"
 #include    "interpolation.h"
 
+#define BOUNDARY_BOUNDS_MARGIN  1.0e-9  //[m], added to the depth bounds of each interval to absorb rounding errors
 
 
-void boundaryInterpolationExplicit(uint32_t*, double*, double*, uint32_t*, double, double*, vector_t*, vector_t*);
-void boundaryInterpolation(interface_t*, double, double*, vector_t*, vector_t*);
+void boundaryInterpolationExplicit(uint32_t*, double*, const uniformGrid_t*, uintptr_t*, double*, uint32_t*, double, double*, vector_t*, vector_t*);
+void boundaryInterpolation(interface_t*, uintptr_t*, double, double*, vector_t*, vector_t*);
+void boundaryTangent(double, vector_t*, vector_t*);
+uintptr_t boundarySegmentIndex(interface_t*, uintptr_t*, double);
+void boundaryPolynomial(interface_t*, uintptr_t, double*);
+void initBoundarySegments(interface_t*);
+bool boundaryDepthBounds(interface_t*, uintptr_t*, double, double*, double*);
 
-void boundaryInterpolationExplicit(uint32_t* numSurfaceCoords, double* r, double* z, uint32_t* surfaceInterpolation, double ri, double* zi, vector_t* taub, vector_t* normal){
+void boundaryInterpolationExplicit(uint32_t* numSurfaceCoords, double* r, const uniformGrid_t* rUniform, uintptr_t* cursor, double* z, uint32_t* surfaceInterpolation, double ri, double* zi, vector_t* taub, vector_t* normal){
     DEBUG(5,"in\n");
         
     double      zri = 0;    //1st derivative of z at ri
@@ -76,7 +84,7 @@ void boundaryInterpolationExplicit(uint32_t* numSurfaceCoords, double* r, double
             
         case SURFACE_INTERPOLATION__2P:
             DEBUG(5,"2P surface interpolation\n");
-            bracket(*numSurfaceCoords, r, ri, &i);
+            bracketHunt(*numSurfaceCoords, r, rUniform, ri, cursor, &i);
             intLinear1D( &(r[i]), &(z[i]),ri,zi,&zri);
             break;
             
@@ -91,11 +99,54 @@ void boundaryInterpolationExplicit(uint32_t* numSurfaceCoords, double* r, double
             }else if(ri >= r[*numSurfaceCoords - 2]){
                 i = *numSurfaceCoords - 3;
             }else{
-                bracket( *numSurfaceCoords, &(r[0]), ri, &i);
+                bracketHunt( *numSurfaceCoords, &(r[0]), rUniform, ri, cursor, &i);
             }
             intBarycCubic1D( &(r[i-1]), &(z[i-1]), ri, zi, &zri, &zrri);
     }
 
+    boundaryTangent(zri, taub, normal);
+    DEBUG(5,"out\n");
+}
+
+void boundaryInterpolation(interface_t* interface, uintptr_t* cursor, double ri, double* zi, vector_t* taub, vector_t* normal){
+    uintptr_t   n = interface->numSurfaceCoords;
+    uintptr_t   i, j;
+    double      t, zri, zrri;
+    
+    if (interface->segments == NULL){
+        boundaryInterpolationExplicit(  &(interface->numSurfaceCoords),
+                                        interface->r,
+                                        &(interface->rUniform),
+                                        cursor,
+                                        interface->z,
+                                        &(interface->surfaceInterpolation),
+                                        ri, zi, taub, normal);
+        return;
+    }
+    //use the precomputed table (see initBoundarySegments()), with the same arithmetic as boundaryInterpolationExplicit():
+    switch(interface->surfaceInterpolation){
+        case SURFACE_INTERPOLATION__4P:
+            i = boundarySegmentIndex(interface, cursor, ri);
+            j = min(max(i, 1), n-3);
+            intBarycCubic1DEval(&interface->r[j-1], interface->z[j-1], interface->segments[i].a, ri, zi, &zri, &zrri);
+            break;
+            
+        default:
+            //points outside of the interface use its first interval:
+            i = 0;
+            bracketHunt(n, interface->r, &interface->rUniform, ri, cursor, &i);
+            t   = ri - interface->r[i];
+            zri = interface->segments[i].c[1];
+            *zi = interface->segments[i].c[0] + t * zri;
+            break;
+    }
+    boundaryTangent(zri, taub, normal);
+}
+
+void boundaryTangent(double zri, vector_t* taub, vector_t* normal){
+    /*
+     * Returns the unit tangent and normal vectors of a boundary with slope zri.
+     */
     taub->r = cos( atan(zri));
     taub->z = sin( atan(zri));
 
@@ -108,13 +159,129 @@ void boundaryInterpolationExplicit(uint32_t* numSurfaceCoords, double* r, double
     
     normal->r = -taub->z; 
     normal->z =  taub->r;
-    DEBUG(5,"out\n");
 }
 
-void boundaryInterpolation(interface_t* interface, double ri, double* zi, vector_t* taub, vector_t* normal){
-    boundaryInterpolationExplicit(  &(interface->numSurfaceCoords),
-                                    interface->r,
-                                    interface->z,
-                                    &(interface->surfaceInterpolation),
-                                    ri, zi, taub, normal);
+uintptr_t boundarySegmentIndex(interface_t* interface, uintptr_t* cursor, double ri){
+    /*
+     * Returns the interval of interface->r containing ri; ranges outside of the interface
+     * belong to its first or last interval.
+     */
+    uintptr_t   i;
+    
+    if (bracketHunt(interface->numSurfaceCoords, interface->r, &interface->rUniform, ri, cursor, &i) == 0){
+        i = (ri < interface->r[0]) ? 0 : interface->numSurfaceCoords - 2;
+    }
+    return i;
+}
+
+void boundaryPolynomial(interface_t* interface, uintptr_t i, double* c){
+    /*
+     * Returns the coefficients of a 2P or 4P interface's depth in interval i, such that
+     * z(r) = c[0] + c[1]*t + c[2]*t^2 + c[3]*t^3, with t = r - r[i].
+     */
+    uintptr_t   n = interface->numSurfaceCoords;
+    uintptr_t   j;
+    double      a[3];
+    
+    if (interface->segments != NULL){
+        for (j=0; j<4; j++){
+            c[j] = interface->segments[i].c[j];
+        }
+        return;
+    }
+    switch(interface->surfaceInterpolation){
+        case SURFACE_INTERPOLATION__4P:
+            //same stencil as boundaryInterpolationExplicit():
+            j = min(max(i, 1), n-3);
+            intBarycCubic1DCoeffs(&interface->r[j-1], &interface->z[j-1], a);
+            intBarycCubic1DEval(&interface->r[j-1], interface->z[j-1], a, interface->r[i], &c[0], &c[1], &c[2]);
+            c[2] /= 2;
+            c[3]  = a[0] + a[1] + a[2];
+            break;
+            
+        default:
+            c[0] = interface->z[i];
+            c[1] = (interface->z[i+1] - interface->z[i]) / (interface->r[i+1] - interface->r[i]);
+            c[2] = 0;
+            c[3] = 0;
+            break;
+    }
+}
+
+void initBoundarySegments(interface_t* interface){
+    /*
+     * Precomputes the polynomial (and, for 4P, the barycentric weights) and the depth
+     * bounds of each interval [r[i], r[i+1]] of a 2P or 4P interface, so that
+     * boundaryInterpolation() only needs to evaluate them and solveEikonalEq() can skip
+     * the interface wherever a ray is clear of it (see boundaryDepthBounds()). Other
+     * interfaces are left without a table.
+     * Must be called again whenever r or z change; the previous table is not freed, as it
+     * may still be shared with other settings.
+     */
+    uintptr_t           n = interface->numSurfaceCoords;
+    uintptr_t           i, k;
+    boundarySegment_t*  segment;
+    double              t[2], dt, q, disc, z;
+    
+    interface->segments = NULL;
+    if (!(  (interface->surfaceInterpolation == SURFACE_INTERPOLATION__2P && n >= 2) ||
+            (interface->surfaceInterpolation == SURFACE_INTERPOLATION__4P && n >= 4))){
+        return;
+    }
+    
+    //compute the polynomials before setting interface->segments, as boundaryPolynomial() would use it:
+    segment = malloc((n-1) * sizeof(boundarySegment_t));
+    if (segment == NULL){
+        fatal("Memory alocation error.");
+    }
+    for (i=0; i<n-1; i++){
+        boundaryPolynomial(interface, i, segment[i].c);
+        if (interface->surfaceInterpolation == SURFACE_INTERPOLATION__4P){
+            k = min(max(i, 1), n-3);
+            intBarycCubic1DCoeffs(&interface->r[k-1], &interface->z[k-1], segment[i].a);
+        }
+        
+        //the depth's extremes within the interval are at its ends or at the roots of c[1] + 2*c[2]*t + 3*c[3]*t^2:
+        dt = interface->r[i+1] - interface->r[i];
+        segment[i].zMin = min(segment[i].c[0], segment[i].c[0] + dt * (segment[i].c[1] + dt * (segment[i].c[2] + dt * segment[i].c[3])));
+        segment[i].zMax = max(segment[i].c[0], segment[i].c[0] + dt * (segment[i].c[1] + dt * (segment[i].c[2] + dt * segment[i].c[3])));
+        k = 0;
+        if (segment[i].c[3] != 0){
+            disc = segment[i].c[2]*segment[i].c[2] - 3*segment[i].c[1]*segment[i].c[3];
+            if (disc > 0){
+                q = -(segment[i].c[2] + copysign(sqrt(disc), segment[i].c[2]));
+                t[k++] = q / (3*segment[i].c[3]);
+                t[k++] = segment[i].c[1] / q;
+            }
+        }else if (segment[i].c[2] != 0){
+            t[k++] = -segment[i].c[1] / (2*segment[i].c[2]);
+        }
+        while (k > 0){
+            k--;
+            if (t[k] > 0 && t[k] < dt){
+                z = segment[i].c[0] + t[k] * (segment[i].c[1] + t[k] * (segment[i].c[2] + t[k] * segment[i].c[3]));
+                segment[i].zMin = min(segment[i].zMin, z);
+                segment[i].zMax = max(segment[i].zMax, z);
+            }
+        }
+        segment[i].zMin -= BOUNDARY_BOUNDS_MARGIN;
+        segment[i].zMax += BOUNDARY_BOUNDS_MARGIN;
+    }
+    interface->segments = segment;
+}
+
+bool boundaryDepthBounds(interface_t* interface, uintptr_t* cursor, double ri, double* zMin, double* zMax){
+    /*
+     * Returns the minimum and maximum depth of an interface within the interval containing ri,
+     * or false if the interface has no table (see initBoundarySegments()) or ri lies outside of it.
+     */
+    uintptr_t   i;
+    
+    if (interface->segments == NULL || ri < interface->r[0] || ri > interface->r[interface->numSurfaceCoords-1]){
+        return false;
+    }
+    i = boundarySegmentIndex(interface, cursor, ri);
+    *zMin = interface->segments[i].zMin;
+    *zMax = interface->segments[i].zMax;
+    return true;
 }
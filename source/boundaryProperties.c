@@ -0,0 +1,163 @@
+/****************************************************************************************
+ * boundaryProperties.c                                                                 *
+ * Interpolate the properties of non-homogeneous elastic boundaries.                    *
+ *                                                                                      *
+ * ------------------------------------------------------------------------------------ *
+ * Website:                                                                             *
+ *          https://github.com/EyNuel/cTraceo/wiki                                      *
+ *                                                                                      *
+ * License: This file is part of the cTraceo Raytracing Model and is released under the *
+ *          Creative Commons Attribution-NonCommercial-ShareAlike 3.0 Unported License  *
+ *          http://creativecommons.org/licenses/by-nc-sa/3.0/                           *
+ *                                                                                      *
+ * NOTE:    cTraceo is research code under active development.                          *
+ *          The code may contain bugs and updates are possible in the future.           *
+ *                                                                                      *
+ * Written for project SENSOCEAN by:                                                    *
+ *          Emanuel Ey                                                                  *
+ *          emanuel.ey@gmail.com                                                        *
+ *          Copyright (C) 2011 - 2013                                                   *
+ *          Signal Processing Laboratory                                                *
+ *          Universidade do Algarve                                                     *
+ *                                                                                      *
+ * ------------------------------------------------------------------------------------ *
+ * The properties of a non-homogeneous interface (density, speeds and attenuations) are *
+ * stored interleaved per coordinate by initBoundaryProperties(), with the attenuations *
+ * already converted to dB/lambda. Thus boundaryProperties() finds the interval only    *
+ * once per reflection and interpolates all properties with the same stencil as         *
+ * boundaryInterpolationExplicit().                                                     *
+ * Attenuations given per meter or per neper are proportional to the wavelength and are *
+ * stored for a frequency of 1 Hz; they are scaled to the ray's frequency on lookup, so *
+ * that one table serves all frequencies (see calcBroadband.c).                         *
+ *                                                                                      *
+ * Inputs:                                                                              *
+ *          interface: Interface whose properties are interpolated.                     *
+ *          cursor:    Lookup cursor of the interface (see lookupCursor_t).             *
+ *          ri:        Range of interpolation point.                                    *
+ *          freq:      Frequency.                                                       *
+ *                                                                                      *
+ * Outputs:                                                                             *
+ *          prop:      Interpolated properties, with attenuations in dB/lambda.         *
+ *                                                                                      *
+ * Return Value:                                                                        *
+ *          None                                                                        *
+ *                                                                                      *
+ ****************************************************************************************/
+
+#pragma     once
+#include    "globals.h"
+#include    "tools.h"
+#include    "bracket.c"
+#include    "convertUnits.c"
+
+void    initBoundaryProperties(interface_t*);
+void    boundaryProperties(interface_t*, uintptr_t*, double, double, boundaryProperties_t*);
+double  boundaryPropertyLinear(double, double, double, double);
+double  boundaryPropertyCubic(double, double, double, double, const double*, const double*);
+
+void    initBoundaryProperties(interface_t* interface){
+    /*
+     * Builds the interleaved property table of a non-homogeneous elastic interface; other
+     * interfaces are left without a table.
+     */
+    uintptr_t               n = interface->numSurfaceCoords;
+    uintptr_t               i;
+    boundaryProperties_t*   prop;
+    double                  freq = 1.0;     //see header
+    
+    interface->properties = NULL;
+    if (interface->surfaceType         != SURFACE_TYPE__ELASTIC ||
+        interface->surfacePropertyType != SURFACE_PROPERTY_TYPE__NON_HOMOGENEOUS){
+        return;
+    }
+    prop = malloc(n * sizeof(boundaryProperties_t));
+    if (prop == NULL){
+        fatal("Memory alocation error.");
+    }
+    for (i=0; i<n; i++){
+        prop[i].rho = interface->rho[i];
+        prop[i].cp  = interface->cp[i];
+        prop[i].cs  = interface->cs[i];
+        //at 1 Hz, the wavelength equals the speed:
+        convertUnits(&interface->ap[i], &interface->cp[i], &freq, &interface->surfaceAttenUnits, &prop[i].ap);
+        convertUnits(&interface->as[i], &interface->cs[i], &freq, &interface->surfaceAttenUnits, &prop[i].as);
+    }
+    interface->properties = prop;
+}
+
+double  boundaryPropertyLinear(double dxi, double dx, double f0, double f1){
+    /*
+     * Same as intLinear1D(), given dxi = xi - x[0] and dx = x[1] - x[0].
+     */
+    return f0 + dxi * ((f1 - f0) / dx);
+}
+
+double  boundaryPropertyCubic(double f0, double f1, double f2, double f3, const double* px, const double* pxi){
+    /*
+     * Same as intBarycCubic1D(), given the products px of intBarycCubic1DCoeffs() and
+     * pxi of intBarycCubic1DEval().
+     */
+    return f0 + (f1 - f0) / px[0] * pxi[0] + (f2 - f0) / px[1] * pxi[1] + (f3 - f0) / px[2] * pxi[2];
+}
+
+void    boundaryProperties(interface_t* interface, uintptr_t* cursor, double ri, double freq, boundaryProperties_t* prop){
+    DEBUG(5,"in\n");
+    boundaryProperties_t*   p = interface->properties;
+    uintptr_t               n = interface->numSurfaceCoords;
+    uintptr_t               i = 0;
+    double*                 x;
+    double                  dxi, dx, px[3], pxi[3];
+    
+    switch(interface->surfaceInterpolation){
+        case SURFACE_INTERPOLATION__4P:
+            if (ri <= interface->r[1]){
+                i = 1;
+            }else if(ri >= interface->r[n - 2]){
+                i = n - 3;
+            }else{
+                bracketHunt(n, interface->r, &interface->rUniform, ri, cursor, &i);
+            }
+            x = &interface->r[i-1];
+            p = &p[i-1];
+            px[0]  = ( x[1] - x[0] )*( x[1] - x[2] )*( x[1] - x[3] );
+            px[1]  = ( x[2] - x[0] )*( x[2] - x[1] )*( x[2] - x[3] );
+            px[2]  = ( x[3] - x[0] )*( x[3] - x[1] )*( x[3] - x[2] );
+            pxi[0] = ( ri - x[0] )*( ri - x[2] )*( ri - x[3] );
+            pxi[1] = ( ri - x[0] )*( ri - x[1] )*( ri - x[3] );
+            pxi[2] = ( ri - x[0] )*( ri - x[1] )*( ri - x[2] );
+            prop->rho = boundaryPropertyCubic(p[0].rho, p[1].rho, p[2].rho, p[3].rho, px, pxi);
+            prop->cp  = boundaryPropertyCubic(p[0].cp,  p[1].cp,  p[2].cp,  p[3].cp,  px, pxi);
+            prop->cs  = boundaryPropertyCubic(p[0].cs,  p[1].cs,  p[2].cs,  p[3].cs,  px, pxi);
+            prop->ap  = boundaryPropertyCubic(p[0].ap,  p[1].ap,  p[2].ap,  p[3].ap,  px, pxi);
+            prop->as  = boundaryPropertyCubic(p[0].as,  p[1].as,  p[2].as,  p[3].as,  px, pxi);
+            break;
+            
+        case SURFACE_INTERPOLATION__3P:
+            fatal("Error: Parabolic (3P) interpolation is no longer supported as it causes incorrect results.\nPlease use a different type of Boundary interpolation.");
+            break;
+            
+        default:
+            //flat and sloped interfaces are interpolated between their first two coordinates:
+            if (interface->surfaceInterpolation == SURFACE_INTERPOLATION__2P){
+                bracketHunt(n, interface->r, &interface->rUniform, ri, cursor, &i);
+            }
+            x = &interface->r[i];
+            p = &p[i];
+            dxi = ri - x[0];
+            dx  = x[1] - x[0];
+            prop->rho = boundaryPropertyLinear(dxi, dx, p[0].rho, p[1].rho);
+            prop->cp  = boundaryPropertyLinear(dxi, dx, p[0].cp,  p[1].cp);
+            prop->cs  = boundaryPropertyLinear(dxi, dx, p[0].cs,  p[1].cs);
+            prop->ap  = boundaryPropertyLinear(dxi, dx, p[0].ap,  p[1].ap);
+            prop->as  = boundaryPropertyLinear(dxi, dx, p[0].as,  p[1].as);
+            break;
+    }
+    
+    //attenuations proportional to the wavelength were stored for 1 Hz:
+    if (interface->surfaceAttenUnits == SURFACE_ATTEN_UNITS__dBperMeter ||
+        interface->surfaceAttenUnits == SURFACE_ATTEN_UNITS__dBperNeper){
+        prop->ap /= freq;
+        prop->as /= freq;
+    }
+    DEBUG(5,"out\n");
+}
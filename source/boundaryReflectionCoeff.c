@@ -53,6 +53,7 @@
 #include <math.h>
 
 void    boundaryReflectionCoeff(double*, double*, double*, double*, double*, double*, double*, double*, complex double*);
+complex double  boundaryReflectionG(double, double, double, double, double, double, double);
 
 void    boundaryReflectionCoeff(double* rho1, double* rho2, double* cp1, double* cp2, double* cs2, double* ap,
                                 double* as, double* theta, complex double* refl){
@@ -81,3 +82,28 @@ void    boundaryReflectionCoeff(double* rho1, double* rho2, double* cp1, double*
     *refl = ( d * ccos( *theta ) -1) / ( d * ccos( *theta ) + 1);
 }
 
+complex double  boundaryReflectionG(double rho1, double rho2, double cp2, double cs2, double ap, double as, double s){
+    /*
+     * The reflection coefficient computed by boundaryReflectionCoeff() only depends on the
+     * water's sound speed cp1 and the angle theta through the horizontal slowness
+     * s = sin(theta)/cp1 and the vertical slowness cos(theta)/cp1:
+     *      refl = (g * cos(theta)/cp1 - 1) / (g * cos(theta)/cp1 + 1),
+     * with g = d * cp1 returned by this function (see reflectionTable.c).
+     */
+    double          tilap, tilas;
+    complex double  a4, a5, a6, a7;
+    complex double  tilcp2, tilcs2;
+
+    tilap = ap/( 40.0 * M_PI * M_LOG10E );
+    tilas = as/( 40.0 * M_PI * M_LOG10E );
+
+    tilcp2 = cp2 * (1 - I * tilap) / (1 + tilap * tilap);
+    tilcs2 = cs2 * (1 - I * tilas) / (1 + tilas * tilas);
+
+    a4  = tilcs2 * s;
+    a5  = 2*a4 * a4;
+    a6  = tilcp2 * s;
+    a7  = 2*a5 - a5*a5;
+
+    return rho2 / rho1 * ( tilcp2 * (1 - a7 ) / csqrt( 1 - a6 * a6 ) + tilcs2 * a7 / csqrt(1 - 0.5*a5) );
+}
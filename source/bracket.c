@@ -53,8 +53,21 @@
 
 #pragma  once
 #include <stdint.h>
+#include <stdbool.h>
+#include <math.h>
+#include "globals.h"
+
+/*
+ * Maximum deviation of a table's points from a uniform grid, in fractions of the mean
+ * spacing, for the table to be considered uniform by initUniformGrid().
+ * Larger deviations would still give correct results, but take longer to correct.
+ */
+#define UNIFORM_GRID_TOLERANCE  0.1
 
 uintptr_t   bracket(uintptr_t, double*, double, uintptr_t*);
+void        initUniformGrid(uintptr_t, double*, uniformGrid_t*);
+uintptr_t   bracketUniform(uintptr_t, double*, const uniformGrid_t*, double, uintptr_t*);
+uintptr_t   bracketHunt(uintptr_t, double*, const uniformGrid_t*, double, uintptr_t*, uintptr_t*);
 
 uintptr_t   bracket(uintptr_t n, double* x, double xi, uintptr_t* i){
     DEBUG(5, "Entering bracket().\n");
@@ -97,3 +110,135 @@ uintptr_t   bracket(uintptr_t n, double* x, double xi, uintptr_t* i){
     }
     DEBUG(5, "Leaving bracket().\n");
 }
+
+void        initUniformGrid(uintptr_t n, double* x, uniformGrid_t* grid){
+    /*
+     * Determines whether the points of a lookup table lie on a uniform grid (within
+     * UNIFORM_GRID_TOLERANCE), which is typically the case for tables taken from gridded
+     * ocean models.
+     */
+    double      dx;
+    uintptr_t   i;
+
+    grid->isUniform = false;
+    grid->x0        = 0.0;
+    grid->invDx     = 0.0;
+
+    if(n < 3 || !(x[n-1] > x[0])){
+        return;
+    }
+    dx = (x[n-1] - x[0]) / (double)(n-1);
+    for(i=1; i<n-1; i++){
+        if(fabs(x[i] - (x[0] + (double)i * dx)) > UNIFORM_GRID_TOLERANCE * dx){
+            return;
+        }
+    }
+    grid->isUniform = true;
+    grid->x0        = x[0];
+    grid->invDx     = 1.0 / dx;
+    DEBUG(3, "Table with %u points is uniform, dx: %e\n", (uint32_t)n, dx);
+}
+
+uintptr_t   bracketUniform(uintptr_t n, double* x, const uniformGrid_t* grid, double xi, uintptr_t* i){
+    /*
+     * Same as bracket(), but computes the index directly for tables marked as uniform by
+     * initUniformGrid(). The estimate is corrected against the actual table points, so
+     * that the result is always the same as bracket()'s.
+     * grid may be NULL, in which case bracket() is used.
+     */
+    double      t;
+    uintptr_t   k;
+
+    if(grid == NULL || !grid->isUniform){
+        return bracket(n, x, xi, i);
+    }
+    if( (xi < x[0]) || (xi > x[n-1])){
+        DEBUG(1, "bracketUniform(): xi is outside of bounds.\n");
+        return 0;
+    }
+
+    t = (xi - grid->x0) * grid->invDx;
+    if(t < (double)(n-2)){
+        k = (uintptr_t)t;
+    }else{
+        k = n-2;
+    }
+    while(k > 0 && xi < x[k]){
+        k--;
+    }
+    while(k < n-2 && xi >= x[k+1]){
+        k++;
+    }
+    *i = k;
+    return 1;
+}
+
+uintptr_t   bracketHunt(uintptr_t n, double* x, const uniformGrid_t* grid, double xi, uintptr_t* cursor, uintptr_t* i){
+    /*
+     * Same as bracketUniform(), but starts searching at the interval found by the
+     * previous call (*cursor) and walks away from it with increasing steps ("hunting"),
+     * which is much faster when successive lookups are close to each other, as is the
+     * case along a ray (see lookupCursor_t). The cursor is updated with the result.
+     * For non-decreasing tables, the result is always the same as bracket()'s.
+     * cursor may be NULL, in which case bracketUniform() is used.
+     */
+    uintptr_t   lo, hi, im, step;
+
+    if(cursor == NULL){
+        return bracketUniform(n, x, grid, xi, i);
+    }
+    if( (xi < x[0]) || (xi > x[n-1])){
+        DEBUG(1, "bracketHunt(): xi is outside of bounds.\n");
+        return 0;
+    }
+
+    lo = *cursor;
+    if(lo > n-2){
+        lo = n-2;
+    }
+    //most lookups fall into the same interval as the previous one:
+    if(xi >= x[lo] && (lo == n-2 || xi < x[lo+1])){
+        *i = lo;
+        return 1;
+    }
+    //bracket() returns the last interval for all points beyond x[n-2]:
+    if(xi >= x[n-2]){
+        *cursor = *i = n-2;
+        return 1;
+    }
+    if(grid != NULL && grid->isUniform){
+        bracketUniform(n, x, grid, xi, i);
+        *cursor = *i;
+        return 1;
+    }
+
+    //hunt for an interval [lo, hi] such that x[lo] <= xi < x[hi]:
+    step = 1;
+    if(xi >= x[lo]){
+        hi = (n-2 - lo > step) ? lo + step : n-2;
+        while(xi >= x[hi]){
+            lo = hi;
+            step *= 2;
+            hi = (n-2 - lo > step) ? lo + step : n-2;
+        }
+    }else{
+        hi = lo;
+        lo = (hi > step) ? hi - step : 0;
+        while(xi < x[lo]){
+            hi = lo;
+            step *= 2;
+            lo = (hi > step) ? hi - step : 0;
+        }
+    }
+    //and bisect it:
+    while(hi - lo > 1){
+        im = (lo + hi)/2;
+        if(xi < x[im]){
+            hi = im;
+        }else{
+            lo = im;
+        }
+    }
+    *cursor = *i = lo;
+    return 1;
+}
@@ -35,6 +35,9 @@
  *          (TODO)
  ****************************************************************************************/
 
+#ifndef WINDOWS
+    #define _POSIX_C_SOURCE 200809L     //for fmemopen(), open_memstream() and dup() (see '--worker')
+#endif
 #include <assert.h>
 #include <stdio.h>
 #include "globals.h"
@@ -50,10 +53,20 @@
 #include "calcCohTransLoss.c"
 #include "calcParticleVel.c"
 #include "calcSSP.c"
+#include "calcNx2D.c"
+#include "calcEnsemble.c"
+#include "calcBroadband.c"
+#include "calcSources.c"
+#include "reflectionTable.c"
 #include <time.h>
 #include <string.h>
 #include <stdbool.h>
 #include "logOptions.c"
+#include "toolsWorker.c"
+#ifndef WINDOWS
+    #include <unistd.h>
+    #include <sys/wait.h>
+#endif
 #if USE_MATLAB == 1
     #include <mat.h>
     #include "matrix.h"
@@ -61,7 +74,26 @@
     #include    "matOut/matOut.h"
 #endif
 
+typedef struct batchWorker{
+    /*
+     * Arguments of one worker thread of a batch run (see '--batch', '--jobs').
+     * Cases are distributed among workers in an interleaved fashion.
+     */
+    settings_t*     settings;               //holds the command line options, which apply to all cases
+    char**          caseNames;
+    char**          outputFileNames;
+    uintptr_t       nCases;
+    uint32_t        iThread;
+    uint32_t        nThreads;
+}batchWorker_t;
+
 void    printHelp(void);
+void    writeShard(settings_t*);
+void    runCase(settings_t*);
+void*   runBatchWorker(void*);
+void    runBatch(settings_t*);
+FILE*   openWorkerReplyStream(void);
+void    runWorker(settings_t*, FILE*);
 int     main(int, char**);
 
 void    printHelp(void){
@@ -143,6 +175,114 @@ printf(""
 "*                              Specify a custom file name for the output      *\n"
 "*                              generated by cTraceo.                          *\n"
 "*                                                                             *\n"
+"*          --threads <#>       Trace rays on # parallel threads. Applies to   *\n"
+"*                              all output options except ADR; results for any *\n"
+"*                              fixed number of threads are reproducible.      *\n"
+"*                              Default: 1.                                    *\n"
+"*                                                                             *\n");
+printf(""
+"*          --rkTolerance <tol> Integrate the rays with an adaptive step size, *\n"
+"*                              keeping the estimated error of each step below *\n"
+"*                              <tol> (in meters for the ray's coordinates,    *\n"
+"*                              relative for its slowness vector). The first   *\n"
+"*                              step is the input file's ray step. Default:    *\n"
+"*                              fixed ray step.                                *\n"
+"*                                                                             *\n"
+"*          --rkMaxStep <m>     Maximum step size [m] of the adaptive step     *\n"
+"*                              size (see '--rkTolerance'). Larger steps speed *\n"
+"*                              up smooth environments, but coarsen the ray's  *\n"
+"*                              coordinates, from which amplitudes and travel  *\n"
+"*                              times are interpolated. Default: the input     *\n"
+"*                              file's ray step.                               *\n"
+"*                                                                             *\n"
+"*          --arcStep           Where the sound speed is a linear function of  *\n"
+"*                              depth (ISOV and LINP profiles, first and last  *\n"
+"*                              interval of TABL profiles), step the rays in   *\n"
+"*                              closed form (straight lines and circular arcs) *\n"
+"*                              instead of by Runge-Kutta integration.         *\n"
+"*                              Default: Runge-Kutta integration everywhere.   *\n"
+"*                                                                             *\n"
+"*          --denseOutput       Interpolate the rays' depth, travel time,      *\n"
+"*                              amplitude and beam spreading at the            *\n"
+"*                              hydrophones with cubic Hermite polynomials     *\n"
+"*                              (instead of linearly), so that larger ray      *\n"
+"*                              steps (see '--rkMaxStep') can be used.         *\n"
+"*                                                                             *\n"
+"*          --reflectionTable <n>                                              *\n"
+"*                              Tabulate the reflection coefficients of        *\n"
+"*                              homogeneous elastic boundaries and objects at  *\n"
+"*                              <n> values of the ray's horizontal slowness    *\n"
+"*                              and interpolate them, instead of evaluating    *\n"
+"*                              them at each reflection. The tables' maximum   *\n"
+"*                              error is written to the log file. Default: no  *\n"
+"*                              tables.                                        *\n"
+"*                                                                             *\n");
+printf(""
+"*          --shard <k/N>       Trace only the k-th of N equal slices of the   *\n"
+"*                              launching angles and write the raw partial     *\n"
+"*                              results to '<xxx>.shard<k>of<N>' (or the file  *\n"
+"*                              given by '--outputFileName'). Run all N shards *\n"
+"*                              (e.g., on different machines) and combine them *\n"
+"*                              with 'ctraceo-merge <input file> <shards...>'. *\n"
+"*                              Applies to the CPR, CTL, PVL, PAV, EPR and ADP *\n"
+"*                              output options. N may not exceed the number of *\n"
+"*                              launching angles.                              *\n"
+"*                                                                             *\n"
+"*          --nx2d <file>       Nx2D mode: trace each bearing listed in the    *\n"
+"*                              grid file through its gridded bathymetry (and  *\n"
+"*                              optional sound speed volume), on parallel      *\n"
+"*                              threads (see '--threads'), and write a single  *\n"
+"*                              pressure/TL cube. Applies to the CPR and CTL   *\n"
+"*                              output options. The grid file's format is      *\n"
+"*                              described in calcNx2D.c.                       *\n"
+"*                                                                             *\n"
+"*          --ensemble <file>   Run each sound speed realization listed in the *\n"
+"*                              ensemble file on the input file's geometry, on *\n"
+"*                              parallel threads (see '--threads'), and stack  *\n"
+"*                              the results of all members in a single output  *\n"
+"*                              file. Applies to the CPR, CTL, EPR and ADP     *\n"
+"*                              output options. The ensemble file's format is  *\n"
+"*                              described in calcEnsemble.c.                   *\n"
+"*                                                                             *\n");
+printf(""
+"*          --broadband <file>  Trace the rays once and calculate the pressure *\n"
+"*                              or TL at each frequency listed in the          *\n"
+"*                              frequency file, on parallel threads (see       *\n"
+"*                              '--threads'). Applies to the CPR and CTL       *\n"
+"*                              output options. The frequency file's format is *\n"
+"*                              described in calcBroadband.c.                  *\n"
+"*                                                                             *\n"
+"*          --sources <file>    Run the input file for each source position    *\n"
+"*                              listed in the source file, on parallel threads *\n"
+"*                              (see '--threads'), and stack the results of    *\n"
+"*                              all sources in a single output file. Applies   *\n"
+"*                              to the CPR, CTL, EPR and ADP output options.   *\n"
+"*                              The source file's format is described in       *\n"
+"*                              calcSources.c.                                 *\n"
+"*                                                                             *\n");
+printf(""
+"*          --batch <file>      Run all cases listed in the manifest <file>    *\n"
+"*                              within a single process. Each line contains a  *\n"
+"*                              case's input file name (without extension)     *\n"
+"*                              and, optionally, its output file name          *\n"
+"*                              (default: '<name>.mat'). Lines starting with   *\n"
+"*                              '#' are ignored. All other options apply to    *\n"
+"*                              every case. Note that an error in any case's   *\n"
+"*                              input file aborts the whole batch.             *\n"
+"*                                                                             *\n"
+"*          --jobs <#>          Number of cases of a batch run which are run   *\n"
+"*                              concurrently. Default: 1.                      *\n"
+"*                                                                             *\n");
+printf(""
+"*          --worker            Persistent worker mode: read input files from  *\n"
+"*                              stdin and write the resulting output files to  *\n"
+"*                              stdout, as length-prefixed binary records,     *\n"
+"*                              until stdin is closed. Intended for inversion  *\n"
+"*                              loops. No log or output files are written; all *\n"
+"*                              messages go to stderr. The record format is    *\n"
+"*                              described in toolsWorker.c.                    *\n"
+"*                                                                             *\n");
+printf(""
 "*  Note:   cTraceo's command line options are not case sensitive, i.e.,       *\n"
 "*          passing '--noLog' or '--nolog' will have the same effect.          *\n"
 "*                                                                             *\n"
@@ -154,10 +294,536 @@ printf(""
     
 }
 
+void    writeShard(settings_t* settings){
+    /*
+     * Traces the launching angles of a single shard (see '--shard') and writes
+     * the raw partial results to the shard file, to be merged by ctraceo-merge.
+     */
+    FILE*           shardFile   = NULL;
+    arrivalBuffer_t buffer;
+    uintptr_t       dimR = 0, dimZ = 0;
+    uintptr_t       iFirst, iLast;
+    
+    buffer.nArrivals    = 0;
+    buffer.maxArrivals  = 0;
+    buffer.arrival      = NULL;
+    
+    getShardRange(settings, &iFirst, &iLast);
+    printf( "Tracing shard %u of %u (launching angles %lu to %lu of %lu).\n",
+            settings->options.shardIndex + 1, settings->options.nShards,
+            (unsigned long)iFirst + 1, (unsigned long)iLast, (unsigned long)settings->source.nThetas);
+    
+    switch(settings->output.calcType){
+        case CALC_TYPE__EIGENRAYS_PROXIMITY:
+            traceEigenrayPr(settings, &buffer);
+            break;
+            
+        case CALC_TYPE__AMP_DELAY_PROXIMITY:
+            traceAmpDelPr(settings, &buffer);
+            break;
+            
+        case CALC_TYPE__COH_ACOUS_PRESS:
+        case CALC_TYPE__COH_TRANS_LOSS:
+        case CALC_TYPE__PART_VEL:
+        case CALC_TYPE__COH_ACOUS_PRESS_PART_VEL:
+            initCohAcoustPress(settings);
+            traceCohAcoustPress(settings);
+            getPressureDims(settings, &dimR, &dimZ);
+            break;
+            
+        default:
+            fatal("Unknown output option.\nAborting...");
+            break;
+    }
+    
+    shardFile = openFile(settings->options.outputFileName, "wb");
+    writeShardHeader(shardFile, settings);
+    if( settings->output.calcType == CALC_TYPE__EIGENRAYS_PROXIMITY ||
+        settings->output.calcType == CALC_TYPE__AMP_DELAY_PROXIMITY){
+        writeShardArrivals(shardFile, &buffer);
+        freeArrivalBuffer(&buffer);
+    }else{
+        writeShardPressure(shardFile, settings, dimR, dimZ);
+    }
+    if(fclose(shardFile) != 0){
+        fatal("Could not write to shard file.\nAborting...");
+    }
+}
+
+void    runCase(settings_t* settings){
+    /*
+     * Reads the input file given in settings->options, runs the computation and
+     * writes the output file. The log file (if any) is left open.
+     */
+    const char*     line = "-----------------------------------------------";
+    
+    //Read the input file
+    readIn(settings);
+    
+    //user specified a filename for the ssp, but didn't specify '--ssp <#>':
+    if (settings->options.sspFileName != NULL && settings->options.saveSSP == false){
+        fatal("Option '--sspFileName <filename>' requires option '--ssp <#>' to be passed as well.");
+    }
+    
+    //user specified a maximum step, but didn't enable the adaptive step size:
+    if (settings->options.rkMaxStep > 0 && settings->options.rkTolerance == 0){
+        fatal("Option '--rkMaxStep <m>' requires option '--rkTolerance <tol>' to be passed as well.\nAborting...");
+    }
+    
+    //only some output options can be split into shards:
+    if (settings->options.writeShard && !isShardable(settings->output.calcType)){
+        fatal("Option '--shard <k/N>' is only available for the CPR, CTL, PVL, PAV, EPR and ADP output options.\nAborting...");
+    }
+    
+    //every shard must trace at least one launching angle:
+    else if (settings->options.writeShard && settings->options.nShards > settings->source.nThetas){
+        printf("Option '--shard <k/N>': N (%u) exceeds the number of launching angles (%u).\n",
+                settings->options.nShards, settings->source.nThetas);
+        fatal("Aborting...");
+    }
+    
+    //bearings and ensembles are traced as a whole, they can not be split into shards:
+    else if (settings->options.writeShard && settings->options.nx2dFileName != NULL){
+        fatal("Options '--shard <k/N>' and '--nx2d <file>' can not be combined.\nAborting...");
+    }
+    else if (settings->options.writeShard && settings->options.ensembleFileName != NULL){
+        fatal("Options '--shard <k/N>' and '--ensemble <file>' can not be combined.\nAborting...");
+    }
+    else if (settings->options.writeShard && settings->options.broadbandFileName != NULL){
+        fatal("Options '--shard <k/N>' and '--broadband <file>' can not be combined.\nAborting...");
+    }
+    else if (settings->options.writeShard && settings->options.sourcesFileName != NULL){
+        fatal("Options '--shard <k/N>' and '--sources <file>' can not be combined.\nAborting...");
+    }
+    else if (settings->options.nx2dFileName != NULL && settings->options.ensembleFileName != NULL){
+        fatal("Options '--nx2d <file>' and '--ensemble <file>' can not be combined.\nAborting...");
+    }
+    else if (settings->options.broadbandFileName != NULL &&
+            (settings->options.nx2dFileName != NULL || settings->options.ensembleFileName != NULL)){
+        fatal("Option '--broadband <file>' can not be combined with the '--nx2d' and '--ensemble' options.\nAborting...");
+    }
+    else if (settings->options.sourcesFileName != NULL &&
+            (   settings->options.nx2dFileName != NULL || settings->options.ensembleFileName != NULL ||
+                settings->options.broadbandFileName != NULL)){
+        fatal("Option '--sources <file>' can not be combined with the '--nx2d', '--ensemble' and '--broadband' options.\nAborting...");
+    }
+    
+    //if user requested storing the interpolated sound speed profile, do so now:
+    else if (settings->options.saveSSP == true){
+        
+        if(settings->options.sspFileName == NULL){
+            //user didn't specify a custom name for storing the sound speed profile => use default file name
+            settings->options.sspFileName = malloc(8*sizeof(char));
+            strcpy( settings->options.sspFileName, "ssp.mat");
+        }
+        calcSSP(settings);
+    }
+    
+    //if cTraceo was compiled in verbose mode, print out the settings to stdout
+    if (VERBOSE){
+        DEBUG(2, "Calling printSettings()\n");
+        printSettings(settings);
+        DEBUG(2, "Returned from printSettings()\n");
+    }
+    
+    //determine output file's name:
+    if(settings->options.outputFileName != NULL){
+        //user has manually defined the output file's name -no need to do anything.
+        
+    }else if(settings->options.writeShard){
+        //partial results are named after the default output file, e.g.: "ctl.shard2of4"
+        settings->options.outputFileName = mallocChar(64);
+        sprintf(settings->options.outputFileName, "%.3s.shard%uof%u",
+                getDefaultOutputFileName(settings->output.calcType),
+                settings->options.shardIndex + 1, settings->options.nShards);
+        
+    }else{
+        settings->options.outputFileName = mallocChar(8);
+        strcpy( settings->options.outputFileName, getDefaultOutputFileName(settings->output.calcType));
+    }
+    
+    //write program options to log file
+    if(settings->options.writeLogFile){
+        //open the log file and write the header:
+        settings->options.logFile= openFile(strcat(settings->options.logFileName,".log"), "w");
+        LOG(HEADER);
+        LOG("\n");
+        
+        LOG("Input file: %s\n", settings->options.inFileName);
+        LOG("Title: %s\n", settings->options.caseTitle);
+        LOG("%s\n", line);
+        
+        logOptions(settings);
+        LOG("%s\n", line);
+    }
+    
+    //tabulate reflection coefficients (see '--reflectionTable'):
+    initReflectionTables(settings);
+    
+    if(settings->options.writeShard){
+        //trace a single shard and write the partial results (see ctraceo-merge):
+        writeShard(settings);
+    }else{
+        //open the output file (unless the caller provides an output stream, see '--worker') and write case name:
+        if(settings->options.matfile == NULL){
+            settings->options.matfile = matOpen(settings->options.outputFileName, "w");
+        }
+        if(settings->options.matfile == NULL)
+            fatal("Memory alocation error: could not open output file.");
+    
+        {
+            mxArray*  mxTitle      = NULL;
+            mxTitle = mxCreateString(settings->options.caseTitle);
+            if(mxTitle == NULL)
+                fatal("Memory alocation error.");
+        
+            matPutVariable(settings->options.matfile, "caseTitle", mxTitle);
+            mxDestroyArray(mxTitle);
+        }
+    
+    
+        //run the computation
+        if(settings->options.nx2dFileName != NULL){
+            printf( "Calculating along the bearings of grid file %s [Nx2D].\n", settings->options.nx2dFileName);
+            calcNx2D(settings);
+        }else if(settings->options.ensembleFileName != NULL){
+            printf( "Running the sound speed ensemble of file %s.\n", settings->options.ensembleFileName);
+            calcEnsemble(settings);
+        }else if(settings->options.broadbandFileName != NULL){
+            printf( "Calculating at the frequencies of file %s [broadband].\n", settings->options.broadbandFileName);
+            calcBroadband(settings);
+        }else if(settings->options.sourcesFileName != NULL){
+            printf( "Running the sources of file %s.\n", settings->options.sourcesFileName);
+            calcSources(settings);
+        }else switch(settings->output.calcType){
+            case CALC_TYPE__RAY_COORDS:
+                printf( "Calculating ray coordinates [RCO].\n");
+                calcRayCoords(settings);
+                break;
+            
+            case CALC_TYPE__ALL_RAY_INFO:
+                printf( "Calculating all ray information [ARI].\n");
+                calcAllRayInfo(settings);
+                break;
+            
+            case CALC_TYPE__EIGENRAYS_PROXIMITY:
+                printf( "Calculating eigenrays by proximity method [EPR].\n");
+                calcEigenrayPr(settings);
+                break;
+            
+            case CALC_TYPE__EIGENRAYS_REG_FALSI:
+                printf( "Calculating eigenrays by Regula Falsi Method [ERF].\n");
+                calcEigenrayRF(settings);
+                break;
+            
+            case CALC_TYPE__AMP_DELAY_PROXIMITY:
+                printf( "Calculating amplitudes and delays by Proximity Method [ADP].\n");
+                calcAmpDelPr(settings);
+                break;
+            
+            case CALC_TYPE__AMP_DELAY_REG_FALSI:
+                printf( "Calculating amplitudes and delays by Regula Falsi Method [ADR].\n");
+                calcAmpDelRF(settings);
+                break;
+            
+            case CALC_TYPE__COH_ACOUS_PRESS:
+                printf( "Calculating coherent acoustic pressure [CPR].\n");
+                calcCohAcoustPress(settings);
+                break;
+            
+            case CALC_TYPE__COH_TRANS_LOSS:
+                printf( "Calculating coherent transmission loss [CTL].\n");
+                calcCohAcoustPress(settings);
+                calcCohTransLoss(settings);
+                break;
+            
+            case CALC_TYPE__PART_VEL:
+                printf( "Calculating particle velocity [PVL].\n");
+                calcCohAcoustPress(settings);
+                calcParticleVel(settings);
+                break;
+            
+            case CALC_TYPE__COH_ACOUS_PRESS_PART_VEL:
+                printf( "Calculating coherent acoustic pressure and particle velocity [PAV].\n");
+                calcCohAcoustPress(settings);
+                calcParticleVel(settings);
+                break;
+            
+            default:
+                fatal("Unknown output option.\nAborting...");
+                break;
+        }
+    
+
+        //write number of truncated rays to log and matfile:
+        if (settings->options.killBackscatteredRays){
+            LOG("Truncated %u backscattered rays.\n", settings->options.nBackscatteredRays);
+        
+            mxArray*        mxNBackscatteredRays    = NULL;
+        
+            DEBUG(0, "nBackscatteredRays_d: %lf\n", settings->options.nBackscatteredRays);
+            DEBUG(0, "output file name: %s\n", settings->options.outputFileName);
+        
+            //write launching angles to file
+            mxNBackscatteredRays = mxCreateDoubleMatrix((MWSIZE)1, (MWSIZE)1, mxREAL);
+        
+            //copy cArray to mxArray:
+            copyUInt32ToMxArray(&settings->options.nBackscatteredRays, mxNBackscatteredRays, 1);
+        
+            //move mxArray to file:
+            matPutVariable(settings->options.matfile, "nBackscatteredRays", mxNBackscatteredRays);
+            mxDestroyArray(mxNBackscatteredRays);
+        }
+    
+    }
+    
+    //finish up the log:
+    LOG("%s\n", line);
+    LOG("Done.\n");
+    
+    // close output file:
+    if(settings->options.matfile != NULL){
+        matClose(settings->options.matfile);
+    }
+}
+
+void*   runBatchWorker(void* args){
+    /*
+     * Runs every nThreads-th case of a batch, starting at case iThread.
+     * NOTE: cases don't share ray or pressure buffers. Each case allocates them once
+     *       (rays are resized per ray by solveEikonalEq() anyway), which takes less
+     *       than 0.1% of a batch's run time.
+     */
+    batchWorker_t*  worker      = (batchWorker_t*)args;
+    settings_t*     settings    = NULL;
+    char*           outputFileName = NULL;
+    uintptr_t       i;
+    
+    for(i=worker->iThread; i<worker->nCases; i+=worker->nThreads){
+        settings = mallocSettings();
+        
+        //options passed on the command line apply to all cases:
+        settings->options.killBackscatteredRays = worker->settings->options.killBackscatteredRays;
+        settings->options.writeLogFile          = worker->settings->options.writeLogFile;
+        settings->options.nThreads              = worker->settings->options.nThreads;
+        settings->options.rkTolerance           = worker->settings->options.rkTolerance;
+        settings->options.rkMaxStep             = worker->settings->options.rkMaxStep;
+        settings->options.arcStep               = worker->settings->options.arcStep;
+        settings->options.denseOutput           = worker->settings->options.denseOutput;
+        settings->options.reflectionTable       = worker->settings->options.reflectionTable;
+        settings->options.nx2dFileName          = worker->settings->options.nx2dFileName;
+        settings->options.ensembleFileName      = worker->settings->options.ensembleFileName;
+        settings->options.broadbandFileName     = worker->settings->options.broadbandFileName;
+        settings->options.sourcesFileName       = worker->settings->options.sourcesFileName;
+        
+        //input, output and log file names are given by the manifest:
+        if(strlen(worker->caseNames[i]) + 5 > 256){
+            fatal("Batch manifest: case name too long.\nAborting...");
+        }
+        strcpy(settings->options.inFileName, worker->caseNames[i]);
+        strcat(settings->options.inFileName, ".in");
+        strcpy(settings->options.logFileName, worker->caseNames[i]);
+        settings->options.inFile            = openFile(settings->options.inFileName, "r");
+        settings->options.outputFileName    = worker->outputFileNames[i];
+        outputFileName                      = settings->options.outputFileName;
+        
+        runCase(settings);
+        
+        if(settings->options.writeLogFile){
+            fclose( settings->options.logFile);
+            free(   settings->options.logFileName);
+        }
+        free(settings->options.inFileName);
+        freeSettings(settings);
+        printf("Finished case %lu of %lu, written to %s.\n", (unsigned long)i + 1, (unsigned long)worker->nCases, outputFileName);
+    }
+    return NULL;
+}
+
+void    runBatch(settings_t* settings){
+    /*
+     * Runs all cases listed in a manifest (see '--batch') on '--jobs' parallel worker threads.
+     * Each line of the manifest contains the name of a case's input file (without the
+     * '.in' extension) and, optionally, the name of its output file (default: '<name>.mat').
+     * Empty lines and lines starting with '#' are ignored.
+     */
+    FILE*           manifest        = openFile(settings->options.batchFileName, "r");
+    char*           lineBuffer      = mallocChar((uintptr_t)(MAX_LINE_LEN + 1));
+    char*           caseName        = mallocChar((uintptr_t)(MAX_LINE_LEN + 1));
+    char*           outputFileName  = mallocChar((uintptr_t)(MAX_LINE_LEN + 1));
+    char**          caseNames       = NULL;
+    char**          outputFileNames = NULL;
+    uintptr_t       i, nCases = 0, maxCases = 0;
+    int             nItems;
+    uint32_t        t, nThreads;
+    batchWorker_t*  workers         = NULL;
+    
+    //read the manifest:
+    while(fgets(lineBuffer, MAX_LINE_LEN + 1, manifest) != NULL){
+        nItems = sscanf(lineBuffer, "%s %s", caseName, outputFileName);
+        if(nItems < 1 || caseName[0] == '#'){
+            continue;
+        }
+        if(nItems < 2){
+            sprintf(outputFileName, "%s.mat", caseName);
+        }
+        
+        if(nCases == maxCases){
+            maxCases        = (uintptr_t)max(2.0 * (double)maxCases, 64.0);
+            caseNames       = realloc(caseNames,       maxCases * sizeof(char*));
+            outputFileNames = realloc(outputFileNames, maxCases * sizeof(char*));
+            if(caseNames == NULL || outputFileNames == NULL){
+                fatal("Memory alocation error.");
+            }
+        }
+        caseNames[nCases]       = mallocChar(strlen(caseName) + 1);
+        outputFileNames[nCases] = mallocChar(strlen(outputFileName) + 1);
+        strcpy(caseNames[nCases],       caseName);
+        strcpy(outputFileNames[nCases], outputFileName);
+        nCases++;
+    }
+    fclose(manifest);
+    free(lineBuffer);
+    free(caseName);
+    free(outputFileName);
+    printf("Running %lu cases on %u jobs.\n", (unsigned long)nCases, settings->options.nJobs);
+    
+    //run the cases:
+    nThreads = (uint32_t)min( (double)settings->options.nJobs, (double)nCases);
+    nThreads = (uint32_t)max( (double)nThreads, 1.0);
+    workers = malloc(nThreads * sizeof(batchWorker_t));
+    if(workers == NULL){
+        fatal("Memory alocation error.");
+    }
+    for(t=0; t<nThreads; t++){
+        workers[t].settings         = settings;
+        workers[t].caseNames        = caseNames;
+        workers[t].outputFileNames  = outputFileNames;
+        workers[t].nCases           = nCases;
+        workers[t].iThread          = t;
+        workers[t].nThreads         = nThreads;
+    }
+    runThreads(nThreads, runBatchWorker, workers, sizeof(batchWorker_t));
+    free(workers);
+    
+    for(i=0; i<nCases; i++){
+        free(caseNames[i]);
+        free(outputFileNames[i]);
+    }
+    free(caseNames);
+    free(outputFileNames);
+    
+    //the settings used as a template for the cases don't have a log file of their own:
+    settings->options.writeLogFile = false;
+}
+
+FILE*   openWorkerReplyStream(void){
+    /*
+     * Returns a stream to the original stdout for the worker's replies (see '--worker')
+     * and redirects stdout to stderr, so that progress messages don't corrupt the replies.
+     */
+    #if defined(WINDOWS) || USE_MATLAB == 1
+        fatal("Option '--worker' is not available in this build of cTraceo.\nAborting...");
+        return NULL;
+    #else
+        FILE*   replyStream = NULL;
+        
+        fflush(stdout);
+        replyStream = fdopen(dup(STDOUT_FILENO), "wb");
+        if(replyStream == NULL || dup2(STDERR_FILENO, STDOUT_FILENO) < 0){
+            fatal("Worker: could not redirect stdout.\nAborting...");
+        }
+        return replyStream;
+    #endif
+}
+
+void    runWorker(settings_t* settings, FILE* replyStream){
+    /*
+     * Persistent worker mode (see '--worker' and toolsWorker.c): runs each case read
+     * from stdin and writes its output file's contents to replyStream, without
+     * touching the disk, until stdin is closed or an empty request is read.
+     * Each case runs in a child process, so that a case which aborts (through fatal())
+     * is answered with an error record instead of terminating the worker.
+     */
+    #if defined(WINDOWS) || USE_MATLAB == 1
+        (void)settings;
+        (void)replyStream;
+    #else
+        settings_t*     caseSettings    = NULL;
+        char*           request         = NULL;     //reused between requests
+        uint64_t        requestSize     = 0;
+        uint64_t        nBytes          = 0;
+        char*           reply           = NULL;
+        size_t          replySize       = 0;
+        uintptr_t       nCases          = 0;
+        uintptr_t       nFailed         = 0;
+        pid_t           pid;
+        int             status;
+        
+        //children share stdin's file offset, which they may reset to the end of unconsumed
+        //buffered input when they exit. Without a buffer there is nothing to reset:
+        setvbuf(stdin, NULL, _IONBF, 0);
+        
+        while(readWorkerRequest(stdin, &request, &requestSize, &nBytes)){
+            nCases++;
+            
+            //nothing may be left in the buffers that the child process inherits:
+            fflush(NULL);
+            pid = fork();
+            if(pid < 0){
+                fatal("Worker: could not start a child process.\nAborting...");
+            }
+            if(pid > 0){
+                if(waitpid(pid, &status, 0) != pid || !WIFEXITED(status) || WEXITSTATUS(status) != EXIT_SUCCESS){
+                    printf("Worker: case %lu failed.\n", (unsigned long)nCases);
+                    writeWorkerError(replyStream);
+                    nFailed++;
+                }
+                continue;
+            }
+            
+            //child process: run the case and reply.
+            caseSettings = mallocSettings();
+            
+            //options passed on the command line apply to all cases:
+            caseSettings->options.killBackscatteredRays = settings->options.killBackscatteredRays;
+            caseSettings->options.nThreads              = settings->options.nThreads;
+            caseSettings->options.rkTolerance           = settings->options.rkTolerance;
+            caseSettings->options.rkMaxStep             = settings->options.rkMaxStep;
+            caseSettings->options.arcStep               = settings->options.arcStep;
+            caseSettings->options.denseOutput           = settings->options.denseOutput;
+            caseSettings->options.reflectionTable       = settings->options.reflectionTable;
+            caseSettings->options.nx2dFileName          = settings->options.nx2dFileName;
+            caseSettings->options.ensembleFileName      = settings->options.ensembleFileName;
+            caseSettings->options.broadbandFileName     = settings->options.broadbandFileName;
+            caseSettings->options.sourcesFileName       = settings->options.sourcesFileName;
+            caseSettings->options.writeLogFile          = false;
+            
+            //read the input file from the request and write the output file to memory:
+            caseSettings->options.inFile    = fmemopen(request, (size_t)nBytes, "r");
+            caseSettings->options.matfile   = open_memstream(&reply, &replySize);
+            if(caseSettings->options.inFile == NULL || caseSettings->options.matfile == NULL){
+                fatal("Worker: could not open memory streams.\nAborting...");
+            }
+            writeMatfileHeader(caseSettings->options.matfile, MATLAB_HEADER_TEXT);
+            
+            runCase(caseSettings);      //closes both streams
+            writeWorkerReply(replyStream, reply, (uint64_t)replySize);
+            
+            //flush this case's messages, then leave without running the worker's exit handlers:
+            fflush(NULL);
+            _exit(EXIT_SUCCESS);
+        }
+        free(request);
+        fclose(replyStream);
+        printf("Worker: ran %lu cases, %lu of which failed.\n", (unsigned long)nCases, (unsigned long)nFailed);
+    #endif
+}
+
 int main(int argc, char **argv){
+    FILE*           replyStream = NULL;     //see '--worker'
     float           tEnd, tInit   = (double)clock()/CLOCKS_PER_SEC;   //get time
     settings_t*     settings    = mallocSettings();
-    const char*     line = "-----------------------------------------------";
 
     DEBUG(1,"Running cTraceo in verbose mode.\n\n");
     
@@ -242,7 +908,7 @@ int main(int argc, char **argv){
                     // '--sspFileName' specify custom name for storing interpolated ssp file.
                     else if(!strcmp(stringToLower(argv[i]), "--sspfilename")){
                         //next argument should contain the file name in which to store the ssp.
-                        settings->options.sspFileName = mallocChar(strlen(argv[++i]+1));
+                        settings->options.sspFileName = mallocChar(strlen(argv[++i])+1);
                         strcpy( settings->options.sspFileName, argv[i]);
                     }
                     
@@ -267,10 +933,138 @@ int main(int argc, char **argv){
                         settings->options.writeHeader = false;
                     }
                     
+                    // '--threads' number of worker threads used for tracing rays
+                    else if(!strcmp(stringToLower(argv[i]), "--threads")){
+                        //next argument should contain the number of threads.
+                        if(i+1 >= argc || atoi(argv[i+1]) < 1){
+                            fatal("Option '--threads <#>' requires a positive integer.\nAborting...");
+                        }
+                        settings->options.nThreads = (uint32_t)atoi(argv[++i]);
+                    }
+                    
+                    // '--rkTolerance' adaptive step size of the Runge-Kutta integration
+                    else if(!strcmp(stringToLower(argv[i]), "--rktolerance")){
+                        //next argument should contain the tolerance.
+                        if(i+1 >= argc || atof(argv[i+1]) <= 0){
+                            fatal("Option '--rkTolerance <tol>' requires a positive number.\nAborting...");
+                        }
+                        settings->options.rkTolerance = atof(argv[++i]);
+                    }
+                    
+                    // '--rkMaxStep' maximum step size of the adaptive Runge-Kutta integration
+                    else if(!strcmp(stringToLower(argv[i]), "--rkmaxstep")){
+                        //next argument should contain the maximum step size.
+                        if(i+1 >= argc || atof(argv[i+1]) <= 0){
+                            fatal("Option '--rkMaxStep <m>' requires a positive number.\nAborting...");
+                        }
+                        settings->options.rkMaxStep = atof(argv[++i]);
+                    }
+                    
+                    // '--arcStep' step rays in closed form where the sound speed is linear
+                    else if(!strcmp(stringToLower(argv[i]), "--arcstep")){
+                        settings->options.arcStep = true;
+                    }
+                    
+                    // '--denseOutput' interpolate the rays with Hermite polynomials
+                    else if(!strcmp(stringToLower(argv[i]), "--denseoutput")){
+                        settings->options.denseOutput = true;
+                    }
+                    
+                    // '--reflectionTable' interpolate reflection coefficients from a table
+                    else if(!strcmp(stringToLower(argv[i]), "--reflectiontable")){
+                        //next argument should contain the number of table entries.
+                        if(i+1 >= argc || atoi(argv[i+1]) < 2){
+                            fatal("Option '--reflectionTable <n>' requires an integer of at least 2.\nAborting...");
+                        }
+                        settings->options.reflectionTable = (uint32_t)atoi(argv[++i]);
+                    }
+                    
+                    // '--shard k/N' trace only the k-th of N slices of launching angles
+                    else if(!strcmp(stringToLower(argv[i]), "--shard")){
+                        uint32_t    k, n;
+                        int         length = 0;
+                        
+                        //next argument should be of the form "k/N", with 1 <= k <= N, and nothing else.
+                        if( i+1 >= argc || sscanf(argv[i+1], "%u/%u%n", &k, &n, &length) != 2 ||
+                            argv[i+1][length] != '\0' || strchr(argv[i+1], '-') != NULL || k < 1 || k > n){
+                            fatal("Option '--shard <k/N>' requires two positive integers with k <= N.\nAborting...");
+                        }
+                        i++;
+                        settings->options.writeShard = true;
+                        settings->options.shardIndex = k - 1;
+                        settings->options.nShards    = n;
+                    }
+                    
+                    // '--nx2d' trace the bearings of a gridded bathymetry
+                    else if(!strcmp(stringToLower(argv[i]), "--nx2d")){
+                        //next argument should contain the grid file's name.
+                        if(i+1 >= argc){
+                            fatal("Option '--nx2d <file>' requires a file name.\nAborting...");
+                        }
+                        settings->options.nx2dFileName = mallocChar(strlen(argv[++i])+1);
+                        strcpy( settings->options.nx2dFileName, argv[i]);
+                    }
+                    
+                    // '--ensemble' run an ensemble of sound speeds
+                    else if(!strcmp(stringToLower(argv[i]), "--ensemble")){
+                        //next argument should contain the ensemble file's name.
+                        if(i+1 >= argc){
+                            fatal("Option '--ensemble <file>' requires a file name.\nAborting...");
+                        }
+                        settings->options.ensembleFileName = mallocChar(strlen(argv[++i])+1);
+                        strcpy( settings->options.ensembleFileName, argv[i]);
+                    }
+                    
+                    // '--broadband' calculate at several frequencies
+                    else if(!strcmp(stringToLower(argv[i]), "--broadband")){
+                        //next argument should contain the frequency file's name.
+                        if(i+1 >= argc){
+                            fatal("Option '--broadband <file>' requires a file name.\nAborting...");
+                        }
+                        settings->options.broadbandFileName = mallocChar(strlen(argv[++i])+1);
+                        strcpy( settings->options.broadbandFileName, argv[i]);
+                    }
+                    
+                    // '--sources' run multiple source positions
+                    else if(!strcmp(stringToLower(argv[i]), "--sources")){
+                        //next argument should contain the source file's name.
+                        if(i+1 >= argc){
+                            fatal("Option '--sources <file>' requires a file name.\nAborting...");
+                        }
+                        settings->options.sourcesFileName = mallocChar(strlen(argv[++i])+1);
+                        strcpy( settings->options.sourcesFileName, argv[i]);
+                    }
+                    
+                    // '--batch' run all cases listed in a manifest
+                    else if(!strcmp(stringToLower(argv[i]), "--batch")){
+                        //next argument should contain the manifest's name.
+                        if(i+1 >= argc){
+                            fatal("Option '--batch <file>' requires a file name.\nAborting...");
+                        }
+                        settings->options.batchFileName = mallocChar(strlen(argv[++i])+1);
+                        strcpy( settings->options.batchFileName, argv[i]);
+                    }
+                    
+                    // '--jobs' number of cases of a batch run which are run concurrently
+                    else if(!strcmp(stringToLower(argv[i]), "--jobs")){
+                        //next argument should contain the number of jobs.
+                        if(i+1 >= argc || atoi(argv[i+1]) < 1){
+                            fatal("Option '--jobs <#>' requires a positive integer.\nAborting...");
+                        }
+                        settings->options.nJobs = (uint32_t)atoi(argv[++i]);
+                    }
+                    
+                    // '--worker' persistent worker mode
+                    else if(!strcmp(stringToLower(argv[i]), "--worker")){
+                        //redirect stdout right away, so that no further messages corrupt the replies
+                        settings->options.runWorker = true;
+                        replyStream = openWorkerReplyStream();
+                    }
+                    
                     // '--outputFileName'  
                     else if(!strcmp(stringToLower(argv[i]), "--outputfilename")){
                         //next argument should contain output file name.
-                        settings->options.outputFileName = mallocChar(strlen(argv[++i]+1));
+                        settings->options.outputFileName = mallocChar(strlen(argv[++i])+1);
                         strcpy( settings->options.outputFileName, argv[i]);
                     }
                     
@@ -301,204 +1095,25 @@ int main(int argc, char **argv){
         printf(HEADER);
     }
     
-    //Read the input file
-    readIn(settings);
-    
-    //user specified a filename for the ssp, but didn't specify '--ssp <#>':
-    if (settings->options.sspFileName != NULL && settings->options.saveSSP == false){
-        fatal("Option '--sspFileName <filename>' requires option '--ssp <#>' to be passed as well.");
-    }
-    
-    //if user requested storing the interpolated sound speed profile, do so now:
-    else if (settings->options.saveSSP == true){
-        
-        if(settings->options.sspFileName == NULL){
-            //user didn't specify a custom name for storing the sound speed profile => use default file name
-            settings->options.sspFileName = malloc(8*sizeof(char));
-            strcpy( settings->options.sspFileName, "ssp.mat");
+    if(settings->options.batchFileName != NULL){
+        //input and output files are given by the manifest:
+        if( settings->options.inFile != NULL || settings->options.outputFileName != NULL ||
+            settings->options.writeShard || settings->options.saveSSP || settings->options.runWorker){
+            fatal("Option '--batch <file>' can not be combined with an input file or the '--stdin', '--outputFileName', '--shard', '--ssp' and '--worker' options.\nAborting...");
         }
-        calcSSP(settings);
-    }
-    
-    //if cTraceo was compiled in verbose mode, print out the settings to stdout
-    if (VERBOSE){
-        DEBUG(2, "Calling printSettings()\n");
-        printSettings(settings);
-        DEBUG(2, "Returned from printSettings()\n");
-    }
-    
-    //determine output file's name:
-    if(settings->options.outputFileName != NULL){
-        //user has manually defined the output file's name -no need to do anything.
-        
-    }else{
-        settings->options.outputFileName = mallocChar(8);
-        
-        switch(settings->output.calcType){
-            case CALC_TYPE__RAY_COORDS:
-                strcpy( settings->options.outputFileName, "rco.mat");
-                break;
-
-            case CALC_TYPE__ALL_RAY_INFO:
-                strcpy( settings->options.outputFileName, "ari.mat");
-                break;
-                
-            case CALC_TYPE__EIGENRAYS_PROXIMITY:
-                strcpy( settings->options.outputFileName, "eig.mat");
-                break;
-                
-            case CALC_TYPE__EIGENRAYS_REG_FALSI:
-                strcpy( settings->options.outputFileName, "eig.mat");
-                break;
-                
-            case CALC_TYPE__AMP_DELAY_PROXIMITY:
-                strcpy( settings->options.outputFileName, "aad.mat");
-                break;
-                
-            case CALC_TYPE__AMP_DELAY_REG_FALSI:
-                strcpy( settings->options.outputFileName, "aad.mat");
-                break;
-                
-            case CALC_TYPE__COH_ACOUS_PRESS:
-                strcpy( settings->options.outputFileName, "cpr.mat");
-                break;
-                
-            case CALC_TYPE__COH_TRANS_LOSS:
-                strcpy( settings->options.outputFileName, "ctl.mat");
-                break;
-                
-            case CALC_TYPE__PART_VEL:
-                strcpy( settings->options.outputFileName, "pvl.mat");
-                break;
-                
-            case CALC_TYPE__COH_ACOUS_PRESS_PART_VEL:
-                strcpy( settings->options.outputFileName, "pav.mat");
-                break;
-                
-            default:
-                fatal("Unknown output option.\nAborting...");
-                break;
+        //run all cases listed in the manifest:
+        runBatch(settings);
+    }else if(settings->options.runWorker){
+        //input files are read from stdin, output files written to stdout:
+        if( settings->options.inFile != NULL || settings->options.outputFileName != NULL ||
+            settings->options.writeShard || settings->options.saveSSP){
+            fatal("Option '--worker' can not be combined with an input file or the '--stdin', '--outputFileName', '--shard' and '--ssp' options.\nAborting...");
         }
+        runWorker(settings, replyStream);
+        settings->options.writeLogFile = false;
+    }else{
+        runCase(settings);
     }
-    
-    //write program options to log file
-    if(settings->options.writeLogFile){
-        //open the log file and write the header:
-        settings->options.logFile= openFile(strcat(settings->options.logFileName,".log"), "w");
-        LOG(HEADER);
-        LOG("\n");
-        
-        LOG("Input file: %s\n", settings->options.inFileName);
-        LOG("Title: %s\n", settings->options.caseTitle);
-        LOG("%s\n", line);
-        
-        logOptions(settings);
-        LOG("%s\n", line);
-    }
-    
-    //open the output file and write case name:
-    settings->options.matfile = matOpen(settings->options.outputFileName, "w");
-    if(settings->options.matfile == NULL)
-        fatal("Memory alocation error: could not open output file.");
-    
-    {
-        mxArray*  mxTitle      = NULL;
-        mxTitle = mxCreateString(settings->options.caseTitle);
-        if(mxTitle == NULL)
-            fatal("Memory alocation error.");
-        
-        matPutVariable(settings->options.matfile, "caseTitle", mxTitle);
-        mxDestroyArray(mxTitle);
-    }
-    
-    
-    //run the computation
-    switch(settings->output.calcType){
-        case CALC_TYPE__RAY_COORDS:
-            printf( "Calculating ray coordinates [RCO].\n");
-            calcRayCoords(settings);
-            break;
-            
-        case CALC_TYPE__ALL_RAY_INFO:
-            printf( "Calculating all ray information [ARI].\n");
-            calcAllRayInfo(settings);
-            break;
-            
-        case CALC_TYPE__EIGENRAYS_PROXIMITY:
-            printf( "Calculating eigenrays by proximity method [EPR].\n");
-            calcEigenrayPr(settings);
-            break;
-            
-        case CALC_TYPE__EIGENRAYS_REG_FALSI:
-            printf( "Calculating eigenrays by Regula Falsi Method [ERF].\n");
-            calcEigenrayRF(settings);
-            break;
-            
-        case CALC_TYPE__AMP_DELAY_PROXIMITY:
-            printf( "Calculating amplitudes and delays by Proximity Method [ADP].\n");
-            calcAmpDelPr(settings);
-            break;
-            
-        case CALC_TYPE__AMP_DELAY_REG_FALSI:
-            printf( "Calculating amplitudes and delays by Regula Falsi Method [ADR].\n");
-            calcAmpDelRF(settings);
-            break;
-            
-        case CALC_TYPE__COH_ACOUS_PRESS:
-            printf( "Calculating coherent acoustic pressure [CPR].\n");
-            calcCohAcoustPress(settings);
-            break;
-            
-        case CALC_TYPE__COH_TRANS_LOSS:
-            printf( "Calculating coherent transmission loss [CTL].\n");
-            calcCohAcoustPress(settings);
-            calcCohTransLoss(settings);
-            break;
-            
-        case CALC_TYPE__PART_VEL:
-            printf( "Calculating particle velocity [PVL].\n");
-            calcCohAcoustPress(settings);
-            calcParticleVel(settings);
-            break;
-            
-        case CALC_TYPE__COH_ACOUS_PRESS_PART_VEL:
-            printf( "Calculating coherent acoustic pressure and particle velocity [PAV].\n");
-            calcCohAcoustPress(settings);
-            calcParticleVel(settings);
-            break;
-            
-        default:
-            fatal("Unknown output option.\nAborting...");
-            break;
-    }
-    
-
-    //write number of truncated rays to log and matfile:
-    if (settings->options.killBackscatteredRays){
-        LOG("Truncated %u backscattered rays.\n", settings->options.nBackscatteredRays);
-        
-        mxArray*        mxNBackscatteredRays    = NULL;
-        
-        DEBUG(0, "nBackscatteredRays_d: %lf\n", settings->options.nBackscatteredRays);
-        DEBUG(0, "output file name: %s\n", settings->options.outputFileName);
-        
-        //write launching angles to file
-        mxNBackscatteredRays = mxCreateDoubleMatrix((MWSIZE)1, (MWSIZE)1, mxREAL);
-        
-        //copy cArray to mxArray:
-        copyUInt32ToMxArray(&settings->options.nBackscatteredRays, mxNBackscatteredRays, 1);
-        
-        //move mxArray to file:
-        matPutVariable(settings->options.matfile, "nBackscatteredRays", mxNBackscatteredRays);
-        mxDestroyArray(mxNBackscatteredRays);
-    }
-    
-    //finish up the log:
-    LOG("%s\n", line);
-    LOG("Done.\n");
-    
-    // close output file:
-    matClose(settings->options.matfile);
 
     //get elapsed time:
     tEnd = (double)clock()/CLOCKS_PER_SEC;    
@@ -506,11 +1121,14 @@ int main(int argc, char **argv){
     LOG("---------\n%f seconds total.\n", tEnd-tInit);
     
     //free memory
-    freeSettings(settings);
     if(settings->options.writeLogFile){
         fclose( settings->options.logFile);
         free(   settings->options.logFileName);
     }
     free(settings->options.inFileName);
+    if(settings->options.batchFileName == NULL && !settings->options.runWorker){
+        //(the settings used as a template for batch and worker runs contain no input data)
+        freeSettings(settings);
+    }
     exit(EXIT_SUCCESS);
 }
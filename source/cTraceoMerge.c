@@ -0,0 +1,262 @@
+/****************************************************************************************
+ *  cTraceoMerge.c                                                                      *
+ *  Merges the partial results written by cTraceo's '--shard' option into the same      *
+ *  output file a single run would produce.                                             *
+ *                                                                                      *
+ * ------------------------------------------------------------------------------------ *
+ * Website:                                                                             *
+ *          https://github.com/EyNuel/cTraceo/wiki                                      *
+ *                                                                                      *
+ * License: This file is part of the cTraceo Raytracing Model and is released under the *
+ *          Creative Commons Attribution-NonCommercial-ShareAlike 3.0 Unported License  *
+ *          http://creativecommons.org/licenses/by-nc-sa/3.0/                           *
+ *                                                                                      *
+ * NOTE:    cTraceo is research code under active development.                          *
+ *          The code may contain bugs and updates are possible in the future.           *
+ *                                                                                      *
+ * Written for project SENSOCEAN by:                                                    *
+ *          Emanuel Ey                                                                  *
+ *          emanuel.ey@gmail.com                                                        *
+ *          Copyright (C) 2011 - 2013                                                   *
+ *          Signal Processing Laboratory                                                *
+ *          Universidade do Algarve                                                     *
+ *                                                                                      *
+ * ------------------------------------------------------------------------------------ *
+ *  Command line arguments:                                                             *
+ *          ctraceo-merge [options] <input file> <shard file> [<shard file> ...]        *
+ *                                                                                      *
+ *  The input file must be the one used to create the shards. Shards may be passed in   *
+ *  any order, but all N shards of a run must be present exactly once.                  *
+ *  Pressures are summed in order of shard index, so the result may differ from a       *
+ *  single run by rounding only.                                                        *
+ ****************************************************************************************/
+
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include "globals.h"
+#include "tools.h"
+#include "readIn.c"
+#include "calcEigenrayPr.c"
+#include "calcAmpDelPr.c"
+#include "calcCohAcoustPress.c"
+#include "calcCohTransLoss.c"
+#include "calcParticleVel.c"
+#if USE_MATLAB == 1
+    #include <mat.h>
+    #include "matrix.h"
+#else
+    #include    "matOut/matOut.h"
+#endif
+
+void    printMergeHelp(void);
+int     main(int, char**);
+
+void    printMergeHelp(void){
+    printf("\n"
+"* =========================================================================== *\n"
+"*  ctraceo-merge: merges the partial results of cTraceo runs with the         *\n"
+"*  '--shard <k/N>' option.                                                    *\n"
+"*                                                                             *\n"
+"*  Usage:  ctraceo-merge [options] <input file> <shard> [<shard> ...]         *\n"
+"*                                                                             *\n"
+"*          <input file> is the input file used to create the shards,          *\n"
+"*          without the '.in' extension (as passed to cTraceo).                *\n"
+"*                                                                             *\n"
+"*  Options:                                                                   *\n"
+"*          -h, --help          Prints this help.                              *\n"
+"*                                                                             *\n"
+"*          --outputFileName <name>                                            *\n"
+"*                              Specify a custom file name for the merged      *\n"
+"*                              output.                                        *\n"
+"* =========================================================================== *\n\n");
+}
+
+int main(int argc, char **argv){
+    settings_t*     settings        = mallocSettings();
+    arrivalBuffer_t buffer;
+    shardHeader_t   header;
+    FILE*           shardFile       = NULL;
+    char**          shardFileNames  = NULL;     //file name of each shard, by shard index
+    uint32_t        nShards         = 0;
+    uintptr_t       dimR = 0, dimZ = 0;
+    uint32_t        k;
+    int             i, iFirstShard  = 0;
+
+    buffer.nArrivals    = 0;
+    buffer.maxArrivals  = 0;
+    buffer.arrival      = NULL;
+
+    //the merge tool never writes a log file:
+    settings->options.writeLogFile = false;
+    settings->options.inFile       = NULL;
+
+    //process command line options:
+    for (i = 1; i < argc; i++){
+        if(argv[i][0] == '-'){
+            if(!strcmp(stringToLower(argv[i]), "-h") || !strcmp(argv[i], "--help")){
+                printMergeHelp();
+                exit(EXIT_SUCCESS);
+            }
+
+            else if(!strcmp(argv[i], "--outputfilename")){
+                //next argument should contain output file name.
+                if(i+1 >= argc){
+                    fatal("Option '--outputFileName' requires a file name.\nAborting...");
+                }
+                settings->options.outputFileName = mallocChar(strlen(argv[++i])+1);
+                strcpy( settings->options.outputFileName, argv[i]);
+            }
+
+            else{
+                printf("Ignoring unknown option %s.\n", argv[i]);
+            }
+        }else{
+            //the input file's name is followed by the shard files:
+            strcpy(settings->options.inFileName, argv[i]);
+            settings->options.inFileName = strcat(  settings->options.inFileName, ".in");
+            settings->options.inFile     = openFile(settings->options.inFileName, "r");
+            iFirstShard = i+1;
+            break;
+        }
+    }
+    if(settings->options.inFile == NULL || iFirstShard >= argc){
+        printMergeHelp();
+        fatal("No input file or shard files provided.\nAborting...");
+    }
+
+    //Read the input file
+    readIn(settings);
+
+    if(!isShardable(settings->output.calcType)){
+        fatal("Input file's output option can not be split into shards.\nAborting...");
+    }
+    if(settings->options.outputFileName == NULL){
+        settings->options.outputFileName = mallocChar(8);
+        strcpy( settings->options.outputFileName, getDefaultOutputFileName(settings->output.calcType));
+    }
+
+    /**
+     * First pass: verify the shards' headers and sort them by shard index.
+     */
+    for(i=iFirstShard; i<argc; i++){
+        shardFile = openFile(argv[i], "rb");
+        readShardHeader(shardFile, settings, &header);
+        fclose(shardFile);
+
+        if(shardFileNames == NULL){
+            nShards = (uint32_t)header.nShards;
+            shardFileNames = malloc(nShards * sizeof(char*));
+            if(shardFileNames == NULL){
+                fatal("Memory alocation error.");
+            }
+            for(k=0; k<nShards; k++){
+                shardFileNames[k] = NULL;
+            }
+        }
+        if(header.nShards != nShards){
+            fatal("Shard files belong to runs with different numbers of shards.\nAborting...");
+        }
+        if(shardFileNames[header.shardIndex] != NULL){
+            fprintf(stderr, "Shard %u was passed twice (%s, %s).\n", (uint32_t)header.shardIndex + 1, shardFileNames[header.shardIndex], argv[i]);
+            fatal("Aborting...");
+        }
+        shardFileNames[header.shardIndex] = argv[i];
+    }
+    for(k=0; k<nShards; k++){
+        if(shardFileNames[k] == NULL){
+            fprintf(stderr, "Shard %u of %u is missing.\n", k+1, nShards);
+            fatal("Aborting...");
+        }
+    }
+
+    /**
+     * Second pass: combine the partial results in order of shard index.
+     */
+    if( settings->output.calcType != CALC_TYPE__EIGENRAYS_PROXIMITY &&
+        settings->output.calcType != CALC_TYPE__AMP_DELAY_PROXIMITY){
+        initCohAcoustPress(settings);
+        getPressureDims(settings, &dimR, &dimZ);
+    }
+    for(k=0; k<nShards; k++){
+        shardFile = openFile(shardFileNames[k], "rb");
+        readShardHeader(shardFile, settings, &header);
+
+        settings->options.killBackscatteredRays = (bool)header.killBackscatteredRays;
+        settings->options.nBackscatteredRays   += (uint32_t)header.nBackscatteredRays;
+
+        if( settings->output.calcType == CALC_TYPE__EIGENRAYS_PROXIMITY ||
+            settings->output.calcType == CALC_TYPE__AMP_DELAY_PROXIMITY){
+            readShardArrivals(shardFile, &buffer);
+        }else{
+            addShardPressure(shardFile, settings, dimR, dimZ);
+        }
+        fclose(shardFile);
+    }
+
+    /**
+     * Write the output file, exactly as a single run of cTraceo would.
+     */
+    settings->options.matfile = matOpen(settings->options.outputFileName, "w");
+    if(settings->options.matfile == NULL)
+        fatal("Memory alocation error: could not open output file.");
+
+    {
+        mxArray*  mxTitle      = NULL;
+        mxTitle = mxCreateString(settings->options.caseTitle);
+        if(mxTitle == NULL)
+            fatal("Memory alocation error.");
+
+        matPutVariable(settings->options.matfile, "caseTitle", mxTitle);
+        mxDestroyArray(mxTitle);
+    }
+
+    switch(settings->output.calcType){
+        case CALC_TYPE__EIGENRAYS_PROXIMITY:
+            writeEigenrayPr(settings, &buffer);
+            break;
+
+        case CALC_TYPE__AMP_DELAY_PROXIMITY:
+            writeAmpDelPr(settings, &buffer);
+            break;
+
+        case CALC_TYPE__COH_ACOUS_PRESS:
+            writeCohAcoustPress(settings);
+            break;
+
+        case CALC_TYPE__COH_TRANS_LOSS:
+            writeCohAcoustPress(settings);
+            calcCohTransLoss(settings);
+            break;
+
+        case CALC_TYPE__PART_VEL:
+        case CALC_TYPE__COH_ACOUS_PRESS_PART_VEL:
+            writeCohAcoustPress(settings);
+            calcParticleVel(settings);
+            break;
+
+        default:
+            fatal("Unknown output option.\nAborting...");
+            break;
+    }
+
+    //write number of truncated rays to matfile:
+    if (settings->options.killBackscatteredRays){
+        mxArray*        mxNBackscatteredRays    = NULL;
+
+        mxNBackscatteredRays = mxCreateDoubleMatrix((MWSIZE)1, (MWSIZE)1, mxREAL);
+        copyUInt32ToMxArray(&settings->options.nBackscatteredRays, mxNBackscatteredRays, 1);
+        matPutVariable(settings->options.matfile, "nBackscatteredRays", mxNBackscatteredRays);
+        mxDestroyArray(mxNBackscatteredRays);
+    }
+    matClose(settings->options.matfile);
+    printf("Merged %u shards into %s.\n", nShards, settings->options.outputFileName);
+
+    //free memory
+    freeArrivalBuffer(&buffer);
+    free(shardFileNames);
+    freeSettings(settings);
+    free(settings->options.inFileName);
+    exit(EXIT_SUCCESS);
+}
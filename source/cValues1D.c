@@ -35,6 +35,10 @@
  *          n:      number of elements in vectors x anc c.                              *
  *          xTable: vector containing independent variable.                             *
  *          cTable: vector containing dependent variable c(x)                           *
+ *          xUniform: spacing of xTable, see initUniformGrid().                         *
+ *          xCursor: interval of xTable found by the previous lookup (or NULL);         *
+ *                  updated with the new interval (see bracketHunt()).                  *
+ *          cCoeffs: interpolation coefficients of c(x), see initCValues1D().           *
  *          xi:     interpolation point.                                                *
  *                                                                                      *
  *  Outputs:                                                                            *
@@ -51,9 +55,10 @@
 #include "interpolation.h"
 #include "bracket.c"
 
-void    cValues1D(uintptr_t, double*, double*, double, double*, double*, double*);
+void    cValues1D(uintptr_t, double*, const uniformGrid_t*, uintptr_t*, double*, const double*, double, double*, double*, double*);
+void    initCValues1D(soundSpeed_t*);
 
-void    cValues1D(uintptr_t n, double* xTable, double* cTable, double xi, double* ci, double* cxi, double* cxxi){
+void    cValues1D(uintptr_t n, double* xTable, const uniformGrid_t* xUniform, uintptr_t* xCursor, double* cTable, const double* cCoeffs, double xi, double* ci, double* cxi, double* cxxi){
     DEBUG(10,"Entering cValues1D().\n");
     uintptr_t   i = 0;
 
@@ -61,24 +66,23 @@ void    cValues1D(uintptr_t n, double* xTable, double* cTable, double xi, double
 
     if( xi >= xTable[1] &&  xi <xTable[n-2]){
         //for all other cases do barycentric cubic interpolation
-        bracket(n, xTable, xi, &i);
-        intBarycCubic1D(    &xTable[i-1],
-                            &cTable[i-1],
-                            xi, ci, cxi, cxxi);
+        bracketHunt(n, xTable, xUniform, xi, xCursor, &i);
+        intBarycCubic1DEval(    &xTable[i-1],
+                                cTable[i-1],
+                                &cCoeffs[3*i],
+                                xi, ci, cxi, cxxi);
     
     }else if( xi < xTable[1]){
         //if xi is in first interval of xTable, do linear interpolation
-        intLinear1D(    &xTable[0],
-                        &cTable[0],
-                        xi, ci, cxi);
-        *cxxi = 0.0;
+        *cxi    = cCoeffs[0];
+        *ci     = cTable[0] +(xi -xTable[0]) *(*cxi);
+        *cxxi   = 0.0;
     
     }else if( xi >= xTable[n-2]){
         //if xi is in last interval of xTable, do linear interpolation
-        intLinear1D(    &xTable[n-2],
-                        &cTable[n-2],
-                        xi, ci, cxi);
-        *cxxi = 0.0;
+        *cxi    = cCoeffs[3*(n-2)];
+        *ci     = cTable[n-2] +(xi -xTable[n-2]) *(*cxi);
+        *cxxi   = 0.0;
     
     }else{
         printf("Interpolating sound speed at: %lf [m]\n", xi);
@@ -87,3 +91,33 @@ void    cValues1D(uintptr_t n, double* xTable, double* cTable, double xi, double
     DEBUG(10,"Leaving cValues1D.\n");
 }
 
+void    initCValues1D(soundSpeed_t* soundSpeed){
+    /*
+     * Precomputes the interpolation coefficients of each interval [z[i], z[i+1][ of a
+     * tabulated sound speed profile, so that cValues1D() only needs to evaluate them.
+     * The 3 coefficients of interval i are stored at c1DCoeffs[3*i]: the barycentric
+     * weights of the cubic through z[i-1]..z[i+2] for inner intervals and the slope
+     * (same expression as in intLinear1D()) for the first and last interval.
+     * Must be called again whenever c1D changes; the previous table is not freed, as it
+     * may still be shared with other settings.
+     */
+    uintptr_t   n = soundSpeed->nz;
+    double*     z = soundSpeed->z;
+    double*     c = soundSpeed->c1D;
+    uintptr_t   i;
+
+    if(n < 2){
+        fatal("Input file: tabulated sound speed profile must have at least 2 points.\nAborting...");
+    }
+
+    soundSpeed->c1DCoeffs = mallocDouble(3*(n-1));
+    for(i=0; i<3*(n-1); i++){
+        soundSpeed->c1DCoeffs[i] = 0.0;
+    }
+
+    for(i=1; i+2<n; i++){
+        intBarycCubic1DCoeffs(&z[i-1], &c[i-1], &soundSpeed->c1DCoeffs[3*i]);
+    }
+    soundSpeed->c1DCoeffs[0]        = ( c[1] -c[0]) / ( z[1] -z[0]);
+    soundSpeed->c1DCoeffs[3*(n-2)]  = ( c[n-1] -c[n-2]) / ( z[n-1] -z[n-2]);
+}
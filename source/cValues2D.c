@@ -37,7 +37,11 @@
  *          ny:         number of elements in vector y.                                 *
  *          xTable:     vector containing independent variable x.                       *
  *          yTable:     vector containing independent variable y.                       *
- *          cTable:     array containing c(x, y)                                        *
+ *          xUniform:   spacing of xTable, see initUniformGrid().                       *
+ *          yUniform:   spacing of yTable, see initUniformGrid().                       *
+ *          xCursor:    interval of xTable found by the previous lookup (or NULL),      *
+ *          yCursor:    same for yTable. Both are updated (see bracketHunt()).          *
+ *          cCoeffs:    interpolation coefficients of c(x, y), see initCValues2D().     *
  *          xi:         x coordinate of interpolation point.                            *
  *          yi:         y coordinate of interpolation point.                            *
  *                                                                                      *
@@ -57,20 +61,21 @@
 #pragma once
 #include "bracket.c"
 #include "globals.h"
+#include "interpolation.h"
 
-void    cValues2D(uintptr_t, uintptr_t, double*, double*, double**, double, double, double*, double*, double*, double*, double*, double*);
+void    cValues2D(uintptr_t, uintptr_t, double*, double*, const uniformGrid_t*, const uniformGrid_t*, uintptr_t*, uintptr_t*, const double*, double, double, double*, double*, double*, double*, double*, double*);
+void    initCValues2D(soundSpeed_t*);
 
-void    cValues2D(uintptr_t nx, uintptr_t ny, double* xTable, double* yTable, double** cTable, double xi, double yi, double* ci, double* cxi, double* cyi, double* cxxi, double* cyyi, double* cxyi){
+void    cValues2D(uintptr_t nx, uintptr_t ny, double* xTable, double* yTable, const uniformGrid_t* xUniform, const uniformGrid_t* yUniform, uintptr_t* xCursor, uintptr_t* yCursor, const double* cCoeffs, double xi, double yi, double* ci, double* cxi, double* cyi, double* cxxi, double* cyyi, double* cxyi){
     DEBUG(8, "in: nx: %u, ny: %u, xi: %lf (x[nx-2]: %lf), yi: %lf (y[ny-2]: %lf)\n", (uint32_t)nx, (uint32_t)ny, xi, xTable[nx-2], yi, yTable[ny-2]);
-    uintptr_t   i=0, j=0, a, b;
-    double**    tempDouble2D = mallocDouble2D(3,3);
+    uintptr_t   i=0, j=0;
     
     if (xi <= xTable [1]){
         i = 0;
     }else if (xi >= xTable[nx-2]){
         i = nx - 3;
     }else{
-        bracket(nx, xTable, xi, &i);
+        bracketHunt(nx, xTable, xUniform, xi, xCursor, &i);
     }
     
     if (yi <= yTable[1]){
@@ -78,19 +83,39 @@ void    cValues2D(uintptr_t nx, uintptr_t ny, double* xTable, double* yTable, do
     }else if (yi >= yTable[ny -2]){
         j = ny - 3;
     }else{
-        bracket(ny, yTable, yi, &j);
+        bracketHunt(ny, yTable, yUniform, yi, yCursor, &j);
     }
     
-    for(a=0; a<3; a++){
-        for(b=0; b<3; b++){
-            DEBUG(8, "tempDouble2D[%u][%u] = cTable[%u][%u] = ", (uint32_t)a, (uint32_t)b, (uint32_t)(j+a), (uint32_t)(i+b));
-            tempDouble2D[a][b] = cTable[j+a][i+b];
-            DEBUG(8, "%lf.\n", cTable[j+a][i+b]);
-        }
-    }
-    
-    intBarycParab2D( &xTable[i], &yTable[j], tempDouble2D, xi, yi, ci, cxi, cyi, cxxi, cyyi, cxyi);
-    freeDouble2D(tempDouble2D,3);
+    intBarycParab2DEval( &xTable[i], &yTable[j], &cCoeffs[(j*(nx-2) + i)*9], xi, yi, ci, cxi, cyi, cxxi, cyyi, cxyi);
     DEBUG(8, "out, ci: %lf\n", *ci);
 }
 
+void    initCValues2D(soundSpeed_t* soundSpeed){
+    /*
+     * Precomputes the barycentric interpolation coefficients of every 3x3 stencil of a
+     * sound speed field, so that cValues2D() does not need to recompute (or allocate)
+     * them at every step of a ray.
+     * The 9 coefficients of the stencil starting at c2D[j][i] are stored contiguously at
+     * c2DCoeffs[(j*(nr-2) + i)*9]. Must be called again whenever c2D changes; the
+     * previous table is not freed, as it may still be shared with other settings.
+     */
+    uintptr_t   nr = soundSpeed->nr;
+    uintptr_t   nz = soundSpeed->nz;
+    uintptr_t   i, j;
+    double*     f[3];
+
+    if(nr < 3 || nz < 3){
+        fatal("Input file: sound speed field must have at least 3 points in range and depth.\nAborting...");
+    }
+
+    soundSpeed->c2DCoeffs = mallocDouble((nr-2) * (nz-2) * 9);
+
+    for(j=0; j<nz-2; j++){
+        for(i=0; i<nr-2; i++){
+            f[0] = &soundSpeed->c2D[j  ][i];
+            f[1] = &soundSpeed->c2D[j+1][i];
+            f[2] = &soundSpeed->c2D[j+2][i];
+            intBarycParab2DCoeffs(&soundSpeed->r[i], &soundSpeed->z[j], f, &soundSpeed->c2DCoeffs[(j*(nr-2) + i)*9]);
+        }
+    }
+}
@@ -54,8 +54,31 @@
     #include    "matOut/matOut.h"
 #endif
 
+bool    traceAllRayInfo(settings_t*, ray_t*, uintptr_t);
 void    calcAllRayInfo(settings_t*);
 
+bool    traceAllRayInfo(settings_t* settings, ray_t* ray, uintptr_t i){
+    /*
+     * Traces a single ray (called by the ray pipeline, possibly on a worker thread).
+     * Returns false if the ray was not traced.
+     */
+    double      thetai, ctheta;
+    
+    thetai = -settings->source.thetas[i] * M_PI/180.0;
+    ray->theta = thetai;
+    DEBUG(2,"ray[%u].theta: %lf\n", (uint32_t)i, settings->source.thetas[i]);
+    ctheta = fabs( cos(thetai));
+    
+    //Trace a ray as long as it is neither 90 or -90:
+    if (ctheta > 1.0e-7){
+        solveEikonalEq(settings, ray);
+        solveDynamicEq(settings, ray);
+        DEBUG(4, "Equations solved.\n");
+        return true;
+    }
+    return false;
+}
+
 void    calcAllRayInfo(settings_t* settings){
     DEBUG(1,"in\n");
     mxArray*            pThetas     = NULL;
@@ -85,8 +108,10 @@ void    calcAllRayInfo(settings_t* settings){
                                         "nRefrac",
                                         "refrac_r",
                                         "refrac_z"};        //the names of the fields contained in mxRayStruct
-    double              thetai, ctheta;
     ray_t*              ray         = NULL;
+    rayPipeline_t       pipe;
+    uint32_t            nThreads;
+    bool                traced;
     uintptr_t           i;
     
     
@@ -111,21 +136,20 @@ void    calcAllRayInfo(settings_t* settings){
         fatal("Memory Alocation error.");
     }
     
-    //allocate memory for the rays:
-    ray = makeRay(settings->source.nThetas);
+    /*
+     * Trace the rays: rays are traced by worker threads (see '--threads') and
+     * written to the mxStructArray in order of launching angle as soon as they are available.
+     */
+    nThreads = (uint32_t)min( (double)settings->options.nThreads, (double)settings->source.nThetas);
+    nThreads = (uint32_t)max( (double)nThreads, 1.0);
+    startRayPipeline(&pipe, settings, nThreads, settings->source.nThetas, traceAllRayInfo);
     
-    /** Trace the rays: */
     for(i=0; i<settings->source.nThetas; i++){
-        thetai = -settings->source.thetas[i] * M_PI/180.0;
-        ray[i].theta = thetai;
-        DEBUG(2,"ray[%u].theta: %lf\n", (uint32_t)i, settings->source.thetas[i]);
-        ctheta = fabs( cos(thetai));
+        ray = waitForRay(&pipe, i, &traced);
         
-        //Trace a ray as long as it is neither 90 or -90:
-        if (ctheta > 1.0e-7){
-            solveEikonalEq(settings, &ray[i]);
-            solveDynamicEq(settings, &ray[i]);
-            DEBUG(4, "Equations solved.\n");
+        if (traced){
+            if(ray->iBackscattered)
+                settings->options.nBackscatteredRays++;
             
             ///prepare to write ray to mxStructArray:
             /*NOTE: when writing a mxArray to a mxStructArray, the mxArray cannot simply be reused after it was
@@ -138,20 +162,20 @@ void    calcAllRayInfo(settings_t* settings){
             
             //create mxArrays:
             mxTheta = mxCreateDoubleMatrix((MWSIZE)1,   (MWSIZE)1,              mxREAL);
-            mxR     = mxCreateDoubleMatrix((MWSIZE)1,   (MWSIZE)ray[i].nCoords, mxREAL);
-            mxZ     = mxCreateDoubleMatrix((MWSIZE)1,   (MWSIZE)ray[i].nCoords, mxREAL);
-            mxTau   = mxCreateDoubleMatrix((MWSIZE)1,   (MWSIZE)ray[i].nCoords, mxREAL);
-            mxAmp   = mxCreateDoubleMatrix((MWSIZE)1,   (MWSIZE)ray[i].nCoords, mxCOMPLEX);
+            mxR     = mxCreateDoubleMatrix((MWSIZE)1,   (MWSIZE)ray->nCoords,   mxREAL);
+            mxZ     = mxCreateDoubleMatrix((MWSIZE)1,   (MWSIZE)ray->nCoords,   mxREAL);
+            mxTau   = mxCreateDoubleMatrix((MWSIZE)1,   (MWSIZE)ray->nCoords,   mxREAL);
+            mxAmp   = mxCreateDoubleMatrix((MWSIZE)1,   (MWSIZE)ray->nCoords,   mxCOMPLEX);
             if( mxTheta == NULL || mxR == NULL || mxZ == NULL || mxTau == NULL || mxAmp == NULL){
                 fatal("Memory alocation error.");
             }
             
             //copy data to mxArrays:
             copyDoubleToMxArray(&settings->source.thetas[i],mxTheta,1);
-            copyDoubleToMxArray(ray[i].r,                   mxR,    ray[i].nCoords);
-            copyDoubleToMxArray(ray[i].z,                   mxZ,    ray[i].nCoords);
-            copyDoubleToMxArray(ray[i].tau,                 mxTau,  ray[i].nCoords);
-            copyComplexToMxArray(ray[i].amp,                mxAmp,  ray[i].nCoords);
+            copyDoubleToMxArray(ray->r,                     mxR,    ray->nCoords);
+            copyDoubleToMxArray(ray->z,                     mxZ,    ray->nCoords);
+            copyDoubleToMxArray(ray->tau,                   mxTau,  ray->nCoords);
+            copyComplexToMxArray(ray->amp,                  mxAmp,  ray->nCoords);
             
             //copy mxArrays to mxRayStruct
             mxSetFieldByNumber( mxRayStruct,        //pointer to the mxStruct
@@ -171,11 +195,11 @@ void    calcAllRayInfo(settings_t* settings){
             nObjRefl    = mxCreateDoubleMatrix((MWSIZE)1,   (MWSIZE)1, mxREAL);
             nRefrac     = mxCreateDoubleMatrix((MWSIZE)1,   (MWSIZE)1, mxREAL);
             
-            copyBoolToMxArray(      &ray[i].iReturn,    iReturns,   1);
-            copyUInt32ToMxArray(    &ray[i].sRefl,      nSurRefl,   1);
-            copyUInt32ToMxArray(    &ray[i].bRefl,      nBotRefl,   1);
-            copyUInt32ToMxArray(    &ray[i].oRefl,      nObjRefl,   1);
-            copyUInt32ToMxArray(    &ray[i].nRefrac,    nRefrac,    1);
+            copyBoolToMxArray(      &ray->iReturn,      iReturns,   1);
+            copyUInt32ToMxArray(    &ray->sRefl,        nSurRefl,   1);
+            copyUInt32ToMxArray(    &ray->bRefl,        nBotRefl,   1);
+            copyUInt32ToMxArray(    &ray->oRefl,        nObjRefl,   1);
+            copyUInt32ToMxArray(    &ray->nRefrac,      nRefrac,    1);
             
             mxSetFieldByNumber( mxRayStruct, (MWINDEX)i, 5, iReturns);
             mxSetFieldByNumber( mxRayStruct, (MWINDEX)i, 6, nSurRefl);
@@ -185,28 +209,25 @@ void    calcAllRayInfo(settings_t* settings){
             ///aditional information has been saved
             
             ///save refraction coordinates to structure:
-            if (ray[i].nRefrac > 0){
-                mxRefrac_r = mxCreateDoubleMatrix((MWSIZE)1,    (MWSIZE)ray[i].nRefrac, mxREAL);
-                mxRefrac_z = mxCreateDoubleMatrix((MWSIZE)1,    (MWSIZE)ray[i].nRefrac, mxREAL);
+            if (ray->nRefrac > 0){
+                mxRefrac_r = mxCreateDoubleMatrix((MWSIZE)1,    (MWSIZE)ray->nRefrac, mxREAL);
+                mxRefrac_z = mxCreateDoubleMatrix((MWSIZE)1,    (MWSIZE)ray->nRefrac, mxREAL);
                 
-                copyDoubleToMxArray(ray[i].rRefrac, mxRefrac_r, ray[i].nRefrac);
-                copyDoubleToMxArray(ray[i].zRefrac, mxRefrac_z, ray[i].nRefrac);
+                copyDoubleToMxArray(ray->rRefrac,   mxRefrac_r, ray->nRefrac);
+                copyDoubleToMxArray(ray->zRefrac,   mxRefrac_z, ray->nRefrac);
                 
                 mxSetFieldByNumber( mxRayStruct, (MWINDEX)i, 10, mxRefrac_r);
                 mxSetFieldByNumber( mxRayStruct, (MWINDEX)i, 11, mxRefrac_z);
             }
-            if(KEEP_RAYS_IN_MEM == false){
-                //free the ray's memory
-                reallocRayMembers(&ray[i],0);
-            }
         }
+        releaseRay(&pipe, i);
     }
+    stopRayPipeline(&pipe);
 
     /// Write all ray information to matfile:
     matPutVariable(settings->options.matfile, "rays", mxRayStruct);
     
     /// Finish up
     mxDestroyArray(mxRayStruct);
-    free(ray);
     DEBUG(1,"out\n");
 }
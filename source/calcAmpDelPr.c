@@ -42,6 +42,7 @@
  *                                                                                      *
  ****************************************************************************************/
 
+#pragma  once
 #include "globals.h"
 #include "tools.h"
 #include "solveDynamicEq.c"
@@ -53,25 +54,223 @@
     #include    "matOut/matOut.h"
 #endif
 #include "interpolation.h"
+#include "getRayParameters.c"
 #include "bracket.c"
 #include "eBracket.c"
 
-void calcAmpDelPr(settings_t*);
-
-void calcAmpDelPr(settings_t* settings){
-    //NOTE: the code below is practically identical to calcEigenrayPr.c, the only difference being the file output
-    DEBUG(1,"in\n");
+typedef struct ampDelPrWorker{
+    /*
+     * Arguments and results of one worker thread (see '--threads').
+     * Rays are distributed among workers in an interleaved fashion; the arrivals found
+     * by a worker are stored in its buffer in the order in which they are found.
+     */
+    settings_t*     settings;
+    uint32_t        iThread;
+    uint32_t        nThreads;
+    uintptr_t       iFirst, iLast;          //range of launching angles to be traced (see '--shard')
+    arrivalBuffer_t buffer;
+    uint32_t        nBackscatteredRays;
+}ampDelPrWorker_t;
+
+void    storeArrivalPr(arrivalBuffer_t*, ray_t*, uintptr_t, uintptr_t, uintptr_t, double, double, double, complex double);
+void*   calcAmpDelPrWorker(void*);
+void    traceAmpDelPr(settings_t*, arrivalBuffer_t*);
+void    writeAmpDelPr(settings_t*, arrivalBuffer_t*);
+void    calcAmpDelPr(settings_t*);
+
+void    storeArrivalPr(arrivalBuffer_t* buffer, ray_t* ray, uintptr_t iTheta, uintptr_t iHydR, uintptr_t iHydZ, double rHyd, double zRay, double tauRay, complex double ampRay){
+    /*
+     * Copies an arrival (and some additional ray information) to a worker's buffer.
+     */
+    arrival_t*      arrival = pushArrival(buffer, 1, 0);
+    
+    arrival->iTheta     = iTheta;
+    arrival->iHydR      = iHydR;
+    arrival->iHydZ      = iHydZ;
+    arrival->r[0]       = rHyd;
+    arrival->z[0]       = zRay;
+    arrival->tau[0]     = tauRay;
+    arrival->amp[0]     = ampRay;
+    arrival->iReturn    = ray->iReturn;
+    arrival->sRefl      = ray->sRefl;
+    arrival->bRefl      = ray->bRefl;
+    arrival->oRefl      = ray->oRefl;
+}
 
+void*   calcAmpDelPrWorker(void* args){
+    /*
+     * Traces every nThreads-th ray, starting at ray iThread, and stores any arrivals found.
+     */
+    ampDelPrWorker_t* worker  = (ampDelPrWorker_t*)args;
+    settings_t*     settings    = worker->settings;
     double          thetai, ctheta;
-    double          junkDouble;
-    double          maxNumArrivals=0;       //keeps track of the highest number of arrivals
+    ray_t*          ray         = NULL;
     uintptr_t       i, j, jj, l;
     double          rHyd, zHyd, zRay, tauRay;
-    complex double  junkComplex, ampRay;
+    complex double  ampRay;
     double          dz;
     uintptr_t       nRet, iHyd = 0;
     uintptr_t       iRet[51];
-    ray_t*          ray                 = NULL;
+    
+    //allocate memory for the ray (reused for all of this worker's rays):
+    ray = makeRay(1);
+    
+    /** Trace the rays:  */
+    for(i=worker->iFirst + worker->iThread; i<worker->iLast; i+=worker->nThreads){
+        thetai = -settings->source.thetas[i] * M_PI/180.0;
+        ray->theta = thetai;
+        ctheta = fabs( cos(thetai));
+
+        //Trace a ray as long as it is neither at 90 nor -90:
+        if (ctheta > 1.0e-7){
+            solveEikonalEq(settings, ray);
+            if(ray->iBackscattered)
+                worker->nBackscatteredRays++;
+            solveDynamicEq(settings, ray);
+
+            //test for proximity of ray to each hydrophone
+            //(yes, this is slow, can you figure out a better way to do it?)
+            for(j=0; j<settings->output.nArrayR; j++){
+                rHyd = settings->output.arrayR[j];
+
+                if ( (rHyd >= ray->rMin) && (rHyd <= ray->rMax)){
+
+                    //  Check if the ray is returning back or not;
+                    //  if not:     we can bracket it without problems,
+                    //  otherwise:  we need to know how many times it passed by the given array range
+                    if (ray->iReturn == false){
+
+                        //get the index of the lower bracketing element:
+                        bracket(ray->nCoords, ray->r, rHyd, &iHyd);
+                        DEBUG(3,"non-returning ray: nCoords: %u, iHyd:%u\n", (uint32_t)ray->nCoords, (uint32_t)iHyd);
+
+                        //from index interpolate the rays' depth:
+                        interpolateRay(settings, ray, iHyd, rHyd, &zRay, NULL, NULL, NULL, NULL);
+
+                        //for every hydrophone check distance to ray
+                        for(jj=0; jj<settings->output.nArrayZ; jj++){
+                            zHyd = settings->output.arrayZ[jj];
+                            dz = fabs(zRay-zHyd);
+                            DEBUG(4, "dz: %e\n", dz);
+
+                            if (dz < settings->output.miss){
+                                DEBUG(3, "Eigenray found\n");
+
+                                //from index interpolate the rays' travel time and amplitude:
+                                interpolateRay(settings, ray, iHyd, rHyd, NULL, NULL, &tauRay, &ampRay, NULL);
+
+                                //save the arrival (it is written to the matfile later on):
+                                storeArrivalPr(&worker->buffer, ray, i, j, jj, rHyd, zRay, tauRay, ampRay);
+                            }// if (dz settings->output.miss)
+                        }// for(jj=1; jj<=settings->output.nArrayZ; jj++)
+
+                    }else{// if (ray->iReturn == false)
+
+                        DEBUG(3,"returning ray: nCoords: %u, iHyd:%u\n", (uint32_t)ray->nCoords, (uint32_t)iHyd);
+                        //get the indexes of the bracketing points.
+                        eBracket(ray->nCoords, ray->r, rHyd, &nRet, iRet);
+
+                        //for each index where the ray passes at the hydrophone, interpolate the rays' depth:
+                        for(l=0; l<nRet; l++){
+                            DEBUG(4, "nRet=%u, iRet[%u]= %u\n", (uint32_t)nRet, (uint32_t)l, (uint32_t)iRet[l]);
+                            interpolateRay(settings, ray, iRet[l], rHyd, &zRay, NULL, NULL, NULL, NULL);
+
+                            //for every hydrophone check if the ray is close enough to be considered an eigenray:
+                            for(jj=0;jj<settings->output.nArrayZ; jj++){
+                                zHyd = settings->output.arrayZ[jj];
+                                dz = fabs( zRay - zHyd );
+
+                                if (dz < settings->output.miss){
+
+                                    //interpolate the ray's travel time and amplitude:
+                                    interpolateRay(settings, ray, iRet[l], rHyd, NULL, NULL, &tauRay, &ampRay, NULL);
+
+                                    //save the arrival (it is written to the matfile later on):
+                                    storeArrivalPr(&worker->buffer, ray, i, j, jj, rHyd, zRay, tauRay, ampRay);
+                                }
+                            }
+                        }
+                    }// if (ray->iReturn == false)
+                }//if ( (rHyd >= ray->rMin) && (rHyd < ray->rMax))
+            }//for(j=0; j<settings->output.nArrayR; j++){
+        }//if (ctheta > 1.0e-7)
+    }//for(i=worker->iFirst + worker->iThread; i<worker->iLast; i+=worker->nThreads)
+    
+    reallocRayMembers(ray, 0);
+    free(ray);
+    return NULL;
+}
+
+void    traceAmpDelPr(settings_t* settings, arrivalBuffer_t* buffer){
+    /*
+     * Traces the rays of the current shard (all rays, unless '--shard' was passed) and
+     * appends the arrivals found to a buffer, in order of launching angle.
+     */
+    DEBUG(1,"in\n");
+    uintptr_t       i, iFirst, iLast;
+    uint32_t        t, nThreads;
+    ampDelPrWorker_t*  workers         = NULL;
+    uintptr_t*      cursor          = NULL;     //index of the next arrival to be read from each worker's buffer
+    
+    getShardRange(settings, &iFirst, &iLast);
+    
+    /** Trace the rays:  */
+    nThreads = (uint32_t)min( (double)settings->options.nThreads, (double)(iLast - iFirst));
+    nThreads = (uint32_t)max( (double)nThreads, 1.0);
+    workers = malloc(nThreads * sizeof(ampDelPrWorker_t));
+    cursor  = malloc(nThreads * sizeof(uintptr_t));
+    if(workers == NULL || cursor == NULL){
+        fatal("Memory alocation error.");
+    }
+    for(t=0; t<nThreads; t++){
+        workers[t].settings             = settings;
+        workers[t].iThread              = t;
+        workers[t].nThreads             = nThreads;
+        workers[t].iFirst               = iFirst;
+        workers[t].iLast                = iLast;
+        workers[t].buffer.nArrivals     = 0;
+        workers[t].buffer.maxArrivals   = 0;
+        workers[t].buffer.arrival       = NULL;
+        workers[t].nBackscatteredRays   = 0;
+        cursor[t] = 0;
+    }
+    
+    runThreads(nThreads, calcAmpDelPrWorker, workers, sizeof(ampDelPrWorker_t));
+    
+    /**
+     * Collect the arrivals. Ray i was traced by worker ((i - iFirst) % nThreads), so
+     * taking the arrivals from the workers' buffers in order of the launching angles
+     * results in the same output as a serial run.
+     */
+    for(i=iFirst; i<iLast; i++){
+        t = (uint32_t)((i - iFirst) % nThreads);
+        
+        while(  cursor[t] < workers[t].buffer.nArrivals &&
+                workers[t].buffer.arrival[cursor[t]].iTheta == i){
+            moveArrival(buffer, &workers[t].buffer.arrival[cursor[t]]);
+            cursor[t]++;
+        }
+    }
+    
+    for(t=0; t<nThreads; t++){
+        settings->options.nBackscatteredRays += workers[t].nBackscatteredRays;
+        //the arrivals themselves now belong to the output buffer:
+        free(workers[t].buffer.arrival);
+    }
+    free(workers);
+    free(cursor);
+    DEBUG(1,"out\n");
+}
+
+void    writeAmpDelPr(settings_t* settings, arrivalBuffer_t* buffer){
+    /*
+     * Writes the launching angles, the hydrophone array and the arrivals found at each hydrophone to the output file.
+     */
+    DEBUG(1,"in\n");
+
+    double          maxNumArrivals=0;       //keeps track of the highest number of arrivals
+    uintptr_t       i, j, jj, k;
+    arrival_t*      arrival             = NULL;
 
     mxArray*        pThetas             = NULL;
     mxArray*        pHydArrayR          = NULL;
@@ -163,187 +362,63 @@ void calcAmpDelPr(settings_t* settings){
     copyDoubleToMxArray(&settings->source.zx, pSourceZ, 1);
     matPutVariable(settings->options.matfile, "sourceZ", pSourceZ);
     mxDestroyArray(pSourceZ);
-
-
-    //allocate memory for the rays:
-    ray = makeRay(settings->source.nThetas);
     #endif
 
-    /** Trace the rays:  */
-    for(i=0; i<settings->source.nThetas; i++){
-        thetai = -settings->source.thetas[i] * M_PI/180.0;
-        ray[i].theta = thetai;
-        ctheta = fabs( cos(thetai));
-
-        //Trace a ray as long as it is neither at 90 nor -90:
-        if (ctheta > 1.0e-7){
-            solveEikonalEq(settings, &ray[i]);
-            solveDynamicEq(settings, &ray[i]);
-
-            //test for proximity of ray to each hydrophone
-            //(yes, this is slow, can you figure out a better way to do it?)
-            for(j=0; j<settings->output.nArrayR; j++){
-                rHyd = settings->output.arrayR[j];
-
-                if ( (rHyd >= ray[i].rMin) && (rHyd <= ray[i].rMax)){
-
-                    //  Check if the ray is returning back or not;
-                    //  if not:     we can bracket it without problems,
-                    //  otherwise:  we need to know how many times it passed by the given array range
-                    if (ray[i].iReturn == false){
-
-                        //get the index of the lower bracketing element:
-                        bracket(ray[i].nCoords, ray[i].r, rHyd, &iHyd);
-                        DEBUG(3,"non-returning ray: nCoords: %u, iHyd:%u\n", (uint32_t)ray[i].nCoords, (uint32_t)iHyd);
-
-                        //from index interpolate the rays' depth:
-                        intLinear1D(        &ray[i].r[iHyd], &ray[i].z[iHyd],   rHyd, &zRay,    &junkDouble);
-
-                        //for every hydrophone check distance to ray
-                        for(jj=0; jj<settings->output.nArrayZ; jj++){
-                            zHyd = settings->output.arrayZ[jj];
-                            dz = fabs(zRay-zHyd);
-                            DEBUG(4, "dz: %e\n", dz);
-
-                            if (dz < settings->output.miss){
-                                DEBUG(3, "Eigenray found\n");
-
-                                //from index interpolate the rays' travel time and amplitude:
-                                intLinear1D(        &ray[i].r[iHyd], &ray[i].tau[iHyd], rHyd, &tauRay,  &junkDouble);
-                                intComplexLinear1D( &ray[i].r[iHyd], &ray[i].amp[iHyd], rHyd, &ampRay,  &junkComplex);
-
-                                ///prepare to write arrival to matfile:
-                                //create mxArrays:
-                                mxTheta = mxCreateDoubleMatrix((MWSIZE)1,   (MWSIZE)1,  mxREAL);
-                                mxR     = mxCreateDoubleMatrix((MWSIZE)1,   (MWSIZE)1,  mxREAL);
-                                mxZ     = mxCreateDoubleMatrix((MWSIZE)1,   (MWSIZE)1,  mxREAL);
-                                mxTau   = mxCreateDoubleMatrix((MWSIZE)1,   (MWSIZE)1,  mxREAL);
-                                mxAmp   = mxCreateDoubleMatrix((MWSIZE)1,   (MWSIZE)1,  mxCOMPLEX);
-                                if( mxTheta == NULL || mxR == NULL || mxZ == NULL || mxTau == NULL || mxAmp == NULL){
-                                    fatal("Memory alocation error.");
-                                }
-
-                                //copy data to mxArrays:
-                                copyDoubleToMxArray(&settings->source.thetas[i],mxTheta,1);
-                                copyDoubleToMxArray(&rHyd,                      mxR,    1);
-                                copyDoubleToMxArray(&zRay,                      mxZ,    1);
-                                copyDoubleToMxArray(&tauRay,                    mxTau,  1);
-                                copyComplexToMxArray(&ampRay,                   mxAmp,  1);
-
-                                //copy mxArrays to mxArrivalStruct
-                                mxSetFieldByNumber( arrivals[j][jj].mxArrivalStruct,    //pointer to the mxStruct
-                                                    (MWINDEX)arrivals[j][jj].nArrivals, //index of the element
-                                                    0,                                  //position of the field (in this case, field 0 is "theta"
-                                                    mxTheta);                           //the mxArray we want to copy into the mxStruct
-                                mxSetFieldByNumber( arrivals[j][jj].mxArrivalStruct, (MWINDEX)arrivals[j][jj].nArrivals, 1, mxR);
-                                mxSetFieldByNumber( arrivals[j][jj].mxArrivalStruct, (MWINDEX)arrivals[j][jj].nArrivals, 2, mxZ);
-                                mxSetFieldByNumber( arrivals[j][jj].mxArrivalStruct, (MWINDEX)arrivals[j][jj].nArrivals, 3, mxTau);
-                                mxSetFieldByNumber( arrivals[j][jj].mxArrivalStruct, (MWINDEX)arrivals[j][jj].nArrivals, 4, mxAmp);
-                                ///Arrival has been saved to mxAadStruct
-                                
-                                ///now lets save some aditional ray information:
-                                iReturns    = mxCreateDoubleMatrix((MWSIZE)1,   (MWSIZE)1, mxREAL);
-                                nSurRefl    = mxCreateDoubleMatrix((MWSIZE)1,   (MWSIZE)1, mxREAL);
-                                nBotRefl    = mxCreateDoubleMatrix((MWSIZE)1,   (MWSIZE)1, mxREAL);
-                                nObjRefl    = mxCreateDoubleMatrix((MWSIZE)1,   (MWSIZE)1, mxREAL);
-
-                                copyBoolToMxArray(      &ray[i].iReturn,    iReturns,   1);
-                                copyUInt32ToMxArray(    &ray[i].sRefl,  nSurRefl,   1);
-                                copyUInt32ToMxArray(    &ray[i].bRefl,  nBotRefl,   1);
-                                copyUInt32ToMxArray(    &ray[i].oRefl,  nObjRefl,   1);
-
-                                mxSetFieldByNumber( arrivals[j][jj].mxArrivalStruct, (MWINDEX)arrivals[j][jj].nArrivals, 5, iReturns);
-                                mxSetFieldByNumber( arrivals[j][jj].mxArrivalStruct, (MWINDEX)arrivals[j][jj].nArrivals, 6, nSurRefl);
-                                mxSetFieldByNumber( arrivals[j][jj].mxArrivalStruct, (MWINDEX)arrivals[j][jj].nArrivals, 7, nBotRefl);
-                                mxSetFieldByNumber( arrivals[j][jj].mxArrivalStruct, (MWINDEX)arrivals[j][jj].nArrivals, 8, nObjRefl);
-                                ///aditional information has been saved
-                                
-                                arrivals[j][jj].nArrivals += 1;
-                                maxNumArrivals = max(arrivals[j][jj].nArrivals, maxNumArrivals);
-                            }// if (dz settings->output.miss)
-                        }// for(jj=1; jj<=settings->output.nArrayZ; jj++)
-
-                    }else{// if (ray[i].iReturn == false)
-
-                        DEBUG(3,"returning ray: nCoords: %u, iHyd:%u\n", (uint32_t)ray[i].nCoords, (uint32_t)iHyd);
-                        //get the indexes of the bracketing points.
-                        eBracket(ray[i].nCoords, ray[i].r, rHyd, &nRet, iRet);
-
-                        //for each index where the ray passes at the hydrophone, interpolate the rays' depth:
-                        for(l=0; l<nRet; l++){
-                            DEBUG(4, "nRet=%u, iRet[%u]= %u\n", (uint32_t)nRet, (uint32_t)l, (uint32_t)iRet[l]);
-                            intLinear1D(        &ray[i].r[iRet[l]], &ray[i].z[iRet[l]],     rHyd, &zRay,    &junkDouble);
-
-                            //for every hydrophone check if the ray is close enough to be considered an eigenray:
-                            for(jj=0;jj<settings->output.nArrayZ; jj++){
-                                zHyd = settings->output.arrayZ[jj];
-                                dz = fabs( zRay - zHyd );
-
-                                if (dz < settings->output.miss){
+    for(k=0; k<buffer->nArrivals; k++){
+        arrival = &buffer->arrival[k];
+        i   = arrival->iTheta;
+        j   = arrival->iHydR;
+        jj  = arrival->iHydZ;
+        
+        ///prepare to write arrival to matfile:
+        //create mxArrays:
+        mxTheta = mxCreateDoubleMatrix((MWSIZE)1,   (MWSIZE)1,  mxREAL);
+        mxR     = mxCreateDoubleMatrix((MWSIZE)1,   (MWSIZE)1,  mxREAL);
+        mxZ     = mxCreateDoubleMatrix((MWSIZE)1,   (MWSIZE)1,  mxREAL);
+        mxTau   = mxCreateDoubleMatrix((MWSIZE)1,   (MWSIZE)1,  mxREAL);
+        mxAmp   = mxCreateDoubleMatrix((MWSIZE)1,   (MWSIZE)1,  mxCOMPLEX);
+        if( mxTheta == NULL || mxR == NULL || mxZ == NULL || mxTau == NULL || mxAmp == NULL){
+            fatal("Memory alocation error.");
+        }
 
-                                    //interpolate the ray's travel time and amplitude:
-                                    intLinear1D(        &ray[i].r[iRet[l]], &ray[i].tau[iRet[l]],   rHyd, &tauRay,  &junkDouble);
-                                    intComplexLinear1D( &ray[i].r[iRet[l]], &ray[i].amp[iRet[l]],   (complex double)rHyd, &ampRay,  &junkComplex);
-
-                                    ///prepare to write arrival to matfile:
-                                    //create mxArrays:
-                                    mxTheta = mxCreateDoubleMatrix((MWSIZE)1,   (MWSIZE)1,  mxREAL);
-                                    mxR     = mxCreateDoubleMatrix((MWSIZE)1,   (MWSIZE)1,  mxREAL);
-                                    mxZ     = mxCreateDoubleMatrix((MWSIZE)1,   (MWSIZE)1,  mxREAL);
-                                    mxTau   = mxCreateDoubleMatrix((MWSIZE)1,   (MWSIZE)1,  mxREAL);
-                                    mxAmp   = mxCreateDoubleMatrix((MWSIZE)1,   (MWSIZE)1,  mxCOMPLEX);
-                                    if( mxTheta == NULL || mxR == NULL || mxZ == NULL || mxTau == NULL || mxAmp == NULL){
-                                        fatal("Memory alocation error.");
-                                    }
-
-                                    //copy data to mxArrays:
-                                    copyDoubleToMxArray(&settings->source.thetas[i],mxTheta,1);
-                                    copyDoubleToMxArray(&rHyd,                      mxR,    1);
-                                    copyDoubleToMxArray(&zRay,                      mxZ,    1);
-                                    copyDoubleToMxArray(&tauRay,                    mxTau,  1);
-                                    copyComplexToMxArray(&ampRay,                   mxAmp,  1);
-
-                                    //copy mxArrays to mxArrivalStruct
-                                    mxSetFieldByNumber( arrivals[j][jj].mxArrivalStruct,    //pointer to the mxStruct
-                                                        (MWINDEX)arrivals[j][jj].nArrivals, //index of the element
-                                                        0,                                  //position of the field (in this case, field 0 is "theta"
-                                                        mxTheta);                           //the mxArray we want to copy into the mxStruct
-                                    mxSetFieldByNumber( arrivals[j][jj].mxArrivalStruct, (MWINDEX)arrivals[j][jj].nArrivals, 1, mxR);
-                                    mxSetFieldByNumber( arrivals[j][jj].mxArrivalStruct, (MWINDEX)arrivals[j][jj].nArrivals, 2, mxZ);
-                                    mxSetFieldByNumber( arrivals[j][jj].mxArrivalStruct, (MWINDEX)arrivals[j][jj].nArrivals, 3, mxTau);
-                                    mxSetFieldByNumber( arrivals[j][jj].mxArrivalStruct, (MWINDEX)arrivals[j][jj].nArrivals, 4, mxAmp);
-                                    ///Arrival has been saved to mxAadStruct
-                                    
-                                     ///now lets save some aditional ray information:
-                                    iReturns    = mxCreateDoubleMatrix((MWSIZE)1,   (MWSIZE)1, mxREAL);
-                                    nSurRefl    = mxCreateDoubleMatrix((MWSIZE)1,   (MWSIZE)1, mxREAL);
-                                    nBotRefl    = mxCreateDoubleMatrix((MWSIZE)1,   (MWSIZE)1, mxREAL);
-                                    nObjRefl    = mxCreateDoubleMatrix((MWSIZE)1,   (MWSIZE)1, mxREAL);
-
-                                    copyBoolToMxArray(      &ray[i].iReturn,    iReturns,   1);
-                                    copyUInt32ToMxArray(    &ray[i].sRefl,  nSurRefl,   1);
-                                    copyUInt32ToMxArray(    &ray[i].bRefl,  nBotRefl,   1);
-                                    copyUInt32ToMxArray(    &ray[i].oRefl,  nObjRefl,   1);
-
-                                    mxSetFieldByNumber( arrivals[j][jj].mxArrivalStruct, (MWINDEX)arrivals[j][jj].nArrivals, 5, iReturns);
-                                    mxSetFieldByNumber( arrivals[j][jj].mxArrivalStruct, (MWINDEX)arrivals[j][jj].nArrivals, 6, nSurRefl);
-                                    mxSetFieldByNumber( arrivals[j][jj].mxArrivalStruct, (MWINDEX)arrivals[j][jj].nArrivals, 7, nBotRefl);
-                                    ///aditional information has been saved
-
-                                    arrivals[j][jj].nArrivals += 1;
-                                    maxNumArrivals = max(arrivals[j][jj].nArrivals, maxNumArrivals);
-                                }
-                            }
-                        }
-                    }// if (ray[i].iReturn == false)
-                }//if ( (rHyd >= ray[i].rMin) && (rHyd < ray[i].rMax))
-            }//for(j=0; j<settings->output.nArrayR; j++){
-            if(KEEP_RAYS_IN_MEM == false){
-                //free the ray's memory
-                reallocRayMembers(&ray[i],0);
-            }
-        }//if (ctheta > 1.0e-7)
-    }//for(i=0; i<settings->source.nThetas; i++)
+        //copy data to mxArrays:
+        copyDoubleToMxArray(&settings->source.thetas[i],mxTheta,1);
+        copyDoubleToMxArray(arrival->r,                 mxR,    1);
+        copyDoubleToMxArray(arrival->z,                 mxZ,    1);
+        copyDoubleToMxArray(arrival->tau,               mxTau,  1);
+        copyComplexToMxArray(arrival->amp,              mxAmp,  1);
+
+        //copy mxArrays to mxArrivalStruct
+        mxSetFieldByNumber( arrivals[j][jj].mxArrivalStruct,    //pointer to the mxStruct
+                            (MWINDEX)arrivals[j][jj].nArrivals, //index of the element
+                            0,                                  //position of the field (in this case, field 0 is "theta"
+                            mxTheta);                           //the mxArray we want to copy into the mxStruct
+        mxSetFieldByNumber( arrivals[j][jj].mxArrivalStruct, (MWINDEX)arrivals[j][jj].nArrivals, 1, mxR);
+        mxSetFieldByNumber( arrivals[j][jj].mxArrivalStruct, (MWINDEX)arrivals[j][jj].nArrivals, 2, mxZ);
+        mxSetFieldByNumber( arrivals[j][jj].mxArrivalStruct, (MWINDEX)arrivals[j][jj].nArrivals, 3, mxTau);
+        mxSetFieldByNumber( arrivals[j][jj].mxArrivalStruct, (MWINDEX)arrivals[j][jj].nArrivals, 4, mxAmp);
+        ///Arrival has been saved to mxAadStruct
+        
+        ///now lets save some aditional ray information:
+        iReturns    = mxCreateDoubleMatrix((MWSIZE)1,   (MWSIZE)1, mxREAL);
+        nSurRefl    = mxCreateDoubleMatrix((MWSIZE)1,   (MWSIZE)1, mxREAL);
+        nBotRefl    = mxCreateDoubleMatrix((MWSIZE)1,   (MWSIZE)1, mxREAL);
+        nObjRefl    = mxCreateDoubleMatrix((MWSIZE)1,   (MWSIZE)1, mxREAL);
+
+        copyBoolToMxArray(      &arrival->iReturn,  iReturns,   1);
+        copyUInt32ToMxArray(    &arrival->sRefl,    nSurRefl,   1);
+        copyUInt32ToMxArray(    &arrival->bRefl,    nBotRefl,   1);
+        copyUInt32ToMxArray(    &arrival->oRefl,    nObjRefl,   1);
+
+        mxSetFieldByNumber( arrivals[j][jj].mxArrivalStruct, (MWINDEX)arrivals[j][jj].nArrivals, 5, iReturns);
+        mxSetFieldByNumber( arrivals[j][jj].mxArrivalStruct, (MWINDEX)arrivals[j][jj].nArrivals, 6, nSurRefl);
+        mxSetFieldByNumber( arrivals[j][jj].mxArrivalStruct, (MWINDEX)arrivals[j][jj].nArrivals, 7, nBotRefl);
+        mxSetFieldByNumber( arrivals[j][jj].mxArrivalStruct, (MWINDEX)arrivals[j][jj].nArrivals, 8, nObjRefl);
+        ///aditional information has been saved
+        
+        arrivals[j][jj].nArrivals += 1;
+        maxNumArrivals = max(arrivals[j][jj].nArrivals, maxNumArrivals);
+    }
 
 
     //write "maximum number of arrivals at any single hydrophone" to matfile:
@@ -400,7 +475,20 @@ void calcAmpDelPr(settings_t* settings){
     
     //free memory
     mxDestroyArray(mxAadStruct);
-    reallocRayMembers(ray, 0);
-    free(ray);
+    DEBUG(1,"out\n");
+}
+
+void    calcAmpDelPr(settings_t* settings){
+    //NOTE: the code below is practically identical to calcEigenrayPr.c, the only difference being the file output
+    DEBUG(1,"in\n");
+    arrivalBuffer_t buffer;
+    
+    buffer.nArrivals    = 0;
+    buffer.maxArrivals  = 0;
+    buffer.arrival      = NULL;
+    
+    traceAmpDelPr(settings, &buffer);
+    writeAmpDelPr(settings, &buffer);
+    freeArrivalBuffer(&buffer);
     DEBUG(1,"out\n");
 }
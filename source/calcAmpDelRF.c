@@ -55,6 +55,7 @@
     #include    "matOut/matOut.h"
 #endif
 #include "interpolation.h"
+#include "getRayParameters.c"
 #include "bracket.c"
 #include "eBracket.c"
 
@@ -66,7 +67,6 @@ void calcAmpDelRF(settings_t* settings){
     uintptr_t       i, j, k, l, nRays, iHyd = 0;
     uintptr_t       nPossibleArrivals, nFoundArrivals = 0;
     double          zRay, zHyd, rHyd;
-    double          junkDouble;
     double          maxNumArrivals=0;       //keeps track of the highest number of arrivals
     uint32_t        nTrial;
     double          theta0, f0;
@@ -196,6 +196,8 @@ void calcAmpDelRF(settings_t* settings){
             thetas[nRays] = thetai;
             DEBUG(3, "thetas[%u]: %e\n", (uint32_t)nRays, thetas[nRays]);
             solveEikonalEq(settings, &ray[i]);
+            if(ray[i].iBackscattered)
+                settings->options.nBackscatteredRays++;
             solveDynamicEq(settings, &ray[i]);
             
             if (ray[i].iReturn == true){
@@ -214,7 +216,7 @@ void calcAmpDelRF(settings_t* settings){
                     bracket( ray[i].nCoords, ray[i].r, rHyd, &iHyd);
                     
                     //interpolate the ray depth at the range coord of hydrophone
-                    intLinear1D(&ray[i].r[iHyd], &ray[i].z[iHyd], rHyd, &zRay, &junkDouble);
+                    interpolateRay(settings, &ray[i], iHyd, rHyd, &zRay, NULL, NULL, NULL, NULL);
                     depths[nRays][j] = zRay;
                     DEBUG(3,"rHyd: %lf; rMin: %lf; rMax: %lf\n", rHyd, ray[i].rMin, ray[i].rMax);
                     DEBUG(3,"nCoords: %u, rHyd: %lf; iHyd: %u, zRay: %lf\n", (uint32_t)ray[i].nCoords, rHyd, (uint32_t)iHyd, zRay);
@@ -325,6 +327,8 @@ void calcAmpDelRF(settings_t* settings){
                 //Determine "left" ray's depth at rHyd:
                 tempRay[0].theta = thetaL[l];
                 solveEikonalEq(settings, tempRay);
+                if(tempRay[0].iBackscattered)
+                    settings->options.nBackscatteredRays++;
                 fl = tempRay[0].z[tempRay[0].nCoords-1] - zHyd;
                 //reset the ray members to zero:
                 reallocRayMembers(tempRay, 0);  
@@ -332,6 +336,8 @@ void calcAmpDelRF(settings_t* settings){
                 //Determine "right" ray's depth at rHyd:
                 tempRay[0].theta = thetaR[l];
                 solveEikonalEq(settings, tempRay);
+                if(tempRay[0].iBackscattered)
+                    settings->options.nBackscatteredRays++;
                 fr = tempRay[0].z[tempRay[0].nCoords-1] - zHyd;
                 //reset the ray members to zero:
                 reallocRayMembers(tempRay, 0);  
@@ -372,6 +378,8 @@ void calcAmpDelRF(settings_t* settings){
                         //find the distance between the new ray and the hydrophone:
                         tempRay[0].theta = theta0;
                         solveEikonalEq(settings, tempRay);
+                        if(tempRay[0].iBackscattered)
+                            settings->options.nBackscatteredRays++;
                         f0 = tempRay[0].z[tempRay[0].nCoords-1] - zHyd;
                         //reset the ray members to zero:
                         DEBUG(3, "nCoords: %u\n", (uint32_t)tempRay[0].nCoords);
@@ -409,6 +417,8 @@ void calcAmpDelRF(settings_t* settings){
                     //finally: get arrivals from the coordinates and amplitudes of the eigenray
                     tempRay[0].theta = theta0;
                     solveEikonalEq(settings, tempRay);
+                    if(tempRay[0].iBackscattered)
+                        settings->options.nBackscatteredRays++;
                     solveDynamicEq(settings, tempRay);
                     
                     
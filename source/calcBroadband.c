@@ -0,0 +1,345 @@
+/****************************************************************************************
+ *  calcBroadband.c                                                                     *
+ *  Calculates the coherent acoustic pressure or transmission loss at several           *
+ *  frequencies from a single trace of the ray fan.                                     *
+ *                                                                                      *
+ * ------------------------------------------------------------------------------------ *
+ * Website:                                                                             *
+ *          https://github.com/EyNuel/cTraceo/wiki                                      *
+ *                                                                                      *
+ * License: This file is part of the cTraceo Raytracing Model and is released under the *
+ *          Creative Commons Attribution-NonCommercial-ShareAlike 3.0 Unported License  *
+ *          http://creativecommons.org/licenses/by-nc-sa/3.0/                           *
+ *                                                                                      *
+ * NOTE:    cTraceo is research code under active development.                          *
+ *          The code may contain bugs and updates are possible in the future.           *
+ *                                                                                      *
+ * Written for project SENSOCEAN by:                                                    *
+ *          Emanuel Ey                                                                  *
+ *          emanuel.ey@gmail.com                                                        *
+ *          Copyright (C) 2011 - 2013                                                   *
+ *          Signal Processing Laboratory                                                *
+ *          Universidade do Algarve                                                     *
+ *                                                                                      *
+ * ------------------------------------------------------------------------------------ *
+ *  Inputs:                                                                             *
+ *          settings:   Pointer to structure containing all input info.                 *
+ *                      The frequency file's name is given by                           *
+ *                      settings->options.broadbandFileName.                            *
+ *                                                                                      *
+ *  Frequency file format (values are separated by white space):                        *
+ *          'title'                                                                     *
+ *          nFrequencies                                                                *
+ *          f                       the frequencies [Hz].                               *
+ *                                                                                      *
+ *  Outputs:                                                                            *
+ *          CPR, CTL:   frequencies, thetas, arrayR, arrayZ and the pressure ("p") or   *
+ *                      transmission loss ("tl") at all frequencies, written as a       *
+ *                      [nArrayZ x nArrayR*nFrequencies] matrix (see                    *
+ *                      writeCohAcoustPressCube() in calcCohAcoustPress.c).             *
+ *                                                                                      *
+ *  Return Value:                                                                       *
+ *          None                                                                        *
+ *                                                                                      *
+ *  NOTE:   Ray coordinates, travel times, q and the caustic phase don't depend on the  *
+ *          frequency, so each ray is traced once, at the input file's frequency. Only  *
+ *          the phase of the pressure and the Thorpe attenuation are evaluated per      *
+ *          frequency; the latter by rescaling the ray's amplitude.                     *
+ *          Reflections on elastic boundaries with attenuation given in dB/m or dB/Np   *
+ *          depend on the frequency as well; in that case each ray is traced once per   *
+ *          frequency, which is still cheaper than running each frequency separately.   *
+ ****************************************************************************************/
+
+#pragma once
+#include <complex.h>
+#include "globals.h"
+#include "tools.h"
+#include "calcCohAcoustPress.c"
+#if USE_MATLAB == 1
+    #include <mat.h>
+    #include "matrix.h"
+#else
+    #include    "matOut/matOut.h"
+#endif
+
+typedef struct broadbandWorker{
+    /*
+     * Arguments and private accumulators of one worker thread (see '--threads').
+     * Rays are distributed among workers in an interleaved fashion.
+     */
+    settings_t*         settings;
+    uintptr_t           nFreqs;
+    double*             freqs;
+    bool                retrace;                //true if each ray has to be traced once per frequency
+    uint32_t            iThread;
+    uint32_t            nThreads;
+    double              q0;
+    uintptr_t           dimR, dimZ;
+    complex double***   pressure2D;             //pressure2D[iFreq][j][k]
+    uint32_t            nBackscatteredRays;
+}broadbandWorker_t;
+
+double* readBroadband(const char*, uintptr_t*);
+bool    reflectionsDependOnFreq(settings_t*);
+void*   calcBroadbandWorker(void*);
+void    calcBroadband(settings_t*);
+
+double* readBroadband(const char* fileName, uintptr_t* nFreqs){
+    /*
+     * Reads a frequency file and returns the frequencies.
+     */
+    FILE*       broadbandFile = openFile(fileName, "r");
+    double*     freqs = NULL;
+    uintptr_t   i;
+    int32_t     n;
+
+    skipLine(broadbandFile);
+    n = readInt(broadbandFile);
+    if(n < 1){
+        fatal("Frequency file: number of frequencies must be positive.\nAborting...");
+    }
+    *nFreqs = (uintptr_t)n;
+    freqs   = mallocDouble(*nFreqs);
+    for(i=0; i<*nFreqs; i++){
+        freqs[i] = readDouble(broadbandFile);
+        if(freqs[i] <= 0){
+            fatal("Frequency file: frequencies must be positive.\nAborting...");
+        }
+    }
+    fclose(broadbandFile);
+    return freqs;
+}
+
+bool    reflectionsDependOnFreq(settings_t* settings){
+    /*
+     * Returns true if the reflection coefficient of any boundary depends on the frequency,
+     * i.e., if the boundary is elastic and its attenuation is given per meter or per neper
+     * (see convertUnits.c).
+     */
+    uintptr_t   i;
+    uint32_t    type[2], units[2];
+
+    type[0]     = settings->altimetry.surfaceType;
+    units[0]    = settings->altimetry.surfaceAttenUnits;
+    type[1]     = settings->batimetry.surfaceType;
+    units[1]    = settings->batimetry.surfaceAttenUnits;
+    for(i=0; i<2; i++){
+        if( type[i] == SURFACE_TYPE__ELASTIC &&
+            (units[i] == SURFACE_ATTEN_UNITS__dBperMeter || units[i] == SURFACE_ATTEN_UNITS__dBperNeper)){
+            return true;
+        }
+    }
+    for(i=0; i<settings->objects.numObjects; i++){
+        if( settings->objects.object[i].surfaceType == SURFACE_TYPE__ELASTIC &&
+            (   settings->objects.object[i].surfaceAttenUnits == SURFACE_ATTEN_UNITS__dBperMeter ||
+                settings->objects.object[i].surfaceAttenUnits == SURFACE_ATTEN_UNITS__dBperNeper)){
+            return true;
+        }
+    }
+    return false;
+}
+
+void*   calcBroadbandWorker(void* args){
+    /*
+     * Traces every nThreads-th ray, starting at ray iThread, and adds each ray's
+     * pressure contribution at every frequency to the worker's own accumulators.
+     */
+    broadbandWorker_t*  worker      = (broadbandWorker_t*)args;
+    settings_t*         settings    = worker->settings;
+    settings_t*         freqSettings = NULL;       //private copies of the settings, one per frequency
+    double*             dAlpha      = NULL;         //Thorpe attenuation relative to the input file's frequency
+    complex double*     amp         = NULL;         //the ray's amplitude at the input file's frequency
+    uintptr_t           maxCoords   = 0;
+    ray_t*              ray         = NULL;
+    double              alpha, ctheta, thetai;
+    uintptr_t           i, f, n;
+
+    freqSettings    = malloc(worker->nFreqs * sizeof(settings_t));
+    dAlpha          = mallocDouble(worker->nFreqs);
+    if(freqSettings == NULL){
+        fatal("Memory alocation error.");
+    }
+    thorpe(settings->source.freqx, &alpha);
+    for(f=0; f<worker->nFreqs; f++){
+        freqSettings[f]                 = *settings;
+        freqSettings[f].source.freqx    = worker->freqs[f];
+        thorpe(worker->freqs[f], &dAlpha[f]);
+        dAlpha[f] -= alpha;
+    }
+
+    //allocate memory for the ray (reused for all of this worker's rays):
+    ray = makeRay(1);
+
+    for(i=worker->iThread; i<settings->source.nThetas; i+=worker->nThreads){
+        thetai = -settings->source.thetas[i] * M_PI/180.0;
+        ray->theta = thetai;
+        ctheta = fabs( cos(thetai));
+
+        //Trace a ray as long as it is neither at 90 nor -90:
+        if (ctheta > 1.0e-7){
+            if(worker->retrace){
+                //the reflection coefficients depend on the frequency:
+                for(f=0; f<worker->nFreqs; f++){
+                    solveEikonalEq(&freqSettings[f], ray);
+                    if(f == 0 && ray->iBackscattered)
+                        worker->nBackscatteredRays++;
+                    solveDynamicEq(&freqSettings[f], ray);
+                    addRayPressure(&freqSettings[f], ray, worker->q0, worker->dimR, worker->dimZ, worker->pressure2D[f]);
+                }
+            }else{
+                solveEikonalEq(settings, ray);
+                if(ray->iBackscattered)
+                    worker->nBackscatteredRays++;
+                solveDynamicEq(settings, ray);
+
+                //keep the amplitude at the input file's frequency:
+                if(ray->nCoords > maxCoords){
+                    maxCoords   = ray->nCoords;
+                    amp         = realloc(amp, maxCoords * sizeof(complex double));
+                    if(amp == NULL){
+                        fatal("Memory alocation error.");
+                    }
+                }
+                memcpy(amp, ray->amp, ray->nCoords * sizeof(complex double));
+
+                for(f=0; f<worker->nFreqs; f++){
+                    //apply the Thorpe attenuation at this frequency (amp[0] is not used):
+                    for(n=1; n<ray->nCoords; n++){
+                        ray->amp[n] = amp[n] * exp( -dAlpha[f] * ray->s[n] );
+                    }
+                    addRayPressure(&freqSettings[f], ray, worker->q0, worker->dimR, worker->dimZ, worker->pressure2D[f]);
+                }
+            }
+        }
+    }
+
+    //free memory
+    reallocRayMembers(ray, 0);
+    free(ray);
+    free(amp);
+    freeDouble(dAlpha);
+    free(freqSettings);
+    return NULL;
+}
+
+void    calcBroadband(settings_t* settings){
+    /*
+     * Traces the ray fan once (in parallel, see '--threads') and writes the pressure or
+     * transmission loss at all frequencies of the frequency file to the output file.
+     */
+    assert(settings->options.matfile != NULL);   //output file must be open
+
+    DEBUG(1,"in\n");
+    broadbandWorker_t*  workers     = NULL;
+    complex double*     pressure    = NULL;
+    double*             freqs       = NULL;
+    uintptr_t           nFreqs      = 0;
+    uintptr_t           f, j, k, dimR = 0, dimZ = 0;
+    uint32_t            t, nThreads;
+    double              cx, q0;
+    double              junkDouble;
+    vector_t            junkVector;
+    mxArray*            pFreqs      = NULL;
+    mxArray*            pThetas     = NULL;
+    mxArray*            pHydArrayR  = NULL;
+    mxArray*            pHydArrayZ  = NULL;
+
+    if( settings->output.calcType != CALC_TYPE__COH_ACOUS_PRESS &&
+        settings->output.calcType != CALC_TYPE__COH_TRANS_LOSS){
+        fatal("Option '--broadband <file>' is only available for the CPR and CTL output options.\nAborting...");
+    }
+    if(settings->output.arrayType == ARRAY_TYPE__LINEAR){
+        fatal("Option '--broadband <file>' is not available for linear hydrophone arrays.\nAborting...");
+    }
+
+    freqs = readBroadband(settings->options.broadbandFileName, &nFreqs);
+    getPressureDims(settings, &dimR, &dimZ);
+
+    //get sound speed at source (cx):
+    csValues(   settings, NULL, settings->source.rx, settings->source.zx, &cx,
+                &junkDouble, &junkDouble, &junkDouble, &junkDouble,
+                &junkVector, &junkDouble, &junkDouble, &junkDouble);
+    q0 = cx / ( M_PI * settings->source.dTheta/180.0 );
+
+    nThreads = (uint32_t)min( (double)settings->options.nThreads, (double)settings->source.nThetas);
+    nThreads = (uint32_t)max( (double)nThreads, 1.0);
+    workers = malloc(nThreads * sizeof(broadbandWorker_t));
+    if(workers == NULL){
+        fatal("Memory alocation error.");
+    }
+    for(t=0; t<nThreads; t++){
+        workers[t].settings             = settings;
+        workers[t].nFreqs               = nFreqs;
+        workers[t].freqs                = freqs;
+        workers[t].retrace              = reflectionsDependOnFreq(settings);
+        workers[t].iThread              = t;
+        workers[t].nThreads             = nThreads;
+        workers[t].q0                   = q0;
+        workers[t].dimR                 = dimR;
+        workers[t].dimZ                 = dimZ;
+        workers[t].nBackscatteredRays   = 0;
+        workers[t].pressure2D           = malloc(nFreqs * sizeof(complex double**));
+        if(workers[t].pressure2D == NULL){
+            fatal("Memory alocation error.");
+        }
+        for(f=0; f<nFreqs; f++){
+            workers[t].pressure2D[f] = mallocComplex2D(dimR, dimZ);
+        }
+    }
+
+    runThreads(nThreads, calcBroadbandWorker, workers, sizeof(broadbandWorker_t));
+
+    /**
+     * Reduction: add the workers' contributions (always in the same order, so that
+     * results are reproducible for a given number of threads).
+     */
+    pressure = malloc(nFreqs * dimR * dimZ * sizeof(complex double));
+    if(pressure == NULL){
+        fatal("Memory alocation error.");
+    }
+    for(f=0; f<nFreqs; f++){
+        for(j=0; j<dimR; j++){
+            for(k=0; k<dimZ; k++){
+                pressure[(f*dimR + j)*dimZ + k] = workers[0].pressure2D[f][j][k];
+                for(t=1; t<nThreads; t++){
+                    pressure[(f*dimR + j)*dimZ + k] += workers[t].pressure2D[f][j][k];
+                }
+            }
+        }
+    }
+    for(t=0; t<nThreads; t++){
+        settings->options.nBackscatteredRays += workers[t].nBackscatteredRays;
+        for(f=0; f<nFreqs; f++){
+            freeComplex2D(workers[t].pressure2D[f], dimR);
+        }
+        free(workers[t].pressure2D);
+    }
+    free(workers);
+
+    //write frequencies, launching angles and hydrophone array to file:
+    pFreqs      = mxCreateDoubleMatrix((MWSIZE)1, (MWSIZE)nFreqs, mxREAL);
+    pThetas     = mxCreateDoubleMatrix((MWSIZE)1, (MWSIZE)settings->source.nThetas, mxREAL);
+    pHydArrayR  = mxCreateDoubleMatrix((MWSIZE)1, (MWSIZE)settings->output.nArrayR, mxREAL);
+    pHydArrayZ  = mxCreateDoubleMatrix((MWSIZE)1, (MWSIZE)settings->output.nArrayZ, mxREAL);
+    if(pFreqs == NULL || pThetas == NULL || pHydArrayR == NULL || pHydArrayZ == NULL){
+        fatal("Memory alocation error.");
+    }
+    copyDoubleToPtr(freqs,                   mxGetPr(pFreqs),     nFreqs);
+    copyDoubleToPtr(settings->source.thetas, mxGetPr(pThetas),    settings->source.nThetas);
+    copyDoubleToPtr(settings->output.arrayR, mxGetPr(pHydArrayR), settings->output.nArrayR);
+    copyDoubleToPtr(settings->output.arrayZ, mxGetPr(pHydArrayZ), settings->output.nArrayZ);
+    matPutVariable(settings->options.matfile, "frequencies", pFreqs);
+    matPutVariable(settings->options.matfile, "thetas",      pThetas);
+    matPutVariable(settings->options.matfile, "arrayR",      pHydArrayR);
+    matPutVariable(settings->options.matfile, "arrayZ",      pHydArrayZ);
+    mxDestroyArray(pFreqs);
+    mxDestroyArray(pThetas);
+    mxDestroyArray(pHydArrayR);
+    mxDestroyArray(pHydArrayZ);
+
+    //write the pressure or transmission loss at all frequencies:
+    writeCohAcoustPressCube(settings, pressure, nFreqs);
+    free(pressure);
+    freeDouble(freqs);
+    DEBUG(1,"out\n");
+}
@@ -42,7 +42,9 @@
  *                                                                                      *
  ****************************************************************************************/
 
+#pragma  once
 #include "globals.h"
+#include "tools.h"
 #include "getRayPressure.c"
 #if USE_MATLAB == 1
     #include <mat.h>
@@ -58,48 +60,46 @@
 #include "pressureMStar.c"
 #include <complex.h>
 
+typedef struct cohAcoustPressWorker{
+    /*
+     * Arguments and private accumulators of one worker thread (see '--threads').
+     * Worker 0 accumulates directly into settings->output; all other workers use their
+     * own memory, which is added to worker 0's in a final reduction.
+     */
+    settings_t*         settings;
+    uint32_t            iThread;
+    uint32_t            nThreads;
+    double              q0;
+    uintptr_t           dimR, dimZ;
+    uintptr_t           iFirst, iLast;          //range of launching angles to be traced (see '--shard')
+    complex double**    pressure2D;
+    complex double      (**pressure_H)[3];
+    complex double      (**pressure_V)[3];
+    uint32_t            nBackscatteredRays;
+}cohAcoustPressWorker_t;
+
+void    getPressureDims(settings_t*, uintptr_t*, uintptr_t*);
+void    addRayPressure(settings_t*, ray_t*, double, uintptr_t, uintptr_t, complex double**);
+void*   calcCohAcoustPressWorker(void*);
+void    initCohAcoustPress(settings_t*);
+void    traceCohAcoustPress(settings_t*);
+void    writeCohAcoustPress(settings_t*);
+void    writeCohAcoustPressCube(settings_t*, complex double*, uintptr_t);
 void    calcCohAcoustPress(settings_t*);
 
-void    calcCohAcoustPress(settings_t* settings){
-    
-    assert(settings != NULL);
-    assert(settings->options.matfile != NULL);   //output file must be open
-    
-    DEBUG(1,"in\n");
-    mxArray*            pThetas = NULL;
-    mxArray*            pHydArrayR  = NULL;
-    mxArray*            pHydArrayZ  = NULL;
-    mxArray*            p   = NULL;
-    double              lambda;
-    uintptr_t           i, j, jj, k, l, iHyd = 0;
-    uintptr_t           dimR = 0, dimZ = 0;
-    ray_t*              ray = NULL;
-    double              ctheta, thetai, cx, q0;
-    double              junkDouble;
-    vector_t            junkVector;
-    double              rHyd, zHyd;
-    complex double      pressure;
-    complex double      pressure_H[3];
-    complex double      pressure_V[3];
-    uintptr_t           nRet;
-    uintptr_t           iRet[51];
-    double              dr, dz; //used for star pressure contributions (for particle velocity)
-    
-    #if VERBOSE
-        //indexing variables used to output the pressure2D variable during debugging:
-        uintptr_t           rr,zz;
-    #endif
-    
-    //determine dimensions of hydrophone array:
+void    getPressureDims(settings_t* settings, uintptr_t* dimR, uintptr_t* dimZ){
+    /*
+     * Determines the dimensions of the pressure arrays for the hydrophone array in use.
+     */
     switch(settings->output.arrayType){
         case ARRAY_TYPE__HORIZONTAL:
-            dimR = settings->output.nArrayR;
-            dimZ = 1;
+            *dimR = settings->output.nArrayR;
+            *dimZ = 1;
             break;
 
         case ARRAY_TYPE__VERTICAL:
-            dimR = 1;
-            dimZ = settings->output.nArrayZ;
+            *dimR = 1;
+            *dimZ = settings->output.nArrayZ;
             break;
 
         case ARRAY_TYPE__LINEAR:
@@ -109,133 +109,146 @@ void    calcCohAcoustPress(settings_t* settings){
             *   The pressure components will be written to the rightmost index
             *   of the 2d-array.
             */
-            dimR = settings->output.nArrayR;
-            dimZ = settings->output.nArrayZ;    //this should be equal to nArrayR
+            *dimR = settings->output.nArrayR;
+            *dimZ = settings->output.nArrayZ;   //this should be equal to nArrayR
             break;
 
         case ARRAY_TYPE__RECTANGULAR:
-            dimR = settings->output.nArrayR;
-            dimZ = settings->output.nArrayZ;
+            *dimR = settings->output.nArrayR;
+            *dimZ = settings->output.nArrayZ;
             break;
 
         default:
             fatal("calcCohAcoustPress(): unknown array type.\nAborting.");
             break;
     }
+}
 
-    pThetas     = mxCreateDoubleMatrix((MWSIZE)1, (MWSIZE)settings->source.nThetas, mxREAL);
-    if(pThetas == NULL)
-        fatal("Memory alocation error.");
-
-    //copy angles in cArray to mxArray:
-    copyDoubleToPtr(    settings->source.thetas,
-                        mxGetPr(pThetas),
-                        settings->source.nThetas);
-    //move mxArray to file and free memory:
-    matPutVariable(settings->options.matfile, "thetas", pThetas);
-    mxDestroyArray(pThetas);
+void    addRayPressure(settings_t* settings, ray_t* ray, double q0, uintptr_t dimR, uintptr_t dimZ, complex double** pressure2D){
+    /*
+     * Adds a ray's contribution to the acoustic pressure at each hydrophone (CPR, CTL).
+     */
+    uintptr_t           j, jj, k, iHyd = 0;
+    uintptr_t           iCursor = 0;    //interval of ray->r found by the last lookup (see bracketHunt())
+    double              rHyd, zHyd;
+    complex double      pressure;
+    uintptr_t           nRet;
+    uintptr_t           iRet[51];
     
-    //write hydrophone array ranges to file:
-    pHydArrayR  = mxCreateDoubleMatrix((MWSIZE)1, (MWSIZE)settings->output.nArrayR, mxREAL);
-    if(pHydArrayR == NULL){
-        fatal("Memory alocation error.");
-    }
-    copyDoubleToPtr(    settings->output.arrayR,
-                        mxGetPr(pHydArrayR),
-                        (uintptr_t)settings->output.nArrayR);
-    //move mxArray to file and free memory:
-    matPutVariable(settings->options.matfile, "arrayR", pHydArrayR);
-    mxDestroyArray(pHydArrayR);
+    switch(settings->output.arrayType){
+        case ARRAY_TYPE__LINEAR:
+            //NOTE: in linear arrays, nArrayR and nArrayZ have to be equal (this is checked in readIn.c when reading the file)
+            DEBUG(3,"Array type: Linear\n");
 
+            for(j=0; j<dimZ; j++){
+                rHyd = settings->output.arrayR[j];
+                zHyd = settings->output.arrayZ[j];
 
-    //write hydrophone array depths to file:
-    pHydArrayZ  = mxCreateDoubleMatrix((MWSIZE)1, (MWSIZE)settings->output.nArrayZ, mxREAL);
-    if(pHydArrayZ == NULL){
-        fatal("Memory alocation error.");
-    }
-    copyDoubleToPtr(    settings->output.arrayZ,
-                        mxGetPr(pHydArrayZ),
-                        (uintptr_t)settings->output.nArrayZ);
-    //move mxArray to file and free memory:
-    matPutVariable(settings->options.matfile, "arrayZ", pHydArrayZ);
-    mxDestroyArray(pHydArrayZ);
+                if (    rHyd >= ray->rMin &&  rHyd < ray->rMax  ){
 
+                    if (ray->iReturn == false){
+                        bracketHunt(ray->nCoords, ray->r, NULL, rHyd, &iCursor, &iHyd);
+                        getRayPressure(settings, ray, iHyd, q0, rHyd, zHyd, &pressure);
+                        pressure2D[0][j] += pressure;
 
-    //allocate memory for the rays:
-    ray = makeRay(settings->source.nThetas);
+                    }else{
+                        eBracket(ray->nCoords, ray->r, rHyd, &nRet, iRet);
 
+                        for(jj=0; jj<nRet; jj++){
 
-    //get sound speed at source (cx):
-    csValues(   settings, settings->source.rx, settings->source.zx, &cx,
-                &junkDouble, &junkDouble, &junkDouble, &junkDouble,
-                &junkVector, &junkDouble, &junkDouble, &junkDouble);
+                            //if the ray returns we have to check all hydrophone depths:
+                            for(k=0; k<dimZ; k++){
+                                zHyd = settings->output.arrayZ[k];
+                                getRayPressure(settings, ray, iRet[jj], q0, rHyd, zHyd, &pressure);
+                                pressure2D[0][j] += pressure;  //TODO make sure this value is initialized
+                            }
+                        }
+                    }
+                }
+            }
+            break;
 
-    q0 = cx / ( M_PI * settings->source.dTheta/180.0 );
+        case ARRAY_TYPE__HORIZONTAL:
+        case ARRAY_TYPE__VERTICAL:
+        case ARRAY_TYPE__RECTANGULAR:
+            DEBUG(3,"Array type: Rectangular/Horizontal/Vertical\n");
+            DEBUG(4,"nArrayR: %u, nArrayZ: %u\n", (uint32_t)dimR, (uint32_t)dimZ );
 
+            for(j=0; j<dimR; j++){
+                rHyd = settings->output.arrayR[j];
 
-    /**
-     * Allocate memory for pressure and do some other case specific initialization
-     */
-    if( settings->output.calcType == CALC_TYPE__PART_VEL ||
-        settings->output.calcType == CALC_TYPE__COH_ACOUS_PRESS_PART_VEL){
-        /**
-         *  In these cases, we will need memory to save the horizontal/vertical pressure components
-         *  (pressure_H[3], presure_V[3])
-         *  see also: globals.h, output struct
-         */
+                //Start by checking if the array range is inside the min and max ranges of the ray:
+                if (    rHyd >= ray->rMin &&  rHyd < ray->rMax){
 
-        //Determine the size of the "star" (the vertical/horizontal offset for the pressure contribuitions).
-        lambda  = cx/settings->source.freqx;
-        dr = lambda/10;
-        dz = lambda/10;
+                    if (ray->iReturn == false){
+                        bracketHunt(ray->nCoords, ray->r, NULL, rHyd, &iCursor, &iHyd);
+                        for(k=0; k<dimZ; k++){
 
-        for (i=1; i<settings->output.nArrayR; i++){
-            dr = min( fabs( settings->output.arrayR[i] - settings->output.arrayR[i-1]), dr);
-        }
-        for (i=1; i<settings->output.nArrayZ; i++){
-            dr = min( fabs( settings->output.arrayZ[i] - settings->output.arrayZ[i-1]), dz);
-        }
+                            zHyd = settings->output.arrayZ[k];
+                            getRayPressure(settings, ray, iHyd, q0, rHyd, zHyd, &pressure);
+                            DEBUG(1, "ray: %d, hyd(j,k)=(%d,%d) : pressure: %lf +%lf*i\n", (int32_t)i, (int32_t)j, (int32_t)k, creal(pressure), cimag(pressure));
 
-        settings->output.dr = dr;
-        settings->output.dz = dz;
-        DEBUG(1, "dr: %lf; dz: %lf\n", dr, dz);
+                            pressure2D[j][k] += pressure;  //verify if initialization is necessary. Done -makes no difference.
+                            DEBUG(4, "k: %u; j: %u; pressure2D[k][j]: %e + j*%e\n", (uint32_t)k, (uint32_t)j, creal(pressure2D[k][j]), cimag(pressure2D[k][j]));
+                            DEBUG(4, "rHyd: %lf; zHyd: %lf \n", rHyd, zHyd);
+                        }
 
-        //malloc memory for horizontal and vertical pressure components:
-        settings->output.pressure_H = malloc( dimR * sizeof(uintptr_t));
-        settings->output.pressure_V = malloc( dimR * sizeof(uintptr_t));
-        if (    settings->output.pressure_H == NULL || settings->output.pressure_V == NULL){
-            fatal("Memory alocation error.");
-        }
-        for (i=0; i<dimR; i++){
-            settings->output.pressure_H[i] = malloc(dimZ * sizeof(complex double[3]));
-            settings->output.pressure_V[i] = malloc(dimZ * sizeof(complex double[3]));
-            if(settings->output.pressure_H[i] == NULL || settings->output.pressure_V[i] == NULL){
-                fatal("Memory allocation error.");
+                    }else{
+                        eBracket(ray->nCoords, ray->r, rHyd, &nRet, iRet);
+                        for(k=0; k<dimZ; k++){
+                            zHyd = settings->output.arrayZ[k];
+
+                            for(jj=0; jj<nRet; jj++){
+                                getRayPressure(settings, ray, iRet[jj], q0, rHyd, zHyd, &pressure);
+                                pressure2D[j][k] += pressure;
+                            }
+                        }
+                    }
+                }
             }
-        }
-    }
-    if( settings->output.calcType == CALC_TYPE__COH_ACOUS_PRESS ||
-        settings->output.calcType == CALC_TYPE__COH_TRANS_LOSS  ||
-        settings->output.calcType == CALC_TYPE__COH_ACOUS_PRESS_PART_VEL){
-            /**
-             * when calculating only the Acoustic Pressure we only need memory the simple pressure, no H/V components.
-             * when calculating both Acoustic Pressure and Particle Velocity, pressure2D is used as a temporary
-             * variable at the end of the file to obtain the simple pressure from the center elements of
-             * star pressure contributions.
-             */
-            settings->output.pressure2D = mallocComplex2D(dimR, dimZ);
+            break;
+
+        default:
+            fatal("calcCohAcoustPress(): unknown array type.");
+            break;
     }
+}
+
+void*   calcCohAcoustPressWorker(void* args){
+    /*
+     * Traces every nThreads-th ray, starting at ray iThread, and adds each
+     * ray's pressure contribution to the worker's own accumulators.
+     */
+    cohAcoustPressWorker_t* worker = (cohAcoustPressWorker_t*)args;
+    settings_t*         settings = worker->settings;
+    uintptr_t           i, j, k, l;
+    uintptr_t           dimR = worker->dimR;
+    uintptr_t           dimZ = worker->dimZ;
+    double              q0 = worker->q0;
+    ray_t*              ray = NULL;
+    double              ctheta, thetai;
+    double              rHyd, zHyd;
+    complex double      pressure_H[3];
+    complex double      pressure_V[3];
+    uintptr_t           iCursor;    //interval of ray->r found by the last lookup (see pressureStar())
+    
+    //allocate memory for the ray (reused for all of this worker's rays):
+    ray = makeRay(1);
 
     ///Solve the EIKonal and the DYNamic sets of EQuations:
-    for(i=0; i<settings->source.nThetas; i++){
+    //NOTE: rays are distributed among threads in an interleaved fashion, which keeps the workload balanced.
+    for(i=worker->iFirst + worker->iThread; i<worker->iLast; i+=worker->nThreads){
         thetai = -settings->source.thetas[i] * M_PI/180.0;
-        ray[i].theta = thetai;
+        ray->theta = thetai;
         ctheta = fabs( cos(thetai));
 
         //Trace a ray as long as it is neither at 90 nor -90:
         if (ctheta > 1.0e-7){
-            solveEikonalEq(settings, &ray[i]);
-            solveDynamicEq(settings, &ray[i]);
+            solveEikonalEq(settings, ray);
+            if(ray->iBackscattered)
+                worker->nBackscatteredRays++;
+            solveDynamicEq(settings, ray);
+            iCursor = 0;
 
             DEBUG(3,"q0: %e\n", q0);
             //Now that the ray has been calculated let's determine the ray influence at each point of the array:
@@ -254,25 +267,25 @@ void    calcCohAcoustPress(settings_t* settings){
                                 rHyd = settings->output.arrayR[j];
 
                                 //check whether the hydrophone is within the range coordinates of the ray:
-                                //if ( (rHyd - dr)>= ray[i].rMin    &&  (rHyd + dr) < ray[i].rMax){
-                                if ( rHyd >= ray[i].rMin    &&  rHyd < ray[i].rMax){
+                                //if ( (rHyd - dr)>= ray->rMin    &&  (rHyd + dr) < ray->rMax){
+                                if ( rHyd >= ray->rMin    &&  rHyd < ray->rMax){
 
-                                    if ( ray[i].iReturn == false){
+                                    if ( ray->iReturn == false){
                                         DEBUG(5, "Ray doesn't return\n");
                                         for(k=0; k<dimZ; k++){
                                             zHyd = settings->output.arrayZ[k];
 
-                                            if( pressureStar( settings, &ray[i], rHyd, zHyd, q0, pressure_H, pressure_V) ){
+                                            if( pressureStar( settings, ray, &iCursor, rHyd, zHyd, q0, pressure_H, pressure_V) ){
                                                 DEBUG(7, "i=%u: (j,k)=(%u,%u): \n",(uint32_t)i, (uint32_t)j, (uint32_t)k);
-                                                DEBUG(7, "in>>  (rH,zH)=(%.2lf,%.2lf), nCoords: %u, q0: %e\n", rHyd, zHyd, (uint32_t)ray[i].nCoords, q0);
+                                                DEBUG(7, "in>>  (rH,zH)=(%.2lf,%.2lf), nCoords: %u, q0: %e\n", rHyd, zHyd, (uint32_t)ray->nCoords, q0);
                                                 DEBUG(7, "out>> pL: %e,  pU, %e,  pR: %e,  pD: %e,  pC:%e\n\n", cabs(pressure_H[LEFT]), cabs(pressure_V[TOP]), cabs(pressure_H[RIGHT]), cabs(pressure_V[BOTTOM]), cabs(pressure_H[CENTER]));
 
                                                 for (l=0; l<3; l++){
-                                                    settings->output.pressure_H[j][k][l] += pressure_H[l];
-                                                    settings->output.pressure_V[j][k][l] += pressure_V[l];
+                                                    worker->pressure_H[j][k][l] += pressure_H[l];
+                                                    worker->pressure_V[j][k][l] += pressure_V[l];
                                                 }
                                             }
-                                            //DEBUG(4, "k: %u; j: %u; pressure2D[k][j]: %e + j*%e\n", (uint32_t)k, (uint32_t)j, creal(settings->output.pressure2D[k][j]), cimag(settings->output.pressure2D[k][j]));
+                                            //DEBUG(4, "k: %u; j: %u; pressure2D[k][j]: %e + j*%e\n", (uint32_t)k, (uint32_t)j, creal(worker->pressure2D[k][j]), cimag(worker->pressure2D[k][j]));
                                             //DEBUG(4, "rHyd: %lf; zHyd: %lf \n", rHyd, zHyd);
                                         }
                                     }else{
@@ -280,14 +293,14 @@ void    calcCohAcoustPress(settings_t* settings){
                                         for(k=0; k<dimZ; k++){
                                             zHyd = settings->output.arrayZ[k];
                                             DEBUG(6, "i=%u: (j,k)=(%u, %u):\n",(uint32_t)i, (uint32_t)j, (uint32_t)k);
-                                            if( pressureMStar( settings, &ray[i], rHyd, zHyd, q0, pressure_H, pressure_V) ){
+                                            if( pressureMStar( settings, ray, rHyd, zHyd, q0, pressure_H, pressure_V) ){
                                                  DEBUG(6, "pL: %e, pU: %e, pR: %e, pD: %e, pC: %e\n",
                                                         cabs(pressure_H[LEFT]),
                                                         cabs(pressure_V[TOP]), cabs(pressure_H[RIGHT]),
                                                         cabs(pressure_V[BOTTOM]), cabs(pressure_H[CENTER]));
                                                 for (l=0; l<3; l++){
-                                                    settings->output.pressure_H[j][k][l] += pressure_H[l];
-                                                    settings->output.pressure_V[j][k][l] += pressure_V[l];
+                                                    worker->pressure_H[j][k][l] += pressure_H[l];
+                                                    worker->pressure_V[j][k][l] += pressure_V[l];
                                                 }
                                             }else{
                                                 DEBUG(6,"pressureMStar returned false => at least one of the pressure contribution points is outside rBox\n");
@@ -302,34 +315,34 @@ void    calcCohAcoustPress(settings_t* settings){
                         case ARRAY_TYPE__LINEAR:
                             for(j=0; j<dimR; j++){
                                 rHyd = settings->output.arrayR[j];
-                                if ( rHyd >= ray[i].rMin    &&  rHyd < ray[i].rMax){
+                                if ( rHyd >= ray->rMin    &&  rHyd < ray->rMax){
                                     zHyd = settings->output.arrayZ[j];
 
-                                    if ( ray[i].iReturn == false){
+                                    if ( ray->iReturn == false){
 
-                                        if( pressureStar( settings, &ray[i], rHyd, zHyd, q0, pressure_H, pressure_V) ){
+                                        if( pressureStar( settings, ray, &iCursor, rHyd, zHyd, q0, pressure_H, pressure_V) ){
                                             DEBUG(3, "i=%u: (j,k)=(%u,%u): \n",(uint32_t)i, (uint32_t)j, (uint32_t)k);
-                                            DEBUG(3, "in>>  (rH,zH)=(%.2lf,%.2lf), nCoords: %u, q0: %e\n", rHyd, zHyd, (uint32_t)ray[i].nCoords, q0);
+                                            DEBUG(3, "in>>  (rH,zH)=(%.2lf,%.2lf), nCoords: %u, q0: %e\n", rHyd, zHyd, (uint32_t)ray->nCoords, q0);
                                             DEBUG(3, "out>> pL: %e,  pU, %e,  pR: %e,  pD: %e,  pC:%e\n\n", cabs(pressure_H[LEFT]), cabs(pressure_V[TOP]), cabs(pressure_H[RIGHT]), cabs(pressure_V[BOTTOM]), cabs(pressure_H[CENTER]));
 
                                             for (l=0; l<3; l++){
-                                                settings->output.pressure_H[0][j][l] += pressure_H[l];
-                                                settings->output.pressure_V[0][j][l] += pressure_V[l];
+                                                worker->pressure_H[0][j][l] += pressure_H[l];
+                                                worker->pressure_V[0][j][l] += pressure_V[l];
                                             }
                                         }
-                                        //DEBUG(4, "k: %u; j: %u; pressure2D[k][j]: %e + j*%e\n", (uint32_t)k, (uint32_t)j, creal(settings->output.pressure2D[k][j]), cimag(settings->output.pressure2D[k][j]));
+                                        //DEBUG(4, "k: %u; j: %u; pressure2D[k][j]: %e + j*%e\n", (uint32_t)k, (uint32_t)j, creal(worker->pressure2D[k][j]), cimag(worker->pressure2D[k][j]));
                                         //DEBUG(4, "rHyd: %lf; zHyd: %lf \n", rHyd, zHyd);
                                     }else{
                                         DEBUG(5, "Ray returns\n");
-                                        if( pressureMStar( settings, &ray[i], rHyd, zHyd, q0, pressure_H, pressure_V) ){
+                                        if( pressureMStar( settings, ray, rHyd, zHyd, q0, pressure_H, pressure_V) ){
                                             DEBUG(3, "pL: %e, pU: %e, pR: %e, pD: %e, pC: %e\n",
                                                     cabs(pressure_H[LEFT]),
                                                     cabs(pressure_V[TOP]), cabs(pressure_H[RIGHT]),
                                                     cabs(pressure_V[BOTTOM]), cabs(pressure_H[CENTER]));
 
                                             for (l=0; l<3; l++){
-                                                settings->output.pressure_H[0][j][l] += pressure_H[l];
-                                                settings->output.pressure_V[0][j][l] += pressure_V[l];
+                                                worker->pressure_H[0][j][l] += pressure_H[l];
+                                                worker->pressure_V[0][j][l] += pressure_V[l];
                                             }
                                         }
                                     }
@@ -344,90 +357,193 @@ void    calcCohAcoustPress(settings_t* settings){
 
                 case CALC_TYPE__COH_ACOUS_PRESS:
                 case CALC_TYPE__COH_TRANS_LOSS:
-                    switch(settings->output.arrayType){
-                        case ARRAY_TYPE__LINEAR:
-                            //NOTE: in linear arrays, nArrayR and nArrayZ have to be equal (this is checked in readIn.c when reading the file)
-                            DEBUG(3,"Array type: Linear\n");
-
-                            for(j=0; j<dimZ; j++){
-                                rHyd = settings->output.arrayR[j];
-                                zHyd = settings->output.arrayZ[j];
-
-                                if (    rHyd >= ray[i].rMin &&  rHyd < ray[i].rMax  ){
-
-                                    if (ray[i].iReturn == false){
-                                        bracket(ray[i].nCoords, ray[i].r, rHyd, &iHyd);
-                                        getRayPressure(settings, &ray[i], iHyd, q0, rHyd, zHyd, &pressure);
-                                        settings->output.pressure2D[0][j] += pressure;
-
-                                    }else{
-                                        eBracket(ray[i].nCoords, ray[i].r, rHyd, &nRet, iRet);
+                    addRayPressure(settings, ray, q0, dimR, dimZ, worker->pressure2D);
+                    break;
 
-                                        for(jj=0; jj<nRet; jj++){
+                default:
+                    fatal("calcCohAcoustPress(): Unknown output type.");
+                    break;
+            }//switch(settings->output.calcType){
+        }//if (ctheta > 1.0e-7)
+    }//for(i=worker->iFirst + worker->iThread; i<worker->iLast; i+=worker->nThreads)
 
-                                            //if the ray returns we have to check all hydrophone depths:
-                                            for(k=0; k<dimZ; k++){
-                                                zHyd = settings->output.arrayZ[k];
-                                                getRayPressure(settings, &ray[i], iRet[jj], q0, rHyd, zHyd, &pressure);
-                                                settings->output.pressure2D[0][j] += pressure;  //TODO make sure this value is initialized
-                                            }
-                                        }
-                                    }
-                                }
-                            }
-                            break;
+    //free ray memory.
+    reallocRayMembers(ray, 0);
+    free(ray);
+    return NULL;
+}
 
-                        case ARRAY_TYPE__HORIZONTAL:
-                        case ARRAY_TYPE__VERTICAL:
-                        case ARRAY_TYPE__RECTANGULAR:
-                            DEBUG(3,"Array type: Rectangular/Horizontal/Vertical\n");
-                            DEBUG(4,"nArrayR: %u, nArrayZ: %u\n", (uint32_t)dimR, (uint32_t)dimZ );
+void    initCohAcoustPress(settings_t* settings){
+    /*
+     * Determines the size of the pressure "star" (if needed) and allocates
+     * zero-initialized memory for the pressure in settings->output.
+     */
+    DEBUG(1,"in\n");
+    double              lambda;
+    uintptr_t           i;
+    uintptr_t           dimR = 0, dimZ = 0;
+    double              cx;
+    double              junkDouble;
+    vector_t            junkVector;
+    double              dr, dz; //used for star pressure contributions (for particle velocity)
+    
+    getPressureDims(settings, &dimR, &dimZ);
+    
+    /**
+     * Allocate memory for pressure and do some other case specific initialization
+     */
+    if( settings->output.calcType == CALC_TYPE__PART_VEL ||
+        settings->output.calcType == CALC_TYPE__COH_ACOUS_PRESS_PART_VEL){
+        /**
+         *  In these cases, we will need memory to save the horizontal/vertical pressure components
+         *  (pressure_H[3], presure_V[3])
+         *  see also: globals.h, output struct
+         */
+        
+        //get sound speed at source (cx):
+        csValues(   settings, NULL, settings->source.rx, settings->source.zx, &cx,
+                    &junkDouble, &junkDouble, &junkDouble, &junkDouble,
+                    &junkVector, &junkDouble, &junkDouble, &junkDouble);
 
-                            for(j=0; j<dimR; j++){
-                                rHyd = settings->output.arrayR[j];
+        //Determine the size of the "star" (the vertical/horizontal offset for the pressure contribuitions).
+        lambda  = cx/settings->source.freqx;
+        dr = lambda/10;
+        dz = lambda/10;
 
-                                //Start by checking if the array range is inside the min and max ranges of the ray:
-                                if (    rHyd >= ray[i].rMin &&  rHyd < ray[i].rMax){
+        for (i=1; i<settings->output.nArrayR; i++){
+            dr = min( fabs( settings->output.arrayR[i] - settings->output.arrayR[i-1]), dr);
+        }
+        for (i=1; i<settings->output.nArrayZ; i++){
+            dr = min( fabs( settings->output.arrayZ[i] - settings->output.arrayZ[i-1]), dz);
+        }
 
-                                    if (ray[i].iReturn == false){
-                                        bracket(ray[i].nCoords, ray[i].r, rHyd, &iHyd);
-                                        for(k=0; k<dimZ; k++){
+        settings->output.dr = dr;
+        settings->output.dz = dz;
+        DEBUG(1, "dr: %lf; dz: %lf\n", dr, dz);
 
-                                            zHyd = settings->output.arrayZ[k];
-                                            getRayPressure(settings, &ray[i], iHyd, q0, rHyd, zHyd, &pressure);
-                                            DEBUG(1, "ray: %d, hyd(j,k)=(%d,%d) : pressure: %lf +%lf*i\n", (int32_t)i, (int32_t)j, (int32_t)k, creal(pressure), cimag(pressure));
+        //malloc memory for horizontal and vertical pressure components:
+        settings->output.pressure_H = mallocComplexStar2D(dimR, dimZ);
+        settings->output.pressure_V = mallocComplexStar2D(dimR, dimZ);
+    }
+    if( settings->output.calcType == CALC_TYPE__COH_ACOUS_PRESS ||
+        settings->output.calcType == CALC_TYPE__COH_TRANS_LOSS  ||
+        settings->output.calcType == CALC_TYPE__COH_ACOUS_PRESS_PART_VEL){
+            /**
+             * when calculating only the Acoustic Pressure we only need memory the simple pressure, no H/V components.
+             * when calculating both Acoustic Pressure and Particle Velocity, pressure2D is used as a temporary
+             * variable at the end of the file to obtain the simple pressure from the center elements of
+             * star pressure contributions.
+             */
+            settings->output.pressure2D = mallocComplex2D(dimR, dimZ);
+    }
+    DEBUG(1,"out\n");
+}
 
-                                            settings->output.pressure2D[j][k] += pressure;  //verify if initialization is necessary. Done -makes no difference.
-                                            DEBUG(4, "k: %u; j: %u; pressure2D[k][j]: %e + j*%e\n", (uint32_t)k, (uint32_t)j, creal(settings->output.pressure2D[k][j]), cimag(settings->output.pressure2D[k][j]));
-                                            DEBUG(4, "rHyd: %lf; zHyd: %lf \n", rHyd, zHyd);
-                                        }
+void    traceCohAcoustPress(settings_t* settings){
+    /*
+     * Traces the rays of the current shard (all rays, unless '--shard' was passed) and
+     * accumulates their pressure contributions in the memory set up by initCohAcoustPress().
+     */
+    DEBUG(1,"in\n");
+    uintptr_t           j, k, l;
+    uintptr_t           dimR = 0, dimZ = 0;
+    uintptr_t           iFirst, iLast;
+    double              cx, q0;
+    double              junkDouble;
+    vector_t            junkVector;
+    uint32_t            t, nThreads;
+    cohAcoustPressWorker_t* workers = NULL;
+    
+    #if VERBOSE
+        //indexing variables used to output the pressure2D variable during debugging:
+        uintptr_t           rr,zz;
+    #endif
+    
+    getPressureDims(settings, &dimR, &dimZ);
+    getShardRange(settings, &iFirst, &iLast);
 
-                                    }else{
-                                        eBracket(ray[i].nCoords, ray[i].r, rHyd, &nRet, iRet);
-                                        for(k=0; k<dimZ; k++){
-                                            zHyd = settings->output.arrayZ[k];
+    //get sound speed at source (cx):
+    csValues(   settings, NULL, settings->source.rx, settings->source.zx, &cx,
+                &junkDouble, &junkDouble, &junkDouble, &junkDouble,
+                &junkVector, &junkDouble, &junkDouble, &junkDouble);
 
-                                            for(jj=0; jj<nRet; jj++){
-                                                getRayPressure(settings, &ray[i], iRet[jj], q0, rHyd, zHyd, &pressure);
-                                                settings->output.pressure2D[j][k] += pressure;
-                                            }
-                                        }
-                                    }
-                                }
-                            }
-                            break;
+    q0 = cx / ( M_PI * settings->source.dTheta/180.0 );
 
-                        default:
-                            fatal("calcCohAcoustPress(): unknown array type.");
-                            break;
+    /**
+     * Set up the workers. Each worker other than the first gets its own zero-initialized
+     * copy of the pressure accumulators, so that no locking is needed while tracing.
+     */
+    nThreads = (uint32_t)min( (double)settings->options.nThreads, (double)(iLast - iFirst));
+    nThreads = (uint32_t)max( (double)nThreads, 1.0);
+    workers = malloc(nThreads * sizeof(cohAcoustPressWorker_t));
+    if(workers == NULL){
+        fatal("Memory alocation error.");
+    }
+    for(t=0; t<nThreads; t++){
+        workers[t].settings             = settings;
+        workers[t].iThread              = t;
+        workers[t].nThreads             = nThreads;
+        workers[t].q0                   = q0;
+        workers[t].dimR                 = dimR;
+        workers[t].dimZ                 = dimZ;
+        workers[t].iFirst               = iFirst;
+        workers[t].iLast                = iLast;
+        workers[t].pressure2D           = NULL;
+        workers[t].pressure_H           = NULL;
+        workers[t].pressure_V           = NULL;
+        workers[t].nBackscatteredRays   = 0;
+        
+        if(t == 0){
+            workers[t].pressure2D = settings->output.pressure2D;
+            workers[t].pressure_H = settings->output.pressure_H;
+            workers[t].pressure_V = settings->output.pressure_V;
+        }else{
+            if( settings->output.calcType == CALC_TYPE__COH_ACOUS_PRESS ||
+                settings->output.calcType == CALC_TYPE__COH_TRANS_LOSS){
+                workers[t].pressure2D = mallocComplex2D(dimR, dimZ);
+            }
+            if( settings->output.calcType == CALC_TYPE__PART_VEL ||
+                settings->output.calcType == CALC_TYPE__COH_ACOUS_PRESS_PART_VEL){
+                workers[t].pressure_H = mallocComplexStar2D(dimR, dimZ);
+                workers[t].pressure_V = mallocComplexStar2D(dimR, dimZ);
+            }
+        }
+    }
+    
+    runThreads(nThreads, calcCohAcoustPressWorker, workers, sizeof(cohAcoustPressWorker_t));
+    
+    /**
+     * Reduction: add the other workers' contributions to the output (always in the
+     * same order, so that results are reproducible for a given number of threads).
+     */
+    for(t=0; t<nThreads; t++){
+        settings->options.nBackscatteredRays += workers[t].nBackscatteredRays;
+        if(t == 0){
+            continue;
+        }
+        
+        if(workers[t].pressure2D != NULL){
+            for(j=0; j<dimR; j++){
+                for(k=0; k<dimZ; k++){
+                    settings->output.pressure2D[j][k] += workers[t].pressure2D[j][k];
+                }
+            }
+            freeComplex2D(workers[t].pressure2D, dimR);
+        }
+        if(workers[t].pressure_H != NULL){
+            for(j=0; j<dimR; j++){
+                for(k=0; k<dimZ; k++){
+                    for(l=0; l<3; l++){
+                        settings->output.pressure_H[j][k][l] += workers[t].pressure_H[j][k][l];
+                        settings->output.pressure_V[j][k][l] += workers[t].pressure_V[j][k][l];
                     }
-                    break;
-                default:
-                    fatal("calcCohAcoustPress(): Unknown output type.");
-                    break;
-            }//switch(settings->output.calcType){
-        }//if (ctheta > 1.0e-7)
-    }//for(i=0; i<settings->source.nThetas; i++
+                }
+            }
+            freeComplexStar2D(workers[t].pressure_H, dimR);
+            freeComplexStar2D(workers[t].pressure_V, dimR);
+        }
+    }
+    free(workers);
 
     //if verbosity is enabled, print out the entire pressure2D array:
     #if VERBOSE
@@ -440,6 +556,63 @@ void    calcCohAcoustPress(settings_t* settings){
     #endif
 
     DEBUG(3,"Rays and pressure calculated\n");
+    DEBUG(1,"out\n");
+}
+
+void    writeCohAcoustPress(settings_t* settings){
+    /*
+     * Writes the launching angles, the hydrophone array and (if needed) the acoustic pressure to the output file.
+     */
+    assert(settings->options.matfile != NULL);   //output file must be open
+    
+    DEBUG(1,"in\n");
+    mxArray*            pThetas = NULL;
+    mxArray*            pHydArrayR  = NULL;
+    mxArray*            pHydArrayZ  = NULL;
+    mxArray*            p   = NULL;
+    uintptr_t           i, j;
+    uintptr_t           dimR = 0, dimZ = 0;
+    
+    getPressureDims(settings, &dimR, &dimZ);
+
+    pThetas     = mxCreateDoubleMatrix((MWSIZE)1, (MWSIZE)settings->source.nThetas, mxREAL);
+    if(pThetas == NULL)
+        fatal("Memory alocation error.");
+
+    //copy angles in cArray to mxArray:
+    copyDoubleToPtr(    settings->source.thetas,
+                        mxGetPr(pThetas),
+                        settings->source.nThetas);
+    //move mxArray to file and free memory:
+    matPutVariable(settings->options.matfile, "thetas", pThetas);
+    mxDestroyArray(pThetas);
+    
+    //write hydrophone array ranges to file:
+    pHydArrayR  = mxCreateDoubleMatrix((MWSIZE)1, (MWSIZE)settings->output.nArrayR, mxREAL);
+    if(pHydArrayR == NULL){
+        fatal("Memory alocation error.");
+    }
+    copyDoubleToPtr(    settings->output.arrayR,
+                        mxGetPr(pHydArrayR),
+                        (uintptr_t)settings->output.nArrayR);
+    //move mxArray to file and free memory:
+    matPutVariable(settings->options.matfile, "arrayR", pHydArrayR);
+    mxDestroyArray(pHydArrayR);
+
+
+    //write hydrophone array depths to file:
+    pHydArrayZ  = mxCreateDoubleMatrix((MWSIZE)1, (MWSIZE)settings->output.nArrayZ, mxREAL);
+    if(pHydArrayZ == NULL){
+        fatal("Memory alocation error.");
+    }
+    copyDoubleToPtr(    settings->output.arrayZ,
+                        mxGetPr(pHydArrayZ),
+                        (uintptr_t)settings->output.nArrayZ);
+    //move mxArray to file and free memory:
+    matPutVariable(settings->options.matfile, "arrayZ", pHydArrayZ);
+    mxDestroyArray(pHydArrayZ);
+
+
     /*********************************************
      * Write Acoustic pressure to file, if needed.
      */
@@ -498,10 +671,60 @@ void    calcCohAcoustPress(settings_t* settings){
     //free memory for pressure, only if not needed for calculating Transmission Loss (or others):
     //this is now done at the end of cTraceo.c, using freeSettings() from toolsMemory.c
 
-    //free ray memory.
-    for(i=0; i<settings->source.nThetas; i++){
-        reallocRayMembers(&ray[i], 0);
+    DEBUG(1,"out\n");
+}
+
+void    writeCohAcoustPressCube(settings_t* settings, complex double* pressure, uintptr_t nSlices){
+    /*
+     * Writes the acoustic pressure ("p", CPR) or transmission loss ("tl", CTL) of several runs
+     * sharing the same hydrophone array (see '--nx2d', '--ensemble').
+     * pressure[(iSlice*dimR + j)*dimZ + k] is written as a [dimZ x dimR*nSlices] matrix, as the
+     * matfile writer only supports 2D arrays; in matlab, reshape(tl, dimZ, dimR, nSlices)
+     * restores the cube.
+     */
+    assert(settings->options.matfile != NULL);   //output file must be open
+
+    mxArray*            p           = NULL;
+    double*             destReal    = NULL;
+    double*             destImag    = NULL;
+    uintptr_t           i, dimR = 0, dimZ = 0;
+
+    getPressureDims(settings, &dimR, &dimZ);
+
+    if(settings->output.calcType == CALC_TYPE__COH_ACOUS_PRESS){
+        p = mxCreateDoubleMatrix((MWSIZE)dimZ, (MWSIZE)(dimR * nSlices), mxCOMPLEX);
+        if(p == NULL){
+            fatal("Memory alocation error.");
+        }
+        destReal = mxGetData(p);
+        destImag = mxGetImagData(p);
+        for(i=0; i<nSlices * dimR * dimZ; i++){
+            destReal[i] = creal(pressure[i]);
+            destImag[i] = cimag(pressure[i]);
+        }
+        matPutVariable(settings->options.matfile, "p", p);
+    }else{
+        p = mxCreateDoubleMatrix((MWSIZE)dimZ, (MWSIZE)(dimR * nSlices), mxREAL);
+        if(p == NULL){
+            fatal("Memory alocation error.");
+        }
+        destReal = mxGetData(p);
+        for(i=0; i<nSlices * dimR * dimZ; i++){
+            destReal[i] = -20.0*log10( cabs( pressure[i] ) );
+        }
+        matPutVariable(settings->options.matfile, "tl", p);
     }
-    free(ray);
+    mxDestroyArray(p);
+}
+
+void    calcCohAcoustPress(settings_t* settings){
+    
+    assert(settings != NULL);
+    assert(settings->options.matfile != NULL);   //output file must be open
+    
+    DEBUG(1,"in\n");
+    initCohAcoustPress(settings);
+    traceCohAcoustPress(settings);
+    writeCohAcoustPress(settings);
     DEBUG(1,"out\n");
 }
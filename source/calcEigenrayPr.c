@@ -55,23 +55,240 @@
     #include    "matOut/matOut.h"
 #endif
 #include "interpolation.h"
+#include "getRayParameters.c"
 #include "bracket.c"
 #include "eBracket.c"
 
+typedef struct eigenrayPrWorker{
+    /*
+     * Arguments and results of one worker thread (see '--threads').
+     * Rays are distributed among workers in an interleaved fashion; the eigenrays found
+     * by a worker are stored in its buffer in the order in which they are found.
+     */
+    settings_t*     settings;
+    uint32_t        iThread;
+    uint32_t        nThreads;
+    uintptr_t       iFirst, iLast;          //range of launching angles to be traced (see '--shard')
+    arrivalBuffer_t buffer;
+    uint32_t        nBackscatteredRays;
+}eigenrayPrWorker_t;
+
+void    storeEigenrayPr(arrivalBuffer_t*, ray_t*, uintptr_t, uintptr_t, uintptr_t, uintptr_t);
+void*   calcEigenrayPrWorker(void*);
+void    traceEigenrayPr(settings_t*, arrivalBuffer_t*);
+void    writeEigenrayPr(settings_t*, arrivalBuffer_t*);
 void    calcEigenrayPr(settings_t*);
 
-void    calcEigenrayPr(settings_t* settings){
-    DEBUG(1,"in\n");
+void    storeEigenrayPr(arrivalBuffer_t* buffer, ray_t* ray, uintptr_t iTheta, uintptr_t iHydR, uintptr_t iHydZ, uintptr_t nCoords){
+    /*
+     * Copies the first nCoords coordinates of a ray (and some additional ray information)
+     * to a worker's buffer.
+     */
+    arrival_t*      eigenray = pushArrival(buffer, nCoords, ray->nRefrac);
+    
+    eigenray->iTheta    = iTheta;
+    eigenray->iHydR     = iHydR;
+    eigenray->iHydZ     = iHydZ;
+    memcpy(eigenray->r,     ray->r,     nCoords * sizeof(double));
+    memcpy(eigenray->z,     ray->z,     nCoords * sizeof(double));
+    memcpy(eigenray->tau,   ray->tau,   nCoords * sizeof(double));
+    memcpy(eigenray->amp,   ray->amp,   nCoords * sizeof(complex double));
+    eigenray->iReturn   = ray->iReturn;
+    eigenray->sRefl     = ray->sRefl;
+    eigenray->bRefl     = ray->bRefl;
+    eigenray->oRefl     = ray->oRefl;
+    if (ray->nRefrac > 0){
+        memcpy(eigenray->rRefrac,   ray->rRefrac,   ray->nRefrac * sizeof(double));
+        memcpy(eigenray->zRefrac,   ray->zRefrac,   ray->nRefrac * sizeof(double));
+    }
+}
+
+void*   calcEigenrayPrWorker(void* args){
+    /*
+     * Traces every nThreads-th ray, starting at ray iThread, and stores any eigenrays found.
+     */
+    eigenrayPrWorker_t* worker  = (eigenrayPrWorker_t*)args;
+    settings_t*     settings    = worker->settings;
     double          thetai, ctheta;
-    double          junkDouble;
     ray_t*          ray         = NULL;
     uintptr_t       i, j, jj, l;
     double          rHyd, zHyd, zRay, tauRay;
-    complex double  junkComplex, ampRay;
+    complex double  ampRay;
     double          dz;
     uintptr_t       nRet, iHyd = 0;
     uintptr_t       iRet[51];
+    
+    //allocate memory for the ray (reused for all of this worker's rays):
+    ray = makeRay(1);
+    
+    /** Trace the rays:  */
+    for(i=worker->iFirst + worker->iThread; i<worker->iLast; i+=worker->nThreads){
+        thetai = -settings->source.thetas[i] * M_PI/180.0;
+        ray->theta = thetai;
+        ctheta = fabs( cos(thetai));
+
+        //Trace a ray as long as it is neither at 90 nor -90:
+        if (ctheta > 1.0e-7){
+            solveEikonalEq(settings, ray);
+            if(ray->iBackscattered)
+                worker->nBackscatteredRays++;
+            solveDynamicEq(settings, ray);
+
+            //test for proximity of ray to each hydrophone
+            //(yes, this is slow, can you figure out a better way to do it?)
+            for(j=0; j<settings->output.nArrayR; j++){
+                rHyd = settings->output.arrayR[j];
+
+                if ( (rHyd >= ray->rMin) && (rHyd <= ray->rMax)){
+
+                    //  Check if the ray is returning back or not;
+                    //  if not:     we can bracket it without problems,
+                    //  otherwise:  we need to know how many times it passed by the given array range
+                    if (ray->iReturn == false){
+
+                        //get the index of the lower bracketing element:
+                        bracket(ray->nCoords, ray->r, rHyd, &iHyd);
+                        DEBUG(3,"non-returning ray: nCoords: %u, iHyd:%u\n", (uint32_t)ray->nCoords, (uint32_t)iHyd);
+
+                        //from index interpolate the rays' depth:
+                        interpolateRay(settings, ray, iHyd, rHyd, &zRay, NULL, NULL, NULL, NULL);
+
+                        //for every hydrophone check distance to ray
+                        for(jj=0; jj<settings->output.nArrayZ; jj++){
+                            zHyd = settings->output.arrayZ[jj];
+                            dz = fabs(zRay-zHyd);
+                            DEBUG(4, "dz: %e\n", dz);
+
+                            if (dz < settings->output.miss){
+                                DEBUG(3, "Eigenray found\n");
+
+                                //from index interpolate the rays' travel time and amplitude:
+                                interpolateRay(settings, ray, iHyd, rHyd, NULL, NULL, &tauRay, &ampRay, NULL);
+
+                                //adjust the ray's last set of coordinates so that it matches up with the hydrophone
+                                ray->r[iHyd+1]      = rHyd;
+                                ray->z[iHyd+1]      = zRay;
+                                ray->tau[iHyd+1]    = tauRay;
+                                ray->amp[iHyd+1]    = ampRay;
+
+                                //save the eigenray (it is written to the matfile later on):
+                                storeEigenrayPr(&worker->buffer, ray, i, j, jj, iHyd+2);
+                            }// if (dz settings->output.miss)
+                        }// for(jj=1; jj<=settings->output.nArrayZ; jj++)
+
+                    }else{// if (ray->iReturn == false)
+
+                        DEBUG(3,"returning ray: nCoords: %u, iHyd:%u\n", (uint32_t)ray->nCoords, (uint32_t)iHyd);
+                        //get the indexes of the bracketing points.
+                        eBracket(ray->nCoords, ray->r, rHyd, &nRet, iRet);
+
+                        //for each index where the ray passes at the hydrophone, interpolate the rays' depth:
+                        for(l=0; l<nRet; l++){
+                            DEBUG(4, "nRet=%u, iRet[%u]= %u\n", (uint32_t)nRet, (uint32_t)l, (uint32_t)iRet[l]);
+                            interpolateRay(settings, ray, iRet[l], rHyd, &zRay, NULL, NULL, NULL, NULL);
+
+                            //for every hydrophone check if the ray is close enough to be considered an eigenray:
+                            for(jj=0;jj<settings->output.nArrayZ; jj++){
+                                zHyd = settings->output.arrayZ[jj];
+                                dz = fabs( zRay - zHyd );
+
+                                if (dz < settings->output.miss){
+
+                                    //interpolate the ray's travel time and amplitude:
+                                    interpolateRay(settings, ray, iRet[l], rHyd, NULL, NULL, &tauRay, &ampRay, NULL);
+
+                                    DEBUG(1, "i: %u, iHyd: %u, nCoords: %u\n", (uint32_t)i, (uint32_t)iHyd,(uint32_t)ray->nCoords);
+                                    //adjust the ray's last set of coordinates so that it matches up with the hydrophone
+                                    ray->r[iRet[l]+1]   = rHyd;
+                                    ray->z[iRet[l]+1]   = zRay;
+                                    ray->tau[iRet[l]+1] = tauRay;
+                                    ray->amp[iRet[l]+1] = ampRay;
+
+                                    //save the eigenray (it is written to the matfile later on):
+                                    storeEigenrayPr(&worker->buffer, ray, i, j, jj, iRet[l]+2);
+                                }
+                            }
+                        }
+                    }// if (ray->iReturn == false)
+                }//if ( (rHyd >= ray->rMin) && (rHyd < ray->rMax))
+            }//for(j=0; j<settings->output.nArrayR; j++){
+        }//if (ctheta > 1.0e-7)
+    }//for(i=worker->iFirst + worker->iThread; i<worker->iLast; i+=worker->nThreads)
+    
+    reallocRayMembers(ray, 0);
+    free(ray);
+    return NULL;
+}
+
+void    traceEigenrayPr(settings_t* settings, arrivalBuffer_t* buffer){
+    /*
+     * Traces the rays of the current shard (all rays, unless '--shard' was passed) and
+     * appends the eigenrays found to a buffer, in order of launching angle.
+     */
+    DEBUG(1,"in\n");
+    uintptr_t       i, iFirst, iLast;
+    uint32_t        t, nThreads;
+    eigenrayPrWorker_t*  workers         = NULL;
+    uintptr_t*      cursor          = NULL;     //index of the next arrival to be read from each worker's buffer
+    
+    getShardRange(settings, &iFirst, &iLast);
+    
+    /** Trace the rays:  */
+    nThreads = (uint32_t)min( (double)settings->options.nThreads, (double)(iLast - iFirst));
+    nThreads = (uint32_t)max( (double)nThreads, 1.0);
+    workers = malloc(nThreads * sizeof(eigenrayPrWorker_t));
+    cursor  = malloc(nThreads * sizeof(uintptr_t));
+    if(workers == NULL || cursor == NULL){
+        fatal("Memory alocation error.");
+    }
+    for(t=0; t<nThreads; t++){
+        workers[t].settings             = settings;
+        workers[t].iThread              = t;
+        workers[t].nThreads             = nThreads;
+        workers[t].iFirst               = iFirst;
+        workers[t].iLast                = iLast;
+        workers[t].buffer.nArrivals     = 0;
+        workers[t].buffer.maxArrivals   = 0;
+        workers[t].buffer.arrival       = NULL;
+        workers[t].nBackscatteredRays   = 0;
+        cursor[t] = 0;
+    }
+    
+    runThreads(nThreads, calcEigenrayPrWorker, workers, sizeof(eigenrayPrWorker_t));
+    
+    /**
+     * Collect the eigenrays. Ray i was traced by worker ((i - iFirst) % nThreads), so
+     * taking the eigenrays from the workers' buffers in order of the launching angles
+     * results in the same output as a serial run.
+     */
+    for(i=iFirst; i<iLast; i++){
+        t = (uint32_t)((i - iFirst) % nThreads);
+        
+        while(  cursor[t] < workers[t].buffer.nArrivals &&
+                workers[t].buffer.arrival[cursor[t]].iTheta == i){
+            moveArrival(buffer, &workers[t].buffer.arrival[cursor[t]]);
+            cursor[t]++;
+        }
+    }
+    
+    for(t=0; t<nThreads; t++){
+        settings->options.nBackscatteredRays += workers[t].nBackscatteredRays;
+        //the arrivals themselves now belong to the output buffer:
+        free(workers[t].buffer.arrival);
+    }
+    free(workers);
+    free(cursor);
+    DEBUG(1,"out\n");
+}
+
+void    writeEigenrayPr(settings_t* settings, arrivalBuffer_t* buffer){
+    /*
+     * Writes the launching angles, the hydrophone array and the eigenrays found at each hydrophone to the output file.
+     */
+    DEBUG(1,"in\n");
+    uintptr_t       i, j, jj, k;
     uint32_t        maxNumEigenrays = 0;
+    arrival_t*      eigenray        = NULL;
 
     mxArray*        pThetas             = NULL;
     mxArray*        pHydArrayR          = NULL;
@@ -89,7 +306,6 @@ void    calcEigenrayPr(settings_t* settings){
     mxArray*        nRefrac             = NULL;
     mxArray*        mxRefrac_r          = NULL;
     mxArray*        mxRefrac_z          = NULL;
-    mxArray*        mxEigenrayStruct    = NULL;     //contains the eigenrays at a single hydrophone
     mxArray*        mxAllEigenraysStruct= NULL;     //contains all the eigenrays at all hydrophones
     mxArray*        mxNumEigenrays      = NULL;
     mxArray*        mxRHyd              = NULL;
@@ -162,259 +378,79 @@ void    calcEigenrayPr(settings_t* settings){
     matPutVariable(settings->options.matfile, "zarray", pHydArrayZ);
     mxDestroyArray(pHydArrayZ);
 
-
-    //allocate memory for the rays:
-    ray = makeRay(settings->source.nThetas);
     #endif
 
-    /** Trace the rays:  */
-    for(i=0; i<settings->source.nThetas; i++){
-        thetai = -settings->source.thetas[i] * M_PI/180.0;
-        ray[i].theta = thetai;
-        ctheta = fabs( cos(thetai));
-
-        //Trace a ray as long as it is neither at 90 nor -90:
-        if (ctheta > 1.0e-7){
-            solveEikonalEq(settings, &ray[i]);
-            solveDynamicEq(settings, &ray[i]);
-
-            //test for proximity of ray to each hydrophone
-            //(yes, this is slow, can you figure out a better way to do it?)
-            for(j=0; j<settings->output.nArrayR; j++){
-                rHyd = settings->output.arrayR[j];
-
-                if ( (rHyd >= ray[i].rMin) && (rHyd <= ray[i].rMax)){
-
-                    //  Check if the ray is returning back or not;
-                    //  if not:     we can bracket it without problems,
-                    //  otherwise:  we need to know how many times it passed by the given array range
-                    if (ray[i].iReturn == false){
-
-                        /*
-                        //when debugging, save the coordinates of the last ray to a separate matfile before exiting.
-                        #if VERBOSE
-                        if((int)i==(int)4){
-                            DEBUG(1,"i:%u, nCoords: %u\n", (uint32_t)i, (uint32_t)ray[i].nCoords);
-                            DEBUG(1,"rMin: %e, rMax: %e\n",ray[i].rMin, ray[i].rMax);
-
-                            mxArray*    pDyingRay   = NULL;
-                            MATFile*    matfile2    = NULL;
-                            double**    dyingRay    = malloc(2*sizeof(uintptr_t));
-                            char*       string2     = mallocChar(10);
-
-                            dyingRay[0] = ray[i].r;
-                            dyingRay[1] = ray[i].z;
-                            matfile2    = matOpen("dyingRay.mat", "w");
-                            pDyingRay   = mxCreateDoubleMatrix((MWSIZE)2, (MWSIZE)ray[i].nCoords, mxREAL);
-                            if(pDyingRay == NULL || matfile2 == NULL)
-                                fatal("Memory alocation error.");
-                            copyDoubleToPtr2D(dyingRay, mxGetPr(pDyingRay), ray[i].nCoords,2);
-                            sprintf(string2, "dyingRay");
-                            matPutVariable(matfile2, (const char*)string2, pDyingRay);
-
-                            mxDestroyArray(pDyingRay);
-                            matClose(matfile2);
-                            DEBUG(1,"Dying ray written to file.\n");
-                        }
-                        #endif
-                        */
-
-                        //get the index of the lower bracketing element:
-                        bracket(ray[i].nCoords, ray[i].r, rHyd, &iHyd);
-                        DEBUG(3,"non-returning ray: nCoords: %u, iHyd:%u\n", (uint32_t)ray[i].nCoords, (uint32_t)iHyd);
-
-                        //from index interpolate the rays' depth:
-                        intLinear1D(        &ray[i].r[iHyd], &ray[i].z[iHyd],   rHyd, &zRay,    &junkDouble);
-
-                        //for every hydrophone check distance to ray
-                        for(jj=0; jj<settings->output.nArrayZ; jj++){
-                            zHyd = settings->output.arrayZ[jj];
-                            dz = fabs(zRay-zHyd);
-                            DEBUG(4, "dz: %e\n", dz);
-
-                            if (dz < settings->output.miss){
-                                DEBUG(3, "Eigenray found\n");
-
-                                //from index interpolate the rays' travel time and amplitude:
-                                intLinear1D(        &ray[i].r[iHyd], &ray[i].tau[iHyd], rHyd, &tauRay,  &junkDouble);
-                                intComplexLinear1D( &ray[i].r[iHyd], &ray[i].amp[iHyd], rHyd, &ampRay,  &junkComplex);
-
-                                //adjust the ray's last set of coordinates so that it matches up with the hydrophone
-                                ray[i].r[iHyd+1]    = rHyd;
-                                ray[i].z[iHyd+1]    = zRay;
-                                ray[i].tau[iHyd+1]  = tauRay;
-                                ray[i].amp[iHyd+1]  = ampRay;
-
-                                ///prepare to write eigenray to matfile:
-                                //create mxArrays:
-                                mxTheta = mxCreateDoubleMatrix((MWSIZE)1,   (MWSIZE)1,          mxREAL);
-                                mxR     = mxCreateDoubleMatrix((MWSIZE)1,   (MWSIZE)(iHyd+2),   mxREAL);
-                                mxZ     = mxCreateDoubleMatrix((MWSIZE)1,   (MWSIZE)(iHyd+2),   mxREAL);
-                                mxTau   = mxCreateDoubleMatrix((MWSIZE)1,   (MWSIZE)(iHyd+2),   mxREAL);
-                                mxAmp   = mxCreateDoubleMatrix((MWSIZE)1,   (MWSIZE)(iHyd+2),   mxCOMPLEX);
-                                if( mxTheta == NULL || mxR == NULL || mxZ == NULL || mxTau == NULL || mxAmp == NULL){
-                                    fatal("Memory alocation error.");
-                                }
-
-                                //copy data to mxArrays:
-                                copyDoubleToMxArray(&settings->source.thetas[i],mxTheta,1);
-                                copyDoubleToMxArray(ray[i].r,                   mxR,    iHyd+2);
-                                copyDoubleToMxArray(ray[i].z,                   mxZ,    iHyd+2);
-                                copyDoubleToMxArray(ray[i].tau,                 mxTau,  iHyd+2);
-                                copyComplexToMxArray(ray[i].amp,                mxAmp,  iHyd+2);
-
-                                //copy mxArrays to mxEigenrayStruct
-                                mxSetFieldByNumber( eigenrays[j][jj].mxEigenrayStruct,  //pointer to the mxStruct
-                                                    (MWINDEX)eigenrays[j][jj].nEigenrays,   //index of the element
-                                                    0,                                  //position of the field (in this case, field 0 is "theta"
-                                                    mxTheta);                           //the mxArray we want to copy into the mxStruct
-                                mxSetFieldByNumber( eigenrays[j][jj].mxEigenrayStruct, (MWINDEX)eigenrays[j][jj].nEigenrays, 1, mxR);
-                                mxSetFieldByNumber( eigenrays[j][jj].mxEigenrayStruct, (MWINDEX)eigenrays[j][jj].nEigenrays, 2, mxZ);
-                                mxSetFieldByNumber( eigenrays[j][jj].mxEigenrayStruct, (MWINDEX)eigenrays[j][jj].nEigenrays, 3, mxTau);
-                                mxSetFieldByNumber( eigenrays[j][jj].mxEigenrayStruct, (MWINDEX)eigenrays[j][jj].nEigenrays, 4, mxAmp);
-                                ///Eigenray has been saved to mxAadStruct
-
-                                ///now lets save some aditional ray information:
-                                iReturns    = mxCreateDoubleMatrix((MWSIZE)1,   (MWSIZE)1, mxREAL);
-                                nSurRefl    = mxCreateDoubleMatrix((MWSIZE)1,   (MWSIZE)1, mxREAL);
-                                nBotRefl    = mxCreateDoubleMatrix((MWSIZE)1,   (MWSIZE)1, mxREAL);
-                                nObjRefl    = mxCreateDoubleMatrix((MWSIZE)1,   (MWSIZE)1, mxREAL);
-                                nRefrac     = mxCreateDoubleMatrix((MWSIZE)1,   (MWSIZE)1, mxREAL);
-
-                                copyBoolToMxArray(      &ray[i].iReturn,    iReturns,   1);
-                                copyUInt32ToMxArray(    &ray[i].sRefl,  nSurRefl,   1);
-                                copyUInt32ToMxArray(    &ray[i].bRefl,  nBotRefl,   1);
-                                copyUInt32ToMxArray(    &ray[i].oRefl,  nObjRefl,   1);
-                                copyUInt32ToMxArray(    &ray[i].nRefrac,    nRefrac,    1);
-
-                                mxSetFieldByNumber( eigenrays[j][jj].mxEigenrayStruct, (MWINDEX)eigenrays[j][jj].nEigenrays, 5, iReturns);
-                                mxSetFieldByNumber( eigenrays[j][jj].mxEigenrayStruct, (MWINDEX)eigenrays[j][jj].nEigenrays, 6, nSurRefl);
-                                mxSetFieldByNumber( eigenrays[j][jj].mxEigenrayStruct, (MWINDEX)eigenrays[j][jj].nEigenrays, 7, nBotRefl);
-                                mxSetFieldByNumber( eigenrays[j][jj].mxEigenrayStruct, (MWINDEX)eigenrays[j][jj].nEigenrays, 8, nObjRefl);
-                                mxSetFieldByNumber( eigenrays[j][jj].mxEigenrayStruct, (MWINDEX)eigenrays[j][jj].nEigenrays, 9, nRefrac);
-                                ///aditional information has been saved
-
-                                ///save refraction coordinates to structure:
-                                if (ray[i].nRefrac > 0){
-                                    mxRefrac_r = mxCreateDoubleMatrix((MWSIZE)1,    (MWSIZE)ray[i].nRefrac, mxREAL);
-                                    mxRefrac_z = mxCreateDoubleMatrix((MWSIZE)1,    (MWSIZE)ray[i].nRefrac, mxREAL);
-
-                                    copyDoubleToMxArray(ray[i].rRefrac, mxRefrac_r, ray[i].nRefrac);
-                                    copyDoubleToMxArray(ray[i].zRefrac, mxRefrac_z, ray[i].nRefrac);
-
-                                    mxSetFieldByNumber( eigenrays[j][jj].mxEigenrayStruct, (MWINDEX)i, 10, mxRefrac_r);
-                                    mxSetFieldByNumber( eigenrays[j][jj].mxEigenrayStruct, (MWINDEX)i, 11, mxRefrac_z);
-                                }
-
-                                eigenrays[j][jj].nEigenrays += 1;
-                                maxNumEigenrays = max(eigenrays[j][jj].nEigenrays, maxNumEigenrays);
-                            }// if (dz settings->output.miss)
-                        }// for(jj=1; jj<=settings->output.nArrayZ; jj++)
-
-                    }else{// if (ray[i].iReturn == false)
-
-                        DEBUG(3,"returning ray: nCoords: %u, iHyd:%u\n", (uint32_t)ray[i].nCoords, (uint32_t)iHyd);
-                        //get the indexes of the bracketing points.
-                        eBracket(ray[i].nCoords, ray[i].r, rHyd, &nRet, iRet);
-
-                        //for each index where the ray passes at the hydrophone, interpolate the rays' depth:
-                        for(l=0; l<nRet; l++){
-                            DEBUG(4, "nRet=%u, iRet[%u]= %u\n", (uint32_t)nRet, (uint32_t)l, (uint32_t)iRet[l]);
-                            intLinear1D(        &ray[i].r[iRet[l]], &ray[i].z[iRet[l]],     rHyd, &zRay,    &junkDouble);
-
-                            //for every hydrophone check if the ray is close enough to be considered an eigenray:
-                            for(jj=0;jj<settings->output.nArrayZ; jj++){
-                                zHyd = settings->output.arrayZ[jj];
-                                dz = fabs( zRay - zHyd );
+    for(k=0; k<buffer->nArrivals; k++){
+        eigenray = &buffer->arrival[k];
+        i   = eigenray->iTheta;
+        j   = eigenray->iHydR;
+        jj  = eigenray->iHydZ;
+        
+        ///prepare to write eigenray to matfile:
+        //create mxArrays:
+        mxTheta = mxCreateDoubleMatrix((MWSIZE)1,   (MWSIZE)1,                  mxREAL);
+        mxR     = mxCreateDoubleMatrix((MWSIZE)1,   (MWSIZE)eigenray->nCoords,  mxREAL);
+        mxZ     = mxCreateDoubleMatrix((MWSIZE)1,   (MWSIZE)eigenray->nCoords,  mxREAL);
+        mxTau   = mxCreateDoubleMatrix((MWSIZE)1,   (MWSIZE)eigenray->nCoords,  mxREAL);
+        mxAmp   = mxCreateDoubleMatrix((MWSIZE)1,   (MWSIZE)eigenray->nCoords,  mxCOMPLEX);
+        if( mxTheta == NULL || mxR == NULL || mxZ == NULL || mxTau == NULL || mxAmp == NULL){
+            fatal("Memory alocation error.");
+        }
 
-                                if (dz < settings->output.miss){
+        //copy data to mxArrays:
+        copyDoubleToMxArray(&settings->source.thetas[i],mxTheta,1);
+        copyDoubleToMxArray(eigenray->r,                mxR,    eigenray->nCoords);
+        copyDoubleToMxArray(eigenray->z,                mxZ,    eigenray->nCoords);
+        copyDoubleToMxArray(eigenray->tau,              mxTau,  eigenray->nCoords);
+        copyComplexToMxArray(eigenray->amp,             mxAmp,  eigenray->nCoords);
+
+        //copy mxArrays to mxEigenrayStruct
+        mxSetFieldByNumber( eigenrays[j][jj].mxEigenrayStruct,  //pointer to the mxStruct
+                            (MWINDEX)eigenrays[j][jj].nEigenrays,   //index of the element
+                            0,                                  //position of the field (in this case, field 0 is "theta"
+                            mxTheta);                           //the mxArray we want to copy into the mxStruct
+        mxSetFieldByNumber( eigenrays[j][jj].mxEigenrayStruct, (MWINDEX)eigenrays[j][jj].nEigenrays, 1, mxR);
+        mxSetFieldByNumber( eigenrays[j][jj].mxEigenrayStruct, (MWINDEX)eigenrays[j][jj].nEigenrays, 2, mxZ);
+        mxSetFieldByNumber( eigenrays[j][jj].mxEigenrayStruct, (MWINDEX)eigenrays[j][jj].nEigenrays, 3, mxTau);
+        mxSetFieldByNumber( eigenrays[j][jj].mxEigenrayStruct, (MWINDEX)eigenrays[j][jj].nEigenrays, 4, mxAmp);
+        ///Eigenray has been saved to mxAadStruct
+
+        ///now lets save some aditional ray information:
+        iReturns    = mxCreateDoubleMatrix((MWSIZE)1,   (MWSIZE)1, mxREAL);
+        nSurRefl    = mxCreateDoubleMatrix((MWSIZE)1,   (MWSIZE)1, mxREAL);
+        nBotRefl    = mxCreateDoubleMatrix((MWSIZE)1,   (MWSIZE)1, mxREAL);
+        nObjRefl    = mxCreateDoubleMatrix((MWSIZE)1,   (MWSIZE)1, mxREAL);
+        nRefrac     = mxCreateDoubleMatrix((MWSIZE)1,   (MWSIZE)1, mxREAL);
+
+        copyBoolToMxArray(      &eigenray->iReturn, iReturns,   1);
+        copyUInt32ToMxArray(    &eigenray->sRefl,   nSurRefl,   1);
+        copyUInt32ToMxArray(    &eigenray->bRefl,   nBotRefl,   1);
+        copyUInt32ToMxArray(    &eigenray->oRefl,   nObjRefl,   1);
+        copyUInt32ToMxArray(    &eigenray->nRefrac, nRefrac,    1);
+
+        mxSetFieldByNumber( eigenrays[j][jj].mxEigenrayStruct, (MWINDEX)eigenrays[j][jj].nEigenrays, 5, iReturns);
+        mxSetFieldByNumber( eigenrays[j][jj].mxEigenrayStruct, (MWINDEX)eigenrays[j][jj].nEigenrays, 6, nSurRefl);
+        mxSetFieldByNumber( eigenrays[j][jj].mxEigenrayStruct, (MWINDEX)eigenrays[j][jj].nEigenrays, 7, nBotRefl);
+        mxSetFieldByNumber( eigenrays[j][jj].mxEigenrayStruct, (MWINDEX)eigenrays[j][jj].nEigenrays, 8, nObjRefl);
+        mxSetFieldByNumber( eigenrays[j][jj].mxEigenrayStruct, (MWINDEX)eigenrays[j][jj].nEigenrays, 9, nRefrac);
+        ///aditional information has been saved
+
+        ///save refraction coordinates to structure:
+        if (eigenray->nRefrac > 0){
+            mxRefrac_r = mxCreateDoubleMatrix((MWSIZE)1,    (MWSIZE)eigenray->nRefrac, mxREAL);
+            mxRefrac_z = mxCreateDoubleMatrix((MWSIZE)1,    (MWSIZE)eigenray->nRefrac, mxREAL);
+
+            copyDoubleToMxArray(eigenray->rRefrac,  mxRefrac_r, eigenray->nRefrac);
+            copyDoubleToMxArray(eigenray->zRefrac,  mxRefrac_z, eigenray->nRefrac);
+
+            mxSetFieldByNumber( eigenrays[j][jj].mxEigenrayStruct, (MWINDEX)eigenrays[j][jj].nEigenrays, 10, mxRefrac_r);
+            mxSetFieldByNumber( eigenrays[j][jj].mxEigenrayStruct, (MWINDEX)eigenrays[j][jj].nEigenrays, 11, mxRefrac_z);
+        }
 
-                                    //interpolate the ray's travel time and amplitude:
-                                    intLinear1D(        &ray[i].r[iRet[l]], &ray[i].tau[iRet[l]],   rHyd, &tauRay,  &junkDouble);
-                                    intComplexLinear1D( &ray[i].r[iRet[l]], &ray[i].amp[iRet[l]],   (complex double)rHyd, &ampRay,  &junkComplex);
+        eigenrays[j][jj].nEigenrays += 1;
+        maxNumEigenrays = max(eigenrays[j][jj].nEigenrays, maxNumEigenrays);
+    }
 
-                                    DEBUG(1, "i: %u, iHyd: %u, nCoords: %u\n", (uint32_t)i, (uint32_t)iHyd,(uint32_t)ray[i].nCoords);
-                                    //adjust the ray's last set of coordinates so that it matches up with the hydrophone
-                                    ray[i].r[iRet[l]+1] = rHyd;
-                                    ray[i].z[iRet[l]+1] = zRay;
-                                    ray[i].tau[iRet[l]+1]   = tauRay;
-                                    ray[i].amp[iRet[l]+1]   = ampRay;
-
-                                    ///prepare to write eigenray to matfile:
-                                    //create mxArrays:
-                                    mxTheta = mxCreateDoubleMatrix((MWSIZE)1,   (MWSIZE)1,          mxREAL);
-                                    mxR     = mxCreateDoubleMatrix((MWSIZE)1,   (MWSIZE)(iRet[l]+2),    mxREAL);
-                                    mxZ     = mxCreateDoubleMatrix((MWSIZE)1,   (MWSIZE)(iRet[l]+2),    mxREAL);
-                                    mxTau   = mxCreateDoubleMatrix((MWSIZE)1,   (MWSIZE)(iRet[l]+2),    mxREAL);
-                                    mxAmp   = mxCreateDoubleMatrix((MWSIZE)1,   (MWSIZE)(iRet[l]+2),    mxCOMPLEX);
-                                    if( mxTheta == NULL || mxR == NULL || mxZ == NULL || mxTau == NULL || mxAmp == NULL){
-                                        fatal("Memory alocation error.");
-                                    }
-
-                                    //copy data to mxArrays:
-                                    copyDoubleToMxArray(&settings->source.thetas[i],mxTheta,1);
-                                    copyDoubleToMxArray(ray[i].r,                   mxR,    iRet[l]+2);
-                                    copyDoubleToMxArray(ray[i].z,                   mxZ,    iRet[l]+2);
-                                    copyDoubleToMxArray(ray[i].tau,                 mxTau,  iRet[l]+2);
-                                    copyComplexToMxArray(ray[i].amp,                mxAmp,  iRet[l]+2);
-
-                                    //copy mxArrays to mxEigenrayStruct
-                                    mxSetFieldByNumber( eigenrays[j][jj].mxEigenrayStruct,  //pointer to the mxStruct
-                                                        (MWINDEX)eigenrays[j][jj].nEigenrays,   //index of the element
-                                                        0,                                  //position of the field (in this case, field 0 is "theta"
-                                                        mxTheta);                           //the mxArray we want to copy into the mxStruct
-                                    mxSetFieldByNumber( eigenrays[j][jj].mxEigenrayStruct, (MWINDEX)eigenrays[j][jj].nEigenrays, 1, mxR);
-                                    mxSetFieldByNumber( eigenrays[j][jj].mxEigenrayStruct, (MWINDEX)eigenrays[j][jj].nEigenrays, 2, mxZ);
-                                    mxSetFieldByNumber( eigenrays[j][jj].mxEigenrayStruct, (MWINDEX)eigenrays[j][jj].nEigenrays, 3, mxTau);
-                                    mxSetFieldByNumber( eigenrays[j][jj].mxEigenrayStruct, (MWINDEX)eigenrays[j][jj].nEigenrays, 4, mxAmp);
-                                    ///Eigenray has been saved to mxAadStruct
-
-                                    ///now lets save some aditional ray information:
-                                    iReturns    = mxCreateDoubleMatrix((MWSIZE)1,   (MWSIZE)1, mxREAL);
-                                    nSurRefl    = mxCreateDoubleMatrix((MWSIZE)1,   (MWSIZE)1, mxREAL);
-                                    nBotRefl    = mxCreateDoubleMatrix((MWSIZE)1,   (MWSIZE)1, mxREAL);
-                                    nObjRefl    = mxCreateDoubleMatrix((MWSIZE)1,   (MWSIZE)1, mxREAL);
-                                    nRefrac     = mxCreateDoubleMatrix((MWSIZE)1,   (MWSIZE)1, mxREAL);
-
-                                    copyBoolToMxArray(      &ray[i].iReturn,    iReturns,   1);
-                                    copyUInt32ToMxArray(    &ray[i].sRefl,  nSurRefl,   1);
-                                    copyUInt32ToMxArray(    &ray[i].bRefl,  nBotRefl,   1);
-                                    copyUInt32ToMxArray(    &ray[i].oRefl,  nObjRefl,   1);
-                                    copyUInt32ToMxArray(    &ray[i].nRefrac,    nRefrac,    1);
-
-                                    mxSetFieldByNumber( eigenrays[j][jj].mxEigenrayStruct, (MWINDEX)i, 5, iReturns);
-                                    mxSetFieldByNumber( eigenrays[j][jj].mxEigenrayStruct, (MWINDEX)i, 6, nSurRefl);
-                                    mxSetFieldByNumber( eigenrays[j][jj].mxEigenrayStruct, (MWINDEX)i, 7, nBotRefl);
-                                    mxSetFieldByNumber( eigenrays[j][jj].mxEigenrayStruct, (MWINDEX)i, 8, nObjRefl);
-                                    mxSetFieldByNumber( eigenrays[j][jj].mxEigenrayStruct, (MWINDEX)i, 9, nRefrac);
-                                    ///aditional information has been saved
-
-                                    ///save refraction coordinates to structure:
-                                    if (ray[i].nRefrac > 0){
-                                        mxRefrac_r = mxCreateDoubleMatrix((MWSIZE)1,    (MWSIZE)ray[i].nRefrac, mxREAL);
-                                        mxRefrac_z = mxCreateDoubleMatrix((MWSIZE)1,    (MWSIZE)ray[i].nRefrac, mxREAL);
-
-                                        copyDoubleToMxArray(ray[i].rRefrac, mxRefrac_r, ray[i].nRefrac);
-                                        copyDoubleToMxArray(ray[i].zRefrac, mxRefrac_z, ray[i].nRefrac);
-
-                                        mxSetFieldByNumber( eigenrays[j][jj].mxEigenrayStruct, (MWINDEX)i, 10, mxRefrac_r);
-                                        mxSetFieldByNumber( eigenrays[j][jj].mxEigenrayStruct, (MWINDEX)i, 11, mxRefrac_z);
-                                    }
-
-                                    eigenrays[j][jj].nEigenrays += 1;
-                                    maxNumEigenrays = max(eigenrays[j][jj].nEigenrays, maxNumEigenrays);
-                                }
-                            }
-                        }
-                    }// if (ray[i].iReturn == false)
-                }//if ( (rHyd >= ray[i].rMin) && (rHyd < ray[i].rMax))
-            }//for(j=0; j<settings->output.nArrayR; j++){
-            if(KEEP_RAYS_IN_MEM == false){
-                //free the ray's memory
-                reallocRayMembers(&ray[i],0);
-            }
-        }//if (ctheta > 1.0e-7)
-    }//for(i=0; i<settings->source.nThetas; i++)
     
     //write "maximum number of eigenrays at any of the hydrophones
     mxMaxNumEigenrays = mxCreateDoubleMatrix((MWSIZE)1, (MWSIZE)1, mxREAL);
@@ -468,8 +504,20 @@ void    calcEigenrayPr(settings_t* settings){
     matPutVariable(settings->options.matfile, "eigenrays", mxAllEigenraysStruct);
     
     //free memory
-    mxDestroyArray(mxEigenrayStruct);
-    reallocRayMembers(ray, 0);
-    free(ray);
+    mxDestroyArray(mxAllEigenraysStruct);
+    DEBUG(1,"out\n");
+}
+
+void    calcEigenrayPr(settings_t* settings){
+    DEBUG(1,"in\n");
+    arrivalBuffer_t buffer;
+    
+    buffer.nArrivals    = 0;
+    buffer.maxArrivals  = 0;
+    buffer.arrival      = NULL;
+    
+    traceEigenrayPr(settings, &buffer);
+    writeEigenrayPr(settings, &buffer);
+    freeArrivalBuffer(&buffer);
     DEBUG(1,"out\n");
 }
@@ -57,17 +57,45 @@
     #include    "matOut/matOut.h"
 #endif
 #include "interpolation.h"
+#include "getRayParameters.c"
 #include "bracket.c"
 
+typedef struct eigenrayRFWorker{
+    /*
+     * Arguments and results of one worker thread of the Regula Falsi stage (see '--threads').
+     * Hydrophones are distributed among workers; the eigenrays found at hydrophone
+     * (i,j) are stored in found[i*nArrayZ + j] and written to the matfile afterwards,
+     * in the same order as when running on a single thread.
+     */
+    settings_t*     settings;
+    uint32_t        iThread;
+    uint32_t        nThreads;
+    uintptr_t       nRays;
+    double*         thetas;
+    double**        depths;
+    uintptr_t*      nFound;             //number of eigenrays found at each hydrophone
+    ray_t**         found;              //eigenrays found at each hydrophone
+    uint32_t        nBackscatteredRays;
+}eigenrayRFWorker_t;
+
+void*   calcEigenrayRFWorker(void*);
 void    calcEigenrayRF(settings_t*);
 
-void    calcEigenrayRF(settings_t* settings){
-    DEBUG(1,"in\n");
-    double          thetai, ctheta;
-    uintptr_t       i, j, k, l, nRays, iHyd = 0;
+void*   calcEigenrayRFWorker(void* args){
+    /*
+     * Searches for the eigenrays at every nThreads-th hydrophone, starting at hydrophone iThread.
+     * NOTE: each worker uses its own copy of the settings, as the range box is modified
+     *       for every hydrophone.
+     */
+    eigenrayRFWorker_t* worker  = (eigenrayRFWorker_t*)args;
+    settings_t      localSettings = *worker->settings;
+    settings_t*     settings    = &localSettings;
+    uintptr_t       nRays       = worker->nRays;
+    double*         thetas      = worker->thetas;
+    double**        depths      = worker->depths;
+    uintptr_t       h, i, j, k, l;
     uintptr_t       nPossibleEigenRays, nFoundEigenRays = 0;
-    double          zRay, zHyd, rHyd;
-    double          junkDouble;
+    double          zHyd, rHyd;
     uint32_t        nTrial;
     double          theta0, f0;
     //used for root-finding in actual Regula-Falsi Method:
@@ -75,12 +103,209 @@ void    calcEigenrayRF(settings_t* settings){
     double*         thetaL              = NULL;
     double*         thetaR              = NULL;
     ray_t*          tempRay             = NULL;
+    ray_t*          eigenray            = NULL;
     bool            success             = false;
+    double*         dz                  = NULL;
+    
+    //allocate memory for some temporary variables
+    dz =        mallocDouble(nRays);
+    thetaL =    mallocDouble(nRays);
+    thetaR =    mallocDouble(nRays);
+    tempRay =   makeRay(1);
+    
+    //  iterate over the entire hydrophone array:
+    for (h=worker->iThread; h<settings->output.nArrayR * settings->output.nArrayZ; h+=worker->nThreads){
+        i = h / settings->output.nArrayZ;
+        j = h % settings->output.nArrayZ;
+        rHyd = settings->output.arrayR[i];
+        zHyd = settings->output.arrayZ[j];
+        DEBUG(3, "i: %u; j: %u; rHyd:%lf, zHyd:%lf\n",(uint32_t)i, (uint32_t)j, rHyd, zHyd );
+
+        //for each ray calculate the difference between the hydrophone and ray depths:
+        for(k=0; k<nRays; k++){
+            dz[k] = zHyd - depths[k][i];
+            DEBUG(3,"dz[%u]= %lf\n", (uint32_t)k, dz[k]);
+        }
+
+        /** By looking at sign variations (or zero values) of dz[]:
+         *      :: determine the number of possible eigenrays
+         *      :: find the launching angles of adjacent rays that pass above and below (named L and R) a hydrophone
+         *          (which implies that there may be an intermediate launching angle that corresponds to an eigenray.
+         */
+        nPossibleEigenRays = 0;
+        for(k=0; k<nRays-1; k++){
+            fl = dz[k];
+            fr = dz[k+1];
+            prod = fl*fr;
+            DEBUG(3, "k: %u; thetaL: %e; thetaR: %e\n", (uint32_t)k, thetaL[k], thetaR[k]);
+
+            if( isnan_d(depths[k][i]) == false  &&
+                isnan_d(depths[k+1][i]) == false    ){
+                DEBUG(3, "Not a NAN\n");
+
+                if( (fl == 0.0) && (fr != 0.0)){
+                    thetaL[nPossibleEigenRays] = thetas[k];
+                    thetaR[nPossibleEigenRays] = thetas[k+1];
+                    nPossibleEigenRays++;
+
+                }else if(   (fr == 0.0) && (fl != 0.0)){
+                    thetaL[nPossibleEigenRays] = thetas[k];
+                    thetaR[nPossibleEigenRays] = thetas[k+1];
+                    nPossibleEigenRays++;
+
+                }else if(prod < 0.0){
+                    thetaL[nPossibleEigenRays] = thetas[k];
+                    thetaR[nPossibleEigenRays] = thetas[k+1];
+                    nPossibleEigenRays++;
+
+                }
+                DEBUG(3, "thetaL: %e, thetaR: %e\n", thetaL[nPossibleEigenRays-1], thetaR[nPossibleEigenRays-1]);
+            }else{
+                DEBUG(4, "Its a NAN\n");
+            }
+            if (nPossibleEigenRays > nRays){
+                //this should not be possible. TODO replace by assertion?
+                fatal("The impossible happened.\nNumber of possible eigenrays exceeds number of calculated rays.\nAborting.");
+            }
+        }
+
+        //Time to find eigenrays; either we are lucky or we need to apply regula falsi:
+        /** We now know how many possible eigenrays this hydrophone has (nPossibleEigenRays),
+         *  and for each of them we have the bracketing launching angles.
+         *  It is now time to determine the "exact" launching angle of each eigenray.
+         */
+        DEBUG(3, "nPossibleEigenRays: %u\n", (uint32_t)nPossibleEigenRays);
+        
+        worker->nFound[h] = 0;
+        worker->found[h] = NULL;
+        if (nPossibleEigenRays > 0){
+            worker->found[h] = makeRay(nPossibleEigenRays);
+        }
+        
+        nFoundEigenRays = 0;
+        for(l=0; l<nPossibleEigenRays; l++){        //Note that if nPossibleEigenRays = 0 this loop will not be executed:
+            settings->source.rbox2 = rHyd + 1;  //TODO: change this to "rbox2 = rHyd + ds" and verify results.
+            DEBUG(3,"l: %u\n", (uint32_t)l);
+
+            //Determine "left" ray's depth at rHyd:
+            tempRay[0].theta = thetaL[l];
+            solveEikonalEq(settings, tempRay);
+            if(tempRay[0].iBackscattered)
+                worker->nBackscatteredRays++;
+            fl = tempRay[0].z[tempRay[0].nCoords-1] - zHyd;
+            //reset the ray members to zero:
+            reallocRayMembers(tempRay, 0);
+
+            //Determine "right" ray's depth at rHyd:
+            tempRay[0].theta = thetaR[l];
+            solveEikonalEq(settings, tempRay);
+            if(tempRay[0].iBackscattered)
+                worker->nBackscatteredRays++;
+            fr = tempRay[0].z[tempRay[0].nCoords-1] - zHyd;
+            //reset the ray members to zero:
+            reallocRayMembers(tempRay, 0);
+
+            //check if either the "left" or "right" ray pass at a distance within the defined threshold
+            if (fabs(fl) <= settings->output.miss){
+                DEBUG(3, "\"left\" is eigenray.\n");
+                theta0 = thetaL[l];
+                nFoundEigenRays++;
+                success = true;
+
+            }else if (fabs(fr) <= settings->output.miss){
+                DEBUG(3, "\"right\" is eigenray.\n");
+                theta0 = thetaR[l];
+                nFoundEigenRays++;
+                success = true;
+
+            //if not, try to find the "exact" launching angle
+            }else{
+                DEBUG(3, "Neither \"left\" nor \"right\" ray are close enough to be eigenrays.\nApplying Regula-Falsi...\n");
+                nTrial = 0;
+                success = false;
+
+                //here comes the actual Regula-Falsi loop:
+                while(success == false){
+                    nTrial++;
+
+                    if (nTrial > 21){
+                        //printf("(rHyd,zHyd)= %e, %e\n", rHyd, zHyd);
+                        //printf("Eigenray search failure, skipping to next case...\n");
+                        break;
+                    }
+
+                    theta0 = thetaR[l] - fr*( thetaL[l] - thetaR[l] )/( fl - fr );
+                    DEBUG(3, "l: %u; thetaR[l]: %e; thetaL[l]: %e; theta0: %e; fl: %e; fr: %e;\n",
+                            (uint32_t)l, thetaR[l], thetaL[l],          theta0,     fl,     fr);
+
+                    //find the distance between the new ray and the hydrophone:
+                    tempRay[0].theta = theta0;
+                    solveEikonalEq(settings, tempRay);
+                    if(tempRay[0].iBackscattered)
+                        worker->nBackscatteredRays++;
+                    f0 = tempRay[0].z[tempRay[0].nCoords-1] - zHyd;
+                    //reset the ray members to zero:
+                    DEBUG(3, "nCoords: %u\n", (uint32_t)tempRay[0].nCoords);
+                    reallocRayMembers(tempRay, 0);
+                    DEBUG(3, "zHyd: %e; miss: %e, nTrial: %u, f0: %e\n", zHyd, settings->output.miss, (uint32_t)nTrial, f0);
+
+                    //check if the new rays is close enough to the hydrophone to be considered and eigenray:
+                    if (fabs(f0) < settings->output.miss){
+                        DEBUG(3, "Found eigenray by applying Regula-Falsi.\n");
+                        success = true;
+                        nFoundEigenRays++;
+                        break;
+
+                    //if the root wasn't found, do another Regula-Falsi iterarion:
+                    }else{
+                        prod = fl*f0;
+
+                        if ( prod < 0.0 ){
+                            thetaR[l] = theta0;
+                            fr = f0;
+                        }else{
+                            thetaL[l] = theta0;
+                            fl = f0;
+                        }
+                    }
+                }//while()
+            }
+            if (success == true){
+                //finally: get the coordinates and amplitudes of the eigenray (written to the matfile later on)
+                eigenray = &worker->found[h][worker->nFound[h]];
+                eigenray->theta = theta0;
+                solveEikonalEq(settings, eigenray);
+                if(eigenray->iBackscattered)
+                    worker->nBackscatteredRays++;
+                solveDynamicEq(settings, eigenray);
+                worker->nFound[h] += 1;
+            }
+        }
+        DEBUG(3, "nFoundEigenRays: %u\n", (uint32_t)nFoundEigenRays);
+    }
+    
+    reallocRayMembers(tempRay, 0);
+    free(tempRay);
+    free(dz);
+    free(thetaL);
+    free(thetaR);
+    return NULL;
+}
+
+void    calcEigenrayRF(settings_t* settings){
+    DEBUG(1,"in\n");
+    double          thetai, ctheta;
+    uintptr_t       i, j, k, h, nRays, nHyd, iHyd = 0;
+    double          zRay, rHyd;
+    ray_t*          tempRay             = NULL;
     double*         thetas              = NULL;
     double**        depths              = NULL;
     ray_t*          ray                 = NULL;
-    double*         dz                  = NULL;
     uint32_t        maxNumEigenrays     = 0;
+    uint32_t        t, nThreads;
+    eigenrayRFWorker_t* workers         = NULL;
+    uintptr_t*      nFound              = NULL;
+    ray_t**         found               = NULL;
 
     mxArray*        pThetas             = NULL;
     mxArray*        pHydArrayR          = NULL;
@@ -192,6 +417,8 @@ void    calcEigenrayRF(settings_t* settings){
             thetas[nRays] = thetai;
             DEBUG(3, "thetas[%u]: %e\n", (uint32_t)nRays, thetas[nRays]);
             solveEikonalEq(settings, &ray[i]);
+            if(ray[i].iBackscattered)
+                settings->options.nBackscatteredRays++;
             solveDynamicEq(settings, &ray[i]);
 
             if (ray[i].iReturn == true){
@@ -210,7 +437,7 @@ void    calcEigenrayRF(settings_t* settings){
                     bracket( ray[i].nCoords, ray[i].r, rHyd, &iHyd);
 
                     //interpolate the ray depth at the range coord of hydrophone
-                    intLinear1D(&ray[i].r[iHyd], &ray[i].z[iHyd], rHyd, &zRay, &junkDouble);
+                    interpolateRay(settings, &ray[i], iHyd, rHyd, &zRay, NULL, NULL, NULL, NULL);
                     depths[nRays][j] = zRay;
                     DEBUG(3,"rHyd: %lf; rMin: %lf; rMax: %lf\n", rHyd, ray[i].rMin, ray[i].rMax);
                     DEBUG(3,"nCoords: %u, rHyd: %lf; iHyd: %u, zRay: %lf\n", (uint32_t)ray[i].nCoords, rHyd, (uint32_t)iHyd, zRay);
@@ -228,251 +455,125 @@ void    calcEigenrayRF(settings_t* settings){
     DEBUG(3, "Preliminary rays calculated.\n");
 
     /********************************************************************************
-     *  2)  Proceed to searching for possible eigenrays at each point of the array:
+     *  2)  Proceed to searching for possible eigenrays at each point of the array.
+     *      The hydrophones are independent of each other and are distributed among the workers:
+     */
+    nHyd    = (uintptr_t)settings->output.nArrayR * settings->output.nArrayZ;
+    nFound  = malloc(nHyd * sizeof(uintptr_t));
+    found   = malloc(nHyd * sizeof(ray_t*));
+    if(nFound == NULL || found == NULL){
+        fatal("Memory alocation error.");
+    }
+    
+    nThreads = (uint32_t)min( (double)settings->options.nThreads, (double)nHyd);
+    nThreads = (uint32_t)max( (double)nThreads, 1.0);
+    workers = malloc(nThreads * sizeof(eigenrayRFWorker_t));
+    if(workers == NULL){
+        fatal("Memory alocation error.");
+    }
+    for(t=0; t<nThreads; t++){
+        workers[t].settings             = settings;
+        workers[t].iThread              = t;
+        workers[t].nThreads             = nThreads;
+        workers[t].nRays                = nRays;
+        workers[t].thetas               = thetas;
+        workers[t].depths               = depths;
+        workers[t].nFound               = nFound;
+        workers[t].found                = found;
+        workers[t].nBackscatteredRays   = 0;
+    }
+    
+    runThreads(nThreads, calcEigenrayRFWorker, workers, sizeof(eigenrayRFWorker_t));
+    
+    for(t=0; t<nThreads; t++){
+        settings->options.nBackscatteredRays += workers[t].nBackscatteredRays;
+    }
+    free(workers);
+    /** 2)  Done.
+     */
+    
+    /********************************************************************************
+     *  3)  Copy the eigenrays found at each hydrophone to the mxStructArrays:
      */
-
-    //allocate memory for some temporary variables
-    dz =        mallocDouble(nRays);
-    thetaL =    mallocDouble(nRays);
-    thetaR =    mallocDouble(nRays);
-
-    //  iterate over....
     for (i=0; i<settings->output.nArrayR; i++){
-        rHyd = settings->output.arrayR[i];
-        //  ...the entire hydrophone array:
         for(j=0; j<settings->output.nArrayZ; j++){
-            zHyd = settings->output.arrayZ[j];
-            DEBUG(3, "i: %u; j: %u; rHyd:%lf, zHyd:%lf\n",(uint32_t)i, (uint32_t)j, rHyd, zHyd );
-
-            //for each ray calculate the difference between the hydrophone and ray depths:
-            for(k=0; k<nRays; k++){
-                dz[k] = zHyd - depths[k][i];
-                DEBUG(3,"dz[%u]= %lf\n", (uint32_t)k, dz[k]);
-            }
-
-            /** By looking at sign variations (or zero values) of dz[]:
-             *      :: determine the number of possible eigenrays
-             *      :: find the launching angles of adjacent rays that pass above and below (named L and R) a hydrophone
-             *          (which implies that there may be an intermediate launching angle that corresponds to an eigenray.
-             */
-            nPossibleEigenRays = 0;
-            for(k=0; k<nRays-1; k++){
-                fl = dz[k];
-                fr = dz[k+1];
-                prod = fl*fr;
-                DEBUG(3, "k: %u; thetaL: %e; thetaR: %e\n", (uint32_t)k, thetaL[k], thetaR[k]);
-
-                if( isnan_d(depths[k][i]) == false  &&
-                    isnan_d(depths[k+1][i]) == false    ){
-                    DEBUG(3, "Not a NAN\n");
-
-                    if( (fl == 0.0) && (fr != 0.0)){
-                        thetaL[nPossibleEigenRays] = thetas[k];
-                        thetaR[nPossibleEigenRays] = thetas[k+1];
-                        nPossibleEigenRays++;
-
-                    }else if(   (fr == 0.0) && (fl != 0.0)){
-                        thetaL[nPossibleEigenRays] = thetas[k];
-                        thetaR[nPossibleEigenRays] = thetas[k+1];
-                        nPossibleEigenRays++;
-
-                    }else if(prod < 0.0){
-                        thetaL[nPossibleEigenRays] = thetas[k];
-                        thetaR[nPossibleEigenRays] = thetas[k+1];
-                        nPossibleEigenRays++;
-
-                    }
-                    DEBUG(3, "thetaL: %e, thetaR: %e\n", thetaL[nPossibleEigenRays-1], thetaR[nPossibleEigenRays-1]);
-                }else{
-                    DEBUG(4, "Its a NAN\n");
-                }
-                if (nPossibleEigenRays > nRays){
-                    //this should not be possible. TODO replace by assertion?
-                    fatal("The impossible happened.\nNumber of possible eigenrays exceeds number of calculated rays.\nAborting.");
+            h = i*settings->output.nArrayZ + j;
+            
+            for(k=0; k<nFound[h]; k++){
+                tempRay = &found[h][k];
+                
+                ///prepare to save ray to mxStructArray:
+                //create mxArrays:
+                mxTheta = mxCreateDoubleMatrix((MWSIZE)1,   (MWSIZE)1,                  mxREAL);
+                mxR     = mxCreateDoubleMatrix((MWSIZE)1,   (MWSIZE)(tempRay->nCoords), mxREAL);
+                mxZ     = mxCreateDoubleMatrix((MWSIZE)1,   (MWSIZE)(tempRay->nCoords), mxREAL);
+                mxTau   = mxCreateDoubleMatrix((MWSIZE)1,   (MWSIZE)(tempRay->nCoords), mxREAL);
+                mxAmp   = mxCreateDoubleMatrix((MWSIZE)1,   (MWSIZE)(tempRay->nCoords), mxCOMPLEX);
+                if( mxTheta == NULL || mxR == NULL || mxZ == NULL || mxTau == NULL || mxAmp == NULL){
+                    fatal("Memory alocation error.");
                 }
-            }
-
-            //Time to find eigenrays; either we are lucky or we need to apply regula falsi:
-            /** We now know how many possible eigenrays this hydrophone has (nPossibleEigenRays),
-             *  and for each of them we have the bracketing launching angles.
-             *  It is now time to determine the "exact" launching angle of each eigenray.
-             */
-            DEBUG(3, "nPossibleEigenRays: %u\n", (uint32_t)nPossibleEigenRays);
-
-            #if 0
-            /*
-            //create mxStructArray:
-            mxRayStruct = mxCreateStructMatrix( (MWSIZE)nPossibleEigenRays, //number of rows
-                                                (MWSIZE)1,                  //number of columns
-                                                5,                          //number of fields in each element
-                                                fieldNames);                //list of field names
-            if( mxRayStruct == NULL ) {
-                fatal("Memory Alocation error.");
-            }
-            */
-            #endif
-
-            tempRay = makeRay(1);
-            nFoundEigenRays = 0;
-            for(l=0; l<nPossibleEigenRays; l++){        //Note that if nPossibleEigenRays = 0 this loop will not be executed:
-                settings->source.rbox2 = rHyd + 1;  //TODO: change this to "rbox2 = rHyd + ds" and verify results.
-                DEBUG(3,"l: %u\n", (uint32_t)l);
-
-                //Determine "left" ray's depth at rHyd:
-                tempRay[0].theta = thetaL[l];
-                solveEikonalEq(settings, tempRay);
-                fl = tempRay[0].z[tempRay[0].nCoords-1] - zHyd;
-                //reset the ray members to zero:
-                reallocRayMembers(tempRay, 0);
-
-                //Determine "right" ray's depth at rHyd:
-                tempRay[0].theta = thetaR[l];
-                solveEikonalEq(settings, tempRay);
-                fr = tempRay[0].z[tempRay[0].nCoords-1] - zHyd;
-                //reset the ray members to zero:
-                reallocRayMembers(tempRay, 0);
-
-                //check if either the "left" or "right" ray pass at a distance within the defined threshold
-                if (fabs(fl) <= settings->output.miss){
-                    DEBUG(3, "\"left\" is eigenray.\n");
-                    theta0 = thetaL[l];
-                    nFoundEigenRays++;
-                    success = true;
-
-                }else if (fabs(fr) <= settings->output.miss){
-                    DEBUG(3, "\"right\" is eigenray.\n");
-                    theta0 = thetaR[l];
-                    nFoundEigenRays++;
-                    success = true;
-
-                //if not, try to find the "exact" launching angle
-                }else{
-                    DEBUG(3, "Neither \"left\" nor \"right\" ray are close enough to be eigenrays.\nApplying Regula-Falsi...\n");
-                    nTrial = 0;
-                    success = false;
-
-                    //here comes the actual Regula-Falsi loop:
-                    while(success == false){
-                        nTrial++;
-
-                        if (nTrial > 21){
-                            //printf("(rHyd,zHyd)= %e, %e\n", rHyd, zHyd);
-                            //printf("Eigenray search failure, skipping to next case...\n");
-                            break;
-                        }
 
-                        theta0 = thetaR[l] - fr*( thetaL[l] - thetaR[l] )/( fl - fr );
-                        DEBUG(3, "l: %u; thetaR[l]: %e; thetaL[l]: %e; theta0: %e; fl: %e; fr: %e;\n",
-                                (uint32_t)l, thetaR[l], thetaL[l],          theta0,     fl,     fr);
-
-                        //find the distance between the new ray and the hydrophone:
-                        tempRay[0].theta = theta0;
-                        solveEikonalEq(settings, tempRay);
-                        f0 = tempRay[0].z[tempRay[0].nCoords-1] - zHyd;
-                        //reset the ray members to zero:
-                        DEBUG(3, "nCoords: %u\n", (uint32_t)tempRay[0].nCoords);
-                        reallocRayMembers(tempRay, 0);
-                        DEBUG(3, "zHyd: %e; miss: %e, nTrial: %u, f0: %e\n", zHyd, settings->output.miss, (uint32_t)nTrial, f0);
-
-                        //check if the new rays is close enough to the hydrophone to be considered and eigenray:
-                        if (fabs(f0) < settings->output.miss){
-                            DEBUG(3, "Found eigenray by applying Regula-Falsi.\n");
-                            success = true;
-                            nFoundEigenRays++;
-                            break;
-
-                        //if the root wasn't found, do another Regula-Falsi iterarion:
-                        }else{
-                            DEBUG(3, "ASD\n");
-                            prod = fl*f0;
-
-                            if ( prod < 0.0 ){
-                                DEBUG(3, "ASD1\n");
-                                thetaR[l] = theta0;
-                                fr = f0;
-                            }else{
-                                DEBUG(3, "ASD2\n");
-                                thetaL[l] = theta0;
-                                fl = f0;
-                            }
-                        }
-                    }//while()
-                }
-                if (success == true){
-
-                    //finally: get the coordinates and amplitudes of the eigenray
-                    tempRay[0].theta = theta0;
-                    solveEikonalEq(settings, tempRay);
-                    solveDynamicEq(settings, tempRay);
-
-
-                    ///prepare to save ray to mxStructArray:
-                    //create mxArrays:
-                    mxTheta = mxCreateDoubleMatrix((MWSIZE)1,   (MWSIZE)1,                  mxREAL);
-                    mxR     = mxCreateDoubleMatrix((MWSIZE)1,   (MWSIZE)(tempRay->nCoords), mxREAL);
-                    mxZ     = mxCreateDoubleMatrix((MWSIZE)1,   (MWSIZE)(tempRay->nCoords), mxREAL);
-                    mxTau   = mxCreateDoubleMatrix((MWSIZE)1,   (MWSIZE)(tempRay->nCoords), mxREAL);
-                    mxAmp   = mxCreateDoubleMatrix((MWSIZE)1,   (MWSIZE)(tempRay->nCoords), mxCOMPLEX);
-                    if( mxTheta == NULL || mxR == NULL || mxZ == NULL || mxTau == NULL || mxAmp == NULL){
-                        fatal("Memory alocation error.");
-                    }
-
-                    //copy data to mxArrays:
-                    copyDoubleToMxArray(&tempRay[0].theta,  mxTheta,1);
-                    copyDoubleToMxArray(tempRay->r,         mxR,    tempRay->nCoords);
-                    copyDoubleToMxArray(tempRay->z,         mxZ,    tempRay->nCoords);
-                    copyDoubleToMxArray(tempRay->tau,       mxTau,  tempRay->nCoords);
-                    copyComplexToMxArray(tempRay->amp,      mxAmp,  tempRay->nCoords);
-
-                    //copy mxArrays to mxRayStruct
-                    mxSetFieldByNumber( eigenrays[i][j].mxEigenrayStruct,               //pointer to the mxStruct
-                                        (MWINDEX)eigenrays[i][j].nEigenrays,            //index of the element (number of ray)
-                                        0,                                              //position of the field (in this case, field 0 is "r"
-                                        mxTheta);                                       //the mxArray we want to copy into the mxStruct
-                    mxSetFieldByNumber( eigenrays[i][j].mxEigenrayStruct, (MWINDEX)eigenrays[i][j].nEigenrays, 1, mxR);
-                    mxSetFieldByNumber( eigenrays[i][j].mxEigenrayStruct, (MWINDEX)eigenrays[i][j].nEigenrays, 2, mxZ);
-                    mxSetFieldByNumber( eigenrays[i][j].mxEigenrayStruct, (MWINDEX)eigenrays[i][j].nEigenrays, 3, mxTau);
-                    mxSetFieldByNumber( eigenrays[i][j].mxEigenrayStruct, (MWINDEX)eigenrays[i][j].nEigenrays, 4, mxAmp);
-                    ///ray has been saved to mxStructArray
-
-                    ///now lets save some aditional ray information:
-                    iReturns    = mxCreateDoubleMatrix((MWSIZE)1,   (MWSIZE)1, mxREAL);
-                    nSurRefl    = mxCreateDoubleMatrix((MWSIZE)1,   (MWSIZE)1, mxREAL);
-                    nBotRefl    = mxCreateDoubleMatrix((MWSIZE)1,   (MWSIZE)1, mxREAL);
-                    nObjRefl    = mxCreateDoubleMatrix((MWSIZE)1,   (MWSIZE)1, mxREAL);
-                    nRefrac     = mxCreateDoubleMatrix((MWSIZE)1,   (MWSIZE)1, mxREAL);
-
-                    copyBoolToMxArray(      &tempRay->iReturn,  iReturns,   1);
-                    copyUInt32ToMxArray(    &tempRay->sRefl,    nSurRefl,   1);
-                    copyUInt32ToMxArray(    &tempRay->bRefl,    nBotRefl,   1);
-                    copyUInt32ToMxArray(    &tempRay->oRefl,    nObjRefl,   1);
-                    copyUInt32ToMxArray(    &tempRay->nRefrac,  nRefrac,    1);
-
-                    mxSetFieldByNumber( eigenrays[i][j].mxEigenrayStruct, (MWINDEX)i, 5, iReturns);
-                    mxSetFieldByNumber( eigenrays[i][j].mxEigenrayStruct, (MWINDEX)i, 6, nSurRefl);
-                    mxSetFieldByNumber( eigenrays[i][j].mxEigenrayStruct, (MWINDEX)i, 7, nBotRefl);
-                    mxSetFieldByNumber( eigenrays[i][j].mxEigenrayStruct, (MWINDEX)i, 8, nObjRefl);
-                    mxSetFieldByNumber( eigenrays[i][j].mxEigenrayStruct, (MWINDEX)i, 9, nRefrac);
-                    ///aditional information has been saved
-
-                    ///save refraction coordinates to structure:
-                    if (tempRay->nRefrac > 0){
-                        mxRefrac_r = mxCreateDoubleMatrix((MWSIZE)1,    (MWSIZE)tempRay->nRefrac, mxREAL);
-                        mxRefrac_z = mxCreateDoubleMatrix((MWSIZE)1,    (MWSIZE)tempRay->nRefrac, mxREAL);
-
-                        copyDoubleToMxArray(tempRay->rRefrac,   mxRefrac_r, tempRay->nRefrac);
-                        copyDoubleToMxArray(tempRay->zRefrac,   mxRefrac_z, tempRay->nRefrac);
-
-                        mxSetFieldByNumber( eigenrays[i][j].mxEigenrayStruct, (MWINDEX)i, 10, mxRefrac_r);
-                        mxSetFieldByNumber( eigenrays[i][j].mxEigenrayStruct, (MWINDEX)i, 11, mxRefrac_z);
-                    }
-                    eigenrays[i][j].nEigenrays += 1;
-                    maxNumEigenrays = max(eigenrays[i][j].nEigenrays, maxNumEigenrays);
+                //copy data to mxArrays:
+                copyDoubleToMxArray(&tempRay->theta,    mxTheta,1);
+                copyDoubleToMxArray(tempRay->r,         mxR,    tempRay->nCoords);
+                copyDoubleToMxArray(tempRay->z,         mxZ,    tempRay->nCoords);
+                copyDoubleToMxArray(tempRay->tau,       mxTau,  tempRay->nCoords);
+                copyComplexToMxArray(tempRay->amp,      mxAmp,  tempRay->nCoords);
+
+                //copy mxArrays to mxRayStruct
+                mxSetFieldByNumber( eigenrays[i][j].mxEigenrayStruct,               //pointer to the mxStruct
+                                    (MWINDEX)eigenrays[i][j].nEigenrays,            //index of the element (number of ray)
+                                    0,                                              //position of the field (in this case, field 0 is "r"
+                                    mxTheta);                                       //the mxArray we want to copy into the mxStruct
+                mxSetFieldByNumber( eigenrays[i][j].mxEigenrayStruct, (MWINDEX)eigenrays[i][j].nEigenrays, 1, mxR);
+                mxSetFieldByNumber( eigenrays[i][j].mxEigenrayStruct, (MWINDEX)eigenrays[i][j].nEigenrays, 2, mxZ);
+                mxSetFieldByNumber( eigenrays[i][j].mxEigenrayStruct, (MWINDEX)eigenrays[i][j].nEigenrays, 3, mxTau);
+                mxSetFieldByNumber( eigenrays[i][j].mxEigenrayStruct, (MWINDEX)eigenrays[i][j].nEigenrays, 4, mxAmp);
+                ///ray has been saved to mxStructArray
+
+                ///now lets save some aditional ray information:
+                iReturns    = mxCreateDoubleMatrix((MWSIZE)1,   (MWSIZE)1, mxREAL);
+                nSurRefl    = mxCreateDoubleMatrix((MWSIZE)1,   (MWSIZE)1, mxREAL);
+                nBotRefl    = mxCreateDoubleMatrix((MWSIZE)1,   (MWSIZE)1, mxREAL);
+                nObjRefl    = mxCreateDoubleMatrix((MWSIZE)1,   (MWSIZE)1, mxREAL);
+                nRefrac     = mxCreateDoubleMatrix((MWSIZE)1,   (MWSIZE)1, mxREAL);
+
+                copyBoolToMxArray(      &tempRay->iReturn,  iReturns,   1);
+                copyUInt32ToMxArray(    &tempRay->sRefl,    nSurRefl,   1);
+                copyUInt32ToMxArray(    &tempRay->bRefl,    nBotRefl,   1);
+                copyUInt32ToMxArray(    &tempRay->oRefl,    nObjRefl,   1);
+                copyUInt32ToMxArray(    &tempRay->nRefrac,  nRefrac,    1);
+
+                mxSetFieldByNumber( eigenrays[i][j].mxEigenrayStruct, (MWINDEX)eigenrays[i][j].nEigenrays, 5, iReturns);
+                mxSetFieldByNumber( eigenrays[i][j].mxEigenrayStruct, (MWINDEX)eigenrays[i][j].nEigenrays, 6, nSurRefl);
+                mxSetFieldByNumber( eigenrays[i][j].mxEigenrayStruct, (MWINDEX)eigenrays[i][j].nEigenrays, 7, nBotRefl);
+                mxSetFieldByNumber( eigenrays[i][j].mxEigenrayStruct, (MWINDEX)eigenrays[i][j].nEigenrays, 8, nObjRefl);
+                mxSetFieldByNumber( eigenrays[i][j].mxEigenrayStruct, (MWINDEX)eigenrays[i][j].nEigenrays, 9, nRefrac);
+                ///aditional information has been saved
+
+                ///save refraction coordinates to structure:
+                if (tempRay->nRefrac > 0){
+                    mxRefrac_r = mxCreateDoubleMatrix((MWSIZE)1,    (MWSIZE)tempRay->nRefrac, mxREAL);
+                    mxRefrac_z = mxCreateDoubleMatrix((MWSIZE)1,    (MWSIZE)tempRay->nRefrac, mxREAL);
+
+                    copyDoubleToMxArray(tempRay->rRefrac,   mxRefrac_r, tempRay->nRefrac);
+                    copyDoubleToMxArray(tempRay->zRefrac,   mxRefrac_z, tempRay->nRefrac);
+
+                    mxSetFieldByNumber( eigenrays[i][j].mxEigenrayStruct, (MWINDEX)eigenrays[i][j].nEigenrays, 10, mxRefrac_r);
+                    mxSetFieldByNumber( eigenrays[i][j].mxEigenrayStruct, (MWINDEX)eigenrays[i][j].nEigenrays, 11, mxRefrac_z);
                 }
+                eigenrays[i][j].nEigenrays += 1;
+                maxNumEigenrays = max(eigenrays[i][j].nEigenrays, maxNumEigenrays);
+                
+                reallocRayMembers(tempRay, 0);
+            }
+            if(found[h] != NULL){
+                free(found[h]);
             }
-            DEBUG(3, "nFoundEigenRays: %u\n", (uint32_t)nFoundEigenRays);
         }
     }
+    free(nFound);
+    free(found);
     
     //write "maximum number of eigenrays at any of the hydrophones
     mxMaxNumEigenrays = mxCreateDoubleMatrix((MWSIZE)1, (MWSIZE)1, mxREAL);
@@ -530,7 +631,8 @@ void    calcEigenrayRF(settings_t* settings){
     
     //Free memory
     mxDestroyArray(mxAllEigenraysStruct);
-    free(dz);
+    free(thetas);
+    freeDouble2D(depths, settings->source.nThetas);
     DEBUG(1,"out\n");
 }
 
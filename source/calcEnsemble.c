@@ -0,0 +1,406 @@
+/****************************************************************************************
+ *  calcEnsemble.c                                                                      *
+ *  Runs an ensemble of sound speed realizations (e.g., Monte Carlo perturbations of    *
+ *  the input file's sound speed) on the same geometry and stacks the results of all    *
+ *  members into a single output file.                                                  *
+ *                                                                                      *
+ * ------------------------------------------------------------------------------------ *
+ * Website:                                                                             *
+ *          https://github.com/EyNuel/cTraceo/wiki                                      *
+ *                                                                                      *
+ * License: This file is part of the cTraceo Raytracing Model and is released under the *
+ *          Creative Commons Attribution-NonCommercial-ShareAlike 3.0 Unported License  *
+ *          http://creativecommons.org/licenses/by-nc-sa/3.0/                           *
+ *                                                                                      *
+ * NOTE:    cTraceo is research code under active development.                          *
+ *          The code may contain bugs and updates are possible in the future.           *
+ *                                                                                      *
+ * Written for project SENSOCEAN by:                                                    *
+ *          Emanuel Ey                                                                  *
+ *          emanuel.ey@gmail.com                                                        *
+ *          Copyright (C) 2011 - 2013                                                   *
+ *          Signal Processing Laboratory                                                *
+ *          Universidade do Algarve                                                     *
+ *                                                                                      *
+ * ------------------------------------------------------------------------------------ *
+ *  Inputs:                                                                             *
+ *          settings:   Pointer to structure containing all input info.                 *
+ *                      The ensemble file's name is settings->options.ensembleFileName. *
+ *                                                                                      *
+ *  Ensemble file format (values are separated by white space):                         *
+ *          'title'                                                                     *
+ *          nMembers                                                                    *
+ *          c                       for each member, the sound speeds of the input      *
+ *                                  file's sound speed block, in the same order but     *
+ *                                  without depths or ranges:                           *
+ *                                  c(z,z), analytical:  2 values;                      *
+ *                                  c(z,z), 'TABL':      nz values;                     *
+ *                                  c(r,z):              nz rows of nr values.          *
+ *                                                                                      *
+ *  Outputs:                                                                            *
+ *          CPR, CTL:   nMembers, thetas, arrayR, arrayZ and the pressure ("p") or      *
+ *                      transmission loss ("tl") of all members, written as a           *
+ *                      [nArrayZ x nArrayR*nMembers] matrix (see                        *
+ *                      writeCohAcoustPressCube() in calcCohAcoustPress.c).             *
+ *          EPR, ADP:   nMembers and the usual output, for a hydrophone array which     *
+ *                      repeats the input file's array ranges once per member, i.e.,    *
+ *                      the hydrophone at (arrayR(j), arrayZ(k)) of member m (counting  *
+ *                      from 0) is found at index (j + m*nArrayR, k).                   *
+ *                                                                                      *
+ *  Return Value:                                                                       *
+ *          None                                                                        *
+ *                                                                                      *
+ *  NOTE:   Members are distributed among the threads requested by '--threads'. All     *
+ *          members share the input file's boundaries, objects, hydrophone array and    *
+ *          launching angles; only the sound speed differs.                             *
+ ****************************************************************************************/
+
+#pragma once
+#include <complex.h>
+#include "globals.h"
+#include "tools.h"
+#include "calcEigenrayPr.c"
+#include "calcAmpDelPr.c"
+#include "calcCohAcoustPress.c"
+#if USE_MATLAB == 1
+    #include <mat.h>
+    #include "matrix.h"
+#else
+    #include    "matOut/matOut.h"
+#endif
+
+typedef struct ensemble{
+    /*
+     * Contents of an ensemble file (see above).
+     */
+    uintptr_t   nMembers;
+    double**    c1D;                    //c(z,z): c1D[iMember][iz]
+    double***   c2D;                    //c(r,z): c2D[iMember][iz][ir]
+}ensemble_t;
+
+typedef struct ensembleWorker{
+    /*
+     * Arguments and results of one worker thread (see '--threads').
+     * Members are distributed among workers in an interleaved fashion.
+     */
+    settings_t*         settings;
+    ensemble_t*         ensemble;
+    uint32_t            iThread;
+    uint32_t            nThreads;
+    uintptr_t           dimR, dimZ;
+    complex double*     pressure;       //CPR, CTL: [nMembers][dimR][dimZ], shared by all workers
+    arrivalBuffer_t*    buffers;        //EPR, ADP: one buffer per member, shared by all workers
+    uint32_t            nBackscatteredRays;
+}ensembleWorker_t;
+
+void    readEnsemble(const char*, settings_t*, ensemble_t*);
+void    freeEnsemble(settings_t*, ensemble_t*);
+void*   calcEnsembleWorker(void*);
+void    writeStackedArrivals(settings_t*, arrivalBuffer_t*, uintptr_t);
+void    writeStackedPressure(settings_t*, complex double*, uintptr_t);
+void    calcEnsemble(settings_t*);
+
+void    readEnsemble(const char* fileName, settings_t* settings, ensemble_t* ensemble){
+    /*
+     * Reads an ensemble file; the number of sound speeds per member is given by the input file.
+     */
+    FILE*       ensembleFile = openFile(fileName, "r");
+    uintptr_t   i, j, k, nc;
+    int32_t     n;
+
+    skipLine(ensembleFile);
+    n = readInt(ensembleFile);
+    if(n < 1){
+        fatal("Ensemble file: number of members must be positive.\nAborting...");
+    }
+    ensemble->nMembers  = (uintptr_t)n;
+    ensemble->c1D       = NULL;
+    ensemble->c2D       = NULL;
+
+    switch(settings->soundSpeed.cDist){
+        case C_DIST__PROFILE:
+            //analytical profiles only use 2 sound speeds (see readIn.c):
+            nc = (settings->soundSpeed.cClass == C_CLASS__TABULATED) ? settings->soundSpeed.nz : 2;
+            ensemble->c1D = mallocDouble2D(ensemble->nMembers, nc);
+            for(i=0; i<ensemble->nMembers; i++){
+                for(j=0; j<nc; j++){
+                    ensemble->c1D[i][j] = readDouble(ensembleFile);
+                }
+                if( settings->soundSpeed.cClass != C_CLASS__TABULATED   &&
+                    settings->soundSpeed.cClass != C_CLASS__ISOVELOCITY &&
+                    settings->soundSpeed.cClass != C_CLASS__MUNK        &&
+                    ensemble->c1D[i][0] == ensemble->c1D[i][1]){
+                    fatal("Ensemble file: Analytical sound speed: c[1] == c[0] Only valid for Isovelocity option!\nAborting...");
+                }
+            }
+            break;
+
+        case C_DIST__FIELD:
+            ensemble->c2D = malloc(ensemble->nMembers * sizeof(double**));
+            if(ensemble->c2D == NULL){
+                fatal("Memory alocation error.");
+            }
+            for(i=0; i<ensemble->nMembers; i++){
+                ensemble->c2D[i] = mallocDouble2D(settings->soundSpeed.nz, settings->soundSpeed.nr);
+                for(j=0; j<settings->soundSpeed.nz; j++){
+                    for(k=0; k<settings->soundSpeed.nr; k++){
+                        ensemble->c2D[i][j][k] = readDouble(ensembleFile);
+                    }
+                }
+            }
+            break;
+
+        default:
+            fatal("readEnsemble(): unknown sound speed distribution.\nAborting...");
+            break;
+    }
+    fclose(ensembleFile);
+}
+
+void    freeEnsemble(settings_t* settings, ensemble_t* ensemble){
+    uintptr_t   i;
+
+    if(ensemble->c1D != NULL){
+        freeDouble2D(ensemble->c1D, ensemble->nMembers);
+    }
+    if(ensemble->c2D != NULL){
+        for(i=0; i<ensemble->nMembers; i++){
+            freeDouble2D(ensemble->c2D[i], settings->soundSpeed.nz);
+        }
+        free(ensemble->c2D);
+    }
+}
+
+void*   calcEnsembleWorker(void* args){
+    /*
+     * Runs every nThreads-th member, starting at member iThread, and stores its results
+     * in the member's slice of the shared output.
+     */
+    ensembleWorker_t*   worker      = (ensembleWorker_t*)args;
+    ensemble_t*         ensemble    = worker->ensemble;
+    settings_t          localSettings;
+    uintptr_t           i, j, k;
+    complex double*     pressure    = NULL;
+
+    for(i=worker->iThread; i<ensemble->nMembers; i+=worker->nThreads){
+        //each member is run on a private copy of the settings, which only differs in the sound speed:
+        localSettings = *worker->settings;
+        localSettings.options.nThreads              = 1;
+        localSettings.options.nBackscatteredRays    = 0;
+        localSettings.output.pressure2D             = NULL;
+        if(ensemble->c1D != NULL){
+            localSettings.soundSpeed.c1D = ensemble->c1D[i];
+            if(localSettings.soundSpeed.cClass == C_CLASS__TABULATED){
+                initCValues1D(&localSettings.soundSpeed);
+            }
+        }else{
+            localSettings.soundSpeed.c2D = ensemble->c2D[i];
+            initCValues2D(&localSettings.soundSpeed);
+        }
+
+        switch(localSettings.output.calcType){
+            case CALC_TYPE__EIGENRAYS_PROXIMITY:
+                traceEigenrayPr(&localSettings, &worker->buffers[i]);
+                break;
+
+            case CALC_TYPE__AMP_DELAY_PROXIMITY:
+                traceAmpDelPr(&localSettings, &worker->buffers[i]);
+                break;
+
+            default:
+                initCohAcoustPress(&localSettings);
+                traceCohAcoustPress(&localSettings);
+
+                pressure = &worker->pressure[i * worker->dimR * worker->dimZ];
+                for(j=0; j<worker->dimR; j++){
+                    for(k=0; k<worker->dimZ; k++){
+                        pressure[j*worker->dimZ + k] = localSettings.output.pressure2D[j][k];
+                    }
+                }
+                freeComplex2D(localSettings.output.pressure2D, worker->dimR);
+                break;
+        }
+        if(ensemble->c1D != NULL && localSettings.soundSpeed.cClass == C_CLASS__TABULATED){
+            freeDouble(localSettings.soundSpeed.c1DCoeffs);
+        }else if(ensemble->c2D != NULL){
+            freeDouble(localSettings.soundSpeed.c2DCoeffs);
+        }
+        worker->nBackscatteredRays += localSettings.options.nBackscatteredRays;
+    }
+    return NULL;
+}
+
+void    writeStackedArrivals(settings_t* settings, arrivalBuffer_t* buffers, uintptr_t nSlices){
+    /*
+     * Writes the arrivals of several runs sharing the same hydrophone array (EPR, ADP; see
+     * '--ensemble', '--sources') and frees the buffers. The arrivals are merged in order of
+     * run, moving each run's arrivals to its own copy of the hydrophone array ranges.
+     */
+    arrivalBuffer_t     buffer;
+    settings_t          stackedSettings;
+    uintptr_t           i, j;
+
+    buffer.nArrivals    = 0;
+    buffer.maxArrivals  = 0;
+    buffer.arrival      = NULL;
+    for(i=0; i<nSlices; i++){
+        for(j=0; j<buffers[i].nArrivals; j++){
+            buffers[i].arrival[j].iHydR += i * settings->output.nArrayR;
+            moveArrival(&buffer, &buffers[i].arrival[j]);
+        }
+        free(buffers[i].arrival);
+    }
+    free(buffers);
+
+    stackedSettings = *settings;
+    stackedSettings.output.nArrayR  = (uint32_t)(settings->output.nArrayR * nSlices);
+    stackedSettings.output.arrayR   = mallocDouble(stackedSettings.output.nArrayR);
+    for(i=0; i<nSlices; i++){
+        copyDoubleToPtr(settings->output.arrayR,
+                        &stackedSettings.output.arrayR[i * settings->output.nArrayR],
+                        settings->output.nArrayR);
+    }
+
+    if(settings->output.calcType == CALC_TYPE__EIGENRAYS_PROXIMITY){
+        writeEigenrayPr(&stackedSettings, &buffer);
+    }else{
+        writeAmpDelPr(&stackedSettings, &buffer);
+    }
+    freeDouble(stackedSettings.output.arrayR);
+    freeArrivalBuffer(&buffer);
+}
+
+void    writeStackedPressure(settings_t* settings, complex double* pressure, uintptr_t nSlices){
+    /*
+     * Writes the launching angles, the hydrophone array and the pressure or transmission
+     * loss of several runs sharing the same hydrophone array (CPR, CTL; see '--ensemble',
+     * '--sources') and frees the pressure.
+     */
+    mxArray*            pThetas     = NULL;
+    mxArray*            pHydArrayR  = NULL;
+    mxArray*            pHydArrayZ  = NULL;
+
+    //write launching angles and hydrophone array to file:
+    pThetas     = mxCreateDoubleMatrix((MWSIZE)1, (MWSIZE)settings->source.nThetas, mxREAL);
+    pHydArrayR  = mxCreateDoubleMatrix((MWSIZE)1, (MWSIZE)settings->output.nArrayR, mxREAL);
+    pHydArrayZ  = mxCreateDoubleMatrix((MWSIZE)1, (MWSIZE)settings->output.nArrayZ, mxREAL);
+    if(pThetas == NULL || pHydArrayR == NULL || pHydArrayZ == NULL){
+        fatal("Memory alocation error.");
+    }
+    copyDoubleToPtr(settings->source.thetas, mxGetPr(pThetas),    settings->source.nThetas);
+    copyDoubleToPtr(settings->output.arrayR, mxGetPr(pHydArrayR), settings->output.nArrayR);
+    copyDoubleToPtr(settings->output.arrayZ, mxGetPr(pHydArrayZ), settings->output.nArrayZ);
+    matPutVariable(settings->options.matfile, "thetas",   pThetas);
+    matPutVariable(settings->options.matfile, "arrayR",   pHydArrayR);
+    matPutVariable(settings->options.matfile, "arrayZ",   pHydArrayZ);
+    mxDestroyArray(pThetas);
+    mxDestroyArray(pHydArrayR);
+    mxDestroyArray(pHydArrayZ);
+
+    //write the pressure or transmission loss of all runs:
+    writeCohAcoustPressCube(settings, pressure, nSlices);
+    free(pressure);
+}
+
+void    calcEnsemble(settings_t* settings){
+    /*
+     * Runs all members of the ensemble file (in parallel, see '--threads') and writes
+     * their stacked results to the output file.
+     */
+    assert(settings->options.matfile != NULL);   //output file must be open
+
+    DEBUG(1,"in\n");
+    ensemble_t          ensemble;
+    ensembleWorker_t*   workers     = NULL;
+    complex double*     pressure    = NULL;
+    arrivalBuffer_t*    buffers     = NULL;
+    uintptr_t           i, dimR = 0, dimZ = 0;
+    uint32_t            t, nThreads;
+    uint32_t            nMembers;
+    bool                arrivals;
+    mxArray*            pNMembers   = NULL;
+
+    switch(settings->output.calcType){
+        case CALC_TYPE__COH_ACOUS_PRESS:
+        case CALC_TYPE__COH_TRANS_LOSS:
+            if(settings->output.arrayType == ARRAY_TYPE__LINEAR){
+                fatal("Option '--ensemble <file>' is not available for linear hydrophone arrays.\nAborting...");
+            }
+            arrivals = false;
+            break;
+
+        case CALC_TYPE__EIGENRAYS_PROXIMITY:
+        case CALC_TYPE__AMP_DELAY_PROXIMITY:
+            arrivals = true;
+            break;
+
+        default:
+            fatal("Option '--ensemble <file>' is only available for the CPR, CTL, EPR and ADP output options.\nAborting...");
+            arrivals = false;
+            break;
+    }
+
+    readEnsemble(settings->options.ensembleFileName, settings, &ensemble);
+    getPressureDims(settings, &dimR, &dimZ);
+
+    if(arrivals){
+        buffers = malloc(ensemble.nMembers * sizeof(arrivalBuffer_t));
+        if(buffers == NULL){
+            fatal("Memory alocation error.");
+        }
+        for(i=0; i<ensemble.nMembers; i++){
+            buffers[i].nArrivals    = 0;
+            buffers[i].maxArrivals  = 0;
+            buffers[i].arrival      = NULL;
+        }
+    }else{
+        pressure = malloc(ensemble.nMembers * dimR * dimZ * sizeof(complex double));
+        if(pressure == NULL){
+            fatal("Memory alocation error.");
+        }
+    }
+
+    nThreads = (uint32_t)min( (double)settings->options.nThreads, (double)ensemble.nMembers);
+    nThreads = (uint32_t)max( (double)nThreads, 1.0);
+    workers = malloc(nThreads * sizeof(ensembleWorker_t));
+    if(workers == NULL){
+        fatal("Memory alocation error.");
+    }
+    for(t=0; t<nThreads; t++){
+        workers[t].settings             = settings;
+        workers[t].ensemble             = &ensemble;
+        workers[t].iThread              = t;
+        workers[t].nThreads             = nThreads;
+        workers[t].dimR                 = dimR;
+        workers[t].dimZ                 = dimZ;
+        workers[t].pressure             = pressure;
+        workers[t].buffers              = buffers;
+        workers[t].nBackscatteredRays   = 0;
+    }
+
+    runThreads(nThreads, calcEnsembleWorker, workers, sizeof(ensembleWorker_t));
+
+    for(t=0; t<nThreads; t++){
+        settings->options.nBackscatteredRays += workers[t].nBackscatteredRays;
+    }
+    free(workers);
+
+    //write number of members to file:
+    nMembers = (uint32_t)ensemble.nMembers;
+    pNMembers = mxCreateDoubleMatrix((MWSIZE)1, (MWSIZE)1, mxREAL);
+    if(pNMembers == NULL){
+        fatal("Memory alocation error.");
+    }
+    copyUInt32ToMxArray(&nMembers, pNMembers, 1);
+    matPutVariable(settings->options.matfile, "nMembers", pNMembers);
+    mxDestroyArray(pNMembers);
+
+    if(arrivals){
+        writeStackedArrivals(settings, buffers, ensemble.nMembers);
+    }else{
+        writeStackedPressure(settings, pressure, ensemble.nMembers);
+    }
+
+    freeEnsemble(settings, &ensemble);
+    DEBUG(1,"out\n");
+}
@@ -0,0 +1,461 @@
+/****************************************************************************************
+ *  calcNx2D.c                                                                          *
+ *  Computes the coherent acoustic pressure or transmission loss along a fan of         *
+ *  bearings ("Nx2D"), each bearing being a 2D slice through a gridded bathymetry       *
+ *  (and optionally a gridded sound speed volume).                                      *
+ *                                                                                      *
+ * ------------------------------------------------------------------------------------ *
+ * Website:                                                                             *
+ *          https://github.com/EyNuel/cTraceo/wiki                                      *
+ *                                                                                      *
+ * License: This file is part of the cTraceo Raytracing Model and is released under the *
+ *          Creative Commons Attribution-NonCommercial-ShareAlike 3.0 Unported License  *
+ *          http://creativecommons.org/licenses/by-nc-sa/3.0/                           *
+ *                                                                                      *
+ * NOTE:    cTraceo is research code under active development.                          *
+ *          The code may contain bugs and updates are possible in the future.           *
+ *                                                                                      *
+ * Written for project SENSOCEAN by:                                                    *
+ *          Emanuel Ey                                                                  *
+ *          emanuel.ey@gmail.com                                                        *
+ *          Copyright (C) 2011 - 2013                                                   *
+ *          Signal Processing Laboratory                                                *
+ *          Universidade do Algarve                                                     *
+ *                                                                                      *
+ * ------------------------------------------------------------------------------------ *
+ *  Inputs:                                                                             *
+ *          settings:   Pointer to structure containing all input info.                 *
+ *                      The grid file's name is settings->options.nx2dFileName.         *
+ *                                                                                      *
+ *  Grid file format (values are separated by white space):                             *
+ *          'title'                                                                     *
+ *          xs ys                   source position in grid coordinates [m]             *
+ *          nAzimuths                                                                   *
+ *          azimuths                bearings [deg], clockwise from the y axis           *
+ *          nx ny                                                                       *
+ *          x                       nx strictly increasing coordinates [m]              *
+ *          y                       ny strictly increasing coordinates [m]              *
+ *          depth                   ny rows of nx bottom depths [m]                     *
+ *          nz                      number of sound speed depths, 0 or at least 3 (0:   *
+ *                                  the input file's sound speed is used on all         *
+ *                                  bearings)                                           *
+ *          z                       nz strictly increasing depths [m]                   *
+ *          c                       nz sound speeds for each grid point, ordered like   *
+ *                                  the depths (x varying fastest) [m/s]                *
+ *                                                                                      *
+ *  Outputs:                                                                            *
+ *          "cpr.mat" / "ctl.mat":  azimuths, thetas, arrayR, arrayZ and the pressure   *
+ *                      ("p") or transmission loss ("tl") cube, written as a            *
+ *                      [nArrayZ x nArrayR*nAzimuths] matrix (see                       *
+ *                      writeCohAcoustPressCube() in calcCohAcoustPress.c).             *
+ *                                                                                      *
+ *  Return Value:                                                                       *
+ *          None                                                                        *
+ *                                                                                      *
+ *  NOTE:   Along each bearing, the grid is sampled at the grid's smallest spacing,     *
+ *          using bilinear interpolation. Points outside the grid take the value of     *
+ *          the nearest point on the grid's edge.                                       *
+ *          All other parameters (source, altimetry, objects, bottom properties,        *
+ *          hydrophone array) are taken from the input file.                            *
+ *          Flat and sloped bottoms (FL/SL) are interpolated linearly (2P) along each   *
+ *          bearing.                                                                    *
+ ****************************************************************************************/
+
+#pragma once
+#include <math.h>
+#include <complex.h>
+#include "globals.h"
+#include "tools.h"
+#include "calcCohAcoustPress.c"
+#if USE_MATLAB == 1
+    #include <mat.h>
+    #include "matrix.h"
+#else
+    #include    "matOut/matOut.h"
+#endif
+
+typedef struct nx2dGrid{
+    /*
+     * Contents of an Nx2D grid file (see above).
+     */
+    double      xs, ys;                 //source position in grid coordinates
+    uintptr_t   nAzimuths;
+    double*     azimuths;               //[deg], clockwise from the y axis
+    uintptr_t   nx, ny;
+    double*     x;
+    double*     y;
+    double**    depth;                  //depth[iy][ix]
+    uintptr_t   nz;                     //0 if the input file's sound speed is used
+    double*     z;
+    double*     c;                      //c[(iy*nx + ix)*nz + iz]
+}nx2dGrid_t;
+
+typedef struct nx2dWorker{
+    /*
+     * Arguments and results of one worker thread (see '--threads').
+     * Bearings are distributed among workers in an interleaved fashion.
+     */
+    settings_t*         settings;
+    nx2dGrid_t*         grid;
+    uint32_t            iThread;
+    uint32_t            nThreads;
+    uintptr_t           dimR, dimZ;
+    complex double*     pressure;       //[nAzimuths][dimR][dimZ], shared by all workers
+    uint32_t            nBackscatteredRays;
+}nx2dWorker_t;
+
+void    readNx2DGrid(const char*, nx2dGrid_t*);
+void    freeNx2DGrid(nx2dGrid_t*);
+void    getNx2DWeights(nx2dGrid_t*, double, double, uintptr_t*, uintptr_t*, double*);
+void    initNx2DBearing(settings_t*, nx2dGrid_t*, double);
+void    freeNx2DBearing(settings_t*, nx2dGrid_t*);
+void*   calcNx2DWorker(void*);
+void    calcNx2D(settings_t*);
+
+void    readNx2DGrid(const char* fileName, nx2dGrid_t* grid){
+    /*
+     * Reads and validates an Nx2D grid file.
+     */
+    FILE*       gridFile = openFile(fileName, "r");
+    uintptr_t   i, j;
+    int32_t     n;
+
+    skipLine(gridFile);
+    grid->xs = readDouble(gridFile);
+    grid->ys = readDouble(gridFile);
+
+    n = readInt(gridFile);
+    if(n < 1){
+        fatal("Nx2D grid file: number of azimuths must be positive.\nAborting...");
+    }
+    grid->nAzimuths = (uintptr_t)n;
+    grid->azimuths = mallocDouble(grid->nAzimuths);
+    for(i=0; i<grid->nAzimuths; i++){
+        grid->azimuths[i] = readDouble(gridFile);
+    }
+
+    n = readInt(gridFile);
+    if(n < 2){
+        fatal("Nx2D grid file: at least 2 grid points are required along x.\nAborting...");
+    }
+    grid->nx = (uintptr_t)n;
+    n = readInt(gridFile);
+    if(n < 2){
+        fatal("Nx2D grid file: at least 2 grid points are required along y.\nAborting...");
+    }
+    grid->ny = (uintptr_t)n;
+
+    grid->x = mallocDouble(grid->nx);
+    for(i=0; i<grid->nx; i++){
+        grid->x[i] = readDouble(gridFile);
+        if(i > 0 && grid->x[i] <= grid->x[i-1]){
+            fatal("Nx2D grid file: x coordinates must be strictly increasing.\nAborting...");
+        }
+    }
+    grid->y = mallocDouble(grid->ny);
+    for(i=0; i<grid->ny; i++){
+        grid->y[i] = readDouble(gridFile);
+        if(i > 0 && grid->y[i] <= grid->y[i-1]){
+            fatal("Nx2D grid file: y coordinates must be strictly increasing.\nAborting...");
+        }
+    }
+
+    grid->depth = mallocDouble2D(grid->ny, grid->nx);
+    for(j=0; j<grid->ny; j++){
+        for(i=0; i<grid->nx; i++){
+            grid->depth[j][i] = readDouble(gridFile);
+        }
+    }
+
+    n = readInt(gridFile);
+    if(n < 0 || n == 1 || n == 2){
+        //sound speed fields are interpolated with parabolas (see cValues2D.c):
+        fatal("Nx2D grid file: number of sound speed depths must be either 0 or at least 3.\nAborting...");
+    }
+    grid->nz = (uintptr_t)n;
+    grid->z = NULL;
+    grid->c = NULL;
+    if(grid->nz > 0){
+        grid->z = mallocDouble(grid->nz);
+        for(i=0; i<grid->nz; i++){
+            grid->z[i] = readDouble(gridFile);
+            if(i > 0 && grid->z[i] <= grid->z[i-1]){
+                fatal("Nx2D grid file: sound speed depths must be strictly increasing.\nAborting...");
+            }
+        }
+        grid->c = mallocDouble(grid->nx * grid->ny * grid->nz);
+        for(i=0; i<grid->nx * grid->ny * grid->nz; i++){
+            grid->c[i] = readDouble(gridFile);
+        }
+    }
+    fclose(gridFile);
+}
+
+void    freeNx2DGrid(nx2dGrid_t* grid){
+    freeDouble(grid->azimuths);
+    freeDouble(grid->x);
+    freeDouble(grid->y);
+    freeDouble2D(grid->depth, grid->ny);
+    if(grid->nz > 0){
+        freeDouble(grid->z);
+        freeDouble(grid->c);
+    }
+}
+
+void    getNx2DWeights(nx2dGrid_t* grid, double x, double y, uintptr_t* ix, uintptr_t* iy, double* w){
+    /*
+     * Returns the lower left grid cell (ix, iy) containing the point (x, y) and the bilinear
+     * weights of its corners (ix,iy), (ix+1,iy), (ix,iy+1), (ix+1,iy+1).
+     * Points outside the grid are moved to the grid's edge.
+     */
+    double      u, v;
+
+    x = min( max(x, grid->x[0]), grid->x[grid->nx-1]);
+    y = min( max(y, grid->y[0]), grid->y[grid->ny-1]);
+
+    bracket(grid->nx, grid->x, x, ix);
+    bracket(grid->ny, grid->y, y, iy);
+    //bracket() returns the last interval for points on the last grid line:
+    *ix = (uintptr_t)min( (double)*ix, (double)(grid->nx - 2));
+    *iy = (uintptr_t)min( (double)*iy, (double)(grid->ny - 2));
+
+    u = (x - grid->x[*ix]) / (grid->x[*ix+1] - grid->x[*ix]);
+    v = (y - grid->y[*iy]) / (grid->y[*iy+1] - grid->y[*iy]);
+
+    w[0] = (1.0 - u) * (1.0 - v);
+    w[1] = u         * (1.0 - v);
+    w[2] = (1.0 - u) * v;
+    w[3] = u         * v;
+}
+
+void    initNx2DBearing(settings_t* settings, nx2dGrid_t* grid, double azimuth){
+    /*
+     * Replaces the bathymetry (and, if the grid contains one, the sound speed) in a copy of
+     * the input file's settings by the grid's slice along a given bearing.
+     * The original arrays are not touched, so that they can still be shared by other bearings.
+     */
+    uintptr_t   i, k, nr, ix, iy;
+    uintptr_t   c00, c10, c01, c11;
+    double      ds, rMin, rMax, dr;
+    double      sinAz = sin(azimuth * M_PI/180.0);
+    double      cosAz = cos(azimuth * M_PI/180.0);
+    double      x, y;
+    double      w[4];
+    double*     r = NULL;
+
+    //sample the bearing at the grid's smallest spacing, reaching one sample beyond the ray box:
+    ds = grid->x[1] - grid->x[0];
+    for(i=1; i<grid->nx; i++){
+        ds = min( ds, grid->x[i] - grid->x[i-1]);
+    }
+    for(i=1; i<grid->ny; i++){
+        ds = min( ds, grid->y[i] - grid->y[i-1]);
+    }
+    rMin = settings->source.rbox1 - ds;
+    rMax = settings->source.rbox2 + ds;
+    nr = (uintptr_t)max( ceil( (rMax - rMin) / ds) + 1.0, 4.0);
+    dr = (rMax - rMin) / (double)(nr - 1);
+
+    r = mallocDouble(nr);
+    for(k=0; k<nr; k++){
+        r[k] = rMin + (double)k * dr;
+    }
+
+    //the sampled slice is a general bathymetry, which flat and sloped bottoms (FL/SL) would
+    //reduce to its first two points:
+    if(settings->batimetry.surfaceInterpolation != SURFACE_INTERPOLATION__4P){
+        settings->batimetry.surfaceInterpolation = SURFACE_INTERPOLATION__2P;
+    }
+    settings->batimetry.numSurfaceCoords = (uint32_t)nr;
+    settings->batimetry.r = r;
+    settings->batimetry.z = mallocDouble(nr);
+    initUniformGrid(nr, r, &settings->batimetry.rUniform);
+    for(k=0; k<nr; k++){
+        //ranges are measured from the source, which is at range source.rx:
+        x = grid->xs + (r[k] - settings->source.rx) * sinAz;
+        y = grid->ys + (r[k] - settings->source.rx) * cosAz;
+        getNx2DWeights(grid, x, y, &ix, &iy, w);
+
+        settings->batimetry.z[k] =  w[0] * grid->depth[iy][ix]   + w[1] * grid->depth[iy][ix+1] +
+                                    w[2] * grid->depth[iy+1][ix] + w[3] * grid->depth[iy+1][ix+1];
+    }
+    initBoundarySegments(&settings->batimetry);
+
+    if(grid->nz > 0){
+        settings->soundSpeed.cDist  = C_DIST__FIELD;
+        settings->soundSpeed.cClass = C_CLASS__TABULATED;
+        settings->soundSpeed.nr     = (uint32_t)nr;
+        settings->soundSpeed.nz     = (uint32_t)grid->nz;
+        settings->soundSpeed.r      = mallocDouble(nr);
+        settings->soundSpeed.z      = mallocDouble(grid->nz);
+        settings->soundSpeed.c1D    = NULL;
+        settings->soundSpeed.c1DCoeffs = NULL;
+        settings->soundSpeed.c2D    = mallocDouble2D(grid->nz, nr);
+        copyDoubleToPtr(r,       settings->soundSpeed.r, nr);
+        copyDoubleToPtr(grid->z, settings->soundSpeed.z, grid->nz);
+        initUniformGrid(nr, settings->soundSpeed.r, &settings->soundSpeed.rUniform);
+        initUniformGrid(grid->nz, settings->soundSpeed.z, &settings->soundSpeed.zUniform);
+
+        for(k=0; k<nr; k++){
+            x = grid->xs + (r[k] - settings->source.rx) * sinAz;
+            y = grid->ys + (r[k] - settings->source.rx) * cosAz;
+            getNx2DWeights(grid, x, y, &ix, &iy, w);
+
+            c00 = ( iy    * grid->nx + ix   ) * grid->nz;
+            c10 = ( iy    * grid->nx + ix+1 ) * grid->nz;
+            c01 = ((iy+1) * grid->nx + ix   ) * grid->nz;
+            c11 = ((iy+1) * grid->nx + ix+1 ) * grid->nz;
+            for(i=0; i<grid->nz; i++){
+                settings->soundSpeed.c2D[i][k] =    w[0] * grid->c[c00 + i] + w[1] * grid->c[c10 + i] +
+                                                    w[2] * grid->c[c01 + i] + w[3] * grid->c[c11 + i];
+            }
+        }
+        initCValues2D(&settings->soundSpeed);
+        initCsValues(&settings->soundSpeed);
+    }
+}
+
+void    freeNx2DBearing(settings_t* settings, nx2dGrid_t* grid){
+    /*
+     * Frees the memory allocated by initNx2DBearing() and initCohAcoustPress().
+     */
+    uintptr_t   dimR = 0, dimZ = 0;
+
+    getPressureDims(settings, &dimR, &dimZ);
+    freeComplex2D(settings->output.pressure2D, dimR);
+    freeDouble(settings->batimetry.r);
+    freeDouble(settings->batimetry.z);
+    free(settings->batimetry.segments);
+    if(grid->nz > 0){
+        freeDouble(settings->soundSpeed.r);
+        freeDouble(settings->soundSpeed.z);
+        freeDouble2D(settings->soundSpeed.c2D, settings->soundSpeed.nz);
+        freeDouble(settings->soundSpeed.c2DCoeffs);
+    }
+}
+
+void*   calcNx2DWorker(void* args){
+    /*
+     * Traces every nThreads-th bearing, starting at bearing iThread, and stores
+     * its pressure in the worker's slice of the shared pressure cube.
+     */
+    nx2dWorker_t*       worker  = (nx2dWorker_t*)args;
+    nx2dGrid_t*         grid    = worker->grid;
+    settings_t          localSettings;
+    uintptr_t           i, j, k;
+    complex double*     pressure = NULL;
+
+    for(i=worker->iThread; i<grid->nAzimuths; i+=worker->nThreads){
+        //each bearing is traced on a private copy of the settings:
+        localSettings = *worker->settings;
+        localSettings.options.nThreads              = 1;
+        localSettings.options.nBackscatteredRays    = 0;
+        localSettings.output.pressure2D             = NULL;
+
+        initNx2DBearing(&localSettings, grid, grid->azimuths[i]);
+        initCohAcoustPress(&localSettings);
+        traceCohAcoustPress(&localSettings);
+
+        pressure = &worker->pressure[i * worker->dimR * worker->dimZ];
+        for(j=0; j<worker->dimR; j++){
+            for(k=0; k<worker->dimZ; k++){
+                pressure[j*worker->dimZ + k] = localSettings.output.pressure2D[j][k];
+            }
+        }
+        worker->nBackscatteredRays += localSettings.options.nBackscatteredRays;
+        freeNx2DBearing(&localSettings, grid);
+    }
+    return NULL;
+}
+
+void    calcNx2D(settings_t* settings){
+    /*
+     * Traces all bearings of the grid file (in parallel, see '--threads') and writes
+     * the resulting pressure or transmission loss cube to the output file.
+     */
+    assert(settings->options.matfile != NULL);   //output file must be open
+
+    DEBUG(1,"in\n");
+    nx2dGrid_t          grid;
+    nx2dWorker_t*       workers = NULL;
+    complex double*     pressure = NULL;
+    uintptr_t           dimR = 0, dimZ = 0;
+    uint32_t            t, nThreads;
+    mxArray*            pAzimuths   = NULL;
+    mxArray*            pThetas     = NULL;
+    mxArray*            pHydArrayR  = NULL;
+    mxArray*            pHydArrayZ  = NULL;
+
+    if( settings->output.calcType != CALC_TYPE__COH_ACOUS_PRESS &&
+        settings->output.calcType != CALC_TYPE__COH_TRANS_LOSS){
+        fatal("Option '--nx2d <file>' is only available for the CPR and CTL output options.\nAborting...");
+    }
+    if(settings->output.arrayType == ARRAY_TYPE__LINEAR){
+        fatal("Option '--nx2d <file>' is not available for linear hydrophone arrays.\nAborting...");
+    }
+    if(settings->batimetry.surfacePropertyType != SURFACE_PROPERTY_TYPE__HOMOGENEOUS){
+        fatal("Option '--nx2d <file>' requires homogeneous bottom properties.\nAborting...");
+    }
+
+    readNx2DGrid(settings->options.nx2dFileName, &grid);
+    getPressureDims(settings, &dimR, &dimZ);
+
+    pressure = malloc(grid.nAzimuths * dimR * dimZ * sizeof(complex double));
+    if(pressure == NULL){
+        fatal("Memory alocation error.");
+    }
+
+    nThreads = (uint32_t)min( (double)settings->options.nThreads, (double)grid.nAzimuths);
+    nThreads = (uint32_t)max( (double)nThreads, 1.0);
+    workers = malloc(nThreads * sizeof(nx2dWorker_t));
+    if(workers == NULL){
+        fatal("Memory alocation error.");
+    }
+    for(t=0; t<nThreads; t++){
+        workers[t].settings             = settings;
+        workers[t].grid                 = &grid;
+        workers[t].iThread              = t;
+        workers[t].nThreads             = nThreads;
+        workers[t].dimR                 = dimR;
+        workers[t].dimZ                 = dimZ;
+        workers[t].pressure             = pressure;
+        workers[t].nBackscatteredRays   = 0;
+    }
+
+    runThreads(nThreads, calcNx2DWorker, workers, sizeof(nx2dWorker_t));
+
+    for(t=0; t<nThreads; t++){
+        settings->options.nBackscatteredRays += workers[t].nBackscatteredRays;
+    }
+    free(workers);
+
+    /**
+     * Write azimuths, launching angles and hydrophone array to file:
+     */
+    pAzimuths   = mxCreateDoubleMatrix((MWSIZE)1, (MWSIZE)grid.nAzimuths, mxREAL);
+    pThetas     = mxCreateDoubleMatrix((MWSIZE)1, (MWSIZE)settings->source.nThetas, mxREAL);
+    pHydArrayR  = mxCreateDoubleMatrix((MWSIZE)1, (MWSIZE)settings->output.nArrayR, mxREAL);
+    pHydArrayZ  = mxCreateDoubleMatrix((MWSIZE)1, (MWSIZE)settings->output.nArrayZ, mxREAL);
+    if(pAzimuths == NULL || pThetas == NULL || pHydArrayR == NULL || pHydArrayZ == NULL){
+        fatal("Memory alocation error.");
+    }
+    copyDoubleToPtr(grid.azimuths,          mxGetPr(pAzimuths),  grid.nAzimuths);
+    copyDoubleToPtr(settings->source.thetas, mxGetPr(pThetas),    settings->source.nThetas);
+    copyDoubleToPtr(settings->output.arrayR, mxGetPr(pHydArrayR), settings->output.nArrayR);
+    copyDoubleToPtr(settings->output.arrayZ, mxGetPr(pHydArrayZ), settings->output.nArrayZ);
+    matPutVariable(settings->options.matfile, "azimuths", pAzimuths);
+    matPutVariable(settings->options.matfile, "thetas",   pThetas);
+    matPutVariable(settings->options.matfile, "arrayR",   pHydArrayR);
+    matPutVariable(settings->options.matfile, "arrayZ",   pHydArrayZ);
+    mxDestroyArray(pAzimuths);
+    mxDestroyArray(pThetas);
+    mxDestroyArray(pHydArrayR);
+    mxDestroyArray(pHydArrayZ);
+
+    //write the pressure or transmission loss cube:
+    writeCohAcoustPressCube(settings, pressure, grid.nAzimuths);
+
+    free(pressure);
+    freeNx2DGrid(&grid);
+    DEBUG(1,"out\n");
+}
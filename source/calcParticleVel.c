@@ -247,6 +247,8 @@ void calcParticleVel(settings_t* settings){
     }
     free(settings->output.pressure_H);
     free(settings->output.pressure_V);
+    settings->output.pressure_H = NULL;
+    settings->output.pressure_V = NULL;
     
     freeComplex2D(dP_dR2D, dimR);
     freeComplex2D(dP_dZ2D, dimR);
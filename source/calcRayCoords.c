@@ -53,8 +53,29 @@
 #include <math.h>
 #include "solveEikonalEq.c"
 
+bool    traceRayCoords(settings_t*, ray_t*, uintptr_t);
 void    calcRayCoords(settings_t*);
 
+bool    traceRayCoords(settings_t* settings, ray_t* ray, uintptr_t i){
+    /*
+     * Traces a single ray (called by the ray pipeline, possibly on a worker thread).
+     * Returns false if the ray was not traced.
+     */
+    double      thetai, ctheta;
+    
+    thetai = -settings->source.thetas[i] * M_PI/180.0;
+    ray->theta = thetai;
+    DEBUG(2,"ray[%u].theta: %lf\n", (uint32_t)i, settings->source.thetas[i]);
+    ctheta = fabs( cos(thetai));
+    
+    //Trace a ray as long as it is neither 90 or -90:
+    if (ctheta > 1.0e-7){
+        solveEikonalEq(settings, ray);
+        return true;
+    }
+    return false;
+}
+
 void    calcRayCoords(settings_t* settings){
     DEBUG(1,"in\n");
     
@@ -67,9 +88,11 @@ void    calcRayCoords(settings_t* settings){
     const char*     fieldNames[]= { "theta",
                                     "r",
                                     "z"};
-    double      thetai, ctheta;
-    ray_t*      ray     = NULL;
-    uintptr_t   i;
+    ray_t*          ray         = NULL;
+    rayPipeline_t   pipe;
+    uint32_t        nThreads;
+    bool            traced;
+    uintptr_t       i;
     
         
     //write launching angles to file
@@ -93,20 +116,20 @@ void    calcRayCoords(settings_t* settings){
     }
     
     
-    //allocate the rays:
-    ray = makeRay(settings->source.nThetas);
-    
+    /*
+     * Trace the rays: rays are traced by worker threads (see '--threads') and
+     * written to the mxStructArray in order of launching angle as soon as they are available.
+     */
+    nThreads = (uint32_t)min( (double)settings->options.nThreads, (double)settings->source.nThetas);
+    nThreads = (uint32_t)max( (double)nThreads, 1.0);
+    startRayPipeline(&pipe, settings, nThreads, settings->source.nThetas, traceRayCoords);
     
-    /* Trace the rays:  */
     for(i=0; i<settings->source.nThetas; i++){
-        thetai = -settings->source.thetas[i] * M_PI/180.0;
-        ray[i].theta = thetai;
-        DEBUG(2,"ray[%u].theta: %lf\n", (uint32_t)i, settings->source.thetas[i]);
-        ctheta = fabs( cos(thetai));
+        ray = waitForRay(&pipe, i, &traced);
         
-        //Trace a ray as long as it is neither 90 or -90:
-        if (ctheta > 1.0e-7){
-            solveEikonalEq(settings, &ray[i]);
+        if (traced){
+            if(ray->iBackscattered)
+                settings->options.nBackscatteredRays++;
             
             ///prepare to write ray to mxStructArray:
             /*NOTE: when writing a mxArray to a mxStructArray, the mxArray cannot simply be reused after it was
@@ -119,13 +142,13 @@ void    calcRayCoords(settings_t* settings){
             
             //create mxArrays:
             mxTheta = mxCreateDoubleMatrix((MWSIZE)1,   (MWSIZE)1,              mxREAL);
-            mxR     = mxCreateDoubleMatrix((MWSIZE)1,   (MWSIZE)ray[i].nCoords, mxREAL);
-            mxZ     = mxCreateDoubleMatrix((MWSIZE)1,   (MWSIZE)ray[i].nCoords, mxREAL);
+            mxR     = mxCreateDoubleMatrix((MWSIZE)1,   (MWSIZE)ray->nCoords,   mxREAL);
+            mxZ     = mxCreateDoubleMatrix((MWSIZE)1,   (MWSIZE)ray->nCoords,   mxREAL);
             
             //copy data to mxArrays:
             copyDoubleToMxArray(&settings->source.thetas[i],mxTheta,1);
-            copyDoubleToMxArray(ray[i].r,                   mxR,    ray[i].nCoords);
-            copyDoubleToMxArray(ray[i].z,                   mxZ,    ray[i].nCoords);
+            copyDoubleToMxArray(ray->r,                     mxR,    ray->nCoords);
+            copyDoubleToMxArray(ray->z,                     mxZ,    ray->nCoords);
             
             //copy mxArrays to mxRayStruct
             mxSetFieldByNumber( mxRayStruct,                        //pointer to the mxStruct
@@ -135,20 +158,15 @@ void    calcRayCoords(settings_t* settings){
             mxSetFieldByNumber( mxRayStruct, (MWINDEX)i, 1, mxR);   // "r"
             mxSetFieldByNumber( mxRayStruct, (MWINDEX)i, 2, mxZ);   // "z"
             ///ray has been saved to mxStructArray
-            
-            if(KEEP_RAYS_IN_MEM == false){
-                //free the ray's memory
-                reallocRayMembers(&ray[i],0);
-            }
-        }//if (ctheta > 1.0e-7)
+        }//if (traced)
+        releaseRay(&pipe, i);
     }//for(i=0; i<settings->source.nThetas; i++)
+    stopRayPipeline(&pipe);
     
     /// Write all ray information to matfile:
     matPutVariable(settings->options.matfile, "rays", mxRayStruct);
     
     /// Finish up
     mxDestroyArray(mxRayStruct);
-    
-    free(ray);
     DEBUG(1,"out\n");
 }
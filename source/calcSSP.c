@@ -50,6 +50,7 @@
 #endif
 #include "tools.h"
 #include <math.h>
+#include "linearSpaced.c"
 #include "solveEikonalEq.c"
 
 void    calcSSP(settings_t* settings);
@@ -76,6 +77,7 @@ void    calcSSP(settings_t* settings){
     /* Interpolate the sound speeds:  */
     for(i=0; i<nPoints; i++){
         csValues(   settings,
+                    NULL,
                     settings->source.rbox1,
                     depths[i],
                     &c[i],
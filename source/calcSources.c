@@ -0,0 +1,276 @@
+/****************************************************************************************
+ *  calcSources.c                                                                       *
+ *  Runs the input file for each of a list of source positions (e.g., a vertical scan   *
+ *  of source depths), sharing the environment, and stacks the results of all sources   *
+ *  into a single output file.                                                          *
+ *                                                                                      *
+ * ------------------------------------------------------------------------------------ *
+ * Website:                                                                             *
+ *          https://github.com/EyNuel/cTraceo/wiki                                      *
+ *                                                                                      *
+ * License: This file is part of the cTraceo Raytracing Model and is released under the *
+ *          Creative Commons Attribution-NonCommercial-ShareAlike 3.0 Unported License  *
+ *          http://creativecommons.org/licenses/by-nc-sa/3.0/                           *
+ *                                                                                      *
+ * NOTE:    cTraceo is research code under active development.                          *
+ *          The code may contain bugs and updates are possible in the future.           *
+ *                                                                                      *
+ * Written for project SENSOCEAN by:                                                    *
+ *          Emanuel Ey                                                                  *
+ *          emanuel.ey@gmail.com                                                        *
+ *          Copyright (C) 2011 - 2013                                                   *
+ *          Signal Processing Laboratory                                                *
+ *          Universidade do Algarve                                                     *
+ *                                                                                      *
+ * ------------------------------------------------------------------------------------ *
+ *  Inputs:                                                                             *
+ *          settings:   Pointer to structure containing all input info.                 *
+ *                      The source file's name is settings->options.sourcesFileName.    *
+ *                                                                                      *
+ *  Source file format (values are separated by white space):                           *
+ *          'title'                                                                     *
+ *          nSources                                                                    *
+ *          rx zx                   range and depth of each source [m].                 *
+ *                                                                                      *
+ *  Outputs:                                                                            *
+ *          sources:    a [nSources x 2] matrix containing the range and depth of each  *
+ *                      source.                                                         *
+ *          CPR, CTL:   thetas, arrayR, arrayZ and the pressure ("p") or transmission   *
+ *                      loss ("tl") of all sources, written as a                        *
+ *                      [nArrayZ x nArrayR*nSources] matrix (see                        *
+ *                      writeCohAcoustPressCube() in calcCohAcoustPress.c).             *
+ *          EPR, ADP:   the usual output, for a hydrophone array which repeats the      *
+ *                      input file's array ranges once per source, i.e., the arrivals   *
+ *                      of source m (counting from 0) at hydrophone (arrayR(j),         *
+ *                      arrayZ(k)) are found at index (j + m*nArrayR, k). (ADP's        *
+ *                      "sourceZ" is the input file's source depth.)                    *
+ *                                                                                      *
+ *  Return Value:                                                                       *
+ *          None                                                                        *
+ *                                                                                      *
+ *  NOTE:   The input file's source position is replaced by the listed positions; its   *
+ *          launching angles, frequency and range box apply to all sources. Sources     *
+ *          are distributed among the threads requested by '--threads'; when there are  *
+ *          fewer sources than threads, the remaining threads trace each source's rays. *
+ ****************************************************************************************/
+
+#pragma once
+#include <complex.h>
+#include "globals.h"
+#include "tools.h"
+#include "calcEigenrayPr.c"
+#include "calcAmpDelPr.c"
+#include "calcCohAcoustPress.c"
+#include "calcEnsemble.c"
+#if USE_MATLAB == 1
+    #include <mat.h>
+    #include "matrix.h"
+#else
+    #include    "matOut/matOut.h"
+#endif
+
+typedef struct sourcesWorker{
+    /*
+     * Arguments and results of one worker thread (see '--threads').
+     * Sources are distributed among workers in an interleaved fashion.
+     */
+    settings_t*         settings;
+    uintptr_t           nSources;
+    double**            sources;                //sources[iSource] = {rx, zx}
+    uint32_t            iThread;
+    uint32_t            nThreads;
+    uint32_t            nRayThreads;            //threads used for tracing the rays of each source
+    uintptr_t           dimR, dimZ;
+    complex double*     pressure;               //CPR, CTL: [nSources][dimR][dimZ], shared by all workers
+    arrivalBuffer_t*    buffers;                //EPR, ADP: one buffer per source, shared by all workers
+    uint32_t            nBackscatteredRays;
+}sourcesWorker_t;
+
+double** readSources(const char*, settings_t*, uintptr_t*);
+void*   calcSourcesWorker(void*);
+void    calcSources(settings_t*);
+
+double** readSources(const char* fileName, settings_t* settings, uintptr_t* nSources){
+    /*
+     * Reads a source file and returns the source positions.
+     */
+    FILE*       sourcesFile = openFile(fileName, "r");
+    double**    sources = NULL;
+    uintptr_t   i;
+    int32_t     n;
+
+    skipLine(sourcesFile);
+    n = readInt(sourcesFile);
+    if(n < 1){
+        fatal("Source file: number of sources must be positive.\nAborting...");
+    }
+    *nSources   = (uintptr_t)n;
+    sources     = mallocDouble2D(*nSources, 2);
+    for(i=0; i<*nSources; i++){
+        sources[i][0] = readDouble(sourcesFile);
+        sources[i][1] = readDouble(sourcesFile);
+        if(sources[i][0] <= settings->source.rbox1 || sources[i][0] >= settings->source.rbox2){
+            fatal("Source file: source range is outside the range box.\nAborting...");
+        }
+    }
+    fclose(sourcesFile);
+    return sources;
+}
+
+void*   calcSourcesWorker(void* args){
+    /*
+     * Runs every nThreads-th source, starting at source iThread, and stores its results
+     * in the source's slice of the shared output.
+     */
+    sourcesWorker_t*    worker      = (sourcesWorker_t*)args;
+    settings_t          localSettings;
+    uintptr_t           i, j, k;
+    complex double*     pressure    = NULL;
+
+    for(i=worker->iThread; i<worker->nSources; i+=worker->nThreads){
+        //each source is run on a private copy of the settings, which only differs in the source position:
+        localSettings = *worker->settings;
+        localSettings.options.nThreads              = worker->nRayThreads;
+        localSettings.options.nBackscatteredRays    = 0;
+        localSettings.output.pressure2D             = NULL;
+        localSettings.source.rx                     = worker->sources[i][0];
+        localSettings.source.zx                     = worker->sources[i][1];
+
+        switch(localSettings.output.calcType){
+            case CALC_TYPE__EIGENRAYS_PROXIMITY:
+                traceEigenrayPr(&localSettings, &worker->buffers[i]);
+                break;
+
+            case CALC_TYPE__AMP_DELAY_PROXIMITY:
+                traceAmpDelPr(&localSettings, &worker->buffers[i]);
+                break;
+
+            default:
+                initCohAcoustPress(&localSettings);
+                traceCohAcoustPress(&localSettings);
+
+                pressure = &worker->pressure[i * worker->dimR * worker->dimZ];
+                for(j=0; j<worker->dimR; j++){
+                    for(k=0; k<worker->dimZ; k++){
+                        pressure[j*worker->dimZ + k] = localSettings.output.pressure2D[j][k];
+                    }
+                }
+                freeComplex2D(localSettings.output.pressure2D, worker->dimR);
+                break;
+        }
+        worker->nBackscatteredRays += localSettings.options.nBackscatteredRays;
+    }
+    return NULL;
+}
+
+void    calcSources(settings_t* settings){
+    /*
+     * Runs the input file for all sources of the source file (in parallel, see '--threads')
+     * and writes their stacked results to the output file.
+     */
+    assert(settings->options.matfile != NULL);   //output file must be open
+
+    DEBUG(1,"in\n");
+    double**            sources     = NULL;
+    uintptr_t           nSources    = 0;
+    sourcesWorker_t*    workers     = NULL;
+    complex double*     pressure    = NULL;
+    arrivalBuffer_t*    buffers     = NULL;
+    uintptr_t           i, dimR = 0, dimZ = 0;
+    uint32_t            t, nThreads, nRayThreads;
+    bool                arrivals;
+    mxArray*            pSources    = NULL;
+    double*             dest        = NULL;
+
+    switch(settings->output.calcType){
+        case CALC_TYPE__COH_ACOUS_PRESS:
+        case CALC_TYPE__COH_TRANS_LOSS:
+            if(settings->output.arrayType == ARRAY_TYPE__LINEAR){
+                fatal("Option '--sources <file>' is not available for linear hydrophone arrays.\nAborting...");
+            }
+            arrivals = false;
+            break;
+
+        case CALC_TYPE__EIGENRAYS_PROXIMITY:
+        case CALC_TYPE__AMP_DELAY_PROXIMITY:
+            arrivals = true;
+            break;
+
+        default:
+            fatal("Option '--sources <file>' is only available for the CPR, CTL, EPR and ADP output options.\nAborting...");
+            arrivals = false;
+            break;
+    }
+
+    sources = readSources(settings->options.sourcesFileName, settings, &nSources);
+    getPressureDims(settings, &dimR, &dimZ);
+
+    if(arrivals){
+        buffers = malloc(nSources * sizeof(arrivalBuffer_t));
+        if(buffers == NULL){
+            fatal("Memory alocation error.");
+        }
+        for(i=0; i<nSources; i++){
+            buffers[i].nArrivals    = 0;
+            buffers[i].maxArrivals  = 0;
+            buffers[i].arrival      = NULL;
+        }
+    }else{
+        pressure = malloc(nSources * dimR * dimZ * sizeof(complex double));
+        if(pressure == NULL){
+            fatal("Memory alocation error.");
+        }
+    }
+
+    //threads which are left over when there are fewer sources than threads trace rays:
+    nThreads    = (uint32_t)min( (double)settings->options.nThreads, (double)nSources);
+    nThreads    = (uint32_t)max( (double)nThreads, 1.0);
+    nRayThreads = (uint32_t)max( (double)(settings->options.nThreads / nThreads), 1.0);
+    workers = malloc(nThreads * sizeof(sourcesWorker_t));
+    if(workers == NULL){
+        fatal("Memory alocation error.");
+    }
+    for(t=0; t<nThreads; t++){
+        workers[t].settings             = settings;
+        workers[t].nSources             = nSources;
+        workers[t].sources              = sources;
+        workers[t].iThread              = t;
+        workers[t].nThreads             = nThreads;
+        workers[t].nRayThreads          = nRayThreads;
+        workers[t].dimR                 = dimR;
+        workers[t].dimZ                 = dimZ;
+        workers[t].pressure             = pressure;
+        workers[t].buffers              = buffers;
+        workers[t].nBackscatteredRays   = 0;
+    }
+
+    runThreads(nThreads, calcSourcesWorker, workers, sizeof(sourcesWorker_t));
+
+    for(t=0; t<nThreads; t++){
+        settings->options.nBackscatteredRays += workers[t].nBackscatteredRays;
+    }
+    free(workers);
+
+    //write source positions to file:
+    pSources = mxCreateDoubleMatrix((MWSIZE)nSources, (MWSIZE)2, mxREAL);
+    if(pSources == NULL){
+        fatal("Memory alocation error.");
+    }
+    dest = mxGetPr(pSources);
+    for(i=0; i<nSources; i++){
+        //matlab matrices are stored in column-major order:
+        dest[i]             = sources[i][0];
+        dest[i + nSources]  = sources[i][1];
+    }
+    matPutVariable(settings->options.matfile, "sources", pSources);
+    mxDestroyArray(pSources);
+
+    if(arrivals){
+        writeStackedArrivals(settings, buffers, nSources);
+    }else{
+        writeStackedPressure(settings, pressure, nSources);
+    }
+
+    freeDouble2D(sources, nSources);
+    DEBUG(1,"out\n");
+}
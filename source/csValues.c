@@ -33,6 +33,7 @@
  * ------------------------------------------------------------------------------------ *
  *  Inputs:                                                                             *
  *          settings:   Pointer to structure containing all input info.                 *
+ *          cursor:     Lookup cursor of the ray being traced (or NULL).                *
  *          ri:         range of interpolation point.                                   *
  *          zi:         depth of interpolation point.                                   *
  *  Outputs:                                                                            *
@@ -57,109 +58,226 @@
 #include    "cValues1D.c"
 #include    "cValues2D.c"
 
-void    csValues(settings_t*, double, double, double*, double*, double*, double*, double*,
+/*
+ * The sound speed of each class of sound speed distribution is evaluated by its own
+ * function, which initCsValues() selects once the input file has been read, so that
+ * csValues() does not need to determine the class at every step of a ray.
+ * All functions share the signature of soundSpeed_t.cValues; profiles (c=c(z)) set
+ * all derivatives with respect to range to 0.
+ */
+#define epsilon (7.4e-3f)
+#define bmunk   (1300.0f)
+#define bmunk2  (bmunk*bmunk)
+
+void    csIsovelocity(const soundSpeed_t*, lookupCursor_t*, double, double, double*, double*, double*, double*, double*, double*);
+void    csLinear(const soundSpeed_t*, lookupCursor_t*, double, double, double*, double*, double*, double*, double*, double*);
+void    csParabolic(const soundSpeed_t*, lookupCursor_t*, double, double, double*, double*, double*, double*, double*, double*);
+void    csExponential(const soundSpeed_t*, lookupCursor_t*, double, double, double*, double*, double*, double*, double*, double*);
+void    csN2Linear(const soundSpeed_t*, lookupCursor_t*, double, double, double*, double*, double*, double*, double*, double*);
+void    csInvSquare(const soundSpeed_t*, lookupCursor_t*, double, double, double*, double*, double*, double*, double*, double*);
+void    csMunk(const soundSpeed_t*, lookupCursor_t*, double, double, double*, double*, double*, double*, double*, double*);
+void    csTabulated(const soundSpeed_t*, lookupCursor_t*, double, double, double*, double*, double*, double*, double*, double*);
+void    csField(const soundSpeed_t*, lookupCursor_t*, double, double, double*, double*, double*, double*, double*, double*);
+void    initCsValues(soundSpeed_t*);
+void    csValues(settings_t*, lookupCursor_t*, double, double, double*, double*, double*, double*, double*,
                 vector_t*, double*, double*, double*);
 
-void    csValues(settings_t* settings, double ri, double zi, double* ci, double* cc, double* si, double* cri, double* czi,
-                vector_t* slowness, double* crri, double* czzi, double* crzi){
-    DEBUG(8,"csValues(),\t in\n");
-    
-    double      k,a,eta, root, root32, root52;
-    double*     c1D;    //used locally to make code more readable
-    double**    c2D;    //used locally to make code more readable
-    double*     r;      //used locally to make code more readable
-    double*     z;      //used locally to make code more readable
-    
-    #define epsilon (7.4e-3f)
-    #define bmunk   (1300.0f)
-    #define bmunk2  (bmunk*bmunk)
-    
-    c1D = settings->soundSpeed.c1D;
-    c2D = settings->soundSpeed.c2D;
-    r =  settings->soundSpeed.r;
-    z =  settings->soundSpeed.z;
-    
-    switch(settings->soundSpeed.cDist){
+void    csIsovelocity(const soundSpeed_t* ssp, lookupCursor_t* cursor, double ri, double zi, double* ci, double* cri, double* czi, double* crri, double* czzi, double* crzi){
+    (void)cursor;
+    (void)ri;
+    (void)zi;
+    *ci     = ssp->c1D[0];
+    *cri    = 0;
+    *czi    = 0;
+    *crri   = 0;
+    *czzi   = 0;
+    *crzi   = 0;
+}
+
+void    csLinear(const soundSpeed_t* ssp, lookupCursor_t* cursor, double ri, double zi, double* ci, double* cri, double* czi, double* crri, double* czzi, double* crzi){  //"LINP"
+    double*     c1D = ssp->c1D;
+    double*     z   = ssp->z;
+    double      k;
+
+    (void)cursor;
+    (void)ri;
+    k       = ( c1D[1] - c1D[0] ) / ( z[1] - z[0]);
+    *ci     = c1D[0] + k*( zi - z[0] );
+    *czi    = k;
+    *czzi   = 0;
+    *cri    = 0;
+    *crri   = 0;
+    *crzi   = 0;
+}
+
+void    csParabolic(const soundSpeed_t* ssp, lookupCursor_t* cursor, double ri, double zi, double* ci, double* cri, double* czi, double* crri, double* czzi, double* crzi){   //"PARP"
+    double*     c1D = ssp->c1D;
+    double*     z   = ssp->z;
+    double      k;
+
+    (void)cursor;
+    (void)ri;
+    k       = ( c1D[1] - c1D[0] ) / pow( ( z[1] - z[0]), 2);
+    *ci     = c1D[0] + k * pow(( zi - z[0] ), 2);
+    *czi    = 2*k*( zi - z[0] );
+    *czzi   = 2*k;
+    *cri    = 0;
+    *crri   = 0;
+    *crzi   = 0;
+}
+
+void    csExponential(const soundSpeed_t* ssp, lookupCursor_t* cursor, double ri, double zi, double* ci, double* cri, double* czi, double* crri, double* czzi, double* crzi){ //"EXPP"
+    double*     c1D = ssp->c1D;
+    double*     z   = ssp->z;
+    double      k;
+
+    (void)cursor;
+    (void)ri;
+    k       = log( c1D[0]/c1D[1] )/( z[1] - z[0] );
+    *ci     = c1D[0]*exp( -k*(zi - z[0]) );
+    *czi    = -k * (*ci);
+    *czzi   = k*k * (*ci);
+    *cri    = 0;
+    *crri   = 0;
+    *crzi   = 0;
+}
+
+void    csN2Linear(const soundSpeed_t* ssp, lookupCursor_t* cursor, double ri, double zi, double* ci, double* cri, double* czi, double* crri, double* czzi, double* crzi){    //"N2LP"
+    double*     c1D = ssp->c1D;
+    double*     z   = ssp->z;
+    double      k, root, root32, root52;
+
+    (void)cursor;
+    (void)ri;
+    k       = ( pow( c1D[0]/c1D[1] ,2) -1) / ( z[1] - z[0] );
+    root    = sqrt( 1 + k*( zi - z[0] ) );
+    root32  = pow(root, 3/2 );
+    root52  = pow(root, 5/2 );
+    *ci     = c1D[0]/sqrt( 1 + k*( zi - z[0] ));
+    *czi    = -k*c1D[0]/( 2*root32 );
+    *czzi   = 3*k*k*c1D[0]/( 4*root52 );
+    *cri    = 0;
+    *crri   = 0;
+    *crzi   = 0;
+}
+
+void    csInvSquare(const soundSpeed_t* ssp, lookupCursor_t* cursor, double ri, double zi, double* ci, double* cri, double* czi, double* crri, double* czzi, double* crzi){   //"ISQP"
+    double*     c1D = ssp->c1D;
+    double*     z   = ssp->z;
+    double      k, a, root, root32, root52;
+
+    (void)cursor;
+    (void)ri;
+    a       = pow(( c1D[1]/c1D[0]) -1 , 2);
+    root    = sqrt( a/(1-a) );
+    k       = root/( z[1] - z[0] );
+    root    = sqrt( 1 + pow( k*( zi - z[0] ),2) );
+    root32  = pow(root, 3/2 );
+    root52  = pow(root, 5/2 );
+    *ci     = c1D[0] * ( 1 + k*( zi - z[0] )/root );
+    *czi    = c1D[0] * k / root32;
+    *czzi   = -3 * c1D[0] * pow(k,3) / root52;
+    *cri    = 0;
+    *crri   = 0;
+    *crzi   = 0;
+}
+
+void    csMunk(const soundSpeed_t* ssp, lookupCursor_t* cursor, double ri, double zi, double* ci, double* cri, double* czi, double* crri, double* czzi, double* crzi){    //"MUNK"
+    double*     c1D = ssp->c1D;
+    double*     z   = ssp->z;
+    double      eta;
+
+    (void)cursor;
+    (void)ri;
+    eta     = 2*( zi - z[0] )/bmunk;
+    *ci     = c1D[0]*( 1 + epsilon*( eta + exp(-eta) - 1 ) );
+    *czi    = 2*epsilon * c1D[0]*( 1 - exp(-eta) )/bmunk;
+    *czzi   = 4*epsilon * c1D[0]*exp( -eta )/bmunk2;
+    *cri    = 0;
+    *crri   = 0;
+    *crzi   = 0;
+}
+
+void    csTabulated(const soundSpeed_t* ssp, lookupCursor_t* cursor, double ri, double zi, double* ci, double* cri, double* czi, double* crri, double* czzi, double* crzi){   //"TABL"
+    (void)ri;
+    cValues1D(  ssp->nz, ssp->z, &ssp->zUniform, (cursor != NULL) ? &cursor->iSSPz : NULL,
+                ssp->c1D, ssp->c1DCoeffs, zi, ci, czi, czzi);
+    *cri    = 0;
+    *crri   = 0;
+    *crzi   = 0;
+}
+
+void    csField(const soundSpeed_t* ssp, lookupCursor_t* cursor, double ri, double zi, double* ci, double* cri, double* czi, double* crri, double* czzi, double* crzi){   //tabulated sound speed field
+    uintptr_t*  iSSPr = NULL;   //intervals of the last lookup (see bracketHunt())
+    uintptr_t*  iSSPz = NULL;
+
+    if(cursor != NULL){
+        iSSPr = &cursor->iSSPr;
+        iSSPz = &cursor->iSSPz;
+    }
+    cValues2D(  ssp->nr, ssp->nz, ssp->r, ssp->z, &ssp->rUniform, &ssp->zUniform, iSSPr, iSSPz,
+                ssp->c2DCoeffs, ri, zi, ci, cri, czi, crri, czzi, crzi);
+}
+
+void    initCsValues(soundSpeed_t* ssp){
+    /*
+     * Selects the function which evaluates the sound speed of the distribution's class.
+     * Must be called again whenever cDist or cClass change.
+     */
+    switch(ssp->cDist){
         case C_DIST__PROFILE:
-            //in the case of soundspeed profiles, all derivatives with respect to range are 0:
-            *cri = 0;
-            *crri = 0;
-            *crzi = 0;
-            switch(settings->soundSpeed.cClass){
-                /// *****   analytical sound speed profiles     *****
-                case C_CLASS__ISOVELOCITY:          //"ISOV"
-                    *ci = c1D[0];
-                    *czi = 0;
-                    *czzi = 0;
+            switch(ssp->cClass){
+                case C_CLASS__ISOVELOCITY:
+                    ssp->cValues = csIsovelocity;
                     break;
-                    
-                case C_CLASS__LINEAR:               //"LINP"
-                    k   = ( c1D[1] - c1D[0] ) / ( z[1] - z[0]);
-                    *ci = c1D[0] + k*( zi - z[0] );
-                    *czi = k;
-                    *czzi= 0;
+
+                case C_CLASS__LINEAR:
+                    ssp->cValues = csLinear;
                     break;
-                    
-                case C_CLASS__PARABOLIC:            //"PARP"
-                    k   = ( c1D[1] - c1D[0] ) / pow( ( z[1] - z[0]), 2);
-                    *ci = c1D[0] + k * pow(( zi - z[0] ), 2);
-                    *czi = 2*k*( zi - z[0] );
-                    *czzi= 2*k;
+
+                case C_CLASS__PARABOLIC:
+                    ssp->cValues = csParabolic;
                     break;
-                    
-                case C_CLASS__EXPONENTIAL:          //"EXPP"
-                    k   = log( c1D[0]/c1D[1] )/( z[1] - z[0] );
-                    *ci = c1D[0]*exp( -k*(zi - z[0]) );
-                    *czi    = -k * (*ci);
-                    *czzi= k*k * (*ci);
+
+                case C_CLASS__EXPONENTIAL:
+                    ssp->cValues = csExponential;
                     break;
-                    
-                case C_CLASS__N2_LINEAR:            //"N2LP"
-                    k       = ( pow( c1D[0]/c1D[1] ,2) -1) / ( z[1] - z[0] );
-                    root    = sqrt( 1 + k*( zi - z[0] ) );
-                    root32  = pow(root, 3/2 );
-                    root52  = pow(root, 5/2 );
-                    *ci         = c1D[0]/sqrt( 1 + k*( zi - z[0] ));
-                    *czi    = -k*c1D[0]/( 2*root32 );
-                    *czzi   = 3*k*k*c1D[0]/( 4*root52 );
+
+                case C_CLASS__N2_LINEAR:
+                    ssp->cValues = csN2Linear;
                     break;
-                    
-                case C_CLASS__INV_SQUARE:           //"ISQP"
-                    a       = pow(( c1D[1]/c1D[0]) -1 , 2);
-                    root    = sqrt( a/(1-a) );
-                    k       = root/( z[1] - z[0] );
-                    root    = sqrt( 1 + pow( k*( zi - z[0] ),2) );
-                    root32  = pow(root, 3/2 );
-                    root52  = pow(root, 5/2 );
-                    *ci         = c1D[0] * ( 1 + k*( zi - z[0] )/root );
-                    *czi    = c1D[0] * k / root32;
-                    *czzi   = -3 * c1D[0] * pow(k,3) / root52;
+
+                case C_CLASS__INV_SQUARE:
+                    ssp->cValues = csInvSquare;
                     break;
-                    
-                case C_CLASS__MUNK:                 //"MUNK"
-                    eta     = 2*( zi - z[0] )/bmunk;
-                    *ci         = c1D[0]*( 1 + epsilon*( eta + exp(-eta) - 1 ) );
-                    *czi    = 2*epsilon * c1D[0]*( 1 - exp(-eta) )/bmunk;
-                    *czzi   = 4*epsilon * c1D[0]*exp( -eta )/bmunk2;
+
+                case C_CLASS__MUNK:
+                    ssp->cValues = csMunk;
                     break;
-                    
-                case C_CLASS__TABULATED:            //"TABL"
-                    //cValues1D(uintptr_t n, double* xTable, double* cTable, double* xi, double* ci, double* cxi, double* cxxi){
-                    cValues1D( settings->soundSpeed.nz, z, c1D, zi, ci, czi, czzi);
+
+                case C_CLASS__TABULATED:
+                    ssp->cValues = csTabulated;
                     break;
-                    
+
                 default:
                     fatal("Unknown sound speed profile.\nAborting...");
             }
             break;
+
         case C_DIST__FIELD:
-            /// *****   tabulated sound speed fields        *****
-            cValues2D(settings->soundSpeed.nr,settings->soundSpeed.nz,r,z,c2D,ri,zi,ci,cri,czi,crri,czzi,crzi);
+            ssp->cValues = csField;
             break;
-            
+
         default:
             fatal("Unknown sound speed distribution.\nAborting...");
     }
+}
+
+void    csValues(settings_t* settings, lookupCursor_t* cursor, double ri, double zi, double* ci, double* cc, double* si, double* cri, double* czi,
+                vector_t* slowness, double* crri, double* czzi, double* crzi){
+    DEBUG(8,"csValues(),\t in\n");
+
+    settings->soundSpeed.cValues(&settings->soundSpeed, cursor, ri, zi, ci, cri, czi, crri, czzi, crzi);
 
     *cc = pow(*ci,2);
     *si =  1.0/(*ci);
@@ -168,4 +286,3 @@ void    csValues(settings_t* settings, double ri, double zi, double* ci, double*
     
     DEBUG(8,"csValues(),\t out\n");
 }
-
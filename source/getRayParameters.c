@@ -32,6 +32,7 @@
  *                                                                                      *
  * ------------------------------------------------------------------------------------ *
  *  Inputs:                                                                             *
+ *          settings: Pointer to the settings (see option '--denseOutput').             *
  *          ray:    Pointer to structure containing a ray.                              *
  *          iHyd:   Index at which to interpolate.                                      *
  *          q0:     TODO                                                                *
@@ -48,6 +49,21 @@
  *  Return Value:                                                                       *
  *          None                                                                        *
  *                                                                                      *
+ * ------------------------------------------------------------------------------------ *
+ *  Dense output (option '--denseOutput'):                                              *
+ *          By default, the ray's parameters are interpolated linearly in range         *
+ *          between two ray coordinates. With '--denseOutput', each segment is          *
+ *          described by cubic Hermite polynomials in arc length instead, using the     *
+ *          derivatives known at both coordinates: dr/ds and dz/ds (the ray's tangent   *
+ *          ray->es), dtau/ds = 1/c, dic/ds = c and dq/ds = c*p. The segment's          *
+ *          parameter at rHyd is found by Newton iteration (safeguarded by bisection)   *
+ *          on r(s). The amplitude follows from the interpolated q, ic and c, as in     *
+ *          solveDynamicEq(); its remaining factor (launch conditions, decay and        *
+ *          attenuation) is interpolated linearly.                                      *
+ *          Segments ending at a reflection, segments containing a caustic (for the     *
+ *          amplitude) and segments along which the ray's range is not monotonous are   *
+ *          interpolated linearly, as before.                                           *
+ *                                                                                      *
  ****************************************************************************************/
  
 #pragma once
@@ -56,23 +72,134 @@
 #include <complex.h>
 #include "tools.h"
 
-void    getRayParameters(ray_t*, uintptr_t, double, double, double*, double*, double*, double complex*, double*, double*);
+bool    hermiteRayParameter(ray_t*, uintptr_t, double, double*, double*);
+void    interpolateRay(settings_t*, ray_t*, uintptr_t, double, double*, double*, double*, complex double*, double*);
+void    getRayParameters(settings_t*, ray_t*, uintptr_t, double, double, double*, double*, double*, double complex*, double*, double*);
+
+bool    hermiteRayParameter(ray_t* ray, uintptr_t i, double rHyd, double* t, double* h){
+    /*
+     * Finds the parameter t in [0,1] of segment i at which the Hermite polynomial r(t) equals rHyd.
+     * Returns false if the segment can't be interpolated with Hermite polynomials.
+     */
+    double      r0, r1, m0, m1, lo, hi, f, df, dt;
+    uintptr_t   k;
+
+    if( i+1 >= ray->nCoords || ray->iRefl[i+1] == true){
+        return false;
+    }
+    r0  = ray->r[i];
+    r1  = ray->r[i+1];
+    *h  = sqrt( (r1-r0)*(r1-r0) + (ray->z[i+1]-ray->z[i])*(ray->z[i+1]-ray->z[i]) );
+    m0  = *h * ray->es[i].r;
+    m1  = *h * ray->es[i+1].r;
+
+    //rHyd must lie within the segment, along which r(t) must be monotonous:
+    if( r0 == r1 || (rHyd - r0)*(rHyd - r1) > 0 || m0*(r1-r0) <= 0 || m1*(r1-r0) <= 0){
+        return false;
+    }
+
+    lo  = 0.0;
+    hi  = 1.0;
+    *t  = (rHyd - r0) / (r1 - r0);
+    for(k=0; k<50; k++){
+        f   = (2*(*t)-3)*(*t)*(*t)*(r0-r1) + r0 + ((*t)-1)*(*t)*(((*t)-1)*m0 + (*t)*m1) - rHyd;
+        df  = 6*(*t)*((*t)-1)*(r0-r1) + (3*(*t)-1)*((*t)-1)*m0 + (3*(*t)-2)*(*t)*m1;
+
+        //keep the root bracketed by [lo,hi]:
+        if( f*(r1-r0) > 0){
+            hi = *t;
+        }else{
+            lo = *t;
+        }
+        dt = -f/df;
+        if( *t + dt <= lo || *t + dt >= hi){
+            dt = 0.5*(lo + hi) - *t;
+        }
+        *t += dt;
+        if( fabs(dt) < 1.0e-14){
+            break;
+        }
+    }
+    return true;
+}
+
+void    interpolateRay(settings_t* settings, ray_t* ray, uintptr_t i, double rHyd, double* zRay, double* dzdr, double* tauRay, complex double* ampRay, double* qRay){
+    /*
+     * Interpolates the ray's parameters at range rHyd within segment i.
+     * Any output which isn't needed may be NULL.
+     */
+    complex double  junkComplex, a0, a1, aHyd;
+    double          junkDouble, zi, dzdri;
+    double          t, h, t2, t3, h00, h10, h01, h11, drdt, dzdt, ci, ici, qi;
+
+    if( settings->options.denseOutput == false || hermiteRayParameter(ray, i, rHyd, &t, &h) == false){
+        if( zRay != NULL || dzdr != NULL){
+            intLinear1D(        &ray->r[i], &ray->z[i],     rHyd, &zi,      &dzdri);
+            if( zRay != NULL)   *zRay = zi;
+            if( dzdr != NULL)   *dzdr = dzdri;
+        }
+        if( tauRay != NULL){
+            intLinear1D(        &ray->r[i], &ray->tau[i],   rHyd, tauRay,   &junkDouble);
+        }
+        if( ampRay != NULL){
+            intComplexLinear1D( &ray->r[i], &ray->amp[i],   rHyd, ampRay,   &junkComplex);
+        }
+        if( qRay != NULL){
+            intLinear1D(        &ray->r[i], &ray->q[i],     rHyd, qRay,     &junkDouble);
+        }
+        return;
+    }
+
+    //Hermite basis functions (h10 and h11 are multiplied by the segment's length h):
+    t2  = t*t;
+    t3  = t2*t;
+    h00 = 2*t3 - 3*t2 + 1;
+    h01 = 3*t2 - 2*t3;
+    h10 = h*(t3 - 2*t2 + t);
+    h11 = h*(t3 - t2);
+
+    if( zRay != NULL){
+        *zRay = h00*ray->z[i] + h10*ray->es[i].z + h01*ray->z[i+1] + h11*ray->es[i+1].z;
+    }
+    if( dzdr != NULL){
+        drdt = 6*(t2-t)*(ray->r[i]-ray->r[i+1]) + h*(3*t2-4*t+1)*ray->es[i].r + h*(3*t2-2*t)*ray->es[i+1].r;
+        dzdt = 6*(t2-t)*(ray->z[i]-ray->z[i+1]) + h*(3*t2-4*t+1)*ray->es[i].z + h*(3*t2-2*t)*ray->es[i+1].z;
+        *dzdr = dzdt/drdt;
+    }
+    if( tauRay != NULL){
+        *tauRay = h00*ray->tau[i] + h10/ray->c[i] + h01*ray->tau[i+1] + h11/ray->c[i+1];
+    }
+    if( qRay != NULL || ampRay != NULL){
+        qi = h00*ray->q[i] + h10*ray->c[i]*ray->p[i] + h01*ray->q[i+1] + h11*ray->c[i+1]*ray->p[i+1];
+        if( qRay != NULL){
+            *qRay = qi;
+        }
+        if( ampRay != NULL){
+            if( i > 0 && ray->q[i]*ray->q[i+1] > 0 && ray->q[i]*qi > 0){
+                //amplitude as in solveDynamicEq(), scaled by the linearly interpolated remaining factor:
+                ci      = ray->c[i] + t*(ray->c[i+1] - ray->c[i]);
+                ici     = h00*ray->ic[i] + h10*ray->c[i] + h01*ray->ic[i+1] + h11*ray->c[i+1];
+                a0      = csqrt( (complex double)( ray->c[i]   / ( ray->ic[i]   * ray->q[i]   )));
+                a1      = csqrt( (complex double)( ray->c[i+1] / ( ray->ic[i+1] * ray->q[i+1] )));
+                aHyd    = csqrt( (complex double)( ci / ( ici * qi )));
+                *ampRay = aHyd * ( (1-t)*ray->amp[i]/a0 + t*ray->amp[i+1]/a1 );
+            }else{
+                intComplexLinear1D( &ray->r[i], &ray->amp[i], rHyd, ampRay, &junkComplex);
+            }
+        }
+    }
+}
 
-void    getRayParameters(ray_t* ray, uintptr_t iHyd, double q0, double rHyd, double* dzdr, double* tauRay, double* zRay, double complex* ampRay, double* qRay, double* width){
+void    getRayParameters(settings_t* settings, ray_t* ray, uintptr_t iHyd, double q0, double rHyd, double* dzdr, double* tauRay, double* zRay, double complex* ampRay, double* qRay, double* width){
 
-    complex double  junkComplex;
-    double          junkDouble;
     double          theta;
 
     if( ray->iRefl[iHyd+1] == true){
         iHyd = iHyd - 1;
     }
 
-    intLinear1D(        &ray->r[iHyd], &ray->z[iHyd],   rHyd, zRay,     dzdr);
-    intLinear1D(        &ray->r[iHyd], &ray->tau[iHyd], rHyd, tauRay,   &junkDouble);
+    interpolateRay(settings, ray, iHyd, rHyd, zRay, dzdr, tauRay, ampRay, qRay);
     DEBUG(7, "iHyd = %u: ampRay = %e + j*%e\n", (uint32_t)iHyd, creal(ray->amp[iHyd]), cimag(ray->amp[iHyd]));
-    intComplexLinear1D( &ray->r[iHyd], &ray->amp[iHyd], rHyd, ampRay,   &junkComplex);
-    intLinear1D(        &ray->r[iHyd], &ray->q[iHyd],   rHyd, qRay,     &junkDouble);
 
     theta = atan( *dzdr );
     *width = max( fabs( ray->q[iHyd] ), fabs( ray->q[iHyd+1]) );
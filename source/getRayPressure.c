@@ -72,7 +72,7 @@ void    getRayPressure(settings_t* settings, ray_t* ray, uintptr_t iHyd, double
     double          dzdr, tauRay, zRay, qRay, width;
     complex double  ampRay;
     
-    getRayParameters(ray, iHyd, q0, rHyd, &dzdr, &tauRay, &zRay, &ampRay, &qRay, &width);
+    getRayParameters(settings, ray, iHyd, q0, rHyd, &dzdr, &tauRay, &zRay, &ampRay, &qRay, &width);
     DEBUG(5, "iHyd: %u, dzdr: %e; tauRay: %e; zRay: %e; ampRay: %e +j%e; qRay: %e; width %e;\n", (uint32_t)iHyd, dzdr, tauRay, zRay, creal(ampRay), cimag(ampRay), qRay, width);
     getRayPressureExplicit(settings, ray, iHyd, zHyd, tauRay, zRay, dzdr, ampRay, width, pressure);
     DEBUG(4, "out\n");
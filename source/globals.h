@@ -49,7 +49,6 @@
                                             //NOTE: for deepwater cases, values between 3-5 are ok.
                                             //      for shallow water, or other cases with a lot of reflections,
                                             //      values of 15-25 may be adequate
-#define KEEP_RAYS_IN_MEM            0       //[boolean] determines whether a ray's coordinates are kept in memory after being written to the .mat file. (mat become usefull for multiprocessing)
 #define MIN_REFLECTION_COEFFICIENT  1.0e-15 //used in solveEikonalEq(). When a rays reflection coeff is below this threshold, it is killed.
 
 
@@ -149,8 +148,10 @@ typedef struct  ray{
     double          theta;      //launching angle of the ray
     double          rMin, rMax; //used to determine if a ray "turns back"
     bool            iReturn;    //indicates if a ray "turns back"
+    bool            iBackscattered; //indicates if a ray was truncated due to the --killBackscatteredRays switch
     double*         r;          //range of ray at index
     double*         z;          //depth of ray at index
+    vector_t*       es;         //tangent of ray at index (used for '--denseOutput')
     double*         c;          //speed of sound at index
     bool*           iRefl;      //indicates if there is a reflection at a certain index of the ray coordinates.
     uint32_t        sRefl;      //number of surface reflections
@@ -175,6 +176,51 @@ typedef struct  ray{
     complex double* amp;        //ray amplitude
 }ray_t;
 
+typedef struct dynamicPoint{
+    /*
+        Sound speed and its derivatives at a ray coordinate, as needed by the dynamic
+        equations (see dynamicStep()).
+    */
+    double          c;          //sound speed
+    double          sigma;      //slowness
+    vector_t        gradC;      //gradient of the sound speed
+    double          crr;        //second derivatives of the sound speed
+    double          czz;
+    double          crz;
+}dynamicPoint_t;
+
+typedef struct arrival{
+    /*
+     * Used in calcAmpDelPr and calcEigenrayPr to temporarily contain a single arrival (or
+     * eigenray) found by a worker thread, until it is copied to the corresponding matlab
+     * structure in the order of the launching angles.
+     */
+    uintptr_t       iTheta;     //index of the ray's launching angle
+    uintptr_t       iHydR;      //range index of the hydrophone
+    uintptr_t       iHydZ;      //depth index of the hydrophone
+    uintptr_t       nCoords;    //number of ray coordinates (1 for arrivals)
+    double*         r;
+    double*         z;
+    double*         tau;
+    complex double* amp;
+    bool            iReturn;
+    uint32_t        sRefl;
+    uint32_t        bRefl;
+    uint32_t        oRefl;
+    uint32_t        nRefrac;
+    double*         rRefrac;
+    double*         zRefrac;
+}arrival_t;
+
+typedef struct arrivalBuffer{
+    /*
+     * A growing list of arrivals, as filled by a single worker thread.
+     */
+    uintptr_t       nArrivals;
+    uintptr_t       maxArrivals;
+    arrival_t*      arrival;
+}arrivalBuffer_t;
+
 
 
 /********************************************************************************
@@ -192,6 +238,65 @@ typedef struct source{
     double*     thetas;         //the array that will actually contain the launching angles (is allocated in "readin.c")
 }source_t;
 
+typedef struct uniformGrid{
+    /*
+        Describes a lookup table with (nearly) uniformly spaced points, for which
+        bracketUniform() can compute the bracketing index directly (see bracket.c).
+    */
+    bool        isUniform;      //false if the table has to be searched by bracket()
+    double      x0;             //first point of the table
+    double      invDx;          //inverse of the mean spacing
+}uniformGrid_t;
+
+typedef struct lookupCursor{
+    /*
+        The intervals of the environment's lookup tables found by the previous lookups
+        along a ray, from which the next lookups start searching (see bracketHunt()).
+        Each ray being traced uses its own cursor, so this is thread safe.
+    */
+    uintptr_t   iSSPr;          //interval of soundSpeed.r
+    uintptr_t   iSSPz;          //interval of soundSpeed.z
+    uintptr_t   iAltimetry;     //interval of altimetry.r
+    uintptr_t   iBatimetry;     //interval of batimetry.r
+    uintptr_t*  iObject;        //interval of objects.object[j].r, for each object
+    uintptr_t   iObjectCell;    //interval of objects.cellR
+}lookupCursor_t;
+
+typedef struct reflectionTable{
+    /*
+        Reflection coefficient of a homogeneous elastic boundary, tabulated over the horizontal
+        slowness sin(theta)/c of the incident ray (see initReflectionTables()).
+    */
+    uint32_t            n;              //number of points; 0 => no table
+    double              invDs;          //inverse of the spacing of the horizontal slowness
+    double              freq;           //frequency for which the table was computed
+    double              maxError;       //estimated maximum interpolation error of the reflection coefficient
+    complex double*     g;              //see boundaryReflectionG()
+}reflectionTable_t;
+
+typedef struct boundarySegment{
+    /*
+        Depth of an interface within the interval [r[i], r[i+1]] of its coordinates,
+        z(r) = c[0] + c[1]*t + c[2]*t^2 + c[3]*t^3 with t = r - r[i] (see initBoundarySegments()).
+    */
+    double      c[4];           //polynomial coefficients
+    double      a[3];           //barycentric weights of the 4P stencil (see intBarycCubic1DCoeffs())
+    double      zMin;           //minimum depth within the interval
+    double      zMax;           //maximum depth within the interval
+}boundarySegment_t;
+
+typedef struct boundaryProperties{
+    /*
+        Properties of a non-homogeneous interface at one of its coordinates, interleaved so
+        that a single lookup returns all of them (see initBoundaryProperties()).
+    */
+    double      rho;            //density
+    double      cp;             //compressional speed
+    double      cs;             //shear speed
+    double      ap;             //compressional attenuation, converted to dB/lambda at 1 Hz
+    double      as;             //shear attenuation, converted to dB/lambda at 1 Hz
+}boundaryProperties_t;
+
 typedef struct interface{
     /*
         Used for both the "batimetry" as well as "altimetry" block
@@ -209,6 +314,10 @@ typedef struct interface{
     uint32_t                surfaceInterpolation;   //formerly "aitype"
     uint32_t                surfaceAttenUnits;      //formerly "atiu"
     uint32_t                numSurfaceCoords;       //formerly "nati"
+    uniformGrid_t           rUniform;               //spacing of r (see initUniformGrid())
+    boundarySegment_t*      segments;               //depth of each interval of r, or NULL (see initBoundarySegments())
+    boundaryProperties_t*   properties;             //interleaved rho, cp, cs, ap, as, or NULL (see initBoundaryProperties())
+    reflectionTable_t       reflTable;              //see '--reflectionTable'
 }interface_t;
 
 //possible values for surfaceType (see page 38, Traceo manual):
@@ -243,7 +352,14 @@ typedef struct soundSpeed{
     double*     z;              //"z0", depth
     double*     r;              //"r0", range
     double*     c1D;            //"c0", sound speed at (z0)
+    double*     c1DCoeffs;      //interpolation coefficients of a tabulated c1D (see initCValues1D())
     double**    c2D;            //"c02d", sound speed at (r0,z0)
+    double*     c2DCoeffs;      //interpolation coefficients of c2D (see initCValues2D())
+    uniformGrid_t rUniform;     //spacing of r (see initUniformGrid())
+    uniformGrid_t zUniform;     //spacing of z (see initUniformGrid())
+    //evaluates c and its derivatives for cDist and cClass (see initCsValues()):
+    void        (*cValues)(const struct soundSpeed*, lookupCursor_t*, double, double,
+                           double*, double*, double*, double*, double*, double*);
 }soundSpeed_t;
 
 //possible values for cDistribuition (see page 39, Traceo Manual)
@@ -276,6 +392,7 @@ typedef struct object{
     double*                 r;                      //"ro"      |
     double*                 zDown;                  //"zdn"      >  actual coordinates that define the object geometry
     double*                 zUp;                    //"zup"     |
+    reflectionTable_t       reflTable;              //see '--reflectionTable'
 }object_t;
 
 typedef struct objects{
@@ -285,6 +402,10 @@ typedef struct objects{
     uint32_t    numObjects;             //"nobj"
     uint32_t    surfaceInterpolation;   //"oitype", Object interpolation type
     object_t*   object;
+    uint32_t    nCells;                 //number of range intervals of the object index (see initObjectIndex())
+    double*     cellR;                  //ranges at which objects begin or end, [nCells+1]
+    uint32_t*   cellStart;              //first entry of each cell in cellObjects, [nCells+1]
+    uint32_t*   cellObjects;            //indices of the objects covering each cell
 }objects_t;
 
 typedef struct output{
@@ -337,6 +458,22 @@ typedef struct options{
     bool            saveSSP;                //command line switch
     uintptr_t       nSSPPoints;             //number of points with which to generate the ssp
     char*           sspFileName;            //File in which to store the generated ssp
+    uint32_t        nThreads;               //number of worker threads used for tracing rays (see '--threads')
+    double          rkTolerance;            //tolerance of the adaptive Runge-Kutta integration; 0 => fixed ray step (see '--rkTolerance')
+    double          rkMaxStep;              //maximum step of the adaptive Runge-Kutta integration; 0 => ray step (see '--rkMaxStep')
+    bool            arcStep;                //command line switch (see '--arcStep')
+    bool            denseOutput;            //command line switch (see '--denseOutput')
+    uint32_t        reflectionTable;        //number of points of the reflection coefficient tables; 0 => no tables (see '--reflectionTable')
+    bool            writeShard;             //command line switch (see '--shard')
+    uint32_t        shardIndex;             //index of the slice of launching angles to be traced [0, nShards-1]
+    uint32_t        nShards;                //number of slices the launching angles are divided into
+    char*           nx2dFileName;           //grid file for tracing multiple bearings (see '--nx2d')
+    char*           ensembleFileName;       //file containing the sound speeds of an ensemble (see '--ensemble')
+    char*           broadbandFileName;      //file containing the frequencies of a broadband run (see '--broadband')
+    char*           sourcesFileName;        //file containing the positions of multiple sources (see '--sources')
+    char*           batchFileName;          //manifest listing the cases of a batch run (see '--batch')
+    uint32_t        nJobs;                  //number of cases of a batch run which are run concurrently (see '--jobs')
+    bool            runWorker;              //command line switch (see '--worker')
 }options_t;
 
 typedef struct settings{
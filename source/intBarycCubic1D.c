@@ -50,9 +50,22 @@
 #include <inttypes.h>
 
 void intBarycCubic1D(double*, double*, double, double*, double*, double*);
+void intBarycCubic1DCoeffs(double*, double*, double*);
+void intBarycCubic1DEval(double*, double, const double*, double, double*, double*, double*);
 
 void intBarycCubic1D(double* x, double* f, double xi, double* fi, double* fxi, double* fxxi){
-    double      a[3],px[3],sx[3],qx[3];
+    double      a[3];
+    
+    intBarycCubic1DCoeffs(x, f, a);
+    intBarycCubic1DEval(x, f[0], a, xi, fi, fxi, fxxi);
+}
+
+void intBarycCubic1DCoeffs(double* x, double* f, double* a){
+    /*
+     * Computes the 3 barycentric weights of a 4-point stencil, which do not depend on
+     * the interpolation point (see initCValues1D()).
+     */
+    double      px[3];
     uintptr_t   i;
     
     px[0] = ( x[1] - x[0] )*( x[1] - x[2] )*( x[1] - x[3] );
@@ -62,6 +75,15 @@ void intBarycCubic1D(double* x, double* f, double xi, double* fi, double* fxi, d
     for(i=0; i<=2; i++){
         a[i] = ( f[i+1] - f[0] )/px[i];
     }
+}
+
+void intBarycCubic1DEval(double* x, double f0, const double* a, double xi, double* fi, double* fxi, double* fxxi){
+    /*
+     * Evaluates the interpolant and its derivatives at xi, given f0 = f[0] and the
+     * weights computed by intBarycCubic1DCoeffs().
+     */
+    double      px[3],sx[3],qx[3];
+    uintptr_t   i;
     
     px[0] = ( xi - x[0] )*( xi - x[2] )*( xi - x[3] );
     px[1] = ( xi - x[0] )*( xi - x[1] )*( xi - x[3] );
@@ -75,7 +97,7 @@ void intBarycCubic1D(double* x, double* f, double xi, double* fi, double* fxi, d
     qx[1] = 2*( 3*xi -x[0] -x[1] -x[3] );
     qx[2] = 2*( 3*xi -x[0] -x[1] -x[2] );
     
-    *fi   = f[0];
+    *fi   = f0;
     *fxi  = 0.0;
     *fxxi = 0.0;
     
@@ -55,18 +55,28 @@
 #include "tools.h"
 
 void intBarycParab2D(double*, double*, double**, double, double, double*, double*, double*, double*, double*, double*);
+void intBarycParab2DCoeffs(double*, double*, double**, double*);
+void intBarycParab2DEval(double*, double*, const double*, double, double, double*, double*, double*, double*, double*, double*);
 
 void intBarycParab2D(double* x, double* y, double** f, double xi, double yi, double* fi, double* fxi, double* fyi, double* fxxi, double* fyyi, double* fxyi){
     DEBUG(8, "in\n");
+    double      a[9];
 
+    intBarycParab2DCoeffs(x, y, f, a);
+    intBarycParab2DEval(x, y, a, xi, yi, fi, fxi, fyi, fxxi, fyyi, fxyi);
+    DEBUG(8, "out\n");
+}
+
+void intBarycParab2DCoeffs(double* x, double* y, double** f, double* a){
+    /*
+     * Computes the 9 barycentric weights a[3*i+j] = f[i][j]/(px[j]*py[i]) of a 3x3 stencil.
+     * These only depend on the stencil, so they may be computed once and reused for any
+     * interpolation point (see initCValues2D()).
+     */
     double      px[3];
     double      py[3];
-    double      sx[3];
-    double      sy[3];
-    double      a[3][3];
     uintptr_t   i, j;
 
-    
     px[0] = ( x[0] - x[1] )*( x[0] - x[2] );
     DEBUG(10,"px[0]\t= ( x[0] - x[1] )*( x[0] - x[2] )\n");
     DEBUG(10,"%lf\t= ( %lf - %lf )*( %lf - %lf )\n", px[0], x[0], x[1], x[0], x[2] );
@@ -79,10 +89,22 @@ void intBarycParab2D(double* x, double* y, double** f, double xi, double yi, dou
     
     for(i=0; i<3; i++){
         for(j=0; j<3; j++){
-            a[i][j] = f[i][j] / ( px[j] * py[i] );
-            DEBUG(10, "i,j: %u,%u => a= %e = {f[i][j] = %lf} / ( {px[j] = %lf} * {py[i] = %lf}\n", (uint32_t)i, (uint32_t)j, a[i][j], f[i][j], px[j], py[i]);
+            a[3*i+j] = f[i][j] / ( px[j] * py[i] );
+            DEBUG(10, "i,j: %u,%u => a= %e = {f[i][j] = %lf} / ( {px[j] = %lf} * {py[i] = %lf}\n", (uint32_t)i, (uint32_t)j, a[3*i+j], f[i][j], px[j], py[i]);
         }
     }
+}
+
+void intBarycParab2DEval(double* x, double* y, const double* a, double xi, double yi, double* fi, double* fxi, double* fyi, double* fxxi, double* fyyi, double* fxyi){
+    /*
+     * Evaluates the interpolant and its derivatives at (xi, yi), given the weights
+     * computed by intBarycParab2DCoeffs().
+     */
+    double      px[3];
+    double      py[3];
+    double      sx[3];
+    double      sy[3];
+    uintptr_t   i, j;
 
     px[0] = ( xi - x[1] )*( xi - x[2] );
     px[1] = ( xi - x[0] )*( xi - x[2] );
@@ -109,14 +131,12 @@ void intBarycParab2D(double* x, double* y, double** f, double xi, double yi, dou
 
     for(i=0; i<3; i++){
         for(j=0; j<3; j++){
-            *fi     += a[i][j] * px[j] * py[i];
-            *fxi    += a[i][j] * sx[j] * py[i];
-            *fyi    += a[i][j] * px[j] * sy[i];
-            *fxxi   += a[i][j] * 2 * py[i];
-            *fyyi   += a[i][j] * 2 * px[j];
-            *fxyi   += a[i][j] * sx[j] * sy[i];
+            *fi     += a[3*i+j] * px[j] * py[i];
+            *fxi    += a[3*i+j] * sx[j] * py[i];
+            *fyi    += a[3*i+j] * px[j] * sy[i];
+            *fxxi   += a[3*i+j] * 2 * py[i];
+            *fyyi   += a[3*i+j] * 2 * px[j];
+            *fxyi   += a[3*i+j] * sx[j] * sy[i];
         }
     }
-
-    DEBUG(8, "out\n");
 }
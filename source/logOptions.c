@@ -61,6 +61,49 @@ void logOptions(settings_t* settings){
         LOG("Option '--outputFileName' enabled; writing results to %s\n", settings->options.outputFileName);
     }
     
+    if(settings->options.nThreads > 1){
+        LOG("Option '--threads' enabled; tracing rays on %u threads.\n", settings->options.nThreads);
+    }
+    
+    if(settings->options.rkTolerance > 0){
+        LOG("Option '--rkTolerance' enabled; adaptive ray step with a tolerance of %g and a maximum step of %g m.\n",
+            settings->options.rkTolerance, (settings->options.rkMaxStep > 0) ? settings->options.rkMaxStep : settings->source.ds);
+    }
+    
+    if(settings->options.arcStep == true){
+        LOG("Option '--arcStep' enabled; stepping rays in closed form where the sound speed is linear.\n");
+    }
+    
+    if(settings->options.denseOutput == true){
+        LOG("Option '--denseOutput' enabled; interpolating rays with Hermite polynomials.\n");
+    }
+    
+    if(settings->options.reflectionTable > 0){
+        LOG("Option '--reflectionTable' enabled; interpolating reflection coefficients from tables of %u entries.\n",
+            settings->options.reflectionTable);
+    }
+    
+    if(settings->options.writeShard == true){
+        LOG("Option '--shard' enabled; tracing shard %u of %u and writing partial results to %s\n",
+            settings->options.shardIndex + 1, settings->options.nShards, settings->options.outputFileName);
+    }
+    
+    if(settings->options.nx2dFileName != NULL){
+        LOG("Option '--nx2d' enabled; tracing the bearings of grid file %s\n", settings->options.nx2dFileName);
+    }
+    
+    if(settings->options.ensembleFileName != NULL){
+        LOG("Option '--ensemble' enabled; running the sound speed ensemble of file %s\n", settings->options.ensembleFileName);
+    }
+    
+    if(settings->options.broadbandFileName != NULL){
+        LOG("Option '--broadband' enabled; calculating at the frequencies of file %s\n", settings->options.broadbandFileName);
+    }
+    
+    if(settings->options.sourcesFileName != NULL){
+        LOG("Option '--sources' enabled; running the sources of file %s\n", settings->options.sourcesFileName);
+    }
+    
     //write the chosen output option to the log file:
     switch(settings->output.calcType){
         case CALC_TYPE__RAY_COORDS:
@@ -0,0 +1,153 @@
+/****************************************************************************************
+ * objectIndex.c                                                                        *
+ * Index of the objects by range, so that each integration step only needs to test the  *
+ * objects whose range contains the ray.                                                *
+ *                                                                                      *
+ * ------------------------------------------------------------------------------------ *
+ * Website:                                                                             *
+ *          https://github.com/EyNuel/cTraceo/wiki                                      *
+ *                                                                                      *
+ * License: This file is part of the cTraceo Raytracing Model and is released under the *
+ *          Creative Commons Attribution-NonCommercial-ShareAlike 3.0 Unported License  *
+ *          http://creativecommons.org/licenses/by-nc-sa/3.0/                           *
+ *                                                                                      *
+ * NOTE:    cTraceo is research code under active development.                          *
+ *          The code may contain bugs and updates are possible in the future.           *
+ *                                                                                      *
+ * Written for project SENSOCEAN by:                                                    *
+ *          Emanuel Ey                                                                  *
+ *          emanuel.ey@gmail.com                                                        *
+ *          Copyright (C) 2011 - 2013                                                   *
+ *          Signal Processing Laboratory                                                *
+ *          Universidade do Algarve                                                     *
+ *                                                                                      *
+ * ------------------------------------------------------------------------------------ *
+ * The ranges at which objects begin and end divide the range axis into intervals       *
+ * ("cells"), each covered completely by a (possibly empty) set of objects. The objects *
+ * of each cell are stored in ascending order, so that nextObject() visits the objects  *
+ * containing a given range in the same order as a loop over all objects would.         *
+ *                                                                                      *
+ ****************************************************************************************/
+
+#pragma     once
+#include    <stdlib.h>
+#include    <stdbool.h>
+#include    "globals.h"
+#include    "tools.h"
+
+int     compareDouble(const void*, const void*);
+uint32_t firstObjectCell(objects_t*, uint32_t);
+void    initObjectIndex(objects_t*);
+bool    nextObject(objects_t*, uintptr_t*, double, uint32_t*);
+
+int     compareDouble(const void* a, const void* b){
+    double  x = *(const double*)a;
+    double  y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+uint32_t firstObjectCell(objects_t* objects, uint32_t j){
+    /*
+     * Returns the cell which begins at object j's first range.
+     */
+    uintptr_t   c = objects->nCells;
+
+    bracket(objects->nCells + 1, objects->cellR, objects->object[j].r[0], &c);
+    if(c < objects->nCells && objects->cellR[c] != objects->object[j].r[0]){
+        //only for the last range, which begins no cell:
+        c = objects->nCells;
+    }
+    return (uint32_t)c;
+}
+
+void    initObjectIndex(objects_t* objects){
+    /*
+     * Builds the index of the objects (see header). Must be called after the objects'
+     * coordinates have been read.
+     */
+    DEBUG(3,"in\n");
+    uint32_t    n = objects->numObjects;
+    uint32_t    i, j, c, nR;
+
+    objects->nCells      = 0;
+    objects->cellR       = NULL;
+    objects->cellStart   = NULL;
+    objects->cellObjects = NULL;
+    if(n == 0){
+        return;
+    }
+
+    //sorted, unique ranges at which the objects begin and end:
+    objects->cellR = mallocDouble(2*n);
+    for(j=0; j<n; j++){
+        objects->cellR[2*j]   = objects->object[j].r[0];
+        objects->cellR[2*j+1] = objects->object[j].r[objects->object[j].nCoords-1];
+    }
+    qsort(objects->cellR, 2*n, sizeof(double), compareDouble);
+    nR = 1;
+    for(i=1; i<2*n; i++){
+        if(objects->cellR[i] != objects->cellR[nR-1]){
+            objects->cellR[nR++] = objects->cellR[i];
+        }
+    }
+    if(nR < 2){
+        //all objects are empty, i.e., no range is inside any of them:
+        return;
+    }
+    objects->nCells = nR - 1;
+
+    //count the objects covering each cell, then store them in ascending order:
+    objects->cellStart = malloc((objects->nCells + 1) * sizeof(uint32_t));
+    if(objects->cellStart == NULL){
+        fatal("Memory alocation error.");
+    }
+    for(c=0; c<=objects->nCells; c++){
+        objects->cellStart[c] = 0;
+    }
+    for(j=0; j<n; j++){
+        for(c=firstObjectCell(objects, j); c<objects->nCells && objects->cellR[c+1] <= objects->object[j].r[objects->object[j].nCoords-1]; c++){
+            objects->cellStart[c+1]++;
+        }
+    }
+    for(c=0; c<objects->nCells; c++){
+        objects->cellStart[c+1] += objects->cellStart[c];
+    }
+    objects->cellObjects = malloc(max(objects->cellStart[objects->nCells], 1) * sizeof(uint32_t));
+    if(objects->cellObjects == NULL){
+        fatal("Memory alocation error.");
+    }
+    for(j=0; j<n; j++){
+        for(c=firstObjectCell(objects, j); c<objects->nCells && objects->cellR[c+1] <= objects->object[j].r[objects->object[j].nCoords-1]; c++){
+            objects->cellObjects[objects->cellStart[c]++] = j;
+        }
+    }
+    //cellStart[c] now points to the end of cell c, restore it:
+    for(c=objects->nCells; c>0; c--){
+        objects->cellStart[c] = objects->cellStart[c-1];
+    }
+    objects->cellStart[0] = 0;
+    DEBUG(3, "%u objects indexed in %u cells.\n", n, objects->nCells);
+    DEBUG(3,"out\n");
+}
+
+bool    nextObject(objects_t* objects, uintptr_t* cursor, double ri, uint32_t* j){
+    /*
+     * Finds the first object with index >= *j whose range may contain ri.
+     * Returns false if there is none; otherwise *j is set to its index.
+     * The objects still have to verify that ri lies inside their range, as the
+     * last cell's end is included.
+     */
+    uintptr_t   c;
+    uint32_t    k;
+
+    if(objects->nCells == 0 || bracketHunt(objects->nCells + 1, objects->cellR, NULL, ri, cursor, &c) == 0){
+        return false;
+    }
+    for(k=objects->cellStart[c]; k<objects->cellStart[c+1]; k++){
+        if(objects->cellObjects[k] >= *j){
+            *j = objects->cellObjects[k];
+            return true;
+        }
+    }
+    return false;
+}
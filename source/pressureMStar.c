@@ -101,7 +101,7 @@ uintptr_t   pressureMStar( settings_t* settings, ray_t* ray, double rHyd, double
         DEBUG(8,"nRet: %u\n", (uint32_t)nRet);
         // NOTE:    this block will not be run if the index returned by bracket() is out of bounds.
         for(jj=0; jj<nRet; jj++){
-            getRayParameters(ray, iRet[jj], q0, rLeft, &dzdr, &tauRay, &zRay, &ampRay, &qRay, &width);
+            getRayParameters(settings, ray, iRet[jj], q0, rLeft, &dzdr, &tauRay, &zRay, &ampRay, &qRay, &width);
             DEBUG(8, "dzdr: %e, tauRay: %e, zRay: %e, ampRay: %e, qRay: %e, w: %e\n", dzdr, tauRay, zRay, cabs(ampRay), qRay, width);
             getRayPressureExplicit(settings, ray, iRet[jj], zHyd, tauRay, zRay, dzdr, ampRay, width, &tempPressure[LEFT]);
             pressure_H[LEFT] += tempPressure[LEFT];
@@ -119,7 +119,7 @@ uintptr_t   pressureMStar( settings_t* settings, ray_t* ray, double rHyd, double
         eBracket(ray->nCoords, ray->r, rHyd, &nRet, iRet);
         DEBUG(8,"nRet: %u\n", (uint32_t)nRet);
         for(jj=0; jj<nRet; jj++){
-            getRayParameters(ray, iRet[jj], q0, rHyd, &dzdr, &tauRay, &zRay, &ampRay, &qRay, &width);
+            getRayParameters(settings, ray, iRet[jj], q0, rHyd, &dzdr, &tauRay, &zRay, &ampRay, &qRay, &width);
             DEBUG(1, "dzdr: %e, tau: %e, amp: %e\n", dzdr, tauRay, ampRay);
             getRayPressureExplicit(settings, ray, iRet[jj], zTop, tauRay, zRay, dzdr, ampRay, width, &tempPressure[TOP]);
             getRayPressureExplicit(settings, ray, iRet[jj], zHyd, tauRay, zRay, dzdr, ampRay, width, &tempPressure[CENTER]);
@@ -142,7 +142,7 @@ uintptr_t   pressureMStar( settings_t* settings, ray_t* ray, double rHyd, double
     eBracket(ray->nCoords, ray->r, rRight, &nRet, iRet);
     DEBUG(8,"nRet: %u\n", (uint32_t)nRet);
         for(jj=0; jj<nRet; jj++){
-            getRayParameters(ray, iRet[jj], q0, rRight, &dzdr, &tauRay, &zRay, &ampRay, &qRay, &width);
+            getRayParameters(settings, ray, iRet[jj], q0, rRight, &dzdr, &tauRay, &zRay, &ampRay, &qRay, &width);
             getRayPressureExplicit(settings, ray, iRet[jj], zHyd, tauRay, zRay, dzdr, ampRay, width, &tempPressure[RIGHT]);
             pressure_H[RIGHT]   += tempPressure[RIGHT];
         }
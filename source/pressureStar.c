@@ -35,6 +35,8 @@
  * Inputs:                                                                              *
  *          settings:   Pointer to structure containing all input info.                 *
  *          ray:        Pointer the the ray, who's influence we are determining.        *
+ *          cursor:     Interval of ray->r found by the previous call for the same      *
+ *                      (non-returning) ray; updated (see bracketHunt()).               *
  *          rHyd:       Range coordinate of the hydrophone.                             *
  *          zHyd:       Depth coordinate of the hydrophone.                             *
  *          q0:         Value of q at beginning of ray.                                 *
@@ -61,9 +63,9 @@
 #include <complex.h>
 #include "bracket.c"
 
-uintptr_t   pressureStar(settings_t*, ray_t*, double, double, double, complex double*, complex double[]);
+uintptr_t   pressureStar(settings_t*, ray_t*, uintptr_t*, double, double, double, complex double*, complex double[]);
 
-uintptr_t   pressureStar( settings_t* settings, ray_t* ray, double rHyd, double zHyd, double q0, complex double* pressure_H, complex double* pressure_V){
+uintptr_t   pressureStar( settings_t* settings, ray_t* ray, uintptr_t* cursor, double rHyd, double zHyd, double q0, complex double* pressure_H, complex double* pressure_V){
 
     double          rLeft, rRight, zTop, zBottom;
     uintptr_t       iHyd;
@@ -89,11 +91,11 @@ uintptr_t   pressureStar( settings_t* settings, ray_t* ray, double rHyd, double
     
     
     //find out at what index of the ray coordinates the hydrophone is located:
-    if( bracket(ray->nCoords, ray->r, rLeft, &iHyd) ){
+    if( bracketHunt(ray->nCoords, ray->r, NULL, rLeft, cursor, &iHyd) ){
         // NOTE:    this block will not be run if the index returned by bracket() is out of bounds.
         DEBUG(8, "iHyd: %u => iRefl: %u\n", (uint32_t)iHyd, (uint32_t)ray->iRefl[iHyd]);
         if ( iHyd<ray->nCoords-1 ){
-            getRayParameters(ray, iHyd, q0, rLeft, &dzdr, &tauRay, &zRay, &ampRay, &qRay, &width);
+            getRayParameters(settings, ray, iHyd, q0, rLeft, &dzdr, &tauRay, &zRay, &ampRay, &qRay, &width);
             DEBUG(8, "dzdr: %e, tauRay: %e, zRay: %e, ampRay: %e, qRay: %e, w: %e\n", dzdr, tauRay, zRay, cabs(ampRay), qRay, width);
             getRayPressureExplicit(settings, ray, iHyd, zHyd, tauRay, zRay, dzdr, ampRay, width, &pressure_H[LEFT]);
         }
@@ -104,14 +106,14 @@ uintptr_t   pressureStar( settings_t* settings, ray_t* ray, double rHyd, double
     
     
     
-    if( bracket(ray->nCoords, ray->r, rHyd, &iHyd)){
+    if( bracketHunt(ray->nCoords, ray->r, NULL, rHyd, cursor, &iHyd)){
         /* NOTE:    this block will not be run if the index returned by
          *          bracket() is out of bounds.
          */
          
         DEBUG(8, "iHyd: %u => iRefl: %u\n", (uint32_t)iHyd, (uint32_t)ray->iRefl[iHyd]);
         if ( iHyd<ray->nCoords-1 ){
-            getRayParameters(ray, iHyd, q0, rHyd, &dzdr, &tauRay, &zRay, &ampRay, &qRay, &width);
+            getRayParameters(settings, ray, iHyd, q0, rHyd, &dzdr, &tauRay, &zRay, &ampRay, &qRay, &width);
             DEBUG(8, "dzdr: %e, tauRay: %e, zRay: %e, ampRay: %e, qRay: %e, w: %e\n", dzdr, tauRay, zRay, cabs(ampRay), qRay, width);
             getRayPressureExplicit(settings, ray, iHyd, zTop,   tauRay, zRay, dzdr, ampRay, width, &pressure_V[TOP]);
             getRayPressureExplicit(settings, ray, iHyd, zHyd,   tauRay, zRay, dzdr, ampRay, width, &pressure_V[CENTER]);
@@ -125,7 +127,7 @@ uintptr_t   pressureStar( settings_t* settings, ray_t* ray, double rHyd, double
     
     
     
-    if( bracket(ray->nCoords, ray->r, rRight, &iHyd)){
+    if( bracketHunt(ray->nCoords, ray->r, NULL, rRight, cursor, &iHyd)){
         /* NOTE:    this block will not be run if the index returned by
          *          bracket() is out of bounds.
          */
@@ -133,7 +135,7 @@ uintptr_t   pressureStar( settings_t* settings, ray_t* ray, double rHyd, double
         DEBUG(8, "iHyd: %u => iRefl: %u\n", (uint32_t)iHyd, (uint32_t)ray->iRefl[iHyd]);
         if ( iHyd<ray->nCoords-1 ){
             //DEBUG(3, "r: %lf, z: %lf, amp:%lf, iHyd: %u\n", ray->r[iHyd], ray->z[iHyd], cabs(ray->amp[iHyd]), (uint32_t)iHyd);
-            getRayParameters(ray, iHyd, q0, rRight, &dzdr, &tauRay, &zRay, &ampRay, &qRay, &width);
+            getRayParameters(settings, ray, iHyd, q0, rRight, &dzdr, &tauRay, &zRay, &ampRay, &qRay, &width);
             DEBUG(8, "dzdr: %e, tauRay: %e, zRay: %e, ampRay: %e, qRay: %e, w: %e\n", dzdr, tauRay, zRay, cabs(ampRay), qRay, width);
             getRayPressureExplicit(settings, ray, iHyd, zHyd,   tauRay, zRay, dzdr, ampRay, width, &pressure_H[RIGHT]);
         }
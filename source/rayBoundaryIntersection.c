@@ -32,12 +32,21 @@
  *          Signal Processing Laboratory                                                *
  *                                                                                      *
  * ------------------------------------------------------------------------------------ *
+ * For piecewise linear (2P) and cubic (4P) boundaries, the intersection is found one   *
+ * boundary interval at a time, in the direction of the ray: within an interval, the   *
+ * depth difference between the ray's step and the boundary is a polynomial of at most  *
+ * the 3rd degree, which is split at its extrema into monotonic pieces. The first piece *
+ * which changes sign contains the intersection, which is then found by Newton's method *
+ * (safeguarded by bisection).                                                          *
+ *                                                                                      *
+ * ------------------------------------------------------------------------------------ *
  * Inputs:                                                                              *
  *          interface:  A pointer of type interface_t, containing the                   *
  *                      parameters of the interface.                                    *
  *          a:          Coords (r, z) of 1st point.                                     *
  *          b:          Coords (r, z) of 2nd point (on the opposite side of the         *
  *                      boundary)                                                       *
+ *          cursor:     Lookup cursor of interface->r (see boundaryInterpolation()).    *
  *                                                                                      *
  * Outputs:                                                                             *
  *          isect:      Coords (r, z) of intesection point.                             *
@@ -51,15 +60,19 @@
 #include "globals.h"
 #include "tools.h"
 #include "lineLineIntersec.c"
-#include "linearSpaced.c"
+#include "boundaryInterpolation.c"
 
 #define     DOWN    -1
 #define     UP      1
+#define     BOUNDARY_ISECT_TOLERANCE    1.0e-9  //[m], convergence tolerance of the intersection's range
+#define     BOUNDARY_ISECT_MAX_ITER     50      //maximum number of iterations of Newton's method
 
-void    rayObjectIntersection(objects_t*, uint32_t*, int32_t, point_t*, point_t*, point_t*);
-void    rayBoundaryIntersection(interface_t*, point_t*, point_t*, point_t*);
+void    rayObjectIntersection(objects_t*, uintptr_t*, uint32_t*, int32_t, point_t*, point_t*, point_t*);
+void    rayBoundaryIntersection(interface_t*, uintptr_t*, point_t*, point_t*, point_t*);
+double  evalCubic(double*, double, double*);
+bool    cubicFirstRoot(double*, double, double, double*);
 
-void    rayObjectIntersection(objects_t* objects, uint32_t* j, int32_t boundary, point_t* a, point_t* b, point_t* isect){
+void    rayObjectIntersection(objects_t* objects, uintptr_t* cursor, uint32_t* j, int32_t boundary, point_t* a, point_t* b, point_t* isect){
     /*
      * maps an object to rayBoundaryIntersection()
      */
@@ -80,17 +93,20 @@ void    rayObjectIntersection(objects_t* objects, uint32_t* j, int32_t boundary,
             break;
     }
     tempInterface.surfaceInterpolation  = objects->surfaceInterpolation;
-    rayBoundaryIntersection(&tempInterface, a, b, isect);
+    tempInterface.rUniform.isUniform    = false;
+    tempInterface.segments              = NULL;
+    rayBoundaryIntersection(&tempInterface, cursor, a, b, isect);
     DEBUG(4, "out\n");
 }
     
 
-void    rayBoundaryIntersection(interface_t* interface, point_t* a, point_t* b, point_t* isect){
+void    rayBoundaryIntersection(interface_t* interface, uintptr_t* cursor, point_t* a, point_t* b, point_t* isect){
     DEBUG(4,"in\n");
-    uint32_t    i,n;
-    double      rl[101];
-    double      zl[101];
-    double      dz[101];
+    uint32_t    i;
+    uintptr_t   n, iSeg;
+    double*     r;
+    double      dz[4];
+    double      slope, r0, r1, t, rIsect;
     point_t     q1;
     point_t     q2;
     vector_t    taub;
@@ -112,36 +128,156 @@ void    rayBoundaryIntersection(interface_t* interface, point_t* a, point_t* b,
             
         default:
             DEBUG(7,"Neither a flat nor sloped boundary.\n");
-            n = 101;
-            linearSpaced(n, a->r, b->r, rl);
-            linearSpaced(n, a->z, b->z, zl);
+            if (b->r == a->r){
+                //vertical step:
+                boundaryInterpolation(interface, cursor, a->r, &isect->z, &taub, &normal);
+                isect->r = a->r;
+                break;
+            }
+            n       = interface->numSurfaceCoords;
+            r       = interface->r;
+            slope   = (b->z - a->z) / (b->r - a->r);
             
-//TODO: tremendous potential for optimization here. A "paralel for" might do wonders
-            //get first dz
-            boundaryInterpolation(interface, rl[0], &isect->z, &taub, &normal);
-            dz[0] = zl[0] - isect->z;
-            for(i=1; i<n; i++){
-                //ri = rl[i];
-                //bdryi(nr,tabr,tabz,itype,ri,zi,taub,normal)
-                boundaryInterpolation(interface, rl[i], &isect->z, &taub, &normal);
-                dz[i] = zl[i] - isect->z;
-                DEBUG(7,"dz0: %lf, dz[%u]: %lf | rl[%u]: %lf, rz[%u]: %lf\n", dz[0], i, dz[i], i, rl[i], i, zl[i]);
-                if( (dz[0] * dz[i]) <= 0){
-                    //intersection point has been found, exit for-loop.
-                    DEBUG(7,"Intersection point found at (%lf, %lf)\n", isect->r, isect->z);
+            //interval containing the first point (the first and last intervals are extrapolated):
+            iSeg = boundarySegmentIndex(interface, cursor, a->r);
+            
+            //walk along the intervals crossed by the step, until the intersection is found.
+            //After a reflection the step starts on the boundary, so roots at its first point are
+            //skipped; otherwise a ray grazing along the boundary (or reflected at a corner) would
+            //stall there:
+            rIsect  = b->r;
+            r0      = a->r + copysign(BOUNDARY_ISECT_TOLERANCE, b->r - a->r);
+            while(true){
+                //ray depth minus boundary depth, as a polynomial of t = r - r[iSeg]:
+                boundaryPolynomial(interface, iSeg, dz);
+                dz[0] = a->z + slope * (r[iSeg] - a->r) - dz[0];
+                dz[1] = slope - dz[1];
+                dz[2] = -dz[2];
+                dz[3] = -dz[3];
+                
+                if (b->r > a->r){
+                    r1 = (iSeg == n-2) ? b->r : min(b->r, r[iSeg+1]);
+                }else{
+                    r1 = (iSeg == 0)   ? b->r : max(b->r, r[iSeg]);
+                }
+                if ((r1 - r0) * (b->r - a->r) > 0 && cubicFirstRoot(dz, r0 - r[iSeg], r1 - r[iSeg], &t)){
+                    rIsect = r[iSeg] + t;
                     break;
                 }
+                if (r1 == b->r){
+                    //the step only touches the boundary at its first point (or grazes it), so end it at b:
+                    DEBUG(5, "No intersection found between (%lf, %lf) and (%lf, %lf)\n", a->r, a->z, b->r, b->z);
+                    break;
+                }
+                //the next interval starts at r1, unless the skipped first point reaches into it:
+                if ((r1 - r0) * (b->r - a->r) > 0){
+                    r0 = r1;
+                }
+                if (b->r > a->r){
+                    iSeg++;
+                }else{
+                    iSeg--;
+                }
             }
-            DEBUG(7,"Intersection point found at (%lf, %lf)\n", isect->r, isect->z);
-            //isect->r = rl[i-1] - dz[i-1] * (rl[i] - rl[i-1]) / (dz[i] - dz[i-1]);
-            isect->r = rl[i-1] - dz[i-1] * (rl[i] - rl[i-1]) / (dz[i] - dz[i-1]);
+            if (cursor != NULL){
+                *cursor = iSeg;
+            }
+            
+            isect->r = rIsect;
             isect->z = (isect->r - a->r) / (b->r - a->r) * (b->z - a->z) + a->z;
+            DEBUG(7,"Intersection point found at (%lf, %lf)\n", isect->r, isect->z);
             //prevent rounding errors:
             if (fabs(isect->z) < 1.0e-12){
                 isect->z = 0.0;
             }
             break;
-//TODO double check the last 20~ lines
     }
     DEBUG(4,"out\n");
 }
+
+double  evalCubic(double* c, double t, double* dfdt){
+    /*
+     * Evaluates c[0] + c[1]*t + c[2]*t^2 + c[3]*t^3 and its derivative at t.
+     */
+    *dfdt = c[1] + t * (2*c[2] + t * 3*c[3]);
+    return c[0] + t * (c[1] + t * (c[2] + t * c[3]));
+}
+
+bool    cubicFirstRoot(double* c, double t0, double t1, double* root){
+    /*
+     * Finds the root of the cubic polynomial c which is closest to t0 in the interval
+     * between t0 and t1 (t1 may be smaller than t0).
+     * Returns false if there is none.
+     */
+    double      tk[4];          //t0, the polynomial's extrema between t0 and t1, and t1
+    double      q, disc, temp;
+    double      lo, hi, fLo, fHi, f, dfdt, t, tNew;
+    uintptr_t   nk, k;
+    uint32_t    iter;
+    
+    //split the interval at the polynomial's extrema, i.e., the roots of c[1] + 2*c[2]*t + 3*c[3]*t^2:
+    nk = 0;
+    tk[nk++] = t0;
+    if (c[3] != 0){
+        disc = c[2]*c[2] - 3*c[1]*c[3];
+        if (disc > 0){
+            q = -(c[2] + copysign(sqrt(disc), c[2]));
+            tk[nk++] = q / (3*c[3]);
+            tk[nk++] = c[1] / q;
+        }
+    }else if (c[2] != 0){
+        tk[nk++] = -c[1] / (2*c[2]);
+    }
+    //discard the extrema outside of (t0, t1) and sort the others in the direction of t0 to t1:
+    k = 1;
+    while (k < nk){
+        if ((tk[k] - t0) * (t1 - tk[k]) <= 0){
+            tk[k] = tk[--nk];
+        }else{
+            k++;
+        }
+    }
+    if (nk == 3 && (tk[2] - tk[1]) * (t1 - t0) < 0){
+        temp  = tk[1];
+        tk[1] = tk[2];
+        tk[2] = temp;
+    }
+    tk[nk++] = t1;
+    
+    //find the first monotonic piece which changes sign (or in which c is zero):
+    fLo = evalCubic(c, t0, &dfdt);
+    for (k=1; k<nk; k++){
+        lo  = tk[k-1];
+        hi  = tk[k];
+        fHi = evalCubic(c, hi, &dfdt);
+        if (fLo * fHi <= 0){
+            //Newton's method, falling back to bisection when leaving the bracket [lo, hi]:
+            t = (fHi == fLo) ? hi : lo - fLo * (hi - lo) / (fHi - fLo);
+            for (iter=0; iter<BOUNDARY_ISECT_MAX_ITER; iter++){
+                f = evalCubic(c, t, &dfdt);
+                if (f == 0){
+                    break;
+                }
+                if ((f < 0) == (fLo < 0)){
+                    lo  = t;
+                    fLo = f;
+                }else{
+                    hi  = t;
+                }
+                tNew = (dfdt != 0) ? t - f / dfdt : 0.5 * (lo + hi);
+                if ((tNew - lo) * (hi - tNew) < 0){
+                    tNew = 0.5 * (lo + hi);
+                }
+                if (fabs(tNew - t) <= BOUNDARY_ISECT_TOLERANCE){
+                    t = tNew;
+                    break;
+                }
+                t = tNew;
+            }
+            *root = t;
+            return true;
+        }
+        fLo = fHi;
+    }
+    return false;
+}
@@ -48,6 +48,10 @@
 #include <inttypes.h>       //contains definitions of integer data types that are inequivocal.
 #include "tools.h"          
 #include "globals.h"        //Include global variables
+#include "csValues.c"
+#include "boundaryInterpolation.c"
+#include "boundaryProperties.c"
+#include "objectIndex.c"
 #include <math.h>
 
 //prototype:
@@ -400,6 +404,7 @@ void    readIn(settings_t* settings){
                     settings->soundSpeed.z[i]   = readDouble(inFile);
                     settings->soundSpeed.c1D[i]= readDouble(inFile);
                 }
+                initCValues1D(&settings->soundSpeed);
             }
             break;
         
@@ -428,8 +433,10 @@ void    readIn(settings_t* settings){
                     settings->soundSpeed.c2D[j][i] = readDouble(inFile);
                 }
             }
+            initCValues2D(&settings->soundSpeed);
             break;
     }
+    initCsValues(&settings->soundSpeed);
 
     /************************************************************************
      * Read and validate object info:                                       *
@@ -513,6 +520,8 @@ void    readIn(settings_t* settings){
             settings->objects.object[i].rho     = readDouble(inFile);               //density
             settings->objects.object[i].ap      = readDouble(inFile);               //compressional attenuation
             settings->objects.object[i].as      = readDouble(inFile);               //shear attenuation
+            settings->objects.object[i].reflTable.n = 0;
+            settings->objects.object[i].reflTable.g = NULL;
 
             //malloc memory for the object coordinates:
             settings->objects.object[i].r       = mallocDouble((uintptr_t)settings->objects.object[i].nCoords);
@@ -532,6 +541,7 @@ void    readIn(settings_t* settings){
             }
         }
     }
+    initObjectIndex(&settings->objects);
     
     /************************************************************************
      * Read and validate batimetry info:                                    *
@@ -785,6 +795,20 @@ void    readIn(settings_t* settings){
         fatal("Minimum batimetry range > minimum rbox range.\nAborting...");
     if(settings->batimetry.r[settings->batimetry.numSurfaceCoords-1] < settings->source.rbox2)
         fatal("Maximum batimetry range < maximum rbox range.\nAborting...");
+
+    /* Detect uniformly spaced lookup tables (see bracketUniform()) */
+    initUniformGrid(settings->altimetry.numSurfaceCoords, settings->altimetry.r, &settings->altimetry.rUniform);
+    initUniformGrid(settings->batimetry.numSurfaceCoords, settings->batimetry.r, &settings->batimetry.rUniform);
+    initBoundarySegments(&settings->altimetry);
+    initBoundarySegments(&settings->batimetry);
+    initBoundaryProperties(&settings->altimetry);
+    initBoundaryProperties(&settings->batimetry);
+    if(settings->soundSpeed.cClass == C_CLASS__TABULATED){
+        initUniformGrid(settings->soundSpeed.nz, settings->soundSpeed.z, &settings->soundSpeed.zUniform);
+    }
+    if(settings->soundSpeed.cDist == C_DIST__FIELD){
+        initUniformGrid(settings->soundSpeed.nr, settings->soundSpeed.r, &settings->soundSpeed.rUniform);
+    }
     DEBUG(1, "out\n");
 
     //close the input file
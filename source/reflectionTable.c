@@ -0,0 +1,196 @@
+/****************************************************************************************
+ * reflectionTable.c                                                                    *
+ * Tabulate the reflection coefficients of homogeneous elastic boundaries and objects   *
+ * (option '--reflectionTable <n>').                                                    *
+ *                                                                                      *
+ * ------------------------------------------------------------------------------------ *
+ * Website:                                                                             *
+ *          https://github.com/EyNuel/cTraceo/wiki                                      *
+ *                                                                                      *
+ * License: This file is part of the cTraceo Raytracing Model and is released under the *
+ *          Creative Commons Attribution-NonCommercial-ShareAlike 3.0 Unported License  *
+ *          http://creativecommons.org/licenses/by-nc-sa/3.0/                           *
+ *                                                                                      *
+ * NOTE:    cTraceo is research code under active development.                          *
+ *          The code may contain bugs and updates are possible in the future.           *
+ *                                                                                      *
+ * Written for project SENSOCEAN by:                                                    *
+ *          Emanuel Ey                                                                  *
+ *          emanuel.ey@gmail.com                                                        *
+ *          Copyright (C) 2011 - 2013                                                   *
+ *          Signal Processing Laboratory                                                *
+ *          Universidade do Algarve                                                     *
+ *                                                                                      *
+ * ------------------------------------------------------------------------------------ *
+ * The reflection coefficient is written as refl = (g*q - 1)/(g*q + 1), where q is the  *
+ * vertical slowness cos(theta)/c of the incident ray and g only depends on its         *
+ * horizontal slowness s = sin(theta)/c (see boundaryReflectionG()). g is tabulated at  *
+ * n equally spaced values of s, from 0 to 1.01 times the inverse of the lowest sound   *
+ * speed in the waveguide, and interpolated linearly, while q is computed exactly. The  *
+ * table is thus exact in the sound speed; its error is estimated at the midpoints      *
+ * between its points. Rays with a larger horizontal slowness, and tables computed for  *
+ * another frequency, fall back to boundaryReflectionCoeff().                           *
+ *                                                                                      *
+ ****************************************************************************************/
+
+#pragma     once
+#include    <complex.h>
+#include    <math.h>
+#include    "globals.h"
+#include    "tools.h"
+#include    "convertUnits.c"
+#include    "boundaryReflectionCoeff.c"
+
+#define REFL_TABLE_SSP_SAMPLES  101     //number of ranges and depths at which the sound speed is sampled
+
+void    soundSpeedRange(settings_t*, double*, double*);
+void    initReflectionTable(reflectionTable_t*, double, double, double, double, double, double, uint32_t, double, double*, double);
+void    initReflectionTables(settings_t*);
+bool    reflectionTableCoeff(const reflectionTable_t*, double, double, double, complex double*);
+
+void    soundSpeedRange(settings_t* settings, double* cMin, double* cMax){
+    /*
+     * Returns the lowest and highest sound speed on a grid spanning the ray box and the
+     * depths between the highest point of the surface and the lowest point of the bottom.
+     */
+    lookupCursor_t  cursor;
+    double          zMin, zMax, ri, zi, ci, cri, czi, crri, czzi, crzi;
+    uintptr_t       i, j;
+
+    zMin = settings->altimetry.z[0];
+    for(i=1; i<settings->altimetry.numSurfaceCoords; i++){
+        zMin = min(zMin, settings->altimetry.z[i]);
+    }
+    zMax = settings->batimetry.z[0];
+    for(i=1; i<settings->batimetry.numSurfaceCoords; i++){
+        zMax = max(zMax, settings->batimetry.z[i]);
+    }
+
+    *cMin = INFINITY;
+    *cMax = -INFINITY;
+    initLookupCursor(settings, &cursor);
+    for(i=0; i<REFL_TABLE_SSP_SAMPLES; i++){
+        ri = settings->source.rbox1 + (settings->source.rbox2 - settings->source.rbox1) * (double)i / (REFL_TABLE_SSP_SAMPLES - 1);
+        for(j=0; j<REFL_TABLE_SSP_SAMPLES; j++){
+            zi = zMin + (zMax - zMin) * (double)j / (REFL_TABLE_SSP_SAMPLES - 1);
+            settings->soundSpeed.cValues(&settings->soundSpeed, &cursor, ri, zi, &ci, &cri, &czi, &crri, &czzi, &crzi);
+            *cMin = min(*cMin, ci);
+            *cMax = max(*cMax, ci);
+        }
+    }
+    freeLookupCursor(&cursor);
+}
+
+void    initReflectionTable(reflectionTable_t* table, double rho1, double rho2, double cp2, double cs2, double ap, double as,
+                            uint32_t n, double sMax, double* cw, double freq){
+    /*
+     * Tabulates g (see header) for a boundary with the given properties (attenuations in dB/lambda)
+     * and estimates the table's maximum error for water sound speeds cw[0] and cw[1].
+     */
+    uint32_t        i, k;
+    double          s, ds, q;
+    complex double  g, gq, gTableQ;
+
+    table->n        = n;
+    table->freq     = freq;
+    table->maxError = 0;
+    table->g        = malloc(n * sizeof(complex double));
+    if(table->g == NULL){
+        fatal("Memory alocation error.");
+    }
+    ds = sMax / (double)(n - 1);
+    table->invDs = 1.0 / ds;
+    for(i=0; i<n; i++){
+        table->g[i] = boundaryReflectionG(rho1, rho2, cp2, cs2, ap, as, (double)i * ds);
+    }
+
+    //the error of linear interpolation is largest between the table's points:
+    for(i=0; i<n-1; i++){
+        s = ((double)i + 0.5) * ds;
+        g = boundaryReflectionG(rho1, rho2, cp2, cs2, ap, as, s);
+        for(k=0; k<2; k++){
+            if(s * cw[k] < 1.0){
+                q       = sqrt(1.0 / (cw[k] * cw[k]) - s * s);
+                gq      = g * q;
+                gTableQ = 0.5 * (table->g[i] + table->g[i+1]) * q;
+                table->maxError = max(table->maxError, cabs( (gTableQ - 1) / (gTableQ + 1) - (gq - 1) / (gq + 1) ));
+            }
+        }
+    }
+}
+
+void    initReflectionTables(settings_t* settings){
+    /*
+     * Computes the reflection coefficient tables of all homogeneous elastic boundaries and
+     * objects, if requested by option '--reflectionTable <n>'.
+     */
+    DEBUG(3,"in\n");
+    interface_t*    interface[2] = {&settings->altimetry, &settings->batimetry};
+    const char*     name[2]      = {"surface", "bottom"};
+    object_t*       object;
+    double          rho1 = 1.0;         //density of water (see solveEikonalEq())
+    double          freq = settings->source.freqx;
+    double          cw[2], sMax, lambda, ap, as;
+    uintptr_t       i;
+
+    if(settings->options.reflectionTable == 0){
+        return;
+    }
+    soundSpeedRange(settings, &cw[0], &cw[1]);
+    if(!(cw[0] > 0) || !isfinite(cw[1])){
+        printf("WARNING: could not determine the range of the sound speed; not using reflection coefficient tables.\n");
+        return;
+    }
+    sMax = 1.01 / cw[0];
+
+    for(i=0; i<2; i++){
+        if( interface[i]->surfaceType         == SURFACE_TYPE__ELASTIC &&
+            interface[i]->surfacePropertyType == SURFACE_PROPERTY_TYPE__HOMOGENEOUS){
+            lambda  = interface[i]->cp[0] / freq;
+            convertUnits(&interface[i]->ap[0], &lambda, &freq, &interface[i]->surfaceAttenUnits, &ap);
+            lambda  = interface[i]->cs[0] / freq;
+            convertUnits(&interface[i]->as[0], &lambda, &freq, &interface[i]->surfaceAttenUnits, &as);
+            initReflectionTable(&interface[i]->reflTable, rho1, interface[i]->rho[0], interface[i]->cp[0], interface[i]->cs[0],
+                                ap, as, settings->options.reflectionTable, sMax, cw, freq);
+            LOG("Reflection coefficient table of the %s: maximum interpolation error %.2e.\n", name[i], interface[i]->reflTable.maxError);
+        }
+    }
+    for(i=0; i<settings->objects.numObjects; i++){
+        object = &settings->objects.object[i];
+        if(object->surfaceType == SURFACE_TYPE__ELASTIC){
+            lambda  = object->cp / freq;
+            convertUnits(&object->ap, &lambda, &freq, &object->surfaceAttenUnits, &ap);
+            lambda  = object->cs / freq;
+            convertUnits(&object->as, &lambda, &freq, &object->surfaceAttenUnits, &as);
+            initReflectionTable(&object->reflTable, rho1, object->rho, object->cp, object->cs,
+                                ap, as, settings->options.reflectionTable, sMax, cw, freq);
+            LOG("Reflection coefficient table of object %u: maximum interpolation error %.2e.\n", (uint32_t)i+1, object->reflTable.maxError);
+        }
+    }
+    DEBUG(3,"out\n");
+}
+
+bool    reflectionTableCoeff(const reflectionTable_t* table, double freq, double ci, double theta, complex double* refl){
+    /*
+     * Interpolates the reflection coefficient at the angle theta (relative to the boundary's
+     * normal) for water with sound speed ci.
+     * Returns false if there is no table for the frequency freq or the ray's horizontal
+     * slowness is beyond the table; refl is not modified in this case.
+     */
+    double          x, w;
+    uintptr_t       k;
+    complex double  gq;
+
+    if(table->n == 0 || freq != table->freq){
+        return false;
+    }
+    x = fabs(sin(theta)) / ci * table->invDs;
+    if(!(x < (double)(table->n - 1))){
+        return false;
+    }
+    k   = (uintptr_t)x;
+    w   = x - (double)k;
+    gq  = ((1.0 - w) * table->g[k] + w * table->g[k+1]) * (cos(theta) / ci);
+    *refl = (gq - 1) / (gq + 1);
+    return true;
+}
@@ -0,0 +1,168 @@
+/****************************************************************************************
+ * rkdp45.c                                                                             *
+ * Perform adaptive Dormand-Prince 5(4) integration of the eikonal equations.           *
+ *                                                                                      *
+ * ------------------------------------------------------------------------------------ *
+ * Website:                                                                             *
+ *          https://github.com/EyNuel/cTraceo/wiki                                      *
+ *                                                                                      *
+ * License: This file is part of the cTraceo Raytracing Model and is released under the *
+ *          Creative Commons Attribution-NonCommercial-ShareAlike 3.0 Unported License  *
+ *          http://creativecommons.org/licenses/by-nc-sa/3.0/                           *
+ *                                                                                      *
+ * NOTE:    cTraceo is research code under active development.                          *
+ *          The code may contain bugs and updates are possible in the future.           *
+ *                                                                                      *
+ * Written for project SENSOCEAN by:                                                    *
+ *          Emanuel Ey                                                                  *
+ *          emanuel.ey@gmail.com                                                        *
+ *          Copyright (C) 2011 - 2013                                                   *
+ *          Signal Processing Laboratory                                                *
+ *          Universidade do Algarve                                                     *
+ *                                                                                      *
+ * ------------------------------------------------------------------------------------ *
+ * Used instead of rkf45() when option '--rkTolerance' is passed.                       *
+ * The last stage is evaluated at the new point ("first same as last"), so that fNew is *
+ * the first stage of the next step and an accepted step costs 6 sound speed            *
+ * evaluations. The error of the embedded 4th order solution is measured against        *
+ * the tolerance (in meters for the coordinates, relative to the slowness for the       *
+ * slowness vector); rkdp45StepFactor() derives the next step size from it.             *
+ *                                                                                      *
+ * Inputs:                                                                              *
+ *          cursor: Lookup cursor of the ray being traced.                              *
+ *          dsi:    Step size.                                                          *
+ *          yOld:   Vector containing initial value of y (see rkf45.c).                 *
+ *          fOld:   Vector containing initial value of F, as defined for yOld.          *
+ *                                                                                      *
+ * Outputs:                                                                             *
+ *          yNew:   Vector containing new values of of y.                               *
+ *          fNew:   Vector containing new values of of F.                               *
+ *          error:  Estimated error of the step, relative to the tolerance. The step    *
+ *                  is accepted by the calling function if error <= 1.                  *
+ *                                                                                      *
+ * Return Value:                                                                        *
+ *          None                                                                        *
+ *                                                                                      *
+ ****************************************************************************************/
+
+#pragma     once
+#include    "csValues.c"
+#include    "math.h"
+
+#define RK_SAFETY           0.9     //safety factor applied to the optimal step size
+#define RK_MIN_FACTOR       0.2     //a step shrinks by at most this factor...
+#define RK_MAX_FACTOR       5.0     //...and grows by at most this factor
+#define RK_MIN_STEP_FACTOR  1.0e-9  //a ray is killed when its step falls below this fraction of the maximum step
+
+
+void    rkdp45Derivative(settings_t*, lookupCursor_t*, double*, double*);
+void    rkdp45(settings_t*, lookupCursor_t*, double*, double*, double*, double*, double*, double*);
+double  rkdp45StepFactor(double);
+
+void    rkdp45Derivative(settings_t* settings, lookupCursor_t* cursor, double* y, double* f){
+    /*
+     * Evaluates F at y, i.e., the ray's tangent vector and the gradient of the slowness.
+     */
+    double      ci, cc, sigmaI, cri, czi, crri, czzi, crzi;
+    vector_t    slowness;
+
+    sigmaI = sqrt( y[2]*y[2] + y[3]*y[3] );
+    f[0] = y[2] / sigmaI;
+    f[1] = y[3] / sigmaI;
+    csValues(settings, cursor, y[0], y[1], &ci, &cc, &sigmaI, &cri, &czi, &slowness, &crri, &czzi, &crzi);
+    f[2] = slowness.r;
+    f[3] = slowness.z;
+}
+
+void    rkdp45(settings_t* settings, lookupCursor_t* cursor, double* dsi, double* yOld, double* fOld, double* yNew, double* fNew, double* error){
+    DEBUG(6,"in\n");
+    uintptr_t   j;
+    double      k2[4],k3[4],k4[4],k5[4],k6[4];
+    double      yk[4];
+    double      h = *dsi;
+    double      scale, sigmaOld, sigmaNew;
+
+    //Dormand-Prince coefficients (the first stage is fOld, the seventh is fNew):
+    #define DP_A21      (1.0/5.0)
+    #define DP_A31      (3.0/40.0)
+    #define DP_A32      (9.0/40.0)
+    #define DP_A41      (44.0/45.0)
+    #define DP_A42      (-56.0/15.0)
+    #define DP_A43      (32.0/9.0)
+    #define DP_A51      (19372.0/6561.0)
+    #define DP_A52      (-25360.0/2187.0)
+    #define DP_A53      (64448.0/6561.0)
+    #define DP_A54      (-212.0/729.0)
+    #define DP_A61      (9017.0/3168.0)
+    #define DP_A62      (-355.0/33.0)
+    #define DP_A63      (46732.0/5247.0)
+    #define DP_A64      (49.0/176.0)
+    #define DP_A65      (-5103.0/18656.0)
+    //5th order solution:
+    #define DP_B1       (35.0/384.0)
+    #define DP_B3       (500.0/1113.0)
+    #define DP_B4       (125.0/192.0)
+    #define DP_B5       (-2187.0/6784.0)
+    #define DP_B6       (11.0/84.0)
+    //difference between the 5th and the embedded 4th order solution:
+    #define DP_E1       (71.0/57600.0)
+    #define DP_E3       (-71.0/16695.0)
+    #define DP_E4       (71.0/1920.0)
+    #define DP_E5       (-17253.0/339200.0)
+    #define DP_E6       (22.0/525.0)
+    #define DP_E7       (-1.0/40.0)
+
+    for(j=0; j<4; j++){
+        yk[j] = yOld[j] + h * DP_A21*fOld[j];
+    }
+    rkdp45Derivative(settings, cursor, yk, k2);
+
+    for(j=0; j<4; j++){
+        yk[j] = yOld[j] + h * (DP_A31*fOld[j] + DP_A32*k2[j]);
+    }
+    rkdp45Derivative(settings, cursor, yk, k3);
+
+    for(j=0; j<4; j++){
+        yk[j] = yOld[j] + h * (DP_A41*fOld[j] + DP_A42*k2[j] + DP_A43*k3[j]);
+    }
+    rkdp45Derivative(settings, cursor, yk, k4);
+
+    for(j=0; j<4; j++){
+        yk[j] = yOld[j] + h * (DP_A51*fOld[j] + DP_A52*k2[j] + DP_A53*k3[j] + DP_A54*k4[j]);
+    }
+    rkdp45Derivative(settings, cursor, yk, k5);
+
+    for(j=0; j<4; j++){
+        yk[j] = yOld[j] + h * (DP_A61*fOld[j] + DP_A62*k2[j] + DP_A63*k3[j] + DP_A64*k4[j] + DP_A65*k5[j]);
+    }
+    rkdp45Derivative(settings, cursor, yk, k6);
+
+    for(j=0; j<4; j++){
+        yNew[j] = yOld[j] + h * (DP_B1*fOld[j] + DP_B3*k3[j] + DP_B4*k4[j] + DP_B5*k5[j] + DP_B6*k6[j]);
+    }
+    rkdp45Derivative(settings, cursor, yNew, fNew);
+
+    //maximum error of all components, relative to the tolerance:
+    sigmaOld = sqrt( yOld[2]*yOld[2] + yOld[3]*yOld[3] );
+    sigmaNew = sqrt( yNew[2]*yNew[2] + yNew[3]*yNew[3] );
+    *error = 0;
+    for(j=0; j<4; j++){
+        if(j < 2){
+            scale = settings->options.rkTolerance;
+        }else{
+            scale = settings->options.rkTolerance * max(sigmaOld, sigmaNew);
+        }
+        *error = max(*error, fabs( h * (DP_E1*fOld[j] + DP_E3*k3[j] + DP_E4*k4[j] + DP_E5*k5[j] + DP_E6*k6[j] + DP_E7*fNew[j])) / scale);
+    }
+    DEBUG(6,"out\n");
+}
+
+double  rkdp45StepFactor(double error){
+    /*
+     * Returns the factor by which to scale the last step size, given its error.
+     */
+    if(error <= 0){
+        return RK_MAX_FACTOR;
+    }
+    return min( RK_MAX_FACTOR, max( RK_MIN_FACTOR, RK_SAFETY * pow(error, -0.2)));
+}
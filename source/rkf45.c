@@ -31,6 +31,7 @@
  *                                                                                      *
  * ------------------------------------------------------------------------------------ *
  * Inputs:                                                                              *
+ *          cursor: Lookup cursor of the ray being traced.                              *
  *          dsi:    Step size used for interpolation (often callen h)                   *
  *          yOld:   Vector containing initial value of y:                               *
  *                      yOld[0]:    r:      range coordinate                            *
@@ -57,9 +58,9 @@
 #include    "math.h"
 
 
-void rkf45(settings_t*, double*, double*, double*, double*, double*, double*, double*);
+void rkf45(settings_t*, lookupCursor_t*, double*, double*, double*, double*, double*, double*, double*);
 
-void rkf45(settings_t* settings, double* dsi, double* yOld, double* fOld, double* yNew, double* fNew, double* ds4, double* ds5){
+void rkf45(settings_t* settings, lookupCursor_t* cursor, double* dsi, double* yOld, double* fOld, double* yNew, double* fNew, double* ds4, double* ds5){
     DEBUG(6,"in\n");
     uintptr_t   j;
     double      dr,dz;
@@ -95,10 +96,7 @@ void rkf45(settings_t* settings, double* dsi, double* yOld, double* fOld, double
     #define B5    (-9.0/50.0)
     #define B6     (2.0/55.0)
 
-    ri = yOld[0];
-    zi = yOld[1];
-    /* determine k1:                                            */
-    csValues(settings, ri, zi, &ci, &cc, &sigmaI, &cri, &czi, &slowness, &crri, &czzi, &crzi);
+    /* determine k1:         (F at yOld is known)           */
     for(j=0; j<4; j++){
         k1[j] = fOld[j];
         yk[j] = yOld[j] + 0.25 * (*dsi) * k1[j];
@@ -111,7 +109,7 @@ void rkf45(settings_t* settings, double* dsi, double* yOld, double* fOld, double
     sigmaI = sqrt( pow(sigmaR,2) + pow(sigmaZ,2) );
     es.r = (sigmaR)/(sigmaI);
     es.z = (sigmaZ)/(sigmaI);
-    csValues(settings, ri, zi, &ci, &cc, &sigmaI, &cri, &czi, &slowness, &crri, &czzi, &crzi);  //interpolate slowness vector
+    csValues(settings, cursor, ri, zi, &ci, &cc, &sigmaI, &cri, &czi, &slowness, &crri, &czzi, &crzi);  //interpolate slowness vector
     k2[0] = es.r;
     k2[1] = es.z;
     k2[2] = slowness.r;
@@ -128,7 +126,7 @@ void rkf45(settings_t* settings, double* dsi, double* yOld, double* fOld, double
     sigmaI = sqrt( pow(sigmaR,2) + pow(sigmaZ,2) );
     es.r = (sigmaR)/(sigmaI);
     es.z = (sigmaZ)/(sigmaI);
-    csValues(settings, ri, zi, &ci, &cc, &sigmaI, &cri, &czi, &slowness, &crri, &czzi, &crzi);
+    csValues(settings, cursor, ri, zi, &ci, &cc, &sigmaI, &cri, &czi, &slowness, &crri, &czzi, &crzi);
     k3[0] = es.r;
     k3[1] = es.z;
     k3[2] = slowness.r;
@@ -145,7 +143,7 @@ void rkf45(settings_t* settings, double* dsi, double* yOld, double* fOld, double
     sigmaI = sqrt( pow(sigmaR,2) + pow(sigmaZ,2) );
     es.r = (sigmaR)/(sigmaI);
     es.z = (sigmaZ)/(sigmaI);
-    csValues(settings, ri, zi, &ci, &cc, &sigmaI, &cri, &czi, &slowness, &crri, &czzi, &crzi);
+    csValues(settings, cursor, ri, zi, &ci, &cc, &sigmaI, &cri, &czi, &slowness, &crri, &czzi, &crzi);
     k4[0] = es.r;
     k4[1] = es.z;
     k4[2] = slowness.r;
@@ -162,7 +160,7 @@ void rkf45(settings_t* settings, double* dsi, double* yOld, double* fOld, double
     sigmaI = sqrt( pow(sigmaR,2) + pow(sigmaZ,2) );
     es.r = (sigmaR)/(sigmaI);
     es.z = (sigmaZ)/(sigmaI);
-    csValues(settings, ri, zi, &ci, &cc, &sigmaI, &cri, &czi, &slowness, &crri, &czzi, &crzi);
+    csValues(settings, cursor, ri, zi, &ci, &cc, &sigmaI, &cri, &czi, &slowness, &crri, &czzi, &crzi);
     k5[0] = es.r;
     k5[1] = es.z;
     k5[2] = slowness.r;
@@ -179,7 +177,7 @@ void rkf45(settings_t* settings, double* dsi, double* yOld, double* fOld, double
     sigmaI = sqrt( pow(sigmaR,2) + pow(sigmaZ,2) );
     es.r = (sigmaR)/(sigmaI);
     es.z = (sigmaZ)/(sigmaI);
-    csValues(settings, ri, zi, &ci, &cc, &sigmaI, &cri, &czi, &slowness, &crri, &czzi, &crzi);
+    csValues(settings, cursor, ri, zi, &ci, &cc, &sigmaI, &cri, &czi, &slowness, &crri, &czzi, &crzi);
     k6[0] = es.r;
     k6[1] = es.z;
     k6[2] = slowness.r;
@@ -209,7 +207,7 @@ void rkf45(settings_t* settings, double* dsi, double* yOld, double* fOld, double
     sigmaI = sqrt( pow(sigmaR,2) + pow(sigmaZ,2) );
     es.r = (sigmaR)/(sigmaI);
     es.z = (sigmaZ)/(sigmaI);
-    csValues(settings, ri, zi, &ci, &cc, &sigmaI, &cri, &czi, &slowness, &crri, &czzi, &crzi);
+    csValues(settings, cursor, ri, zi, &ci, &cc, &sigmaI, &cri, &czi, &slowness, &crri, &czzi, &crzi);
     fNew[0] = es.r;
     fNew[1] = es.z;
     fNew[2] = slowness.r;
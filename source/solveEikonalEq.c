@@ -52,11 +52,17 @@
 #include <math.h>
 #include "csValues.c"
 #include "rkf45.c"
+#include "rkdp45.c"
+#include "arcStep.c"
 #include "boundaryInterpolation.c"
+#include "boundaryProperties.c"
 #include "boundaryReflectionCoeff.c"
+#include "reflectionTable.c"
 #include "rayBoundaryIntersection.c"
+#include "objectIndex.c"
 #include "convertUnits.c"
 #include "specularReflection.c"
+#include "solveDynamicEq.c"
 #if VERBOSE && USE_MATLAB
     #include "mat.h"
     #include "matrix.h"
@@ -80,6 +86,7 @@ void    solveEikonalEq(settings_t* settings, ray_t* ray){
     vector_t        es = {0,0};             //ray's tangent vector
     vector_t        slowness = {0,0};
     vector_t        junkVector = {0,0};
+    boundaryProperties_t    properties;         //of non-homogeneous boundaries
     vector_t        normal = {0,0};
     vector_t        tauB = {0,0};
     vector_t        tauR = {0,0};
@@ -88,9 +95,11 @@ void    solveEikonalEq(settings_t* settings, ray_t* ray){
     double*         yNew            = mallocDouble(4);
     double*         fNew            = mallocDouble(4);
     double          dsi, ds4, ds5;
+    double          dsMax, dsNext;              //maximum and next step size of the adaptive Runge-Kutta integration
     double          stepError;
     double          ri, zi;
     double          altInterpolatedZ, batInterpolatedZ;
+    double          zMin, zMax;                 //depth bounds of a boundary (see boundaryDepthBounds())
     double          thetaRefl;
     point_t         pointA, pointB, pointIsect;
     double          rho1, rho2, cp2, cs2, ap, as, lambda, tempDouble = 0;
@@ -99,12 +108,20 @@ void    solveEikonalEq(settings_t* settings, ray_t* ray){
     uintptr_t       initialMemorySize;
     uint32_t        nObjCoords; //"noj"
     double          ziDown, ziUp;   //"zidn, ziup", interpolated height of upper/lower boundary of an object
+    lookupCursor_t  cursor;         //intervals of the last table lookups along this ray
+    dynamicPoint_t  dynPrev, dynCur, dynNext;   //sound speed derivatives at the last coordinates (see dynamicStep())
 
     //allocate memory for ray components:
     //TODO move memory allocation up one level -this should improve performance
     initialMemorySize = (uintptr_t)(fabs((settings->source.rbox2 - settings->source.rbox1)/settings->source.ds))*MEM_FACTOR;
     reallocRayMembers(ray, initialMemorySize);
     
+    initLookupCursor(settings, &cursor);
+    
+    //the adaptive Runge-Kutta integration starts with the ray step and never exceeds '--rkMaxStep':
+    dsMax   = (settings->options.rkMaxStep > 0) ? settings->options.rkMaxStep : settings->source.ds;
+    dsNext  = min( settings->source.ds, dsMax);
+    
     //set parameters:
     rho1 = 1.0;         //density of water.
     
@@ -117,6 +134,7 @@ void    solveEikonalEq(settings_t* settings, ray_t* ray){
     ray->iRefl[0] = jRefl;
 
     ray->iReturn = false;
+    ray->iBackscattered = false;
     numRungeKutta = 0;
     reflDecay = 1 + 0*I;
     ray->decay[0] = reflDecay;
@@ -126,12 +144,15 @@ void    solveEikonalEq(settings_t* settings, ray_t* ray){
     ray->rMin   = ray->r[0];
     ray->rMax   = ray->r[0];
     ray->z[0]   = settings->source.zx;
+    ray->es[0].r = cos( ray->theta );
+    ray->es[0].z = sin( ray->theta );
 
     es.r = cos( ray->theta );
     es.z = sin( ray->theta );
 
     //Calculate initial sound speed and its derivatives:
     csValues(   settings,
+                &cursor,
                 settings->source.rx,
                 settings->source.zx,
                 &cx,
@@ -152,6 +173,19 @@ void    solveEikonalEq(settings_t* settings, ray_t* ray){
     ray->s[0]   = 0;
     ray->ic[0]  = 0;
     
+    //initial conditions of the dynamic equations:
+    ray->p[0]       = 1;
+    ray->q[0]       = 0;
+    ray->caustc[0]  = 0;
+    dynCur.c        = cx;
+    dynCur.sigma    = sigmaI;
+    dynCur.gradC.r  = cri;
+    dynCur.gradC.z  = czi;
+    dynCur.crr      = crri;
+    dynCur.czz      = czzi;
+    dynCur.crz      = crzi;
+    dynPrev         = dynCur;
+    
     //prepare for Runge-Kutta-Fehlberg integration
     yOld[0] = settings->source.rx;
     yOld[1] = settings->source.zx;
@@ -174,20 +208,42 @@ void    solveEikonalEq(settings_t* settings, ray_t* ray){
             (ray->r[i] > settings->source.rbox1 )){
             //repeat while the ray is whithin the range box (rbox), and hasn't been killed by any other condition.
 
-        //Runge-Kutta integration:
-        dsi = settings->source.ds;
-        stepError = 1;
+        //closed-form step where the ray is a straight line or a circular arc (see '--arcStep'), Runge-Kutta integration otherwise:
         numRungeKutta = 0;
-        
-        while(stepError > 0.1){
-            if(numRungeKutta > 100){
-                fatal("Runge-Kutta integration: failure in step convergence.\nAborting...");
+        if(settings->options.arcStep && arcStep(settings, &cursor, (settings->options.rkTolerance > 0) ? dsMax : settings->source.ds, yOld, yNew, fNew)){
+            DEBUG(8, "closed-form step\n");
+            
+        }else if(settings->options.rkTolerance > 0){
+            //adaptive step (see '--rkTolerance'), starting from the step size estimated after the last step:
+            dsi = dsNext;
+            rkdp45(settings, &cursor, &dsi, yOld, fOld, yNew, fNew, &stepError);
+            
+            while(stepError > 1.0 && ray->iKill == false){
+                dsi *= rkdp45StepFactor(stepError);
+                numRungeKutta++;
+                if(dsi < RK_MIN_STEP_FACTOR * dsMax){
+                    printf("WARNING: Runge-Kutta integration: failure in step convergence; ray at angle %lf terminated.\n", ray->theta);
+                    ray->iKill = true;
+                }
+                rkdp45(settings, &cursor, &dsi, yOld, fOld, yNew, fNew, &stepError);
             }
-            rkf45(settings, &dsi, yOld, fOld, yNew, fNew, &ds4, &ds5);
+            dsNext = min( dsMax, dsi * rkdp45StepFactor(stepError));
+            
+        }else{
+            dsi = settings->source.ds;
+            stepError = 1;
             
-            numRungeKutta++;
-            stepError = fabs( ds4 - ds5) / (0.5 * (ds4 + ds5));
-            dsi *= 0.5;
+            while(stepError > 0.1 && ray->iKill == false){
+                if(numRungeKutta > 100){
+                    printf("WARNING: Runge-Kutta integration: failure in step convergence; ray at angle %lf terminated.\n", ray->theta);
+                    ray->iKill = true;
+                }
+                rkf45(settings, &cursor, &dsi, yOld, fOld, yNew, fNew, &ds4, &ds5);
+                
+                numRungeKutta++;
+                stepError = fabs( ds4 - ds5) / (0.5 * (ds4 + ds5));
+                dsi *= 0.5;
+            }
         }
         
         es.r = fNew[0];
@@ -206,8 +262,17 @@ void    solveEikonalEq(settings_t* settings, ray_t* ray){
                 (ri > settings->batimetry.r[0]) &&
                 (ri < settings->batimetry.r[settings->batimetry.numSurfaceCoords -1] ) ){
             DEBUG(7, "Calculate surface and bottom depth at current ray position: \n");
-            boundaryInterpolation(  &(settings->altimetry), ri, &altInterpolatedZ, &junkVector, &normal);
-            boundaryInterpolation(  &(settings->batimetry), ri, &batInterpolatedZ, &junkVector, &normal);
+            //where the ray is clear of a boundary's depth range in the current interval, the bound is enough:
+            if (boundaryDepthBounds(&(settings->altimetry), &cursor.iAltimetry, ri, &zMin, &zMax) && zi > zMax){
+                altInterpolatedZ = zMax;
+            }else{
+                boundaryInterpolation(  &(settings->altimetry), &cursor.iAltimetry, ri, &altInterpolatedZ, &junkVector, &normal);
+            }
+            if (boundaryDepthBounds(&(settings->batimetry), &cursor.iBatimetry, ri, &zMin, &zMax) && zi < zMin){
+                batInterpolatedZ = zMin;
+            }else{
+                boundaryInterpolation(  &(settings->batimetry), &cursor.iBatimetry, ri, &batInterpolatedZ, &junkVector, &normal);
+            }
         }else{
             DEBUG(8,"ray killed\n");
             ray->iKill = true;
@@ -231,7 +296,7 @@ void    solveEikonalEq(settings_t* settings, ray_t* ray){
             if (zi <= altInterpolatedZ){
                 DEBUG(5,"ray above surface.\n");
                 //determine the coordinates of the ray-boundary intersection:
-                rayBoundaryIntersection(&(settings->altimetry), &pointA, &pointB, &pointIsect);
+                rayBoundaryIntersection(&(settings->altimetry), &cursor.iAltimetry, &pointA, &pointB, &pointIsect);
                 ri = pointIsect.r;
                 zi = pointIsect.z;
                 //verify if the intersection point is identical to the first point:
@@ -242,7 +307,7 @@ void    solveEikonalEq(settings_t* settings, ray_t* ray){
                 */
                 
                 //get the boundary's normal and tangent vector:
-                boundaryInterpolation(  &(settings->altimetry), ri, &altInterpolatedZ, &tauB, &normal);
+                boundaryInterpolation(  &(settings->altimetry), &cursor.iAltimetry, ri, &altInterpolatedZ, &tauB, &normal);
                 ibdry = -1;
                 sRefl = sRefl + 1;
                 jRefl = 1;
@@ -257,7 +322,7 @@ void    solveEikonalEq(settings_t* settings, ray_t* ray){
                     DEBUG(5, "Next step is outside of rangeBox => terminate the ray.\n");
                     ray->iKill = true;
                 }else{
-                    boundaryInterpolation(  &(settings->altimetry), ri+settings->source.ds*tauR.r, &altInterpolatedZ, &tauB, &normal);
+                    boundaryInterpolation(  &(settings->altimetry), &cursor.iAltimetry, ri+settings->source.ds*tauR.r, &altInterpolatedZ, &tauB, &normal);
                     if ( (zi + settings->source.ds*tauR.z) < altInterpolatedZ){
                         DEBUG(5, "Ray is digging in above surface: %lf\n", ray->theta);
                         ray->iKill = true;
@@ -285,6 +350,9 @@ void    solveEikonalEq(settings_t* settings, ray_t* ray){
                         switch(settings->altimetry.surfacePropertyType){
                             
                             case SURFACE_PROPERTY_TYPE__HOMOGENEOUS:        //"H"
+                                if(reflectionTableCoeff(&settings->altimetry.reflTable, settings->source.freqx, ci, thetaRefl, &reflCoeff)){
+                                    break;
+                                }
                                 rho2= settings->altimetry.rho[0];
                                 cp2 = settings->altimetry.cp[0];
                                 cs2 = settings->altimetry.cs[0];
@@ -311,57 +379,12 @@ void    solveEikonalEq(settings_t* settings, ray_t* ray){
                             
                             case SURFACE_PROPERTY_TYPE__NON_HOMOGENEOUS:    //"N"
                                 //Non-Homogeneous interface =>rho, cp, cs, ap, as are variant with range, and thus have to be interpolated
-                                boundaryInterpolationExplicit(  &(settings->altimetry.numSurfaceCoords),
-                                                                settings->altimetry.r,
-                                                                settings->altimetry.rho,
-                                                                &(settings->altimetry.surfaceInterpolation),
-                                                                ri,
-                                                                &rho2,
-                                                                &junkVector,
-                                                                &junkVector
-                                                            );
-                                boundaryInterpolationExplicit(  &(settings->altimetry.numSurfaceCoords),
-                                                                settings->altimetry.r,
-                                                                settings->altimetry.cp,
-                                                                &(settings->altimetry.surfaceInterpolation),
-                                                                ri,
-                                                                &cp2,
-                                                                &junkVector,
-                                                                &junkVector
-                                                            );
-                                boundaryInterpolationExplicit(  &(settings->altimetry.numSurfaceCoords),
-                                                                settings->altimetry.r,
-                                                                settings->altimetry.cs,
-                                                                &(settings->altimetry.surfaceInterpolation),
-                                                                ri,
-                                                                &cs2,
-                                                                &junkVector,
-                                                                &junkVector
-                                                            );
-                                boundaryInterpolationExplicit(  &(settings->altimetry.numSurfaceCoords),
-                                                                settings->altimetry.r,
-                                                                settings->altimetry.ap,
-                                                                &(settings->altimetry.surfaceInterpolation),
-                                                                ri,
-                                                                &ap,
-                                                                &junkVector,
-                                                                &junkVector
-                                                            );
-                                boundaryInterpolationExplicit(  &(settings->altimetry.numSurfaceCoords),
-                                                                settings->altimetry.r,
-                                                                settings->altimetry.as,
-                                                                &(settings->altimetry.surfaceInterpolation),
-                                                                ri,
-                                                                &as,
-                                                                &junkVector,
-                                                                &junkVector
-                                                            );
-                                lambda = cp2/settings->source.freqx;
-                                convertUnits(&ap, &lambda, &settings->source.freqx, &settings->altimetry.surfaceAttenUnits, &tempDouble);
-                                ap = tempDouble;
-                                lambda = cs2/settings->source.freqx;
-                                convertUnits(&as, &lambda, &settings->source.freqx, &settings->altimetry.surfaceAttenUnits, &tempDouble);
-                                as = tempDouble;
+                                boundaryProperties(&settings->altimetry, &cursor.iAltimetry, ri, settings->source.freqx, &properties);
+                                rho2= properties.rho;
+                                cp2 = properties.cp;
+                                cs2 = properties.cs;
+                                ap  = properties.ap;
+                                as  = properties.as;
                                 boundaryReflectionCoeff(&rho1, &rho2, &ci, &cp2, &cs2, &ap, &as, &thetaRefl, &reflCoeff);
                                 break;
                             default:
@@ -393,12 +416,12 @@ void    solveEikonalEq(settings_t* settings, ray_t* ray){
             else if (zi >= batInterpolatedZ){  //  Ray below bottom?
                 DEBUG(5,"ray below bottom.\n");
                 DEBUG(8,"ri: %lf, zi: %lf\n", ri, zi);
-                rayBoundaryIntersection(&(settings->batimetry), &pointA, &pointB, &pointIsect);
+                rayBoundaryIntersection(&(settings->batimetry), &cursor.iBatimetry, &pointA, &pointB, &pointIsect);
                 ri = pointIsect.r;
                 zi = pointIsect.z;
                 
                 DEBUG(8,"ri: %lf, zi: %lf\n", ri, zi);
-                boundaryInterpolation(  &(settings->batimetry), ri, &batInterpolatedZ, &tauB, &normal);
+                boundaryInterpolation(  &(settings->batimetry), &cursor.iBatimetry, ri, &batInterpolatedZ, &tauB, &normal);
                 //Invert the normal at the bottom for reflection:
                 normal.r = -normal.r;   //NOTE: differs from altimetry
                 normal.z = -normal.z;   //NOTE: differs from altimetry
@@ -417,7 +440,7 @@ void    solveEikonalEq(settings_t* settings, ray_t* ray){
                     DEBUG(5, "Next step is outside of rangeBox => terminate the ray.\n");
                     ray->iKill = true;
                 }else{
-                    boundaryInterpolation(  &(settings->batimetry), ri+settings->source.ds*tauR.r, &batInterpolatedZ, &tauB, &normal);
+                    boundaryInterpolation(  &(settings->batimetry), &cursor.iBatimetry, ri+settings->source.ds*tauR.r, &batInterpolatedZ, &tauB, &normal);
                     if ( (zi + settings->source.ds*tauR.z) > batInterpolatedZ){
                         DEBUG(5, "Ray is digging in below bottom: %lf\n", ray->theta);
                         ray->iKill = true;
@@ -444,6 +467,9 @@ void    solveEikonalEq(settings_t* settings, ray_t* ray){
                         switch(settings->batimetry.surfacePropertyType){
                             
                             case SURFACE_PROPERTY_TYPE__HOMOGENEOUS:        //"H"
+                                if(reflectionTableCoeff(&settings->batimetry.reflTable, settings->source.freqx, ci, thetaRefl, &reflCoeff)){
+                                    break;
+                                }
                                 rho2= settings->batimetry.rho[0];
                                 cp2 = settings->batimetry.cp[0];
                                 cs2 = settings->batimetry.cs[0];
@@ -470,57 +496,12 @@ void    solveEikonalEq(settings_t* settings, ray_t* ray){
                             
                             case SURFACE_PROPERTY_TYPE__NON_HOMOGENEOUS:    //"N"
                                 //Non-Homogeneous interface =>rho, cp, cs, ap, as are variant with range, and thus have to be interpolated
-                                boundaryInterpolationExplicit(  &(settings->batimetry.numSurfaceCoords),
-                                                                settings->batimetry.r,
-                                                                settings->batimetry.rho,
-                                                                &(settings->batimetry.surfaceInterpolation),
-                                                                ri,
-                                                                &rho2,
-                                                                &junkVector,
-                                                                &junkVector
-                                                            );
-                                boundaryInterpolationExplicit(  &(settings->batimetry.numSurfaceCoords),
-                                                                settings->batimetry.r,
-                                                                settings->batimetry.cp,
-                                                                &(settings->batimetry.surfaceInterpolation),
-                                                                ri,
-                                                                &cp2,
-                                                                &junkVector,
-                                                                &junkVector
-                                                            );
-                                boundaryInterpolationExplicit(  &(settings->batimetry.numSurfaceCoords),
-                                                                settings->batimetry.r,
-                                                                settings->batimetry.cs,
-                                                                &(settings->batimetry.surfaceInterpolation),
-                                                                ri,
-                                                                &cs2,
-                                                                &junkVector,
-                                                                &junkVector
-                                                            );
-                                boundaryInterpolationExplicit(  &(settings->batimetry.numSurfaceCoords),
-                                                                settings->batimetry.r,
-                                                                settings->batimetry.ap,
-                                                                &(settings->batimetry.surfaceInterpolation),
-                                                                ri,
-                                                                &ap,
-                                                                &junkVector,
-                                                                &junkVector
-                                                            );
-                                boundaryInterpolationExplicit(  &(settings->batimetry.numSurfaceCoords),
-                                                                settings->batimetry.r,
-                                                                settings->batimetry.as,
-                                                                &(settings->batimetry.surfaceInterpolation),
-                                                                ri,
-                                                                &as,
-                                                                &junkVector,
-                                                                &junkVector
-                                                            );
-                                lambda = cp2/settings->source.freqx;
-                                convertUnits(&ap, &lambda, &settings->source.freqx, &settings->batimetry.surfaceAttenUnits, &tempDouble);
-                                ap = tempDouble;
-                                lambda = cs2/settings->source.freqx;
-                                convertUnits(&as, &lambda, &settings->source.freqx, &settings->batimetry.surfaceAttenUnits, &tempDouble);
-                                as = tempDouble;
+                                boundaryProperties(&settings->batimetry, &cursor.iBatimetry, ri, settings->source.freqx, &properties);
+                                rho2= properties.rho;
+                                cp2 = properties.cp;
+                                cs2 = properties.cs;
+                                ap  = properties.ap;
+                                as  = properties.as;
                                 boundaryReflectionCoeff(&rho1, &rho2, &ci, &cp2, &cs2, &ap, &as, &thetaRefl, &reflCoeff);
                                 break;
                             default:
@@ -546,7 +527,7 @@ void    solveEikonalEq(settings_t* settings, ray_t* ray){
             DEBUG(6, "Update marching solution and function: \n");
             ri = pointIsect.r;
             zi = pointIsect.z;
-            csValues(   settings, ri, zi, &ci, &cc, &sigmaI, &cri, &czi, &slowness, &crri, &czzi, &crzi);
+            csValues(   settings, &cursor, ri, zi, &ci, &cc, &sigmaI, &cri, &czi, &slowness, &crri, &czzi, &crzi);
             yNew[0] = ri;
             yNew[1] = zi;
             yNew[2] = sigmaI*tauR.r;
@@ -563,7 +544,8 @@ void    solveEikonalEq(settings_t* settings, ray_t* ray){
          *************************/
         DEBUG(5, "Check for object reflection: \n");
         if (settings->objects.numObjects > 0){
-            for(j=0; j<settings->objects.numObjects; j++){
+            //only the objects whose range contains ri need to be tested (see objectIndex.c):
+            for(j=0; nextObject(&settings->objects, &cursor.iObjectCell, ri, &j); j++){
                 nObjCoords = settings->objects.object[j].nCoords;
                 
                 DEBUG(7, "For each object detect if the ray is inside the object range: \n");
@@ -576,6 +558,8 @@ void    solveEikonalEq(settings_t* settings, ray_t* ray){
                     }
                     boundaryInterpolationExplicit(  &nObjCoords,
                                                     settings->objects.object[j].r,
+                                                    NULL,
+                                                    &cursor.iObject[j],
                                                     settings->objects.object[j].zDown,
                                                     &settings->objects.surfaceInterpolation,
                                                     ri,
@@ -584,6 +568,8 @@ void    solveEikonalEq(settings_t* settings, ray_t* ray){
                                                     &normal);
                     boundaryInterpolationExplicit(  &nObjCoords,
                                                     settings->objects.object[j].r,
+                                                    NULL,
+                                                    &cursor.iObject[j],
                                                     settings->objects.object[j].zUp,
                                                     &settings->objects.surfaceInterpolation,
                                                     ri,
@@ -613,6 +599,8 @@ void    solveEikonalEq(settings_t* settings, ray_t* ray){
                             DEBUG(7,"ri:%lf\n", yOld[0]);
                             boundaryInterpolationExplicit(  &nObjCoords,
                                                             settings->objects.object[j].r,
+                                                            NULL,
+                                                            &cursor.iObject[j],
                                                             settings->objects.object[j].zUp,
                                                             &settings->objects.surfaceInterpolation,
                                                             yOld[0],
@@ -621,6 +609,8 @@ void    solveEikonalEq(settings_t* settings, ray_t* ray){
                                                             &normal);
                             boundaryInterpolationExplicit(  &nObjCoords,
                                                             settings->objects.object[j].r,
+                                                            NULL,
+                                                            &cursor.iObject[j],
                                                             settings->objects.object[j].zDown,
                                                             &settings->objects.surfaceInterpolation,
                                                             yOld[0],
@@ -629,10 +619,10 @@ void    solveEikonalEq(settings_t* settings, ray_t* ray){
                                                             &normal);
                             DEBUG(7,"ri: %lf, ziDown: %lf, ziUp: %lf\n",ri, ziDown, ziUp);
                             if (yOld[1] < ziDown){
-                                rayObjectIntersection(&settings->objects, &j, DOWN, &pointA, &pointB, &pointIsect);
+                                rayObjectIntersection(&settings->objects, &cursor.iObject[j], &j, DOWN, &pointA, &pointB, &pointIsect);
                                 ibdry = -1;
                             }else{
-                                rayObjectIntersection(&settings->objects, &j, UP, &pointA, &pointB, &pointIsect);
+                                rayObjectIntersection(&settings->objects, &cursor.iObject[j], &j, UP, &pointA, &pointB, &pointIsect);
                                 ibdry = 1;
                             }
 
@@ -647,10 +637,10 @@ void    solveEikonalEq(settings_t* settings, ray_t* ray){
                             pointA.z = pointB.z -(pointB.z - pointA.z) / (pointB.r - pointA.r) * (pointB.r - settings->objects.object[j].r[0]);
                             pointA.r = settings->objects.object[j].r[0];
                             if (pointA.z < settings->objects.object[j].zUp[0]){
-                                rayObjectIntersection(&settings->objects, &j, DOWN, &pointA, &pointB, &pointIsect);
+                                rayObjectIntersection(&settings->objects, &cursor.iObject[j], &j, DOWN, &pointA, &pointB, &pointIsect);
                                 ibdry = -1;
                             }else{
-                                rayObjectIntersection(&settings->objects, &j, UP, &pointA, &pointB, &pointIsect);
+                                rayObjectIntersection(&settings->objects, &cursor.iObject[j], &j, UP, &pointA, &pointB, &pointIsect);
                                 ibdry =  1;
                             }
                             DEBUG(5, "Leaving case 2\n");
@@ -663,6 +653,8 @@ void    solveEikonalEq(settings_t* settings, ray_t* ray){
                             DEBUG(5,"Case 3: from right to left, beginning outside of box and ending inside:\n");
                             boundaryInterpolationExplicit(  &nObjCoords,
                                                             settings->objects.object[j].r,
+                                                            NULL,
+                                                            &cursor.iObject[j],
                                                             settings->objects.object[j].zUp,
                                                             &settings->objects.surfaceInterpolation,
                                                             yOld[0],
@@ -671,6 +663,8 @@ void    solveEikonalEq(settings_t* settings, ray_t* ray){
                                                             &normal);
                             boundaryInterpolationExplicit(  &nObjCoords,
                                                             settings->objects.object[j].r,
+                                                            NULL,
+                                                            &cursor.iObject[j],
                                                             settings->objects.object[j].zDown,
                                                             &settings->objects.surfaceInterpolation,
                                                             yOld[0],
@@ -679,10 +673,10 @@ void    solveEikonalEq(settings_t* settings, ray_t* ray){
                                                             &normal);
                             DEBUG(7,"ri: %lf, ziDown: %lf, ziUp: %lf\n",ri, ziDown, ziUp);
                             if (yOld[1] < ziDown){
-                                rayObjectIntersection(&settings->objects, &j, DOWN, &pointA, &pointB, &pointIsect);
+                                rayObjectIntersection(&settings->objects, &cursor.iObject[j], &j, DOWN, &pointA, &pointB, &pointIsect);
                                 ibdry = -1;
                             }else{
-                                rayObjectIntersection(&settings->objects, &j, UP, &pointA, &pointB, &pointIsect);
+                                rayObjectIntersection(&settings->objects, &cursor.iObject[j], &j, UP, &pointA, &pointB, &pointIsect);
                                 ibdry = 1;
                             }
 
@@ -696,10 +690,10 @@ void    solveEikonalEq(settings_t* settings, ray_t* ray){
                             pointA.z = pointB.z -(pointB.z - pointA.z) / (pointB.r - pointA.r) * (pointB.r - settings->objects.object[j].r[ nObjCoords-1 ]);
                             pointA.r = settings->objects.object[j].r[ nObjCoords-1 ];
                             if (pointA.z < settings->objects.object[j].zUp[ nObjCoords-1 ]){
-                                rayObjectIntersection(&settings->objects, &j, DOWN, &pointA, &pointB, &pointIsect);
+                                rayObjectIntersection(&settings->objects, &cursor.iObject[j], &j, DOWN, &pointA, &pointB, &pointIsect);
                                 ibdry = -1;
                             }else{
-                                rayObjectIntersection(&settings->objects, &j, UP, &pointA, &pointB, &pointIsect);
+                                rayObjectIntersection(&settings->objects, &cursor.iObject[j], &j, UP, &pointA, &pointB, &pointIsect);
                                 ibdry =  1;
                             }
                             
@@ -717,6 +711,8 @@ void    solveEikonalEq(settings_t* settings, ray_t* ray){
                         if (    ibdry == -1 ){  
                             boundaryInterpolationExplicit(  &nObjCoords,
                                                             settings->objects.object[j].r,
+                                                            NULL,
+                                                            &cursor.iObject[j],
                                                             settings->objects.object[j].zDown,
                                                             &settings->objects.surfaceInterpolation,
                                                             ri,
@@ -729,6 +725,8 @@ void    solveEikonalEq(settings_t* settings, ray_t* ray){
                         }else if (  ibdry == 1  ){
                             boundaryInterpolationExplicit(  &nObjCoords,
                                                             settings->objects.object[j].r,
+                                                            NULL,
+                                                            &cursor.iObject[j],
                                                             settings->objects.object[j].zUp,
                                                             &settings->objects.surfaceInterpolation,
                                                             ri,
@@ -766,6 +764,9 @@ void    solveEikonalEq(settings_t* settings, ray_t* ray){
                                 
                             case SURFACE_TYPE__ELASTIC:     //"E"
                                 DEBUG(5, "Object: SURFACE_TYPE__ELASTIC\n");
+                                if(reflectionTableCoeff(&settings->objects.object[j].reflTable, settings->source.freqx, ci, thetaRefl, &reflCoeff)){
+                                    break;
+                                }
                                 rho2= settings->objects.object[j].rho;
                                 cp2 = settings->objects.object[j].cp;
                                 cs2 = settings->objects.object[j].cs;
@@ -810,7 +811,7 @@ void    solveEikonalEq(settings_t* settings, ray_t* ray){
                         es.r = tauR.r;
                         es.z = tauR.z;
                         DEBUG(7, "Calculating sound speed parameters for next step...\n");
-                        csValues(   settings, ri, zi, &ci, &cc, &sigmaI, &cri, &czi, &slowness, &crri, &czzi, &crzi);
+                        csValues(   settings, &cursor, ri, zi, &ci, &cc, &sigmaI, &cri, &czi, &slowness, &crri, &czzi, &crzi);
                         DEBUG(7, "Sound speed parameters for next step calculated.\n");
                         
                         yNew[0] = ri;
@@ -836,7 +837,8 @@ void    solveEikonalEq(settings_t* settings, ray_t* ray){
         
         es.r = fNew[0];
         es.z = fNew[1];
-        csValues(   settings, ri, zi, &ci, &cc, &sigmaI, &cri, &czi, &slowness, &crri, &czzi, &crzi);
+        ray->es[i+1] = es;
+        csValues(   settings, &cursor, ri, zi, &ci, &cc, &sigmaI, &cri, &czi, &slowness, &crri, &czzi, &crzi);
         
         dr = ray->r[i+1] - ray->r[i];
         dz = ray->z[i+1] - ray->z[i];
@@ -868,6 +870,18 @@ void    solveEikonalEq(settings_t* settings, ray_t* ray){
         tauB.r          = 0.0;
         tauB.z          = 0.0;
         ray->decay[i+1] = reflDecay;
+        
+        //advance the dynamic equations, reusing the sound speed derivatives at the new coordinate:
+        dynNext.c       = ci;
+        dynNext.sigma   = sigmaI;
+        dynNext.gradC.r = cri;
+        dynNext.gradC.z = czi;
+        dynNext.crr     = crri;
+        dynNext.czz     = czzi;
+        dynNext.crz     = crzi;
+        dynamicStep(ray, i, &dynCur, &dynNext);
+        dynPrev = dynCur;
+        dynCur  = dynNext;
 
         for(j=0; j<4; j++){
             yOld[j] = yNew[j];
@@ -938,6 +952,10 @@ void    solveEikonalEq(settings_t* settings, ray_t* ray){
         ray->tau[ray->nCoords-1] = ray->tau[ray->nCoords-2] + (settings->source.rbox2 - ray->r[ray->nCoords-2])* dTau/dr;
         ray->r[  ray->nCoords-1] = settings->source.rbox2;
         
+        //redo the last step of the dynamic equations at the cut:
+        dynamicPoint(settings, &cursor, ray->r[ray->nCoords-1], ray->z[ray->nCoords-1], &dynNext);
+        dynamicStep(ray, ray->nCoords-2, &dynPrev, &dynNext);
+        
         //adjust memory size of the ray (we don't need more memory than nCoords)
         //TODO remove memmory reallocation -performance!
         reallocRayMembers(ray, ray->nCoords);
@@ -948,6 +966,10 @@ void    solveEikonalEq(settings_t* settings, ray_t* ray){
         ray->ic[ray->nCoords-1] = ray->ic[ray->nCoords-2] + (settings->source.rbox1-ray->r[ray->nCoords-2]) * dIc/dr;
         ray->r[ray->nCoords-1]  = settings->source.rbox1;
         
+        //redo the last step of the dynamic equations at the cut:
+        dynamicPoint(settings, &cursor, ray->r[ray->nCoords-1], ray->z[ray->nCoords-1], &dynNext);
+        dynamicStep(ray, ray->nCoords-2, &dynPrev, &dynNext);
+        
         //adjust memory size of the ray (we don't need more memory than nCoords)
         //TODO remove memmory reallocation -performance!
         reallocRayMembers(ray, ray->nCoords);
@@ -984,7 +1006,7 @@ void    solveEikonalEq(settings_t* settings, ray_t* ray){
                 DEBUG(3, "Truncated a backscattered ray.\n");
                 ray->nCoords = i+1;
                 ray->iReturn = false;   //as we're truncating the ray, we don't need to mark it as 'returning'
-                settings->options.nBackscatteredRays += 1;
+                ray->iBackscattered = true; //counted by the caller, so that this function doesn't modify the settings
                 break;
             }
         }
@@ -1006,5 +1028,6 @@ void    solveEikonalEq(settings_t* settings, ray_t* ray){
     free(fOld);
     free(yNew);
     free(fNew);
+    freeLookupCursor(&cursor);
     DEBUG(5,"out\n");
 }
@@ -3,3 +3,5 @@
 #include "toolsMisc.c"
 #include "toolsFileAccess.c"
 #include "toolsMatlab.c"
+#include "toolsThreads.c"
+#include "toolsShard.c"
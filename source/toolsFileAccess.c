@@ -32,7 +32,7 @@
 
 ///Prototypes:
 
-FILE*           openFile(const char* , const char[4]);
+FILE*           openFile(const char*, const char*);
 double          readDouble(FILE*);
 int32_t         readInt(FILE*);
 char*           readStringN(FILE*, uint32_t);
@@ -42,7 +42,7 @@ void            skipLine(FILE*);
 
 ///Functions:
 
-FILE*       openFile(const char *filename, const char mode[4]) {
+FILE*       openFile(const char *filename, const char *mode) {
     /* 
         Opens a file and returns a filepointer in case of success, exits with error code otherwise.
         Input values:
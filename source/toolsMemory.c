@@ -56,6 +56,8 @@ complex double* reallocComplex(complex double*, uintptr_t);
 void            freeComplex(complex double*);
 complex double** mallocComplex2D(uintptr_t, uintptr_t);
 void            freeComplex2D(complex double**, uintptr_t);
+complex double  (**mallocComplexStar2D(uintptr_t, uintptr_t))[3];
+void            freeComplexStar2D(complex double (**)[3], uintptr_t);
 
 settings_t*     mallocSettings(void);
 void            freeInterface(interface_t*);
@@ -67,7 +69,12 @@ point_t*        mallocPoint(uintptr_t);
 point_t*        reallocPoint(point_t*, uintptr_t);
 void            printSettings(settings_t*);
 ray_t*          makeRay(uintptr_t);
+arrival_t*      pushArrival(arrivalBuffer_t*, uintptr_t, uintptr_t);
+void            moveArrival(arrivalBuffer_t*, arrival_t*);
+void            freeArrivalBuffer(arrivalBuffer_t*);
 void            reallocRayMembers(ray_t*, uintptr_t);
+void            initLookupCursor(settings_t*, lookupCursor_t*);
+void            freeLookupCursor(lookupCursor_t*);
 
 
 
@@ -324,6 +331,51 @@ void                freeComplex2D(complex double** greenMile, uintptr_t items){
 
 
 
+complex double      (**mallocComplexStar2D(uintptr_t numRows, uintptr_t numCols))[3]{
+    /*
+     * Returns a 2D Array of "star" pressure contributions (3 complex values per element),
+     * as used for output.pressure_H and output.pressure_V.
+     * All elements are initialized to zero.
+     */
+
+    uintptr_t   i, j;
+    complex double  (**array)[3] = NULL;
+    array = malloc(numRows * sizeof(uintptr_t*));   //malloc an array of pointers
+    
+    if(array == NULL)
+        fatal("Memory allocation error.\n");
+
+    for(i = 0; i < numRows; i++){
+        array[i] = malloc(numCols * sizeof(complex double[3]));
+        if(array[i] == NULL)
+            fatal("Memory allocation error.\n");
+        
+        for(j = 0; j < numCols; j++){
+            array[i][j][0] = 0 + 0*I;
+            array[i][j][1] = 0 + 0*I;
+            array[i][j][2] = 0 + 0*I;
+        }
+    }
+
+    return array;
+}
+
+void                freeComplexStar2D(complex double (**greenMile)[3], uintptr_t items){
+    /*
+     * frees the memory allocated by mallocComplexStar2D().
+     */
+     uintptr_t  i;
+     
+    for(i=0; i<items; i++){
+        if(greenMile[i] != NULL){
+            free(greenMile[i]);
+        }
+    }
+    free(greenMile);
+}
+
+
+
 settings_t*         mallocSettings(void){
     /*
         Allocate memory for a settings structure.
@@ -339,21 +391,47 @@ settings_t*         mallocSettings(void){
     
     settings->altimetry.r = NULL;
     settings->altimetry.z = NULL;
+    settings->altimetry.rUniform.isUniform = false;
+    settings->altimetry.segments = NULL;
+    settings->altimetry.properties = NULL;
+    settings->altimetry.reflTable.n = 0;
+    settings->altimetry.reflTable.g = NULL;
     //settings->altimetry.surfaceProperties = NULL;
     
     settings->batimetry.r = NULL;
     settings->batimetry.z = NULL;
+    settings->batimetry.rUniform.isUniform = false;
+    settings->batimetry.segments = NULL;
+    settings->batimetry.properties = NULL;
+    settings->batimetry.reflTable.n = 0;
+    settings->batimetry.reflTable.g = NULL;
     //settings->batimetry.surfaceProperties = NULL;
     
+    settings->objects.nCells = 0;
+    settings->objects.cellR = NULL;
+    settings->objects.cellStart = NULL;
+    settings->objects.cellObjects = NULL;
+    
+    settings->soundSpeed.c1DCoeffs = NULL;
+    settings->soundSpeed.c2DCoeffs = NULL;
+    settings->soundSpeed.rUniform.isUniform = false;
+    settings->soundSpeed.zUniform.isUniform = false;
+    settings->soundSpeed.cValues = NULL;
+    
     settings->output.arrayR = NULL;
     settings->output.arrayZ = NULL;
+    settings->output.pressure2D = NULL;
+    settings->output.pressure_H = NULL;
+    settings->output.pressure_V = NULL;
     
     //default values for options:
     settings->options.caseTitle             = mallocChar((uintptr_t)(MAX_LINE_LEN + 1));
     settings->options.inFileName            = mallocChar(256);
+    settings->options.inFile                = NULL;
     settings->options.outputFileName        = NULL;
     settings->options.matfile               = NULL;
     settings->options.killBackscatteredRays = false;
+    settings->options.nBackscatteredRays    = 0;
     settings->options.writeHeader           = true;
     settings->options.writeLogFile          = true;
     settings->options.logFile               = NULL;
@@ -361,6 +439,22 @@ settings_t*         mallocSettings(void){
     settings->options.saveSSP               = false;
     settings->options.nSSPPoints            = 128;      //random value
     settings->options.sspFileName           = NULL;
+    settings->options.nThreads              = 1;
+    settings->options.rkTolerance           = 0;
+    settings->options.rkMaxStep             = 0;
+    settings->options.arcStep               = false;
+    settings->options.denseOutput           = false;
+    settings->options.reflectionTable       = 0;
+    settings->options.writeShard            = false;
+    settings->options.shardIndex            = 0;
+    settings->options.nShards               = 1;
+    settings->options.nx2dFileName          = NULL;
+    settings->options.ensembleFileName      = NULL;
+    settings->options.broadbandFileName     = NULL;
+    settings->options.sourcesFileName       = NULL;
+    settings->options.batchFileName         = NULL;
+    settings->options.nJobs                 = 1;
+    settings->options.runWorker             = false;
     
     return(settings);
 }
@@ -375,6 +469,9 @@ void                freeInterface(interface_t* interface){
         reallocDouble(interface->rho, 0);
         reallocDouble(interface->ap, 0);
         reallocDouble(interface->as, 0);
+        free(interface->segments);
+        free(interface->properties);
+        free(interface->reflTable.g);
         //free(interface);
     }
 }
@@ -384,7 +481,7 @@ void                freeSettings(settings_t* settings){
      * Go through all items in a settings struct and free the alocated memory.
      */
 
-    uintptr_t       i;
+    uintptr_t       i, dimR;
 
     if(settings != NULL){
         
@@ -409,11 +506,13 @@ void                freeSettings(settings_t* settings){
             switch (settings->soundSpeed.cDist){
                 case C_DIST__PROFILE:
                     freeDouble(settings->soundSpeed.c1D);
+                    freeDouble(settings->soundSpeed.c1DCoeffs);
                     break;
                     
                 case C_DIST__FIELD:
                     freeDouble(settings->soundSpeed.r);
                     freeDouble2D(settings->soundSpeed.c2D, settings->soundSpeed.nz);
+                    freeDouble(settings->soundSpeed.c2DCoeffs);
                     break;
                     
                 default:
@@ -432,8 +531,12 @@ void                freeSettings(settings_t* settings){
                         freeDouble(settings->objects.object[i].zDown);
                         freeDouble(settings->objects.object[i].zUp);
                     }
+                    free(settings->objects.object[i].reflTable.g);
                 }
                 free(settings->objects.object);
+                free(settings->objects.cellR);
+                free(settings->objects.cellStart);
+                free(settings->objects.cellObjects);
             }
         }
         
@@ -449,20 +552,15 @@ void                freeSettings(settings_t* settings){
                 freeDouble(settings->output.arrayZ);
             }
 
-            //TODO this is no longer corrrect => adapt to new layout of pressure2D
             //Acoustic pressure is only calculated for some types of output
-            if( settings->output.calcType == CALC_TYPE__COH_ACOUS_PRESS ||
-                settings->output.calcType == CALC_TYPE__COH_TRANS_LOSS  ||
-                settings->output.calcType == CALC_TYPE__PART_VEL        ||
-                settings->output.calcType == CALC_TYPE__COH_ACOUS_PRESS_PART_VEL){
-                    
-                if (settings->output.arrayType == ARRAY_TYPE__RECTANGULAR){
-                    if(settings->output.pressure2D != NULL){
-                        freeComplex2D(settings->output.pressure2D, settings->output.nArrayR);
-                    }
-                }else{
-                    //freeComplex(settings->output.pressure1D);
-                }
+            //(the first dimension of the pressure arrays is 1 for vertical arrays, see getPressureDims()):
+            dimR = (settings->output.arrayType == ARRAY_TYPE__VERTICAL) ? 1 : settings->output.nArrayR;
+            if(settings->output.pressure2D != NULL){
+                freeComplex2D(settings->output.pressure2D, dimR);
+            }
+            if(settings->output.pressure_H != NULL){
+                freeComplexStar2D(settings->output.pressure_H, dimR);
+                freeComplexStar2D(settings->output.pressure_V, dimR);
             }
         }
 
@@ -850,6 +948,7 @@ ray_t*              makeRay(uintptr_t numRays){
     for(i=0; i<numRays; i++){
         tempRay[i].r            = NULL;
         tempRay[i].z            = NULL;
+        tempRay[i].es           = NULL;
         tempRay[i].c            = NULL;
         tempRay[i].iRefl        = NULL;
         tempRay[i].decay        = NULL;
@@ -877,6 +976,7 @@ void                reallocRayMembers(ray_t* ray, uintptr_t numRayCoords){
     ray->nCoords    = numRayCoords;
     ray->r          = reallocDouble(    ray->r,         numRayCoords);
     ray->z          = reallocDouble(    ray->z,         numRayCoords);
+    ray->es         = reallocVector(    ray->es,        numRayCoords);
     ray->c          = reallocDouble(    ray->c,         numRayCoords);
     ray->iRefl      = reallocBool(      ray->iRefl,     numRayCoords);
     ray->decay      = reallocComplex(   ray->decay,     numRayCoords);
@@ -896,5 +996,101 @@ void                reallocRayMembers(ray_t* ray, uintptr_t numRayCoords){
     DEBUG(5,"reallocRayMembers(), \t out\n");
 }
 
+arrival_t*          pushArrival(arrivalBuffer_t* buffer, uintptr_t nCoords, uintptr_t nRefrac){
+    /*
+     * Appends an arrival to a buffer, allocating memory for nCoords ray coordinates
+     * and nRefrac refraction points. Returns a pointer to the new arrival.
+     * NOTE: buffers must be zero-initialized before first use.
+     */
+    arrival_t*  arrival = NULL;
+    
+    if(buffer->nArrivals == buffer->maxArrivals){
+        buffer->maxArrivals = max(2 * buffer->maxArrivals, 64);
+        buffer->arrival = realloc(buffer->arrival, buffer->maxArrivals * sizeof(arrival_t));
+        if(buffer->arrival == NULL){
+            fatal("Memory alocation error.");
+        }
+    }
+    arrival = &buffer->arrival[buffer->nArrivals];
+    buffer->nArrivals++;
+    
+    arrival->nCoords    = nCoords;
+    arrival->r          = mallocDouble(nCoords);
+    arrival->z          = mallocDouble(nCoords);
+    arrival->tau        = mallocDouble(nCoords);
+    arrival->amp        = mallocComplex(nCoords);
+    arrival->nRefrac    = (uint32_t)nRefrac;
+    arrival->rRefrac    = NULL;
+    arrival->zRefrac    = NULL;
+    if(nRefrac > 0){
+        arrival->rRefrac    = mallocDouble(nRefrac);
+        arrival->zRefrac    = mallocDouble(nRefrac);
+    }
+    return arrival;
+}
+
+void                moveArrival(arrivalBuffer_t* buffer, arrival_t* arrival){
+    /*
+     * Appends an arrival to a buffer without copying its coordinates;
+     * the buffer takes over ownership of the arrival's memory.
+     */
+    if(buffer->nArrivals == buffer->maxArrivals){
+        buffer->maxArrivals = max(2 * buffer->maxArrivals, 64);
+        buffer->arrival = realloc(buffer->arrival, buffer->maxArrivals * sizeof(arrival_t));
+        if(buffer->arrival == NULL){
+            fatal("Memory alocation error.");
+        }
+    }
+    buffer->arrival[buffer->nArrivals] = *arrival;
+    buffer->nArrivals++;
+}
+
+void                freeArrivalBuffer(arrivalBuffer_t* buffer){
+    /*
+     * Frees all arrivals contained in a buffer.
+     */
+    uintptr_t   i;
+    
+    for(i=0; i<buffer->nArrivals; i++){
+        free(buffer->arrival[i].r);
+        free(buffer->arrival[i].z);
+        free(buffer->arrival[i].tau);
+        free(buffer->arrival[i].amp);
+        if(buffer->arrival[i].nRefrac > 0){
+            free(buffer->arrival[i].rRefrac);
+            free(buffer->arrival[i].zRefrac);
+        }
+    }
+    free(buffer->arrival);
+    buffer->arrival     = NULL;
+    buffer->nArrivals   = 0;
+    buffer->maxArrivals = 0;
+}
 
+void                initLookupCursor(settings_t* settings, lookupCursor_t* cursor){
+    /*
+     * Resets a lookup cursor to the first interval of each table.
+     */
+    uintptr_t   j;
+
+    cursor->iSSPr       = 0;
+    cursor->iSSPz       = 0;
+    cursor->iAltimetry  = 0;
+    cursor->iBatimetry  = 0;
+    cursor->iObject     = NULL;
+    cursor->iObjectCell = 0;
+    if(settings->objects.numObjects > 0){
+        cursor->iObject = malloc(settings->objects.numObjects * sizeof(uintptr_t));
+        if(cursor->iObject == NULL){
+            fatal("Memory alocation error.");
+        }
+        for(j=0; j<settings->objects.numObjects; j++){
+            cursor->iObject[j] = 0;
+        }
+    }
+}
 
+void                freeLookupCursor(lookupCursor_t* cursor){
+    free(cursor->iObject);
+    cursor->iObject = NULL;
+}
@@ -42,6 +42,7 @@ double      max(double, double);
 void        fatal(const char*);
 void        printCpuTime(FILE*);
 char*       stringToLower(char* str);
+const char* getDefaultOutputFileName(uint32_t);
 
 
 ///Functions:
@@ -111,3 +112,40 @@ char*   stringToLower(char* str){
     
     return str;
 }
+
+const char* getDefaultOutputFileName(uint32_t calcType){
+    /*
+     * Returns the name of the output file used when '--outputFileName' is not passed.
+     */
+    switch(calcType){
+        case CALC_TYPE__RAY_COORDS:
+            return "rco.mat";
+
+        case CALC_TYPE__ALL_RAY_INFO:
+            return "ari.mat";
+
+        case CALC_TYPE__EIGENRAYS_PROXIMITY:
+        case CALC_TYPE__EIGENRAYS_REG_FALSI:
+            return "eig.mat";
+
+        case CALC_TYPE__AMP_DELAY_PROXIMITY:
+        case CALC_TYPE__AMP_DELAY_REG_FALSI:
+            return "aad.mat";
+
+        case CALC_TYPE__COH_ACOUS_PRESS:
+            return "cpr.mat";
+
+        case CALC_TYPE__COH_TRANS_LOSS:
+            return "ctl.mat";
+
+        case CALC_TYPE__PART_VEL:
+            return "pvl.mat";
+
+        case CALC_TYPE__COH_ACOUS_PRESS_PART_VEL:
+            return "pav.mat";
+
+        default:
+            fatal("Unknown output option.\nAborting...");
+            return NULL;
+    }
+}
@@ -0,0 +1,290 @@
+/****************************************************************************************
+ * toolsShard.c                                                                         *
+ * Collection of utility functions for splitting a run into slices of launching angles  *
+ * ("shards") which can be traced on separate machines and merged with ctraceo-merge.   *
+ *                                                                                      *
+ * ------------------------------------------------------------------------------------ *
+ * Website:                                                                             *
+ *          https://github.com/EyNuel/cTraceo/wiki                                      *
+ *                                                                                      *
+ * License: This file is part of the cTraceo Raytracing Model and is released under the *
+ *          Creative Commons Attribution-NonCommercial-ShareAlike 3.0 Unported License  *
+ *          http://creativecommons.org/licenses/by-nc-sa/3.0/                           *
+ *                                                                                      *
+ * NOTE:    cTraceo is research code under active development.                          *
+ *          The code may contain bugs and updates are possible in the future.           *
+ *                                                                                      *
+ * Written for project SENSOCEAN by:                                                    *
+ *          Emanuel Ey                                                                  *
+ *          emanuel.ey@gmail.com                                                        *
+ *          Copyright (C) 2011 - 2013                                                   *
+ *          Signal Processing Laboratory                                                *
+ *          Universidade do Algarve                                                     *
+ *                                                                                      *
+ * ------------------------------------------------------------------------------------ *
+ * Shard file format (native byte order; shards are meant to be merged on a machine     *
+ * of the same architecture):                                                           *
+ *          shardHeader_t, followed by                                                  *
+ *          CPR, CTL:   the complex pressure at each hydrophone [dimR][dimZ];           *
+ *          PVL, PAV:   the horizontal and vertical pressure components [dimR][dimZ][3];*
+ *          EPR, ADP:   the number of arrivals, followed by each arrival (see           *
+ *                      writeShardArrivals()), in order of launching angle.             *
+ *                                                                                      *
+ ****************************************************************************************/
+
+#pragma once
+#include    <stdio.h>
+#include    <stdlib.h>
+#include    <string.h>
+#include    <complex.h>
+#include    "globals.h"
+#include    "toolsMisc.c"
+#include    "toolsMemory.c"
+
+#define SHARD_MAGIC     "cTrShard"
+#define SHARD_VERSION   1
+
+
+///Types:
+
+typedef struct shardHeader{
+    /*
+     * Identifies a shard file and the run it belongs to.
+     * All members have the same size, so that the structure contains no padding.
+     */
+    char        magic[8];
+    uint64_t    version;
+    uint64_t    calcType;
+    uint64_t    arrayType;
+    uint64_t    nThetas;
+    uint64_t    nArrayR;
+    uint64_t    nArrayZ;
+    uint64_t    shardIndex;
+    uint64_t    nShards;
+    uint64_t    killBackscatteredRays;
+    uint64_t    nBackscatteredRays;
+}shardHeader_t;
+
+
+///Prototypes:
+
+void        getShardRange(settings_t*, uintptr_t*, uintptr_t*);
+bool        isShardable(uint32_t);
+void        writeShardData(FILE*, const void*, size_t, size_t);
+void        readShardData(FILE*, void*, size_t, size_t);
+void        writeShardHeader(FILE*, settings_t*);
+void        readShardHeader(FILE*, settings_t*, shardHeader_t*);
+void        writeShardPressure(FILE*, settings_t*, uintptr_t, uintptr_t);
+void        addShardPressure(FILE*, settings_t*, uintptr_t, uintptr_t);
+void        writeShardArrivals(FILE*, arrivalBuffer_t*);
+void        readShardArrivals(FILE*, arrivalBuffer_t*);
+
+
+///Functions:
+
+void        getShardRange(settings_t* settings, uintptr_t* iFirst, uintptr_t* iLast){
+    /*
+     * Returns the range [iFirst, iLast[ of launching angles to be traced in the current shard.
+     * Without '--shard', this covers all launching angles.
+     */
+    uint64_t    nThetas = settings->source.nThetas;
+
+    *iFirst = (uintptr_t)( nThetas *  settings->options.shardIndex      / settings->options.nShards);
+    *iLast  = (uintptr_t)( nThetas * (settings->options.shardIndex + 1) / settings->options.nShards);
+}
+
+
+bool        isShardable(uint32_t calcType){
+    /*
+     * Returns true for output options whose results can be split into shards.
+     */
+    switch(calcType){
+        case CALC_TYPE__EIGENRAYS_PROXIMITY:
+        case CALC_TYPE__AMP_DELAY_PROXIMITY:
+        case CALC_TYPE__COH_ACOUS_PRESS:
+        case CALC_TYPE__COH_TRANS_LOSS:
+        case CALC_TYPE__PART_VEL:
+        case CALC_TYPE__COH_ACOUS_PRESS_PART_VEL:
+            return true;
+
+        default:
+            return false;
+    }
+}
+
+
+void        writeShardData(FILE* shardFile, const void* data, size_t size, size_t n){
+    if(fwrite(data, size, n, shardFile) != n){
+        fatal("Could not write to shard file.\nAborting...");
+    }
+}
+
+
+void        readShardData(FILE* shardFile, void* data, size_t size, size_t n){
+    if(fread(data, size, n, shardFile) != n){
+        fatal("Shard file is truncated or corrupt.\nAborting...");
+    }
+}
+
+
+void        writeShardHeader(FILE* shardFile, settings_t* settings){
+    shardHeader_t   header;
+
+    memset(&header, 0, sizeof(shardHeader_t));
+    memcpy(header.magic, SHARD_MAGIC, 8);
+    header.version                  = SHARD_VERSION;
+    header.calcType                 = settings->output.calcType;
+    header.arrayType                = settings->output.arrayType;
+    header.nThetas                  = settings->source.nThetas;
+    header.nArrayR                  = settings->output.nArrayR;
+    header.nArrayZ                  = settings->output.nArrayZ;
+    header.shardIndex               = settings->options.shardIndex;
+    header.nShards                  = settings->options.nShards;
+    header.killBackscatteredRays    = settings->options.killBackscatteredRays;
+    header.nBackscatteredRays       = settings->options.nBackscatteredRays;
+
+    writeShardData(shardFile, &header, sizeof(shardHeader_t), 1);
+}
+
+
+void        readShardHeader(FILE* shardFile, settings_t* settings, shardHeader_t* header){
+    /*
+     * Reads a shard's header and verifies that the shard was created from the same input file.
+     */
+    readShardData(shardFile, header, sizeof(shardHeader_t), 1);
+
+    if(memcmp(header->magic, SHARD_MAGIC, 8) != 0 || header->version != SHARD_VERSION){
+        fatal("Not a cTraceo shard file (or created by a different version of cTraceo).\nAborting...");
+    }
+    if( header->calcType    != settings->output.calcType    ||
+        header->arrayType   != settings->output.arrayType   ||
+        header->nThetas     != settings->source.nThetas     ||
+        header->nArrayR     != settings->output.nArrayR     ||
+        header->nArrayZ     != settings->output.nArrayZ){
+        fatal("Shard file does not match the input file.\nAborting...");
+    }
+    if(header->nShards == 0 || header->shardIndex >= header->nShards){
+        fatal("Shard file is corrupt.\nAborting...");
+    }
+}
+
+
+void        writeShardPressure(FILE* shardFile, settings_t* settings, uintptr_t dimR, uintptr_t dimZ){
+    uintptr_t   j;
+
+    for(j=0; j<dimR; j++){
+        if( settings->output.calcType == CALC_TYPE__PART_VEL ||
+            settings->output.calcType == CALC_TYPE__COH_ACOUS_PRESS_PART_VEL){
+            writeShardData(shardFile, settings->output.pressure_H[j], 3*sizeof(complex double), dimZ);
+            writeShardData(shardFile, settings->output.pressure_V[j], 3*sizeof(complex double), dimZ);
+        }else{
+            writeShardData(shardFile, settings->output.pressure2D[j], sizeof(complex double), dimZ);
+        }
+    }
+}
+
+
+void        addShardPressure(FILE* shardFile, settings_t* settings, uintptr_t dimR, uintptr_t dimZ){
+    /*
+     * Reads a shard's pressure and adds it to the pressure in settings->output.
+     */
+    complex double      (*star)[3]  = malloc(dimZ * sizeof(complex double[3]));
+    complex double*     row         = mallocComplex(dimZ);
+    uintptr_t           j, k, l;
+
+    if(star == NULL){
+        fatal("Memory alocation error.");
+    }
+
+    for(j=0; j<dimR; j++){
+        if( settings->output.calcType == CALC_TYPE__PART_VEL ||
+            settings->output.calcType == CALC_TYPE__COH_ACOUS_PRESS_PART_VEL){
+            readShardData(shardFile, star, 3*sizeof(complex double), dimZ);
+            for(k=0; k<dimZ; k++){
+                for(l=0; l<3; l++){
+                    settings->output.pressure_H[j][k][l] += star[k][l];
+                }
+            }
+            readShardData(shardFile, star, 3*sizeof(complex double), dimZ);
+            for(k=0; k<dimZ; k++){
+                for(l=0; l<3; l++){
+                    settings->output.pressure_V[j][k][l] += star[k][l];
+                }
+            }
+        }else{
+            readShardData(shardFile, row, sizeof(complex double), dimZ);
+            for(k=0; k<dimZ; k++){
+                settings->output.pressure2D[j][k] += row[k];
+            }
+        }
+    }
+    free(star);
+    free(row);
+}
+
+
+void        writeShardArrivals(FILE* shardFile, arrivalBuffer_t* buffer){
+    uint64_t    n[9];
+    uintptr_t   i;
+    arrival_t*  arrival = NULL;
+
+    n[0] = buffer->nArrivals;
+    writeShardData(shardFile, n, sizeof(uint64_t), 1);
+
+    for(i=0; i<buffer->nArrivals; i++){
+        arrival = &buffer->arrival[i];
+        n[0] = arrival->iTheta;
+        n[1] = arrival->iHydR;
+        n[2] = arrival->iHydZ;
+        n[3] = arrival->nCoords;
+        n[4] = arrival->iReturn;
+        n[5] = arrival->sRefl;
+        n[6] = arrival->bRefl;
+        n[7] = arrival->oRefl;
+        n[8] = arrival->nRefrac;
+        writeShardData(shardFile, n, sizeof(uint64_t), 9);
+
+        writeShardData(shardFile, arrival->r,   sizeof(double),         arrival->nCoords);
+        writeShardData(shardFile, arrival->z,   sizeof(double),         arrival->nCoords);
+        writeShardData(shardFile, arrival->tau, sizeof(double),         arrival->nCoords);
+        writeShardData(shardFile, arrival->amp, sizeof(complex double), arrival->nCoords);
+        if(arrival->nRefrac > 0){
+            writeShardData(shardFile, arrival->rRefrac, sizeof(double), arrival->nRefrac);
+            writeShardData(shardFile, arrival->zRefrac, sizeof(double), arrival->nRefrac);
+        }
+    }
+}
+
+
+void        readShardArrivals(FILE* shardFile, arrivalBuffer_t* buffer){
+    /*
+     * Reads a shard's arrivals and appends them to a buffer.
+     */
+    uint64_t    n[9];
+    uint64_t    i, nArrivals;
+    arrival_t*  arrival = NULL;
+
+    readShardData(shardFile, &nArrivals, sizeof(uint64_t), 1);
+
+    for(i=0; i<nArrivals; i++){
+        readShardData(shardFile, n, sizeof(uint64_t), 9);
+
+        arrival = pushArrival(buffer, (uintptr_t)n[3], (uintptr_t)n[8]);
+        arrival->iTheta     = (uintptr_t)n[0];
+        arrival->iHydR      = (uintptr_t)n[1];
+        arrival->iHydZ      = (uintptr_t)n[2];
+        arrival->iReturn    = (bool)n[4];
+        arrival->sRefl      = (uint32_t)n[5];
+        arrival->bRefl      = (uint32_t)n[6];
+        arrival->oRefl      = (uint32_t)n[7];
+
+        readShardData(shardFile, arrival->r,   sizeof(double),          arrival->nCoords);
+        readShardData(shardFile, arrival->z,   sizeof(double),          arrival->nCoords);
+        readShardData(shardFile, arrival->tau, sizeof(double),          arrival->nCoords);
+        readShardData(shardFile, arrival->amp, sizeof(complex double),  arrival->nCoords);
+        if(arrival->nRefrac > 0){
+            readShardData(shardFile, arrival->rRefrac, sizeof(double),  arrival->nRefrac);
+            readShardData(shardFile, arrival->zRefrac, sizeof(double),  arrival->nRefrac);
+        }
+    }
+}
@@ -0,0 +1,242 @@
+/****************************************************************************************
+ * toolsThreads.c                                                                       *
+ * Collection of utility functions for running computations on multiple threads.      *
+ *                                                                                      *
+ * ------------------------------------------------------------------------------------ *
+ * Website:                                                                             *
+ *          https://github.com/EyNuel/cTraceo/wiki                                      *
+ *                                                                                      *
+ * License: This file is part of the cTraceo Raytracing Model and is released under the *
+ *          Creative Commons Attribution-NonCommercial-ShareAlike 3.0 Unported License  *
+ *          http://creativecommons.org/licenses/by-nc-sa/3.0/                           *
+ *                                                                                      *
+ * NOTE:    cTraceo is research code under active development.                          *
+ *          The code may contain bugs and updates are possible in the future.           *
+ *                                                                                      *
+ * Written for project SENSOCEAN by:                                                    *
+ *          Emanuel Ey                                                                  *
+ *          emanuel.ey@gmail.com                                                        *
+ *          Copyright (C) 2011 - 2013                                                   *
+ *          Signal Processing Laboratory                                                *
+ *          Universidade do Algarve                                                     *
+ *                                                                                      *
+ ****************************************************************************************/
+
+#pragma once
+#include    <pthread.h>
+#include    <stdlib.h>
+#include    "globals.h"
+#include    "toolsMisc.c"
+#include    "toolsMemory.c"
+
+
+///Types:
+
+typedef struct rayPipeline{
+    /*
+     * Ordered producer/consumer pipeline for ray output options (RCO, ARI).
+     * Worker threads trace rays in any order into the ray slots; the calling
+     * thread consumes them strictly in order of launching angle.
+     * At most 'window' rays are held in memory at any time.
+     */
+    settings_t*     settings;
+    bool            (*trace)(settings_t*, ray_t*, uintptr_t);
+    ray_t*          ray;
+    bool*           done;           //ray has been processed by a worker
+    bool*           traced;         //return value of trace()
+    uintptr_t       nRays;
+    uintptr_t       nextRay;        //next ray to be handed to a worker
+    uintptr_t       nReleased;      //number of rays consumed by the writer
+    uintptr_t       window;
+    uint32_t        nThreads;
+    pthread_t*      threads;
+    pthread_mutex_t lock;
+    pthread_cond_t  rayDone;
+    pthread_cond_t  slotFree;
+}rayPipeline_t;
+
+
+///Prototypes:
+
+void        runThreads(uint32_t, void* (*)(void*), void*, size_t);
+void*       rayPipelineWorker(void*);
+void        startRayPipeline(rayPipeline_t*, settings_t*, uint32_t, uintptr_t, bool (*)(settings_t*, ray_t*, uintptr_t));
+ray_t*      waitForRay(rayPipeline_t*, uintptr_t, bool*);
+void        releaseRay(rayPipeline_t*, uintptr_t);
+void        stopRayPipeline(rayPipeline_t*);
+
+
+///Functions:
+
+void        runThreads(uint32_t nThreads, void* (*worker)(void*), void* args, size_t argSize){
+    /*
+     * Runs 'worker' on nThreads threads and waits for all of them to finish.
+     * 'args' points to an array of nThreads structures of argSize bytes each;
+     * thread i is passed a pointer to the i-th structure.
+     * When a single thread is requested the worker is called directly, so
+     * that serial runs behave exactly as before.
+     */
+    pthread_t*  threads = NULL;
+    uint32_t    i;
+    
+    if(nThreads <= 1){
+        worker(args);
+        return;
+    }
+    
+    threads = malloc(nThreads * sizeof(pthread_t));
+    if(threads == NULL){
+        fatal("Memory alocation error.");
+    }
+    
+    for(i=0; i<nThreads; i++){
+        if(pthread_create(&threads[i], NULL, worker, (char*)args + i*argSize) != 0){
+            fatal("Could not create worker thread.\nAborting...");
+        }
+    }
+    for(i=0; i<nThreads; i++){
+        if(pthread_join(threads[i], NULL) != 0){
+            fatal("Could not join worker thread.\nAborting...");
+        }
+    }
+    free(threads);
+}
+
+
+void*       rayPipelineWorker(void* args){
+    /*
+     * Takes the next ray (if it fits into the window), traces it and hands it to the writer.
+     */
+    rayPipeline_t*  pipe = (rayPipeline_t*)args;
+    uintptr_t       i;
+    bool            traced;
+    
+    while(true){
+        pthread_mutex_lock(&pipe->lock);
+        while(pipe->nextRay < pipe->nRays && pipe->nextRay >= pipe->nReleased + pipe->window){
+            pthread_cond_wait(&pipe->slotFree, &pipe->lock);
+        }
+        if(pipe->nextRay >= pipe->nRays){
+            pthread_mutex_unlock(&pipe->lock);
+            return NULL;
+        }
+        i = pipe->nextRay++;
+        pthread_mutex_unlock(&pipe->lock);
+        
+        traced = pipe->trace(pipe->settings, &pipe->ray[i], i);
+        
+        pthread_mutex_lock(&pipe->lock);
+        pipe->traced[i] = traced;
+        pipe->done[i]   = true;
+        pthread_cond_broadcast(&pipe->rayDone);
+        pthread_mutex_unlock(&pipe->lock);
+    }
+}
+
+
+void        startRayPipeline(rayPipeline_t* pipe, settings_t* settings, uint32_t nThreads, uintptr_t nRays, bool (*trace)(settings_t*, ray_t*, uintptr_t)){
+    /*
+     * Sets up the pipeline and starts nThreads workers.
+     * 'trace' is called once per ray index and returns whether the ray was traced.
+     * With a single thread no workers are started: rays are traced by waitForRay()
+     * on the calling thread, exactly as in a serial loop.
+     */
+    uintptr_t   i;
+    
+    pipe->settings  = settings;
+    pipe->trace     = trace;
+    pipe->nRays     = nRays;
+    pipe->nextRay   = 0;
+    pipe->nReleased = 0;
+    pipe->nThreads  = nThreads;
+    pipe->window    = 4 * (uintptr_t)nThreads;
+    pipe->threads   = NULL;
+    pipe->ray       = makeRay(nRays);
+    pipe->done      = mallocBool(nRays);
+    pipe->traced    = mallocBool(nRays);
+    for(i=0; i<nRays; i++){
+        pipe->done[i]   = false;
+        pipe->traced[i] = false;
+    }
+    
+    if(nThreads <= 1){
+        return;
+    }
+    
+    if( pthread_mutex_init(&pipe->lock, NULL) != 0 ||
+        pthread_cond_init(&pipe->rayDone, NULL) != 0 ||
+        pthread_cond_init(&pipe->slotFree, NULL) != 0){
+        fatal("Could not initialize thread synchronization.\nAborting...");
+    }
+    pipe->threads = malloc(nThreads * sizeof(pthread_t));
+    if(pipe->threads == NULL){
+        fatal("Memory alocation error.");
+    }
+    for(i=0; i<nThreads; i++){
+        if(pthread_create(&pipe->threads[i], NULL, rayPipelineWorker, pipe) != 0){
+            fatal("Could not create worker thread.\nAborting...");
+        }
+    }
+}
+
+
+ray_t*      waitForRay(rayPipeline_t* pipe, uintptr_t i, bool* traced){
+    /*
+     * Blocks until ray i is available and returns it.
+     * Rays must be requested in order and released with releaseRay() before the next one is requested.
+     */
+    if(pipe->nThreads <= 1){
+        pipe->traced[i] = pipe->trace(pipe->settings, &pipe->ray[i], i);
+        pipe->done[i]   = true;
+    }else{
+        pthread_mutex_lock(&pipe->lock);
+        while(pipe->done[i] == false){
+            pthread_cond_wait(&pipe->rayDone, &pipe->lock);
+        }
+        pthread_mutex_unlock(&pipe->lock);
+    }
+    *traced = pipe->traced[i];
+    return &pipe->ray[i];
+}
+
+
+void        releaseRay(rayPipeline_t* pipe, uintptr_t i){
+    /*
+     * Frees a ray's memory once it has been written, making room for the next ray in the window.
+     */
+    if(pipe->traced[i]){
+        reallocRayMembers(&pipe->ray[i], 0);
+    }
+    
+    if(pipe->nThreads <= 1){
+        pipe->nReleased = i+1;
+        return;
+    }
+    pthread_mutex_lock(&pipe->lock);
+    pipe->nReleased = i+1;
+    pthread_cond_broadcast(&pipe->slotFree);
+    pthread_mutex_unlock(&pipe->lock);
+}
+
+
+void        stopRayPipeline(rayPipeline_t* pipe){
+    /*
+     * Waits for all workers to finish and frees the pipeline's memory.
+     */
+    uint32_t    i;
+    
+    if(pipe->nThreads > 1){
+        for(i=0; i<pipe->nThreads; i++){
+            if(pthread_join(pipe->threads[i], NULL) != 0){
+                fatal("Could not join worker thread.\nAborting...");
+            }
+        }
+        free(pipe->threads);
+        pthread_mutex_destroy(&pipe->lock);
+        pthread_cond_destroy(&pipe->rayDone);
+        pthread_cond_destroy(&pipe->slotFree);
+    }
+    free(pipe->ray);
+    free(pipe->done);
+    free(pipe->traced);
+}
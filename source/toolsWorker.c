@@ -0,0 +1,102 @@
+/****************************************************************************************
+ * toolsWorker.c                                                                        *
+ * Collection of utility functions for the persistent worker mode (see '--worker'),     *
+ * in which cases are read from stdin and results written to stdout as framed records.  *
+ *                                                                                      *
+ * ------------------------------------------------------------------------------------ *
+ * Website:                                                                             *
+ *          https://github.com/EyNuel/cTraceo/wiki                                      *
+ *                                                                                      *
+ * License: This file is part of the cTraceo Raytracing Model and is released under the *
+ *          Creative Commons Attribution-NonCommercial-ShareAlike 3.0 Unported License  *
+ *          http://creativecommons.org/licenses/by-nc-sa/3.0/                           *
+ *                                                                                      *
+ * NOTE:    cTraceo is research code under active development.                          *
+ *          The code may contain bugs and updates are possible in the future.           *
+ *                                                                                      *
+ * Written for project SENSOCEAN by:                                                    *
+ *          Emanuel Ey                                                                  *
+ *          emanuel.ey@gmail.com                                                        *
+ *          Copyright (C) 2011 - 2013                                                   *
+ *          Signal Processing Laboratory                                                *
+ *          Universidade do Algarve                                                     *
+ *                                                                                      *
+ * ------------------------------------------------------------------------------------ *
+ * Record format (native byte order, as for shard files):                               *
+ *          uint64_t    the number of bytes which follow, N;                            *
+ *          N bytes     the payload.                                                    *
+ *                                                                                      *
+ * A request's payload is the contents of an input file ('.in'); a reply's payload is   *
+ * the contents of the '.mat' file a regular run of the same case would write.          *
+ * Requests are answered in order; an empty request or the end of stdin terminates the  *
+ * worker. A case which fails (e.g., because its input file is invalid) is answered by  *
+ * an error record: a length of WORKER_REPLY_ERROR without payload. The error message   *
+ * is written to stderr and the worker goes on with the next request.                   *
+ *                                                                                      *
+ * NOTE:    Each case runs in a child process of the worker, so that errors can not     *
+ *          affect later cases. Everything derived from an input file (interpolation    *
+ *          coefficients, uniform grids, boundary segments, object index, property and  *
+ *          reflection tables) is rebuilt for every request, even if parts of it are    *
+ *          unchanged: this takes about 1 ms per case, next to tens of ms or more for   *
+ *          tracing the rays.                                                           *
+ *                                                                                      *
+ ****************************************************************************************/
+
+#pragma once
+#include    <stdio.h>
+#include    <stdlib.h>
+#include    <stdbool.h>
+#include    "globals.h"
+#include    "toolsMisc.c"
+
+#define     WORKER_REPLY_ERROR  UINT64_MAX  //reserved record length, marks a failed case
+
+
+///Prototypes:
+
+bool        readWorkerRequest(FILE*, char**, uint64_t*, uint64_t*);
+void        writeWorkerReply(FILE*, const char*, uint64_t);
+void        writeWorkerError(FILE*);
+
+
+///Functions:
+
+bool        readWorkerRequest(FILE* stream, char** buffer, uint64_t* bufferSize, uint64_t* nBytes){
+    /*
+     * Reads the next request from stream into buffer, which is grown as needed and
+     * is reused between requests. Returns false when the worker should terminate.
+     */
+    if(fread(nBytes, sizeof(uint64_t), 1, stream) != 1 || *nBytes == 0){
+        return false;
+    }
+    if(*nBytes > *bufferSize){
+        *buffer = realloc(*buffer, (size_t)*nBytes);
+        if(*buffer == NULL){
+            fatal("Memory alocation error.");
+        }
+        *bufferSize = *nBytes;
+    }
+    if(fread(*buffer, 1, (size_t)*nBytes, stream) != (size_t)*nBytes){
+        fatal("Worker: request is truncated.\nAborting...");
+    }
+    return true;
+}
+
+
+void        writeWorkerReply(FILE* stream, const char* payload, uint64_t nBytes){
+    if( fwrite(&nBytes, sizeof(uint64_t), 1, stream) != 1 ||
+        fwrite(payload, 1, (size_t)nBytes, stream) != (size_t)nBytes ||
+        fflush(stream) != 0){
+        fatal("Worker: could not write reply.\nAborting...");
+    }
+}
+
+
+void        writeWorkerError(FILE* stream){
+    uint64_t    nBytes = WORKER_REPLY_ERROR;
+    
+    if( fwrite(&nBytes, sizeof(uint64_t), 1, stream) != 1 ||
+        fflush(stream) != 0){
+        fatal("Worker: could not write reply.\nAborting...");
+    }
+}